@@ -32,7 +32,11 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include "clif.h"
@@ -60,6 +64,7 @@ struct clif  *clif_open()
 		return NULL;
 	}
 
+	clif->tail = &clif->head;
 	clif->local.sun_family = AF_LOCAL;
 	clif->local.sun_path[0] = '\0';
 	snprintf(&clif->local.sun_path[1], sizeof(clif->local.sun_path) - 1,
@@ -88,15 +93,194 @@ struct clif  *clif_open()
 	return clif;
 }
 
-void clif_close(struct clif *clif)
+/* Outstanding asynchronous request */
+struct clif_req {
+	struct clif_req *next;
+	unsigned int tag;
+	long long expires;		/* Monotonic time in ms */
+	clif_reply_cb cb;
+	void *ctx;
+};
+
+static long long clif_now(void)
 {
-	close(clif->s);
-	free(clif);
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void clif_complete(struct clif *clif, struct clif_req **pp,
+			  int status, char *reply, size_t reply_len)
+{
+	struct clif_req *req = *pp;
+
+	*pp = req->next;
+	if (!*pp)
+		clif->tail = pp;
+	req->cb(clif, req->ctx, status, reply, reply_len);
+	free(req);
+}
+
+/*
+ * Convert a fixed number of hex digits. The buffer is not necessarily
+ * nul terminated.
+ */
+static int hexnum(const char *s, int digits, unsigned int *val)
+{
+	for (*val = 0; digits > 0; --digits, ++s) {
+		if (!isxdigit(*s))
+			return -1;
+		*val <<= 4;
+		*val |= isdigit(*s) ? *s - '0' : tolower(*s) - 'a' + 10;
+	}
+	return 0;
+}
+
+/*
+ * Pass a reply to the callback of its request, matched by tag. Untagged
+ * messages are dropped.
+ * Returns 1 if a request was completed and 0 otherwise.
+ */
+static int clif_deliver(struct clif *clif, char *msg, size_t len)
+{
+	struct clif_req **pp = &clif->head;
+	unsigned int tag, status;
+
+	if (len < CLIF_TAG_HDR || msg[MSG_TYPE] != TAG_CMD
+	    || hexnum(msg + CLIF_TAG_OFF, CLIF_TAG_LEN, &tag))
+		return 0;
+	while (*pp && (*pp)->tag != tag)
+		pp = &(*pp)->next;
+	if (!*pp)
+		return 0;
+	msg += CLIF_TAG_HDR;
+	len -= CLIF_TAG_HDR;
+	if (len < CLIF_RSP_OFF || msg[MSG_TYPE] != CMD_RESPONSE
+	    || hexnum(msg + CLIF_STAT_OFF, CLIF_STAT_LEN, &status)) {
+		clif_complete(clif, pp, -EBADMSG, NULL, 0);
+		return 1;
+	}
+	clif_complete(clif, pp, status, msg, len);
+	return 1;
+}
+
+static int clif_is_event(const char *msg, size_t len)
+{
+	return (len > 0 && msg[MSG_TYPE] == EVENT_MSG) ||
+	       (msg[MSG_TYPE] == MOD_CMD && len > MOD_MSG_TYPE &&
+		msg[MOD_MSG_TYPE] == EVENT_MSG);
 }
 
+int clif_submit(struct clif *clif, const char *cmd, size_t cmd_len,
+		clif_reply_cb cb, void *ctx)
+{
+	char buf[MAX_CLIF_MSGBUF];
+	struct clif_req *req;
+	int version;
+
+	if (!cb || cmd_len + CLIF_TAG_HDR > sizeof(buf))
+		return -EINVAL;
+	/* Older lldpad versions would leave the request to time out */
+	version = clif_version(clif);
+	if (version < 0)
+		return version;
+	if (version < CLIF_MSG_VERSION_TAG)
+		return -EOPNOTSUPP;
+	req = malloc(sizeof(*req));
+	if (!req)
+		return -ENOMEM;
+	/* Tags are positive and unique among the outstanding requests */
+	if (++clif->tag > 0x7fffffff)
+		clif->tag = 1;
+	req->next = NULL;
+	req->tag = clif->tag;
+	req->expires = clif_now() + CMD_RESPONSE_TIMEOUT * 1000;
+	req->cb = cb;
+	req->ctx = ctx;
+
+	snprintf(buf, sizeof(buf), "%c%08x", TAG_CMD, req->tag);
+	memcpy(buf + CLIF_TAG_HDR, cmd, cmd_len);
+	if (send(clif->s, buf, cmd_len + CLIF_TAG_HDR, MSG_DONTWAIT) < 0) {
+		int rc = errno == EWOULDBLOCK ? -EAGAIN : -errno;
+
+		free(req);
+		return rc;
+	}
+	*clif->tail = req;
+	clif->tail = &req->next;
+	return req->tag;
+}
+
+int clif_dispatch(struct clif *clif, void (*msg_cb)(char *msg, size_t len))
+{
+	char buf[MAX_CLIF_MSGBUF];
+	struct clif_req **pp;
+	long long now;
+	int res, done = 0;
+
+	for (;;) {
+		res = recv(clif->s, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+		if (clif_is_event(buf, res)) {
+			if (msg_cb) {
+				buf[res] = '\0';
+				msg_cb(buf, res);
+			}
+			continue;
+		}
+		done += clif_deliver(clif, buf, res);
+	}
+
+	now = clif_now();
+	for (pp = &clif->head; *pp; ) {
+		if ((*pp)->expires <= now) {
+			clif_complete(clif, pp, -ETIMEDOUT, NULL, 0);
+			++done;
+		} else {
+			pp = &(*pp)->next;
+		}
+	}
+	return done;
+}
+
+int clif_timeout(struct clif *clif)
+{
+	struct clif_req *req;
+	long long now, first = -1;
+
+	for (req = clif->head; req; req = req->next)
+		if (first < 0 || req->expires < first)
+			first = req->expires;
+	if (first < 0)
+		return -1;
+	now = clif_now();
+	return first > now ? (int)(first - now) : 0;
+}
 
+unsigned int clif_outstanding(struct clif *clif)
+{
+	struct clif_req *req;
+	unsigned int n = 0;
 
+	for (req = clif->head; req; req = req->next)
+		++n;
+	return n;
+}
 
+void clif_close(struct clif *clif)
+{
+	while (clif->head)
+		clif_complete(clif, &clif->head, -ECANCELED, NULL, 0);
+	close(clif->s);
+	free(clif);
+}
 
 int clif_request(struct clif *clif, const char *cmd, size_t cmd_len,
 		     char *reply, size_t *reply_len,
@@ -107,6 +291,7 @@ int clif_request(struct clif *clif, const char *cmd, size_t cmd_len,
 	fd_set rfds;
 	const char *_cmd;
 	size_t _cmd_len;
+	char buf[MAX_CLIF_MSGBUF];
 
 	_cmd = cmd;
 	_cmd_len = cmd_len;
@@ -121,11 +306,19 @@ int clif_request(struct clif *clif, const char *cmd, size_t cmd_len,
 		FD_SET(clif->s, &rfds);
 		res = select(clif->s + 1, &rfds, NULL, NULL, &tv);
 		if (FD_ISSET(clif->s, &rfds)) {
-			res = recv(clif->s, reply, *reply_len, 0);
+			res = recv(clif->s, buf, sizeof(buf), 0);
 			if (res < 0) {
 				printf("less then zero\n");
 				return res;
 			}
+			/* Reply to a request from clif_submit() */
+			if (res > 0 && buf[MSG_TYPE] == TAG_CMD) {
+				clif_deliver(clif, buf, res);
+				continue;
+			}
+			if ((size_t)res > *reply_len)
+				res = *reply_len;
+			memcpy(reply, buf, res);
 			if ((res > 0 && reply[MSG_TYPE] == EVENT_MSG) ||
 			   ((reply[MSG_TYPE] == MOD_CMD) &&
 			    (res > MOD_MSG_TYPE) &&
@@ -237,6 +430,36 @@ int clif_get_fd(struct clif *clif)
 	return clif->s;
 }
 
+int clif_version(struct clif *clif)
+{
+	char buf[MAX_CLIF_MSGBUF];
+	size_t len = sizeof(buf) - 1;
+	unsigned int version;
+	int ret;
+
+	if (clif->version)
+		return clif->version;
+	ret = clif_request(clif, "V", 1, buf, &len, NULL);
+	if (ret < 0)
+		return ret;
+	if (len < CLIF_RSP_OFF + 3 || buf[CLIF_RSP_OFF] != VERSION_CMD
+	    || hexnum(buf + CLIF_RSP_OFF + 1, 2, &version))
+		version = CLIF_MSG_VERSION;
+	clif->version = version;
+	return version;
+}
+
+const void *clif_reply_data(const char *reply, size_t reply_len, size_t *len)
+{
+	const char *p = memchr(reply, '\0', reply_len);
+
+	if (!p)
+		return NULL;
+	++p;
+	*len = reply_len - (p - reply);
+	return p;
+}
+
 /*
  * Get PID of lldpad from 'ping' command
  */
@@ -285,12 +508,13 @@ out:
  * Includes for lldptool like access to lldpad
  */
 #include <stdbool.h>
-#include <ctype.h>
 #include <errno.h>
 #include "include/qbg22.h"
 #include "include/qbg_vdp22_clif.h"	/* Defines op_XXXX */
 #include <sys/queue.h>			/* Needed by agent.h */
 #include "lldp/agent.h"			/* Nearest customer bridge define */
+#include "include/qbg_vdp22def.h"	/* Defines VSI22_ARG_XXX_STR */
+#include <time.h>
 
 /*
  * Send a command via clif_xxx to lldpad.
@@ -409,25 +633,110 @@ int clif_vsievt(struct clif *clif, char *reply, size_t *reply_len, int wait)
 	}
 	return -EAGAIN;
 }
+/*
+ * Search the sequence number in a list of VSI arguments. Each argument
+ * consists of 2 hex digits name length, the name, 4 hex digits value length
+ * and the value.
+ *
+ * Returns the sequence number or zero if none found.
+ */
+static unsigned long find_seq(char *s, size_t len)
+{
+	char *end = s + len;
+	char no[24];
+	unsigned int klen, vlen;
+
+	while (end - s > 2 && !hexnum(s, 2, &klen)) {
+		s += 2;
+		if ((size_t)(end - s) < klen + 4
+		    || hexnum(s + klen, 4, &vlen)
+		    || (size_t)(end - s) < klen + 4 + vlen)
+			break;
+		if (klen == strlen(VSI22_ARG_SEQ_STR) && vlen < sizeof(no)
+		    && !strncmp(s, VSI22_ARG_SEQ_STR, klen)) {
+			memcpy(no, s + klen + 4, vlen);
+			no[vlen] = '\0';
+			return strtoul(no, NULL, 10);
+		}
+		s += klen + 4 + vlen;
+	}
+	return 0;
+}
+
+/*
+ * Return the sequence number lldpad assigned to an accepted VSI command.
+ * The reply starts with the status and the command header, the VSI arguments
+ * follow the TLV identifier.
+ */
+unsigned long clif_vsiseq(char *reply, size_t reply_len)
+{
+	unsigned int iflen;
+	size_t off = CLIF_RSP_OFF + CMD_IF;
+
+	if (reply_len < off || reply[CLIF_RSP_OFF] != CMD_REQUEST
+	    || hexnum(reply + CLIF_RSP_OFF + CMD_IF_LEN, 2, &iflen))
+		return 0;
+	off += iflen + 2 * sizeof(unsigned int);
+	if (off >= reply_len)
+		return 0;
+	return find_seq(reply + off, reply_len - off);
+}
+
+/*
+ * Wait for a VSI completion event message and return the sequence number
+ * of the request it completes. The sequence number is zero for events
+ * not caused by a command from an attached client, for example a
+ * disassociation initiated by the switch.
+ */
+int clif_vsicompl(struct clif *clif, char *reply, size_t *reply_len,
+		  unsigned long *seq, int wait)
+{
+	int rc;
+	unsigned int vsi_len;
+
+	*seq = 0;
+	rc = clif_vsievt(clif, reply, reply_len, wait);
+	if (!rc && *reply_len > 4 && !hexnum(reply, 4, &vsi_len)
+	    && vsi_len <= *reply_len - 4)
+		*seq = find_seq(reply + 4, vsi_len);
+	return rc;
+}
+
 /*
  * Send a VSI command to the vdp22 mode and expect a reply. The reply can
  * an aknowledgement (error code 0) or an error code != 0 which means the
  * command contained an error and was not accepted.
  *
  * Wait for the event message from lldpad to return the VSI association data
- * from the switch
+ * from the switch. Event messages completing other requests are skipped.
+ * If lldpad does not return a sequence number, the first event message is
+ * taken.
  */
 int clif_vsiwait(struct clif *connp, char *ifname, unsigned int tlvid,
 		 char *cmd, char *reply, size_t *reply_len, int wait)
 {
 	int rc;
-	size_t reply_len2 = *reply_len;
+	size_t reply_len2;
+	unsigned long seq, evtseq;
+	time_t end = time(NULL) + wait;
 
-	rc = clif_vsi(connp, ifname, tlvid, cmd, reply, reply_len);
-	if (!rc) {
-		rc = clif_vsievt(connp, reply, &reply_len2, wait);
-		if (!rc)
+	reply_len2 = *reply_len;
+	rc = clif_vsi(connp, ifname, tlvid, cmd, reply, &reply_len2);
+	if (rc)
+		return rc;
+	seq = clif_vsiseq(reply, reply_len2);
+	for (;;) {
+		reply_len2 = *reply_len;
+		rc = clif_vsicompl(connp, reply, &reply_len2, &evtseq, wait);
+		if (!rc && (!seq || seq == evtseq)) {
 			*reply_len = reply_len2;
+			break;
+		}
+		if (rc && rc != -EBADF)	/* -EBADF: no event message */
+			break;
+		wait = end - time(NULL);
+		if (wait < 0)
+			wait = 0;
 	}
 	return rc;
 }
@@ -24,6 +24,8 @@
 
 *******************************************************************************/
 
+#define _GNU_SOURCE
+
 #include <syslog.h>
 #include <string.h>
 #include <stdlib.h>
@@ -35,6 +37,7 @@
 #include <linux/sockios.h>
 #include <net/if.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "eloop.h"
 #include "lldpad.h"
 #include "lldp.h"
@@ -44,6 +47,9 @@
 #include "lldp_util.h"
 #include "lldp_mod.h"
 #include "lldp_mand_clif.h"
+#include "lldp_mand_cmds.h"
+#include "lldp_dcbx_cfg.h"
+#include "clif_msgs.h"
 #include "lldp_med.h"
 #include "dcb_protocol.h"
 #include "dcb_persist_store.h"
@@ -52,9 +58,47 @@
 #include "lldpad_status.h"
 #include "lldp_mod.h"
 #include "event_iface.h"
+#include "shard.h"
+#include "lldpad_ckpt.h"
+#include "lldp_rtnl.h"
 
 config_t lldpad_cfg;
 
+/*
+ * Serializes access to lldpad_cfg between the shards. Recursive, the
+ * setting functions call each other and the DCBX configuration functions.
+ */
+static pthread_mutex_t cfg_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void cfg_lock(void)
+{
+	pthread_mutex_lock(&cfg_mutex);
+}
+
+void cfg_unlock(void)
+{
+	pthread_mutex_unlock(&cfg_mutex);
+}
+
+/* Set while a reload applies the new file, which must not be rewritten */
+static int cfg_nosave;
+
+/*
+ * write_cfg - write lldpad_cfg back to the configuration file
+ *
+ * Returns CONFIG_TRUE for success and CONFIG_FALSE for failure.
+ */
+int write_cfg(void)
+{
+	int rc = CONFIG_TRUE;
+
+	cfg_lock();
+	if (!cfg_nosave)
+		rc = config_write_file(&lldpad_cfg, cfg_file_name);
+	cfg_unlock();
+	return rc;
+}
+
 /*
  * init_cfg - initialze the global lldpad_cfg via config_init
  *
@@ -67,6 +111,7 @@ int init_cfg(void)
 	const char *p;
 	int err = 1;
 
+	cfg_lock();
 	config_init(&lldpad_cfg);
 
 	if (check_cfg_file()) {
@@ -84,6 +129,7 @@ int init_cfg(void)
 		    !config_read_file(&lldpad_cfg, cfg_file_name))
 			err = 0;
 	}
+	cfg_unlock();
 	return err;
 }
 
@@ -96,7 +142,9 @@ int init_cfg(void)
  */
 void destroy_cfg(void)
 {
+	cfg_lock();
 	config_destroy(&lldpad_cfg);
+	cfg_unlock();
 }
 
 void scan_port(UNUSED void *eloop_data, UNUSED void *user_ctx)
@@ -152,7 +200,7 @@ void scan_port(UNUSED void *eloop_data, UNUSED void *user_ctx)
 		char *ifname = p->if_name;
 		struct lldp_agent *agent;
 
-		if (!is_valid_lldp_device(ifname))
+		if (!shard_mine(p->if_index) || !is_valid_lldp_device(ifname))
 			continue;
 
 		port = port_find_by_ifindex(p->if_index);
@@ -189,7 +237,9 @@ error_out:
 
 void create_default_cfg_file(void)
 {
-	config_write_file(&lldpad_cfg, cfg_file_name);
+	cfg_lock();
+	write_cfg();
+	cfg_unlock();
 }
 
 /* check for existence of cfg file.  If it does not exist,
@@ -344,50 +394,136 @@ int get_array_config(config_setting_t *s, char *attr, int int_type,
 	return rval;
 }
 
-void init_ports(void)
+/*
+ * Ports are brought up in batches, the event loop runs in between so that
+ * the first ports start transmitting while the rest are initialized.
+ */
+#define PORT_INIT_BATCH	64
+
+struct port_init {
+	struct rtnl_link *links;
+	int count;
+	int next;
+};
+
+static __thread struct port_init *port_init;
+
+static int is_valid_lldp_link(const struct rtnl_link *link)
+{
+	if (link->flags & IFF_LOOPBACK)
+		return 0;
+	if (!strcmp(link->kind, "vlan") || !strcmp(link->kind, "bridge") ||
+	    !strcmp(link->kind, "macvtap") || !strcmp(link->kind, "macvlan"))
+		return 0;
+	return 1;
+}
+
+static void init_port(const struct rtnl_link *link)
 {
 	struct lldp_module *np;
-	struct if_nameindex *nameidx, *p;
 	struct port *port;
 	struct lldp_agent *agent;
+	const char *ifname = link->ifname;
 
-	nameidx = if_nameindex();
-	if (nameidx == NULL) {
-		LLDPAD_DBG("error calling if_nameindex()\n");
+	/* Added by a link event meanwhile */
+	if (port_find_by_ifindex(link->ifindex))
 		return;
-	}
 
-	for (p = nameidx; p->if_index; ++p) {
-		int valid = is_valid_lldp_device(p->if_name);
+	port = add_port(link->ifindex, ifname);
+	if (!port) {
+		LLDPAD_ERR("%s: Error adding device %s\n", __func__, ifname);
+		return;
+	}
+	if (!link->carrier)
+		return;
 
-		if (!valid)
-			continue;
+	lldp_add_agents(port);
 
-		port = add_port(p->if_index, p->if_name);
-		if (!port) {
-			LLDPAD_ERR("%s: Error adding device %s\n",
-				     __func__, p->if_name);
-			continue;
+	LIST_FOREACH(agent, &port->agent_head, entry) {
+		LLDPAD_DBG("%s: calling ifup for agent %p.\n",
+			   __func__, agent);
+		LIST_FOREACH(np, &lldp_head, lldp) {
+			if (np->ops->lldp_mod_ifup)
+				np->ops->lldp_mod_ifup(port->ifname, agent);
 		}
-		if (!check_link_status(p->if_name))
-			continue;
+	}
+	set_lldp_port_enable(ifname, 1);
+	ckpt_restore_port(port);
+}
 
-		lldp_add_agent(p->if_name, NEAREST_BRIDGE);
-		lldp_add_agent(p->if_name, NEAREST_NONTPMR_BRIDGE);
-		lldp_add_agent(p->if_name, NEAREST_CUSTOMER_BRIDGE);
+static void init_ports_batch(UNUSED void *eloop_data, UNUSED void *user_ctx)
+{
+	struct port_init *pi = port_init;
+	int end;
 
-		LIST_FOREACH(agent, &port->agent_head, entry) {
-			LLDPAD_DBG("%s: calling ifup for agent %p.\n",
-				   __func__, agent);
-			LIST_FOREACH(np, &lldp_head, lldp) {
-				if (np->ops->lldp_mod_ifup)
-					np->ops->lldp_mod_ifup(p->if_name, agent);
-			}
-		}
-		set_lldp_port_enable(p->if_name, 1);
+	if (!pi)
+		return;
+	end = pi->next + PORT_INIT_BATCH;
+	if (end > pi->count)
+		end = pi->count;
+	for (; pi->next < end; ++pi->next)
+		init_port(&pi->links[pi->next]);
+
+	if (pi->next < pi->count) {
+		eloop_register_timeout(0, 0, init_ports_batch, NULL, NULL);
+		return;
 	}
+	LLDPAD_DBG("%s: %d ports initialized\n", __func__, pi->count);
+	free(pi->links);
+	free(pi);
+	port_init = NULL;
+}
 
-	if_freenameindex(nameidx);
+/*
+ * Stop bringing up ports, called before the ports are removed.
+ */
+void init_ports_cancel(void)
+{
+	if (!port_init)
+		return;
+	eloop_cancel_timeout(init_ports_batch, NULL, NULL);
+	free(port_init->links);
+	free(port_init);
+	port_init = NULL;
+}
+
+/*
+ * Add the valid LLDP devices owned by the calling thread. The links are
+ * taken from a single netlink dump, the first batch of ports is brought up
+ * right away and the rest from the event loop.
+ */
+void init_ports(void)
+{
+	struct rtnl_link *links;
+	struct port_init *pi;
+	int i, n, count;
+
+	init_ports_cancel();
+	n = rtnl_link_dump(&links);
+	if (n < 0) {
+		LLDPAD_ERR("%s: cannot dump links: %d\n", __func__, n);
+		return;
+	}
+
+	for (i = 0, count = 0; i < n; ++i) {
+		if (!shard_mine(links[i].ifindex))
+			continue;
+		if (!is_valid_lldp_link(&links[i]))
+			continue;
+		links[count++] = links[i];
+	}
+
+	pi = malloc(sizeof(*pi));
+	if (!pi) {
+		LLDPAD_ERR("%s: malloc failed\n", __func__);
+		free(links);
+		return;
+	}
+	pi->links = links;
+	pi->count = count;
+	pi->next = 0;
+	port_init = pi;
+	init_ports_batch(NULL, NULL);
 }
 
 static int
@@ -455,6 +591,7 @@ int get_config_setting(const char *ifname, int agenttype, char *path,
 	int rval = CONFIG_FALSE;
 	const char *section = agent_type2section(agenttype);
 
+	cfg_lock();
 	/* look for setting in section->ifname area first */
 	if (ifname) {
 		snprintf(p, sizeof(p), "%s.%s.%s",
@@ -468,6 +605,7 @@ int get_config_setting(const char *ifname, int agenttype, char *path,
 			 section, LLDP_COMMON, path);
 		rval = lookup_config_value(p, v, type);
 	}
+	cfg_unlock();
 
 	return (rval == CONFIG_FALSE) ? cmd_failed : cmd_success;
 }
@@ -480,6 +618,7 @@ int remove_config_setting(const char *ifname, int agenttype, char *parent,
 	config_setting_t *setting = NULL;
 	const char *section = agent_type2section(agenttype);
 
+	cfg_lock();
 	/* look for setting in section->ifname area first */
 	if (ifname) {
 		snprintf(p, sizeof(p), "%s.%s.%s",
@@ -497,11 +636,12 @@ int remove_config_setting(const char *ifname, int agenttype, char *parent,
 	if (setting != NULL) {
 		rval = config_setting_remove(setting, name);
 		if ((rval == CONFIG_TRUE) &&
-			!config_write_file(&lldpad_cfg, cfg_file_name)) {
+			!write_cfg()) {
 			LLDPAD_DBG("config write failed\n");
 			rval = CONFIG_FALSE;
 		}
 	}
+	cfg_unlock();
 
 	return (rval == CONFIG_FALSE) ? cmd_failed : cmd_success;
 }
@@ -582,16 +722,18 @@ int set_config_setting(const char *ifname, int agenttype, char *path,
 	else
 		snprintf(p, sizeof(p), "%s.%s.%s",
 			 section, LLDP_COMMON, path);
+	cfg_lock();
 	setting = find_or_create_setting(p, type);
 
 	if (setting) {
 		if (!set_config_value(setting, v, type)) {
 			rval = cmd_failed;
-		} else if (!config_write_file(&lldpad_cfg, cfg_file_name)) {
+		} else if (!write_cfg()) {
 			LLDPAD_DBG("config write failed\n");
 			rval = cmd_failed;
 		}
 	}
+	cfg_unlock();
 	return rval;
 }
 
@@ -812,3 +954,533 @@ int get_med_devtype(const char *ifname, int agenttype)
 
 	return devtype;
 }
+
+/*
+ * Incremental reload of the configuration file.
+ *
+ * The new file is compared with the running configuration per agent
+ * section, interface and TLV. Changed agent and TLV arguments are applied
+ * through the argument handlers of the modules as if set by a client.
+ * Agents with changes the handlers do not take are restarted, other
+ * changes need a full reload.
+ */
+#define CFG_VALUE_LEN	1024
+
+struct cfg_change {
+	struct cfg_change *next;
+	int type;			/* Agent type, -1 for all agents */
+	char ifname[IFNAMSIZ];		/* Interface or LLDP_COMMON */
+	u32 tlvid;			/* INVALID_TLVID for agent arguments */
+	char arg[64];			/* Argument, empty to restart agent */
+};
+
+struct cfg_diff {
+	int type;
+	const char *ifname;
+	u32 tlvid;
+	struct cfg_change *head;
+};
+
+struct cfg_reload {
+	config_t *cfg;			/* New configuration */
+	struct cfg_change *head;
+};
+
+/* Agents to restart once the new configuration is in place */
+struct cfg_restart {
+	struct cfg_restart *next;
+	int type;
+	char ifname[IFNAMSIZ];
+};
+
+static __thread struct cfg_restart *cfg_restarts;
+
+typedef int (*cfg_diff_fn)(const char *, config_setting_t *,
+			   config_setting_t *, struct cfg_diff *);
+
+static int cfg_is_group(config_setting_t *s)
+{
+	return s && config_setting_type(s) == CONFIG_TYPE_GROUP;
+}
+
+/*
+ * Print a scalar or an array of scalars the way the argument handlers
+ * expect it, arrays as comma separated list.
+ * Returns 0 on success and -1 if the setting cannot be printed.
+ */
+static int cfg_print(config_setting_t *s, char *buf, size_t len)
+{
+	size_t used = 0;
+	int i, c = -1;
+
+	switch (config_setting_type(s)) {
+	case CONFIG_TYPE_INT:
+		c = snprintf(buf, len, "%ld",
+			     (long)config_setting_get_int(s));
+		break;
+	case CONFIG_TYPE_INT64:
+		c = snprintf(buf, len, "%lld", config_setting_get_int64(s));
+		break;
+	case CONFIG_TYPE_FLOAT:
+		c = snprintf(buf, len, "%g", config_setting_get_float(s));
+		break;
+	case CONFIG_TYPE_BOOL:
+		c = snprintf(buf, len, "%s",
+			     config_setting_get_bool(s) ? VAL_YES : VAL_NO);
+		break;
+	case CONFIG_TYPE_STRING:
+		c = snprintf(buf, len, "%s", config_setting_get_string(s));
+		break;
+	case CONFIG_TYPE_ARRAY:
+	case CONFIG_TYPE_LIST:
+		*buf = '\0';
+		for (i = 0; i < config_setting_length(s); ++i) {
+			if (i) {
+				if (used + 1 >= len)
+					return -1;
+				buf[used++] = ',';
+			}
+			if (cfg_print(config_setting_get_elem(s, i), buf + used,
+				      len - used))
+				return -1;
+			used += strlen(buf + used);
+		}
+		return 0;
+	}
+	return (c < 0 || (size_t)c >= len) ? -1 : 0;
+}
+
+static int cfg_equal(config_setting_t *a, config_setting_t *b)
+{
+	char va[CFG_VALUE_LEN], vb[CFG_VALUE_LEN];
+	config_setting_t *s;
+	int i, n;
+
+	if (!a || !b)
+		return a == b;
+	if (config_setting_type(a) != config_setting_type(b))
+		return 0;
+	n = config_setting_length(a);
+	switch (config_setting_type(a)) {
+	case CONFIG_TYPE_GROUP:
+		if (n != config_setting_length(b))
+			return 0;
+		for (i = 0; i < n; ++i) {
+			s = config_setting_get_elem(a, i);
+			if (!cfg_equal(s, config_setting_get_member(b,
+						config_setting_name(s))))
+				return 0;
+		}
+		return 1;
+	case CONFIG_TYPE_ARRAY:
+	case CONFIG_TYPE_LIST:
+		if (n != config_setting_length(b))
+			return 0;
+		for (i = 0; i < n; ++i)
+			if (!cfg_equal(config_setting_get_elem(a, i),
+				       config_setting_get_elem(b, i)))
+				return 0;
+		return 1;
+	}
+	return !cfg_print(a, va, sizeof(va)) && !cfg_print(b, vb, sizeof(vb))
+	       && !strcmp(va, vb);
+}
+
+/*
+ * Call fn for each member of the groups a and b which differs, a or b is
+ * NULL for members found in one group only.
+ */
+static int cfg_diff_members(config_setting_t *a, config_setting_t *b,
+			    cfg_diff_fn fn, struct cfg_diff *d)
+{
+	config_setting_t *s, *t;
+	int i, rc;
+
+	for (i = 0; a && i < config_setting_length(a); ++i) {
+		s = config_setting_get_elem(a, i);
+		t = b ? config_setting_get_member(b, config_setting_name(s))
+		      : NULL;
+		if (cfg_equal(s, t))
+			continue;
+		rc = fn(config_setting_name(s), s, t, d);
+		if (rc)
+			return rc;
+	}
+	for (i = 0; b && i < config_setting_length(b); ++i) {
+		t = config_setting_get_elem(b, i);
+		if (a && config_setting_get_member(a, config_setting_name(t)))
+			continue;
+		rc = fn(config_setting_name(t), NULL, t, d);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+static int cfg_add_change(struct cfg_diff *d, const char *arg)
+{
+	struct cfg_change *c;
+
+	if (strlen(arg) >= sizeof(c->arg))
+		arg = "";
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return -ENOMEM;
+	c->type = d->type;
+	snprintf(c->ifname, sizeof(c->ifname), "%s", d->ifname);
+	c->tlvid = d->tlvid;
+	strcpy(c->arg, arg);
+	c->next = d->head;
+	d->head = c;
+	return 0;
+}
+
+/* Field of a TLV group */
+static int cfg_diff_field(const char *name, config_setting_t *a,
+			  config_setting_t *b, struct cfg_diff *d)
+{
+	if (cfg_is_group(a) || cfg_is_group(b))
+		return cfg_add_change(d, "");
+	return cfg_add_change(d, name);
+}
+
+/* Member of an interface or common group of an agent section */
+static int cfg_diff_agent(const char *name, config_setting_t *a,
+			  config_setting_t *b, struct cfg_diff *d)
+{
+	size_t len = strlen(TLVID_PREFIX);
+	unsigned long tlvid;
+	char *end;
+	int rc;
+
+	if (!strncmp(name, TLVID_PREFIX, len) && (!a || cfg_is_group(a)) &&
+	    (!b || cfg_is_group(b))) {
+		tlvid = strtoul(name + len, &end, 16);
+		if (end == name + len || *end)
+			return cfg_add_change(d, "");
+		d->tlvid = tlvid;
+		rc = cfg_diff_members(a, b, cfg_diff_field, d);
+		d->tlvid = INVALID_TLVID;
+		return rc;
+	}
+	if (!strcmp(name, ARG_ADMINSTATUS))
+		return cfg_add_change(d, ARG_ADMINSTATUS);
+	return cfg_add_change(d, "");
+}
+
+/* Interface or common group of an agent section */
+static int cfg_diff_port(const char *name, config_setting_t *a,
+			 config_setting_t *b, struct cfg_diff *d)
+{
+	if ((a && !cfg_is_group(a)) || (b && !cfg_is_group(b)) ||
+	    strlen(name) >= IFNAMSIZ)
+		return 1;
+	d->ifname = name;
+	return cfg_diff_members(a, b, cfg_diff_agent, d);
+}
+
+/* Interface group of the DCBX section, the DCBX state is renegotiated */
+static int cfg_diff_dcbx(const char *name, config_setting_t *a,
+			 config_setting_t *b, struct cfg_diff *d)
+{
+	if ((a && !cfg_is_group(a)) || (b && !cfg_is_group(b)) ||
+	    strlen(name) >= IFNAMSIZ)
+		return 1;
+	d->type = -1;
+	d->ifname = name;
+	return cfg_add_change(d, "");
+}
+
+static int cfg_diff_section(const char *name, config_setting_t *a,
+			    config_setting_t *b, struct cfg_diff *d)
+{
+	int type;
+
+	if ((a && !cfg_is_group(a)) || (b && !cfg_is_group(b)))
+		return 1;
+	if (!strcmp(name, DCBX_SETTING))
+		return cfg_diff_members(a, b, cfg_diff_dcbx, d);
+	for (type = NEAREST_BRIDGE; type < AGENT_MAX; ++type)
+		if (!strcmp(name, agent_type2section(type)))
+			break;
+	if (type == AGENT_MAX)
+		return 1;
+	d->type = type;
+	return cfg_diff_members(a, b, cfg_diff_port, d);
+}
+
+/*
+ * Look up the path of a change for an agent, in the interface group first
+ * and in the common group otherwise.
+ */
+static config_setting_t *cfg_find(config_t *cfg, struct cfg_change *c,
+				  const char *ifname, int type)
+{
+	const char *section = agent_type2section(type);
+	config_setting_t *s;
+	char p[1024];
+
+	if (c->tlvid == INVALID_TLVID)
+		snprintf(p, sizeof(p), "%s.%s.%s", section, ifname, c->arg);
+	else
+		snprintf(p, sizeof(p), "%s.%s." TLVID_PREFIX "%08x.%s",
+			 section, ifname, c->tlvid, c->arg);
+	s = config_lookup(cfg, p);
+	if (s || !strcmp(ifname, LLDP_COMMON))
+		return s;
+	return cfg_find(cfg, c, LLDP_COMMON, type);
+}
+
+static void cfg_restart_add(const char *ifname, int type)
+{
+	struct cfg_restart *r;
+
+	for (r = cfg_restarts; r; r = r->next)
+		if (!strcmp(r->ifname, ifname) && (r->type == type ||
+						   r->type == -1))
+			return;
+	r = calloc(1, sizeof(*r));
+	if (!r) {
+		LLDPAD_ERR("%s:%s cannot restart agent %d\n", __func__,
+			   ifname, type);
+		return;
+	}
+	r->type = type;
+	snprintf(r->ifname, sizeof(r->ifname), "%s", ifname);
+	r->next = cfg_restarts;
+	cfg_restarts = r;
+}
+
+/*
+ * Apply one changed argument to an agent.
+ * Returns 0 on success and -1 if the agent needs a restart.
+ */
+static int cfg_apply_arg(config_t *cfg, struct cfg_change *c,
+			 struct port *port, struct lldp_agent *agent)
+{
+	static const char *admin[] = {
+		[disabled] = VAL_DISABLED,
+		[enabledTxOnly] = VAL_TX,
+		[enabledRxOnly] = VAL_RX,
+		[enabledRxTx] = VAL_RXTX,
+	};
+	char value[CFG_VALUE_LEN];
+	config_setting_t *s;
+	struct cmd cmd;
+	int rc, status;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.ops = op_config | op_arg | op_argval;
+	cmd.tlvid = c->tlvid;
+	cmd.type = agent->type;
+	snprintf(cmd.ifname, sizeof(cmd.ifname), "%s", port->ifname);
+
+	cfg_lock();
+	s = cfg_find(cfg, c, port->ifname, agent->type);
+	if (c->tlvid == INVALID_TLVID) {
+		cmd.cmd = cmd_set_lldp;
+		status = s ? config_setting_get_int(s) : disabled;
+		rc = (status < disabled || status > enabledRxTx) ? -1 : 0;
+		if (!rc)
+			snprintf(value, sizeof(value), "%s", admin[status]);
+	} else {
+		cmd.cmd = cmd_settlv;
+		rc = s ? cfg_print(s, value, sizeof(value)) : -1;
+	}
+	cfg_unlock();
+	if (rc)
+		return -1;
+
+	rc = mand_apply_arg(&cmd, c->arg, value, cmd.obuf, sizeof(cmd.obuf));
+	if (rc != cmd_success) {
+		LLDPAD_DBG("%s:%s agent %d %s=%s failed:%d\n", __func__,
+			   port->ifname, agent->type, c->arg, value, rc);
+		return -1;
+	}
+	if (c->tlvid != INVALID_TLVID)
+		somethingChangedLocal(port->ifname, agent->type);
+	return 0;
+}
+
+/*
+ * Create the absent agents of a port an adminStatus change enables, as
+ * set_lldp_agent_admin() does. The change is then applied to them.
+ */
+static void cfg_apply_demand(config_t *cfg, struct cfg_change *c,
+			     struct port *port)
+{
+	config_setting_t *s;
+	int type, status;
+
+	for (type = NEAREST_BRIDGE; type < AGENT_MAX; ++type) {
+		if ((c->type >= 0 && type != c->type) ||
+		    lldp_agent_find_by_type(port->ifname, type))
+			continue;
+		cfg_lock();
+		s = cfg_find(cfg, c, port->ifname, type);
+		status = s ? config_setting_get_int(s) : disabled;
+		cfg_unlock();
+		if (status > disabled && status <= enabledRxTx)
+			lldp_agent_demand(port, type);
+	}
+}
+
+/*
+ * Apply the changes to the ports of the calling shard. Changes of the
+ * common group skip ports which override the argument.
+ */
+static int cfg_apply(void *arg)
+{
+	struct cfg_reload *reload = arg;
+	struct lldp_agent *agent;
+	struct cfg_change *c;
+	struct port *port;
+
+	for (c = reload->head; c; c = c->next) {
+		int common = !strcmp(c->ifname, LLDP_COMMON);
+
+		for (port = porthead; port; port = port->next) {
+			if (!common && strcmp(c->ifname, port->ifname))
+				continue;
+			if (c->tlvid == INVALID_TLVID &&
+			    !strcmp(c->arg, ARG_ADMINSTATUS))
+				cfg_apply_demand(reload->cfg, c, port);
+			LIST_FOREACH(agent, &port->agent_head, entry) {
+				if (c->type >= 0 && (int)agent->type != c->type)
+					continue;
+				if (common && *c->arg && cfg_find(reload->cfg,
+						c, port->ifname, agent->type) !=
+				    cfg_find(reload->cfg, c, LLDP_COMMON,
+					     agent->type))
+					continue;
+				if (!*c->arg ||
+				    cfg_apply_arg(reload->cfg, c, port, agent))
+					cfg_restart_add(port->ifname,
+							c->type >= 0 ?
+							(int)agent->type : -1);
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Restart the agents of the calling shard whose changes could not be
+ * applied, the modules read the new configuration when brought up.
+ * Absent agents the new configuration enables are created instead.
+ */
+static int cfg_restart(UNUSED void *arg)
+{
+	struct lldp_module *np;
+	struct lldp_agent *agent;
+	struct cfg_restart *r;
+	struct port *port;
+	unsigned int added;
+	int type, admin;
+
+	while ((r = cfg_restarts)) {
+		cfg_restarts = r->next;
+		for (port = porthead; port; port = port->next)
+			if (!strcmp(port->ifname, r->ifname))
+				break;
+		if (!port) {
+			free(r);
+			continue;
+		}
+		added = 0;
+		for (type = NEAREST_BRIDGE; type < AGENT_MAX; ++type) {
+			if ((r->type >= 0 && type != r->type) ||
+			    lldp_agent_find_by_type(port->ifname, type) ||
+			    get_config_setting(port->ifname, type,
+					       ARG_ADMINSTATUS, &admin,
+					       CONFIG_TYPE_INT) ||
+			    admin == disabled)
+				continue;
+			if (lldp_agent_demand(port, type))
+				added |= 1 << type;
+		}
+		LIST_FOREACH(agent, &port->agent_head, entry) {
+			if ((r->type >= 0 && (int)agent->type != r->type) ||
+			    (added & (1 << agent->type)))
+				continue;
+			LLDPAD_DBG("%s:%s restart agent %d\n", __func__,
+				   r->ifname, agent->type);
+			LIST_FOREACH(np, &lldp_head, lldp)
+				if (np->ops->lldp_mod_ifdown)
+					np->ops->lldp_mod_ifdown(r->ifname,
+								 agent);
+			LIST_FOREACH(np, &lldp_head, lldp)
+				if (np->ops->lldp_mod_ifup)
+					np->ops->lldp_mod_ifup(r->ifname, agent);
+			somethingChangedLocal(r->ifname, agent->type);
+		}
+		free(r);
+	}
+	return 0;
+}
+
+/*
+ * reload_cfg - apply the changes of the configuration file
+ *
+ * Returns 0 if the changes have been applied or the file is unreadable
+ * and the running configuration is kept. Returns nonzero if the changes
+ * need a full reload of the configuration.
+ */
+int reload_cfg(void)
+{
+	struct cfg_diff d = { .tlvid = INVALID_TLVID };
+	struct cfg_reload reload;
+	struct cfg_change *c;
+	unsigned int n = 0;
+	config_t cfg;
+	int rc;
+
+	if (access(cfg_file_name, R_OK))
+		return 1;
+	config_init(&cfg);
+	if (!config_read_file(&cfg, cfg_file_name)) {
+		LLDPAD_ERR("%s:%s:%d: %s, keeping running configuration\n",
+			   __func__, cfg_file_name, config_error_line(&cfg),
+			   config_error_text(&cfg));
+		config_destroy(&cfg);
+		return 0;
+	}
+
+	cfg_lock();
+	rc = cfg_diff_members(config_root_setting(&lldpad_cfg),
+			      config_root_setting(&cfg), cfg_diff_section, &d);
+	cfg_unlock();
+	for (c = d.head; c; c = c->next)
+		++n;
+	LLDPAD_INFO("%s:%u changes%s\n", __func__, n,
+		    rc ? ", full reload" : "");
+	if (rc || !n)
+		goto out;
+
+	/*
+	 * The handlers update the running configuration, which is then
+	 * replaced by the file. Nothing is written back meanwhile.
+	 */
+	reload.cfg = &cfg;
+	reload.head = d.head;
+	cfg_lock();
+	cfg_nosave = 1;
+	cfg_unlock();
+	shard_call_all(cfg_apply, &reload);
+
+	cfg_lock();
+	cfg_nosave = 0;
+	config_destroy(&lldpad_cfg);
+	config_init(&lldpad_cfg);
+	if (!config_read_file(&lldpad_cfg, cfg_file_name))
+		rc = 1;
+	cfg_unlock();
+	shard_call_all(cfg_restart, NULL);
+out:
+	while ((c = d.head)) {
+		d.head = c->next;
+		free(c);
+	}
+	config_destroy(&cfg);
+	return rc;
+}
@@ -40,6 +40,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <net/if.h>
 #include "lldpad.h"
 #include "eloop.h"
 #include "ctrl_iface.h"
@@ -49,11 +50,16 @@
 #include "clif_msgs.h"
 #include "lldpad_status.h"
 #include "lldp/ports.h"
+#include "lldp/stats.h"
 #include "lldp_dcbx.h"
+#include "lldp_dcbx_cmds.h"
 #include "lldp_util.h"
 #include "messages.h"
+#include "qbg_slab22.h"
+#include "qbg_vdp22.h"
+#include "worker.h"
+#include "shard.h"
 
-extern struct lldp_head lldp_head;
 
 struct ctrl_dst {
 	struct ctrl_dst *next;
@@ -61,9 +67,12 @@ struct ctrl_dst {
 	socklen_t addrlen;
 	int debug_level;
 	int errors;
+	int delta;	/* receives neighbor delta events */
 	u32 *tlv_types; /*tlv event types to recv */
 };
 
+int clif_delta_listeners;
+
 static char *hexlist = "0123456789abcdef";
 
 struct clif_cmds {
@@ -82,19 +91,68 @@ static const struct clif_cmds cmd_tbl[] = {
 	{ DETACH_CMD,  clif_iface_detach },
 	{ LEVEL_CMD,   clif_iface_level },
 	{ PING_CMD,    clif_iface_ping },
+	{ VERSION_CMD, clif_iface_version },
+	{ STATS_CMD,   clif_iface_stats },
 	{ UNKNOWN_CMD, clif_iface_cmd_unknown }
 };
 
+/* Module command executed by the shard which owns the interface */
+struct clif_mod_req {
+	struct clif_data *clifd;
+	struct sockaddr_un *from;
+	socklen_t fromlen;
+	u32 module_id;
+	char *cmd;
+	int cmd_len;
+	char *rbuf;
+	int rlen;
+};
+
+static int clif_mod_call(void *arg)
+{
+	struct clif_mod_req *req = arg;
+	struct lldp_module *mod;
+
+	mod = find_module_by_id(&lldp_head, req->module_id);
+	if (mod && mod->ops && mod->ops->client_cmd)
+		return  (mod->ops->client_cmd)(req->clifd, req->from,
+			 req->fromlen, req->cmd, req->cmd_len, req->rbuf,
+			 req->rlen);
+	else
+		return cmd_device_not_found;
+}
+
+/*
+ * Return the shard owning the interface named in a command, shard 0 for
+ * commands without an interface.
+ */
+static unsigned int clif_mod_shard(char *cmd, int cmd_len, int lenoff,
+				   int off)
+{
+	char ifname[IFNAMSIZ];
+	u8 len;
+
+	if (!shard_count() || cmd_len < off ||
+	    hexstr2bin(cmd + lenoff, &len, sizeof(len)))
+		return 0;
+	if (!len || len >= IFNAMSIZ || off + len > cmd_len)
+		return 0;
+	memcpy(ifname, cmd + off, len);
+	ifname[len] = '\0';
+	return shard_of(if_nametoindex(ifname));
+}
+
 int clif_iface_module(struct clif_data *clifd,
 		      struct sockaddr_un *from,
 		      socklen_t fromlen,
 		      char *ibuf, int ilen,
 		      char *rbuf, int rlen)
 {
+	struct clif_mod_req req;
 	u32 module_id;
 	char *cmd_start;
 	int cmd_len;
-	struct lldp_module *mod = NULL;
+	unsigned int shard;
 
 	/* identify the module and start of command */
 	switch (*ibuf) {
@@ -105,23 +163,29 @@ int clif_iface_module(struct clif_data *clifd,
 		module_id = 0x001b2101;
 		cmd_start = ibuf;
 		cmd_len = ilen;
+		shard = clif_mod_shard(cmd_start, cmd_len, DCB_PORTLEN_OFF,
+				       DCB_PORT_OFF);
 		break;
 	case MOD_CMD:
 		hexstr2bin(ibuf+MOD_ID, (u8 *)&module_id, sizeof(module_id));
 		module_id = ntohl(module_id);
 		cmd_start = ibuf + MOD_ID + 2*sizeof(module_id);
 		cmd_len = ilen - MOD_ID - 2*sizeof(module_id);
+		shard = clif_mod_shard(cmd_start, cmd_len, CMD_IF_LEN, CMD_IF);
 		break;
 	default:
 		return cmd_invalid;
 	}
 
-	mod = find_module_by_id(&lldp_head, module_id);
-	if (mod && mod->ops && mod->ops->client_cmd)
-		return  (mod->ops->client_cmd)(clifd, from, fromlen,
-			 cmd_start, cmd_len, rbuf+strlen(rbuf), rlen);
-	else
-		return cmd_device_not_found;
+	req.clifd = clifd;
+	req.from = from;
+	req.fromlen = fromlen;
+	req.module_id = module_id;
+	req.cmd = cmd_start;
+	req.cmd_len = cmd_len;
+	req.rbuf = rbuf + strlen(rbuf);
+	req.rlen = rlen;
+	return shard_call(shard, clif_mod_call, &req);
 }
 
 
@@ -145,6 +209,121 @@ int clif_iface_ping(UNUSED struct clif_data *clifd,
 	return 0;
 }
 
+/*
+ * Report the highest message version, clients of lldpad versions without
+ * this command get cmd_invalid and use CLIF_MSG_VERSION.
+ */
+int clif_iface_version(UNUSED struct clif_data *clifd,
+		       UNUSED struct sockaddr_un *from,
+		       UNUSED socklen_t fromlen,
+		       UNUSED char *ibuf, UNUSED int ilen,
+		       char *rbuf, int rlen)
+{
+	snprintf(rbuf, rlen, "%c%02x", VERSION_CMD, CLIF_MSG_VERSION_BIN);
+	return cmd_success;
+}
+
+/*
+ * Daemon wide statistics. Each section has a name and a function which
+ * prints the statistics as text. The optional argument after the section
+ * name is passed to the function, for example an interface name.
+ * Sections kept per shard are printed once for each shard, and for the
+ * main thread too with STATS_MAIN.
+ */
+#define	STATS_SHARD	1
+#define	STATS_MAIN	2
+
+static const struct clif_stats {
+	const char *name;
+	int (*show)(char *buf, size_t len, const char *arg);
+	int flags;
+} stats_tbl[] = {
+	{ "mem",	slab22_stats,	STATS_SHARD },
+	{ "vdp22br",	vdp22br_stats,	STATS_SHARD },
+	{ "trace",	log_trace_dump,	0 },
+	{ "eloop",	eloop_stats,	STATS_SHARD | STATS_MAIN },
+	{ "prom",	stats_prom,	0 },
+	{ "worker",	worker_stats,	0 },
+	{ NULL,		NULL,		0 }
+};
+
+struct clif_stats_req {
+	const struct clif_stats *sp;
+	char *buf;
+	int len;
+	const char *arg;
+};
+
+static int clif_stats_call(void *arg)
+{
+	struct clif_stats_req *req = arg;
+
+	return (*req->sp->show)(req->buf, req->len, req->arg);
+}
+
+/*
+ * Print a section kept per shard, each under a header naming the shard.
+ * Returns the number of bytes written to the buffer.
+ */
+static int clif_stats_shards(const struct clif_stats *sp, char *buf, int len,
+			     const char *arg)
+{
+	struct clif_stats_req req = { .sp = sp, .arg = arg };
+	unsigned int i;
+	int c, used = 0;
+
+	if (sp->flags & STATS_MAIN) {
+		c = snprintf(buf, len, "main:\n");
+		if (c < 0 || c >= len)
+			return 0;
+		used += c;
+		used += (*sp->show)(buf + used, len - used, arg);
+	}
+	for (i = 0; i < shard_count(); ++i) {
+		c = snprintf(buf + used, len - used, "shard %u:\n", i);
+		if (c < 0 || c >= len - used)
+			break;
+		used += c;
+		req.buf = buf + used;
+		req.len = len - used;
+		used += shard_call(i, clif_stats_call, &req);
+	}
+	return used;
+}
+
+int clif_iface_stats(UNUSED struct clif_data *clifd,
+		     UNUSED struct sockaddr_un *from,
+		     UNUSED socklen_t fromlen,
+		     char *ibuf, UNUSED int ilen,
+		     char *rbuf, int rlen)
+{
+	const struct clif_stats *sp;
+	char *name = ibuf + 1;
+	char *arg = strchr(name, ' ');
+	int c, used;
+	int status = cmd_invalid;
+
+	if (arg)
+		*arg++ = '\0';
+	snprintf(rbuf, rlen, "%c", STATS_CMD);
+	used = strlen(rbuf);
+	for (sp = stats_tbl; sp->name; ++sp) {
+		if (*name && strcmp(name, sp->name))
+			continue;
+		status = cmd_success;
+		c = snprintf(rbuf + used, rlen - used, "%s:\n", sp->name);
+		if (c < 0 || c >= rlen - used)
+			break;
+		used += c;
+		if (shard_count() && (sp->flags & STATS_SHARD))
+			used += clif_stats_shards(sp, rbuf + used, rlen - used,
+						  arg);
+		else
+			used += (*sp->show)(rbuf + used, rlen - used, arg);
+	}
+	return status;
+}
+
 int clif_iface_attach(struct clif_data *clifd,
 		      struct sockaddr_un *from,
 		      socklen_t fromlen,
@@ -201,7 +380,7 @@ int clif_iface_attach(struct clif_data *clifd,
 		for (i = 0; tokenize; i++) {
 			char *myend;
 
-			dst->tlv_types[i] = strtol(tokenize, &myend, 16);
+			dst->tlv_types[i] = strtoul(tokenize, &myend, 16);
 			if (*myend)		/* No hexnumber for module id */
 				goto err_types;
 			tokenize = strtok(NULL, delim);
@@ -209,6 +388,12 @@ int clif_iface_attach(struct clif_data *clifd,
 		free(tlv);
 		/* Insert Termination Pattern */
 		dst->tlv_types[i] = ~0;
+		for (i = 0; dst->tlv_types[i] != (u32)~0; i++)
+			if (dst->tlv_types[i] == NEIGH_DELTA_ID)
+				dst->delta = 1;
+		/* Read by the shards to skip the comparison of frames */
+		if (dst->delta)
+			__sync_add_and_fetch(&clif_delta_listeners, 1);
 	}
 
 	/* Insert new node at beginning */
@@ -243,6 +428,8 @@ static int detach_clif_monitor(struct clif_data *clifd,
 				clifd->ctrl_dst = dst->next;
 			else
 				prev->next = dst->next;
+			if (dst->delta)
+				__sync_sub_and_fetch(&clif_delta_listeners, 1);
 			free(dst->tlv_types);
 			free(dst);
 			dst = NULL;
@@ -320,6 +507,7 @@ static void process_clif_cmd(  struct clif_data *cd,
 	/* setup minimum command response message
 	 * status will be updated at end */
 	snprintf(rbuf, rsize, "%c%02x", CMD_RESPONSE, cmd_failed);
+	cd->rbin = 0;
 	status = cmd_tbl[find_cmd_entry((int)ibuf[0])].cmd_handler(
 					 cd, from, fromlen, ibuf, ilen,
 					 rbuf + strlen(rbuf),
@@ -328,7 +516,7 @@ static void process_clif_cmd(  struct clif_data *cd,
 	/* update status and compute final length */
 	rbuf[CLIF_STAT_OFF] = hexlist[(status & 0xf0) >> 4];
 	rbuf[CLIF_STAT_OFF+1] = hexlist[status & 0x0f];
-	*rlen = strlen(rbuf);
+	*rlen = strlen(rbuf) + cd->rbin;
 }
 
 
@@ -348,6 +536,7 @@ static void ctrl_iface_receive(int sock, void *eloop_ctx,
 	char *reply;
 	const int reply_size = MAX_CLIF_MSGBUF;
 	int reply_len;
+	int tag_len = 0;
 
 	memset(&buf, 0x00, sizeof(buf));
 	iov.iov_base = buf;
@@ -397,8 +586,14 @@ static void ctrl_iface_receive(int sock, void *eloop_ctx,
 	}
 
 	memset(reply, 0, reply_size);
-	process_clif_cmd(clifd, &from, fromlen, buf, res,
-			 reply, reply_size, &reply_len);
+	/* The tag of a tagged request is sent back in front of the reply */
+	if (buf[MSG_TYPE] == TAG_CMD && res > CLIF_TAG_HDR) {
+		tag_len = CLIF_TAG_HDR;
+		memcpy(reply, buf, tag_len);
+	}
+	process_clif_cmd(clifd, &from, fromlen, buf + tag_len, res - tag_len,
+			 reply + tag_len, reply_size - tag_len, &reply_len);
+	reply_len += tag_len;
 
 	/* wpa_hexdump_ascii(MSG_DEBUG, "TX ctrl_iface", (u8 *) reply, reply_len); */
 	sendto(sock, reply, reply_len, 0, (struct sockaddr *) &from, fromlen);
@@ -514,6 +709,8 @@ void ctrl_iface_deinit(struct clif_data *clifd)
 	while (dst) {
 		prev = dst;
 		dst = dst->next;
+		if (prev->delta)
+			__sync_sub_and_fetch(&clif_delta_listeners, 1);
 		free(prev);
 	}
 
@@ -529,6 +726,9 @@ int is_ctrl_listening(struct ctrl_dst *dst, u32 type)
 
 	if (!dst)
 		return 0;
+	/* Delta events only for clients which asked for them */
+	if (type == NEIGH_DELTA_ID)
+		return dst->delta;
 
 	for (i=0; dst->tlv_types[i] != term; i++) {
 		if ((!type && dst->tlv_types[i] == dcbx) ||
@@ -33,6 +33,7 @@
 #include "dcb_types.h"
 #include "dcb_protocol.h"
 #include "dcb_driver_interface.h"
+#include "lldp_dcbx_nl.h"
 #include "dcb_persist_store.h"
 #include "dcb_rule_chk.h"
 #include "dcb_events.h"
@@ -45,38 +46,168 @@
 #include "linux/dcbnl.h"
 
 static void handle_opermode_true(char *device_name);
-u8        gdcbx_subtype = DCBX_SUBTYPE2;
+__thread u8 gdcbx_subtype = DCBX_SUBTYPE2;
 
 int set_configuration(char *device_name, u32 EventFlag);
 
-int pg_not_initted = true;
+/*
+ * All DCBX data stores of one interface. The store entries are kept on the
+ * per store lists below, this record indexes them by interface name so that
+ * the *_find() functions do not walk the lists. Each store entry refers to
+ * its slot in the record. The record is freed with its last store entry.
+ */
+#define	DCB_PORT_HASH	64		/* Must be a power of 2 */
+
+enum {
+	DCB_LOCAL,			/* Local configuration */
+	DCB_PEER,			/* Received from peer */
+	DCB_OPER,			/* Operational */
+	DCB_NSTORE
+};
+
+struct dcb_port_store {
+	LIST_ENTRY(dcb_port_store) node;
+	char ifname[MAX_DESCRIPTION_LEN];
+	unsigned int users;		/* # of store entries indexed */
+	struct pg_store1 *pg[DCB_NSTORE];
+	struct pfc_store *pfc[DCB_NSTORE];
+	struct app_store *app[DCB_NSTORE][DCB_MAX_APPTLV];
+	struct llink_store *llink[DCB_NSTORE][DCB_MAX_LLKTLV];
+	struct pg_desc_store *pgdesc;
+	struct dcb_control_protocol *ctrl[DCB_OPER];	/* No oper store */
+	struct features_store *features;
+};
+
+static __thread LIST_HEAD(dcb_port_head, dcb_port_store)
+	dcb_port_hash[DCB_PORT_HASH];
+static __thread struct dcb_port_store *dcb_port_last;	/* Last record found */
+
+static unsigned int dcb_port_hashval(const char *ifname)
+{
+	unsigned int h = 2166136261u;
+
+	while (*ifname)
+		h = (h ^ (unsigned char)*ifname++) * 16777619u;
+	return h & (DCB_PORT_HASH - 1);
+}
+
+/*
+ * Return the record of an interface, NULL if none exists. A received TLV
+ * triggers many lookups for the same interface in a row, remember the last
+ * record found.
+ */
+static struct dcb_port_store *dcb_port_find(const char *ifname)
+{
+	struct dcb_port_store *dp = dcb_port_last;
+
+	if (dp && !strcmp(dp->ifname, ifname))
+		return dp;
+	LIST_FOREACH(dp, &dcb_port_hash[dcb_port_hashval(ifname)], node)
+		if (!strcmp(dp->ifname, ifname)) {
+			dcb_port_last = dp;
+			break;
+		}
+	return dp;
+}
+
+/*
+ * Return the record of an interface, create it when not found.
+ */
+static struct dcb_port_store *dcb_port_get(const char *ifname)
+{
+	struct dcb_port_store *dp = dcb_port_find(ifname);
+
+	if (dp)
+		return dp;
+	dp = calloc(1, sizeof(*dp));
+	if (!dp) {
+		LLDPAD_ERR("%s:%s unable to allocate dcbx store\n", __func__,
+			   ifname);
+		return NULL;
+	}
+	strncpy(dp->ifname, ifname, sizeof(dp->ifname) - 1);
+	LIST_INSERT_HEAD(&dcb_port_hash[dcb_port_hashval(dp->ifname)], dp,
+			 node);
+	return dp;
+}
+
+static void dcb_port_put(struct dcb_port_store *dp)
+{
+	if (--dp->users)
+		return;
+	if (dcb_port_last == dp)
+		dcb_port_last = NULL;
+	LIST_REMOVE(dp, node);
+	free(dp);
+}
+
+/*
+ * Index a new store entry in its record slot. An entry already in the slot
+ * is no longer indexed and hands its reference on the record over.
+ */
+#define	DCB_PORT_LINK(entry, dp, where)					\
+	do {								\
+		(entry)->port = (dp);					\
+		(entry)->slot = &(dp)->where;				\
+		if (*(entry)->slot)					\
+			(*(entry)->slot)->port = NULL;			\
+		else							\
+			++(dp)->users;					\
+		*(entry)->slot = (entry);				\
+	} while (0)
+
+#define	DCB_PORT_UNLINK(entry)						\
+	do {								\
+		if ((entry)->port && *(entry)->slot == (entry)) {	\
+			*(entry)->slot = NULL;				\
+			dcb_port_put((entry)->port);			\
+		}							\
+	} while (0)
+
+__thread int pg_not_initted = true;
 struct pg_store1 {
 	char ifname[MAX_DESCRIPTION_LEN];
 	pg_attribs *second;
+	struct dcb_port_store *port;
+	struct pg_store1 **slot;
 	LIST_ENTRY(pg_store1) entries;
 };
 typedef struct pg_store1 * pg_it;
-LIST_HEAD(pghead, pg_store1) pg, peer_pg, oper_pg;
+__thread LIST_HEAD(pghead, pg_store1) pg, peer_pg, oper_pg;
+
+static int pg_index(struct pghead *head)
+{
+	if (head == &peer_pg)
+		return DCB_PEER;
+	if (head == &oper_pg)
+		return DCB_OPER;
+	return DCB_LOCAL;
+}
 
 /*todo: check  MAX_DESCRIPTION_LEN?*/
 struct pg_store1 *pg_find(struct pghead *head, char *ifname)
 {
-	struct pg_store1 *p = NULL;
+	struct dcb_port_store *dp = dcb_port_find(ifname);
 
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname))
-			return p;
-	return p;
+	return dp ? dp->pg[pg_index(head)] : NULL;
 }
 
 void pg_insert(struct pghead *head, char *ifname, pg_attribs *store)
 {
+	struct dcb_port_store *dp;
 	struct pg_store1 *entry = NULL;
+
 	entry = (struct pg_store1 *)malloc(sizeof(struct pg_store1));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strncpy(entry->ifname, ifname, sizeof(entry->ifname));
 	entry->second = store;
+	DCB_PORT_LINK(entry, dp, pg[pg_index(head)]);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -88,6 +219,7 @@ void pg_erase(pg_it *p)
 	void *itp = (void *)(*p)->second;
 	/* this line frees the param of this function! */
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 	if (itp) {
 		free (itp);
 		itp = NULL;
@@ -97,31 +229,48 @@ void pg_erase(pg_it *p)
 	*p = NULL;
 }
 
-int pfc_not_initted = true;
+__thread int pfc_not_initted = true;
 struct pfc_store {
 	char ifname[MAX_DESCRIPTION_LEN];
 	pfc_attribs *second;
+	struct dcb_port_store *port;
+	struct pfc_store **slot;
 	LIST_ENTRY(pfc_store) entries;
 };
 typedef struct pfc_store * pfc_it;
-LIST_HEAD(pfchead, pfc_store) pfc, peer_pfc, oper_pfc;
+__thread LIST_HEAD(pfchead, pfc_store) pfc, peer_pfc, oper_pfc;
+
+static int pfc_index(struct pfchead *head)
+{
+	if (head == &peer_pfc)
+		return DCB_PEER;
+	if (head == &oper_pfc)
+		return DCB_OPER;
+	return DCB_LOCAL;
+}
 
 struct pfc_store *pfc_find(struct pfchead *head, char *ifname)
 {
-	struct pfc_store *p = NULL;
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname))
-			return p;
-	return p;
+	struct dcb_port_store *dp = dcb_port_find(ifname);
+
+	return dp ? dp->pfc[pfc_index(head)] : NULL;
 }
 void pfc_insert(struct pfchead *head, char *ifname, pfc_attribs *store)
 {
+	struct dcb_port_store *dp;
 	struct pfc_store *entry;
+
 	entry = (struct pfc_store *) malloc(sizeof(struct pfc_store));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strcpy(entry->ifname, ifname);
 	entry->second = store;
+	DCB_PORT_LINK(entry, dp, pfc[pfc_index(head)]);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -130,6 +279,7 @@ void pfc_erase(pfc_it *p)
 	void *itp = (void *)(*p)->second;
 
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 	if (itp) {
 		free(itp);
 		itp = NULL;
@@ -139,31 +289,40 @@ void pfc_erase(pfc_it *p)
 	*p = NULL;
 }
 
-int pgdesc_not_initted = true;
+__thread int pgdesc_not_initted = true;
 struct pg_desc_store {
 	char ifname[MAX_DESCRIPTION_LEN];
 	pg_info *second;
+	struct dcb_port_store *port;
+	struct pg_desc_store **slot;
 	LIST_ENTRY(pg_desc_store) entries;
 };
 typedef struct pg_desc_store * pg_desc_it;
-LIST_HEAD(pgdesc_head, pg_desc_store) pg_desc;
+__thread LIST_HEAD(pgdesc_head, pg_desc_store) pg_desc;
 
 struct pg_desc_store *pgdesc_find(struct pgdesc_head *head, char *ifname)
 {
-	struct pg_desc_store *p = NULL;
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname))
-			return p;
-	return p;
+	struct dcb_port_store *dp = dcb_port_find(ifname);
+
+	(void)head;
+	return dp ? dp->pgdesc : NULL;
 }
 void pgdesc_insert(struct pgdesc_head *head, char *ifname, pg_info *store)
 {
+	struct dcb_port_store *dp;
 	struct pg_desc_store *entry;
+
 	entry = (struct pg_desc_store *) malloc(sizeof(struct pg_desc_store));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strcpy(entry->ifname, ifname);
 	entry->second = store;
+	DCB_PORT_LINK(entry, dp, pgdesc);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -171,6 +330,7 @@ void pgdesc_erase(pg_desc_it *p)
 {
 	void *itp = (void *)(*p)->second;
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 	if (itp) {
 		free(itp);
 		itp = NULL;
@@ -180,35 +340,57 @@ void pgdesc_erase(pg_desc_it *p)
 	*p = NULL;
 }
 
-int app_not_initted = true;
+__thread int app_not_initted = true;
 struct app_store {
 	char ifname[MAX_DESCRIPTION_LEN];
 	u32 app_subtype;
 	app_attribs *second;
+	struct dcb_port_store *port;
+	struct app_store **slot;
 	LIST_ENTRY(app_store) entries;
 };
 typedef struct app_store * app_it;
-LIST_HEAD(apphead, app_store) apptlv, peer_apptlv, oper_apptlv;
+__thread LIST_HEAD(apphead, app_store) apptlv, peer_apptlv, oper_apptlv;
+
+static int app_index(struct apphead *head)
+{
+	if (head == &peer_apptlv)
+		return DCB_PEER;
+	if (head == &oper_apptlv)
+		return DCB_OPER;
+	return DCB_LOCAL;
+}
 
 struct app_store *apptlv_find(struct apphead *head, char *ifname, u32 subtype)
 {
-	struct app_store *p = NULL;
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname) && (p->app_subtype == subtype))
-			return p;
-	return p;
+	struct dcb_port_store *dp;
+
+	if (subtype >= DCB_MAX_APPTLV)
+		return NULL;
+	dp = dcb_port_find(ifname);
+	return dp ? dp->app[app_index(head)][subtype] : NULL;
 }
 
 void apptlv_insert(struct apphead *head, char *ifname, u32 subtype,
 			app_attribs *store)
 {
+	struct dcb_port_store *dp;
 	struct app_store *entry;
+
+	if (subtype >= DCB_MAX_APPTLV)
+		return;
 	entry = (struct app_store *) malloc(sizeof(struct app_store));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strcpy(entry->ifname, ifname);
 	entry->second = store;
 	entry->app_subtype = subtype;
+	DCB_PORT_LINK(entry, dp, app[app_index(head)][subtype]);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -216,6 +398,7 @@ void apptlv_erase(app_it *p)
 {
 	void *itp = (void *)(*p)->second;
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 	if (itp) {
 		free (itp);
 		itp = NULL;
@@ -226,35 +409,57 @@ void apptlv_erase(app_it *p)
 }
 
 
-int llink_not_initted = true;
+__thread int llink_not_initted = true;
 struct llink_store {
 	char ifname[MAX_DESCRIPTION_LEN];
 	u32 llink_subtype;
 	llink_attribs *second;
+	struct dcb_port_store *port;
+	struct llink_store **slot;
 	LIST_ENTRY(llink_store) entries;
 };
 typedef struct llink_store * llink_it;
-LIST_HEAD(llinkhead, llink_store) llink, peer_llink, oper_llink;
+__thread LIST_HEAD(llinkhead, llink_store) llink, peer_llink, oper_llink;
+
+static int llink_index(struct llinkhead *head)
+{
+	if (head == &peer_llink)
+		return DCB_PEER;
+	if (head == &oper_llink)
+		return DCB_OPER;
+	return DCB_LOCAL;
+}
 
 struct llink_store *llink_find(struct llinkhead *head, char *ifname,
 				u32 subtype)
 {
-	struct llink_store *p = NULL;
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname) && p->llink_subtype == subtype)
-			return p;
-	return p;
+	struct dcb_port_store *dp;
+
+	if (subtype >= DCB_MAX_LLKTLV)
+		return NULL;
+	dp = dcb_port_find(ifname);
+	return dp ? dp->llink[llink_index(head)][subtype] : NULL;
 }
 void llink_insert(struct llinkhead *head, char *ifname, llink_attribs *store,
 			u32 subtype)
 {
+	struct dcb_port_store *dp;
 	struct llink_store *entry;
+
+	if (subtype >= DCB_MAX_LLKTLV)
+		return;
 	entry = (struct llink_store *) malloc(sizeof(struct llink_store));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strcpy(entry->ifname, ifname);
 	entry->second = store;
 	entry->llink_subtype = subtype;
+	DCB_PORT_LINK(entry, dp, llink[llink_index(head)][subtype]);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -262,6 +467,7 @@ void llink_erase(llink_it *p)
 {
 	void *itp = (void *)(*p)->second;
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 	if (itp) {
 		free(itp);
 		itp = NULL;
@@ -271,35 +477,48 @@ void llink_erase(llink_it *p)
 	*p = NULL;
 }
 
-int ctrl_not_initted = true;
+__thread int ctrl_not_initted = true;
 struct dcb_control_protocol {
 	char ifname[MAX_DESCRIPTION_LEN];
 	control_protocol_attribs *second;
+	struct dcb_port_store *port;
+	struct dcb_control_protocol **slot;
 	LIST_ENTRY(dcb_control_protocol) entries;
 };
 typedef struct dcb_control_protocol * control_prot_it;
-LIST_HEAD(control_prot_head, dcb_control_protocol)\
+__thread LIST_HEAD(control_prot_head, dcb_control_protocol)\
 		dcb_control_prot, dcb_peer_control_prot;
 
+static int ctrl_prot_index(struct control_prot_head *head)
+{
+	return head == &dcb_peer_control_prot ? DCB_PEER : DCB_LOCAL;
+}
+
 struct dcb_control_protocol *ctrl_prot_find(struct control_prot_head *head,
 						const char *ifname)
 {
-	struct dcb_control_protocol *p = NULL;
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname))
-			return p;
-	return p;
+	struct dcb_port_store *dp = dcb_port_find(ifname);
+
+	return dp ? dp->ctrl[ctrl_prot_index(head)] : NULL;
 }
 void ctrl_prot_insert(struct control_prot_head *head, char *ifname,
 			control_protocol_attribs *store)
 {
+	struct dcb_port_store *dp;
 	struct dcb_control_protocol *entry;
+
 	entry = (struct dcb_control_protocol *)
 			malloc(sizeof(struct dcb_control_protocol));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strcpy(entry->ifname, ifname);
 	entry->second = store;
+	DCB_PORT_LINK(entry, dp, ctrl[ctrl_prot_index(head)]);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -307,6 +526,7 @@ void ctrl_prot_erase(control_prot_it *p)
 {
 	void *itp = (void *)(*p)->second;
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 	if (itp) {
 		free(itp);
 		itp = NULL;
@@ -316,32 +536,41 @@ void ctrl_prot_erase(control_prot_it *p)
 	*p = NULL;
 }
 
-int feature_not_initted = true;
+__thread int feature_not_initted = true;
 struct features_store {
 	char ifname[MAX_DESCRIPTION_LEN];
 	feature_support *second;
+	struct dcb_port_store *port;
+	struct features_store **slot;
 	LIST_ENTRY(features_store) entries;
 };
 typedef struct features_store * features_it;
-LIST_HEAD(featurehead, features_store) feature_struct;
+__thread LIST_HEAD(featurehead, features_store) feature_struct;
 
 struct features_store *features_find(struct featurehead *head, char *ifname)
 {
-	struct features_store *p = NULL;
-	for (p = head->lh_first; p != NULL; p = p->entries.le_next)
-		if (!strcmp(p->ifname, ifname))
-			return p;
-	return p;
+	struct dcb_port_store *dp = dcb_port_find(ifname);
+
+	(void)head;
+	return dp ? dp->features : NULL;
 }
 void features_insert(struct featurehead *head, char *ifname,
 			feature_support *store)
 {
+	struct dcb_port_store *dp;
 	struct features_store *entry;
+
 	entry = (struct features_store *)malloc(sizeof(struct features_store));
 	if (!entry)
 		return;
+	dp = dcb_port_get(ifname);
+	if (!dp) {
+		free(entry);
+		return;
+	}
 	strcpy(entry->ifname, ifname);
 	entry->second = store;
+	DCB_PORT_LINK(entry, dp, features);
 	LIST_INSERT_HEAD(head, entry, entries);
 }
 
@@ -349,6 +578,7 @@ void features_erase(features_it *p)
 {
 	void *itp = (void *)(*p)->second;
 	LIST_REMOVE(*p, entries);
+	DCB_PORT_UNLINK(*p);
 
 	if (itp) {
 		free(itp);
@@ -596,7 +826,7 @@ bool add_control_protocol(char *device_name, dcbx_state *state)
 
 		init_control_prot(store, state);
 		ctrl_prot_insert(&dcb_control_prot, device_name, store);
-	} else if (get_operstate(device_name) == IF_OPER_DORMANT) {
+	} else if (get_hw_operstate(device_name) == IF_OPER_DORMANT) {
 		init_control_prot(it->second, state);
 	}
 
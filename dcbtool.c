@@ -43,6 +43,9 @@
 #include "lldpad.h"
 #include "dcbtool.h"
 #include "version.h"
+#include "lldp.h"
+#include "dcb_types.h"
+#include "lldpad_shm.h"
 
 #define UNUSED __attribute__((__unused__))
 
@@ -186,6 +189,8 @@ static const char *commands_help =
 "     [status:<0|1>]            for testing, the logical link status may\n"
 "                               be set to 0 or 1.  This setting is not\n"
 "                               persisted.\n\n"
+"  shm [ifname]                 print the lldpad shared memory state, read\n"
+"                               directly from the segment\n"
 "  help                         show command information\n"
 "  license                      show license information\n";
 
@@ -322,6 +327,12 @@ static int cli_cmd_ping(struct clif *clif, UNUSED int argc, UNUSED char *argv[],
 	return clif_command(clif, "P", raw);
 }
 
+static int cli_cmd_shm(UNUSED struct clif *clif, int argc, char *argv[],
+		       UNUSED int raw)
+{
+	return lldpad_shm_print(argc > 0 ? argv[0] : NULL) ? 0 : -1;
+}
+
 static int
 cli_cmd_help(UNUSED struct clif *clif, UNUSED int argc, UNUSED char *argv[],
 	     UNUSED int raw)
@@ -354,6 +365,7 @@ struct cli_cmd {
 
 static struct cli_cmd cli_commands[] = {
 	{ "ping", cli_cmd_ping },
+	{ "shm", cli_cmd_shm },
 	{ "help", cli_cmd_help },
 	{ "license", cli_cmd_license },
 	{ "quit", cli_cmd_quit },
@@ -12,6 +12,7 @@
  * See README and COPYING for more details.
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
@@ -20,6 +21,10 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include "eloop.h"
 #include "include/messages.h"
 
@@ -114,19 +119,200 @@ struct eloop_data {
 
 	int terminate;
 	int reader_table_changed;
+
+	int post_fd;			/* Signals posted messages */
+	pthread_mutex_t post_lock;
+	struct eloop_msg *posted;	/* Messages from other threads */
+	struct eloop_msg **posted_tail;
 };
 
-static struct eloop_data eloop;
+/*
+ * Each thread runs its own event loop, see eloop_post() for communication
+ * between them. Signals are handled by the thread which receives them.
+ */
+static __thread struct eloop_data eloop;
+
+/*
+ * Profile of the event loop. Each handler is accounted by its function
+ * address in a small open addressing hash table. Histograms count event loop
+ * iterations by the time spent in handlers and expired timeouts by the delay
+ * of the handler call. Bucket 0 counts values below 1 microsecond, bucket n
+ * values below 2^n microseconds and the last bucket all larger values.
+ */
+#define	ELOOP_PROF_SLOTS	128	/* Power of 2 */
+#define	ELOOP_PROF_BUCKETS	22
+
+enum eloop_prof_kind {
+	ELOOP_PROF_SOCK,
+	ELOOP_PROF_TIMEOUT,
+	ELOOP_PROF_SIGNAL
+};
+
+static const char *const eloop_prof_kinds[] = { "sock", "timeout", "signal" };
+
+struct eloop_prof_ent {
+	void *handler;			/* Key, NULL for unused slot */
+	enum eloop_prof_kind kind;
+	unsigned long calls;		/* # of calls */
+	unsigned long long total_ns;	/* Time spent in handler */
+	unsigned long long max_ns;	/* Longest call */
+	unsigned long long late_us;	/* Sum of timeout delays */
+	unsigned long long late_max;	/* Longest timeout delay */
+};
+
+static int eloop_prof_all;		/* Profile event loops started later */
+
+static __thread struct {
+	int on;
+	unsigned long iterations;	/* # of iterations with handler calls */
+	unsigned long dropped;		/* # of calls not accounted */
+	unsigned long busy[ELOOP_PROF_BUCKETS];
+	unsigned long late[ELOOP_PROF_BUCKETS];
+	struct eloop_prof_ent ent[ELOOP_PROF_SLOTS];
+} eloop_prof;
 
+static unsigned long long eloop_prof_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int eloop_prof_bucket(unsigned long long us)
+{
+	unsigned int b = 0;
+
+	while (us && b < ELOOP_PROF_BUCKETS - 1) {
+		us >>= 1;
+		++b;
+	}
+	return b;
+}
+
+static struct eloop_prof_ent *eloop_prof_find(void *handler,
+					      enum eloop_prof_kind kind)
+{
+	unsigned int h = ((unsigned long)handler >> 4) * 2654435761U;
+	unsigned int i;
+
+	for (i = 0; i < ELOOP_PROF_SLOTS; ++i) {
+		struct eloop_prof_ent *ep;
+
+		ep = &eloop_prof.ent[(h + i) & (ELOOP_PROF_SLOTS - 1)];
+		if (ep->handler == handler && ep->kind == kind)
+			return ep;
+		if (!ep->handler) {
+			ep->handler = handler;
+			ep->kind = kind;
+			return ep;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Account a handler call which started at time start (nanoseconds).
+ * Parameter late is the delay of a timeout handler in microseconds and
+ * negative for other handlers.
+ */
+static void eloop_prof_call(void *handler, enum eloop_prof_kind kind,
+			    unsigned long long start, long long late)
+{
+	unsigned long long ns = eloop_prof_ns() - start;
+	struct eloop_prof_ent *ep = eloop_prof_find(handler, kind);
+
+	if (!ep) {
+		++eloop_prof.dropped;
+		return;
+	}
+	++ep->calls;
+	ep->total_ns += ns;
+	if (ns > ep->max_ns)
+		ep->max_ns = ns;
+	if (late >= 0) {
+		ep->late_us += late;
+		if ((unsigned long long)late > ep->late_max)
+			ep->late_max = late;
+		++eloop_prof.late[eloop_prof_bucket(late)];
+	}
+}
+
+/*
+ * Turn profiling of the calling thread's event loop on or off. Turning it on
+ * clears all counters. Event loops initialized later inherit the setting.
+ */
+void eloop_profile(int on)
+{
+	if (on && !eloop_prof.on)
+		memset(&eloop_prof, 0, sizeof(eloop_prof));
+	eloop_prof.on = on;
+	eloop_prof_all = on;
+}
+
+
+static void eloop_post_receive(int sock, UNUSED void *eloop_ctx,
+			       UNUSED void *sock_ctx)
+{
+	eventfd_t cnt;
+
+	eventfd_read(sock, &cnt);
+	eloop_run_posted();
+}
 
 int eloop_init(void *user_data)
 {
 	memset(&eloop, 0, sizeof(eloop));
 	eloop.user_data = user_data;
+	eloop.posted_tail = &eloop.posted;
+	pthread_mutex_init(&eloop.post_lock, NULL);
+	eloop.post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (eloop.post_fd < 0)
+		return -1;
+	if (eloop_register_read_sock(eloop.post_fd, eloop_post_receive,
+				     NULL, NULL)) {
+		close(eloop.post_fd);
+		return -1;
+	}
+	if (eloop_prof_all)
+		eloop_profile(1);
 	return 0;
 }
 
 
+struct eloop_data *eloop_self(void)
+{
+	return &eloop;
+}
+
+
+void eloop_post(struct eloop_data *loop, struct eloop_msg *msg)
+{
+	msg->next = NULL;
+	pthread_mutex_lock(&loop->post_lock);
+	*loop->posted_tail = msg;
+	loop->posted_tail = &msg->next;
+	pthread_mutex_unlock(&loop->post_lock);
+	eventfd_write(loop->post_fd, 1);
+}
+
+
+void eloop_run_posted(void)
+{
+	struct eloop_msg *msg, *next;
+
+	pthread_mutex_lock(&eloop.post_lock);
+	msg = eloop.posted;
+	eloop.posted = NULL;
+	eloop.posted_tail = &eloop.posted;
+	pthread_mutex_unlock(&eloop.post_lock);
+	for (; msg; msg = next) {
+		next = msg->next;
+		msg->handler(msg);
+	}
+}
+
+
 static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
                                      int sock, eloop_sock_handler handler,
                                      void *eloop_data, void *user_data)
@@ -206,9 +392,17 @@ static void eloop_sock_table_dispatch(struct eloop_sock_table *table,
 	table->changed = 0;
 	for (i = 0; i < table->count; i++) {
 		if (FD_ISSET(table->table[i].sock, fds)) {
-			table->table[i].handler(table->table[i].sock,
-						table->table[i].eloop_data,
-						table->table[i].user_data);
+			eloop_sock_handler handler = table->table[i].handler;
+			unsigned long long start = 0;
+
+			if (eloop_prof.on)
+				start = eloop_prof_ns();
+			handler(table->table[i].sock,
+				table->table[i].eloop_data,
+				table->table[i].user_data);
+			if (start)
+				eloop_prof_call((void *)handler,
+						ELOOP_PROF_SOCK, start, -1);
 			if (table->changed)
 				break;
 		}
@@ -416,10 +610,17 @@ static void eloop_process_pending_signals(void)
 
 	for (i = 0; i < eloop.signal_count; i++) {
 		if (eloop.signals[i].signaled) {
+			eloop_signal_handler handler = eloop.signals[i].handler;
+			unsigned long long start = 0;
+
+			if (eloop_prof.on)
+				start = eloop_prof_ns();
 			eloop.signals[i].signaled = 0;
-			eloop.signals[i].handler(eloop.signals[i].sig,
-						 eloop.user_data,
-						 eloop.signals[i].user_data);
+			handler(eloop.signals[i].sig, eloop.user_data,
+				eloop.signals[i].user_data);
+			if (start)
+				eloop_prof_call((void *)handler,
+						ELOOP_PROF_SIGNAL, start, -1);
 		}
 	}
 }
@@ -472,6 +673,7 @@ void eloop_run(void)
 	int res;
 	struct timeval _tv;
 	struct os_time tv, now;
+	unsigned long long start;
 
 	rfds = malloc(sizeof(*rfds));
 	wfds = malloc(sizeof(*wfds));
@@ -503,6 +705,7 @@ void eloop_run(void)
 			perror("select");
 			goto out;
 		}
+		start = eloop_prof.on ? eloop_prof_ns() : 0;
 		eloop_process_pending_signals();
 
 		/* check if some registered timeouts have occurred */
@@ -511,21 +714,36 @@ void eloop_run(void)
 
 			os_get_time(&now);
 			if (!os_time_before(&now, &eloop.timeout->time)) {
+				unsigned long long t = 0;
+
 				tmp = eloop.timeout;
 				eloop.timeout = eloop.timeout->next;
+				if (eloop_prof.on) {
+					os_time_sub(&now, &tmp->time, &tv);
+					t = eloop_prof_ns();
+				}
 				tmp->handler(tmp->eloop_data,
 					     tmp->user_data);
+				if (t)
+					eloop_prof_call((void *)tmp->handler,
+							ELOOP_PROF_TIMEOUT, t,
+							tv.sec * 1000000LL +
+							tv.usec);
 				free(tmp);
 			}
 
 		}
 
-		if (res <= 0)
-			continue;
-
-		eloop_sock_table_dispatch(&eloop.readers, rfds);
-		eloop_sock_table_dispatch(&eloop.writers, wfds);
-		eloop_sock_table_dispatch(&eloop.exceptions, efds);
+		if (res > 0) {
+			eloop_sock_table_dispatch(&eloop.readers, rfds);
+			eloop_sock_table_dispatch(&eloop.writers, wfds);
+			eloop_sock_table_dispatch(&eloop.exceptions, efds);
+		}
+		if (start && eloop_prof.on) {
+			++eloop_prof.iterations;
+			++eloop_prof.busy[eloop_prof_bucket((eloop_prof_ns() -
+							     start) / 1000)];
+		}
 	}
 
 out:
@@ -541,10 +759,19 @@ void eloop_terminate(int sig, UNUSED void *eloop_ctx, UNUSED void *signal_ctx)
 	eloop.terminate = 1;
 }
 
+void eloop_stop(void)
+{
+	eloop.terminate = 1;
+}
+
 void eloop_destroy(void)
 {
 	struct eloop_timeout *timeout, *prev;
 
+	eloop_run_posted();
+	eloop_unregister_read_sock(eloop.post_fd);
+	close(eloop.post_fd);
+	pthread_mutex_destroy(&eloop.post_lock);
 	timeout = eloop.timeout;
 	while (timeout != NULL) {
 		prev = timeout;
@@ -581,3 +808,126 @@ void * eloop_get_user_data(void)
 {
 	return eloop.user_data;
 }
+
+
+/*
+ * Name of a handler: the symbol name if it is exported, otherwise the
+ * offset into the object file which addr2line(1) resolves.
+ */
+static const char *eloop_prof_name(void *handler, char *buf, size_t len)
+{
+	Dl_info info;
+
+	if (!dladdr(handler, &info) || !info.dli_fname) {
+		snprintf(buf, len, "%p", handler);
+		return buf;
+	}
+	if (info.dli_sname && info.dli_saddr == handler)
+		return info.dli_sname;
+	snprintf(buf, len, "%s+%#lx", basename(info.dli_fname),
+		 (unsigned long)((char *)handler - (char *)info.dli_fbase));
+	return buf;
+}
+
+static int eloop_prof_cmp(const void *a, const void *b)
+{
+	const struct eloop_prof_ent *x = *(struct eloop_prof_ent **)a;
+	const struct eloop_prof_ent *y = *(struct eloop_prof_ent **)b;
+
+	if (x->total_ns == y->total_ns)
+		return 0;
+	return x->total_ns < y->total_ns ? 1 : -1;
+}
+
+static int eloop_prof_hist(char *buf, size_t len, const char *name,
+			   unsigned long *hist)
+{
+	size_t used;
+	unsigned int i;
+	int c;
+
+	c = snprintf(buf, len, "%-8s", name);
+	if (c < 0 || (size_t)c >= len)
+		return 0;
+	used = c;
+	for (i = 0; i < ELOOP_PROF_BUCKETS; ++i) {
+		if (!hist[i])
+			continue;
+		c = snprintf(buf + used, len - used, " %s%lu:%lu",
+			     i == ELOOP_PROF_BUCKETS - 1 ? ">=" : "<",
+			     1UL << (i == ELOOP_PROF_BUCKETS - 1 ? i - 1 : i),
+			     hist[i]);
+		if (c < 0 || (size_t)c >= len - used)
+			return 0;
+		used += c;
+	}
+	c = snprintf(buf + used, len - used, "\n");
+	if (c < 0 || (size_t)c >= len - used)
+		return 0;
+	return used + c;
+}
+
+/*
+ * Print the event loop profile into buffer. Parameter arg turns profiling
+ * on or off, or clears the counters with "reset".
+ * Handlers are printed in order of the time spent in them, times are in
+ * microseconds.
+ * Returns the number of bytes written to the buffer.
+ */
+int eloop_stats(char *buf, size_t len, const char *arg)
+{
+	struct eloop_prof_ent *sorted[ELOOP_PROF_SLOTS];
+	unsigned int i, cnt = 0;
+	size_t used = 0;
+	char name[64];
+	int c;
+
+	if (arg && !strcmp(arg, "on"))
+		eloop_profile(1);
+	else if (arg && !strcmp(arg, "off"))
+		eloop_profile(0);
+	else if (arg && !strcmp(arg, "reset") && eloop_prof.on) {
+		eloop_profile(0);
+		eloop_profile(1);
+	}
+	for (i = 0; i < ELOOP_PROF_SLOTS; ++i)
+		if (eloop_prof.ent[i].handler)
+			sorted[cnt++] = &eloop_prof.ent[i];
+	qsort(sorted, cnt, sizeof(sorted[0]), eloop_prof_cmp);
+
+	c = snprintf(buf, len, "profiling %s iterations %lu handlers %u "
+		     "dropped %lu\n", eloop_prof.on ? "on" : "off",
+		     eloop_prof.iterations, cnt, eloop_prof.dropped);
+	if (c < 0 || (size_t)c >= len)
+		return 0;
+	used += c;
+	c = eloop_prof_hist(buf + used, len - used, "busy", eloop_prof.busy);
+	if (!c)
+		return used;
+	used += c;
+	c = eloop_prof_hist(buf + used, len - used, "late", eloop_prof.late);
+	if (!c)
+		return used;
+	used += c;
+	c = snprintf(buf + used, len - used, "%-32s %-7s %9s %10s %8s %8s "
+		     "%8s\n", "handler", "kind", "calls", "total", "max",
+		     "late", "late_max");
+	if (c < 0 || (size_t)c >= len - used)
+		return used;
+	used += c;
+	for (i = 0; i < cnt; ++i) {
+		struct eloop_prof_ent *ep = sorted[i];
+
+		c = snprintf(buf + used, len - used,
+			     "%-32.32s %-7s %9lu %10llu %8llu %8llu %8llu\n",
+			     eloop_prof_name(ep->handler, name, sizeof(name)),
+			     eloop_prof_kinds[ep->kind], ep->calls,
+			     ep->total_ns / 1000, ep->max_ns / 1000,
+			     ep->calls ? ep->late_us / ep->calls : 0,
+			     ep->late_max);
+		if (c < 0 || (size_t)c >= len - used)
+			break;
+		used += c;
+	}
+	return used;
+}
@@ -60,11 +60,19 @@
 #include "messages.h"
 #include "lldp_rtnl.h"
 #include "qbg_vdpnl.h"
+#include "qbg_vdp22.h"
 #include "lldp_tlv.h"
+#include "shard.h"
+#include "hostinfo.h"
 
 extern unsigned int if_nametoindex(const char *);
 extern char *if_indextoname(unsigned int, char *);
 
+/*
+ * Maximum number of datagrams read from the user space socket per wakeup.
+ */
+#define EVENT_IFACE_BATCH	64
+
 static int peer_sock;
 
 static void event_if_decode_rta(int type, struct rtattr *rta, int *ls, char *d)
@@ -189,10 +197,7 @@ int oper_add_device(char *device_name)
 	int ifindex;
 
 	ifindex = get_ifidx(device_name);
-	for (port = porthead; port; port = port->next)
-		if (ifindex == port->ifindex)
-			break;
-
+	port = port_find_by_ifindex(ifindex);
 	if (!port) {
 		newport = add_port(ifindex, device_name);
 		if (!newport) {
@@ -206,9 +211,7 @@ int oper_add_device(char *device_name)
 	} else if (is_bond(device_name) || !port->portEnabled)
 		reinit_port(device_name);
 
-	lldp_add_agent(device_name, NEAREST_BRIDGE);
-	lldp_add_agent(device_name, NEAREST_NONTPMR_BRIDGE);
-	lldp_add_agent(device_name, NEAREST_CUSTOMER_BRIDGE);
+	lldp_add_agents(port);
 
 	LIST_FOREACH(agent, &port->agent_head, entry) {
 		LLDPAD_DBG("%s: calling ifup for agent %p.\n",
@@ -230,6 +233,7 @@ static void event_if_decode_nlmsg(int route_type, void *data, int len)
 	struct rtattr *rta;
 	char device_name[IFNAMSIZ];
 	struct lldp_agent *agent;
+	struct port *port;
 	int ifindex;
 	int attrlen;
 	int valid;
@@ -273,7 +277,7 @@ static void event_if_decode_nlmsg(int route_type, void *data, int len)
 			if (!valid)
 				break;
 
-			struct port *port = port_find_by_ifindex(ifindex);
+			port = port_find_by_ifindex(ifindex);
 			if (!port)
 				break;
 
@@ -320,6 +324,17 @@ static void event_if_decode_nlmsg(int route_type, void *data, int len)
 		break;
 	case RTM_NEWADDR:
 	case RTM_DELADDR:
+		if (len < (int)sizeof(struct ifaddrmsg))
+			break;
+		ifindex = ((struct ifaddrmsg *)data)->ifa_index;
+		LLDPAD_DBG("Address change on ifindex %i.\n", ifindex);
+		port = port_find_by_ifindex(ifindex);
+		if (!port || !hostinfo_addr_update(port->ifname))
+			break;
+		/* The management address TLVs are rebuilt with the next frame */
+		LIST_FOREACH(agent, &port->agent_head, entry)
+			somethingChangedLocal(port->ifname, agent->type);
+		break;
 	case RTM_GETADDR:
 		LLDPAD_DBG("Address change.\n");
 		break;
@@ -335,6 +350,127 @@ static void event_if_process_recvmsg(struct nlmsghdr *nlmsg)
 		NLMSG_PAYLOAD(nlmsg, 0));
 }
 
+/*
+ * Return the interface index of a link or address message, taken from the
+ * header or from the interface name attribute. Returns 0 if there is none.
+ */
+static int event_if_ifindex(struct nlmsghdr *nlh)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+	struct rtattr *rta;
+	int attrlen;
+
+	if (nlh->nlmsg_type == RTM_NEWADDR || nlh->nlmsg_type == RTM_DELADDR) {
+		struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+
+		if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa)))
+			return 0;
+		return ifa->ifa_index;
+	}
+	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+		return 0;
+	if (ifi->ifi_index > 0)
+		return ifi->ifi_index;
+	attrlen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, attrlen);
+	     rta = RTA_NEXT(rta, attrlen)) {
+		char name[IFNAMSIZ];
+
+		if (rta->rta_type != IFLA_IFNAME)
+			continue;
+		snprintf(name, sizeof(name), "%.*s",
+			 (int)RTA_PAYLOAD(rta), (char *)RTA_DATA(rta));
+		return if_nametoindex(name);
+	}
+	return 0;
+}
+
+/*
+ * Process a link message forwarded by the main thread on the shard which
+ * owns the interface.
+ */
+static void event_if_shard_recvmsg(void *arg)
+{
+	event_if_process_recvmsg(arg);
+	free(arg);
+}
+
+static void event_if_shard_rescan(UNUSED void *arg)
+{
+	eloop_register_timeout(INI_TIMER, 0, scan_port, NULL, NULL);
+}
+
+/*
+ * Link messages may have been dropped, rescan the ports of all shards.
+ */
+static void event_if_rescan(void)
+{
+	unsigned int i;
+
+	if (!shard_count()) {
+		event_if_shard_rescan(NULL);
+		return;
+	}
+	for (i = 0; i < shard_count(); ++i)
+		shard_post(i, event_if_shard_rescan, NULL);
+}
+
+/*
+ * A netlink message of a datagram from a user space requestor. It is
+ * copied into its own buffer, which receives the reply when the message
+ * is processed.
+ */
+struct event_if_msg {
+	unsigned char *buf;		/* Request, then reply */
+	size_t size;			/* Size of buf */
+	int rc;				/* Length of the reply or error */
+	unsigned int shard;		/* Shard owning the interface */
+	bool pending;			/* Not processed yet */
+};
+
+struct event_if_vdpreq {
+	struct event_if_msg *msg;	/* All messages of one wakeup */
+	unsigned int cnt;
+	unsigned int shard;		/* Shard to process messages of */
+};
+
+/*
+ * Process all messages of the calling shard in one transmit batch.
+ */
+static int event_if_shard_vdpnl(void *arg)
+{
+	struct event_if_vdpreq *req = arg;
+	struct event_if_msg *m;
+
+	vdp22_txbatch_begin();
+	for (m = req->msg; m < req->msg + req->cnt; ++m) {
+		if (!m->pending || m->shard != req->shard)
+			continue;
+		m->rc = vdpnl_recv(m->buf, m->size);
+		m->pending = false;
+	}
+	vdp22_txbatch_end();
+	return 0;
+}
+
+/*
+ * Pass the VDP requests to the shards which own the interfaces, with one
+ * call per shard. The ECP transmissions for the requests of one shard are
+ * combined.
+ */
+static void event_if_vdpnl(struct event_if_msg *msg, unsigned int cnt)
+{
+	struct event_if_vdpreq req = { .msg = msg, .cnt = cnt };
+	unsigned int i;
+
+	for (i = 0; i < cnt; ++i) {
+		if (!msg[i].pending)
+			continue;
+		req.shard = msg[i].shard;
+		shard_call(req.shard, event_if_shard_vdpnl, &req);
+	}
+}
+
 int event_trigger(struct nlmsghdr *nlh, pid_t pid)
 {
 	struct sockaddr_nl dest_addr;
@@ -351,36 +487,215 @@ int event_trigger(struct nlmsghdr *nlh, pid_t pid)
 	return rc;
 }
 
+/*
+ * Send the replies collected for a datagram back to the requestor.
+ */
+static void event_iface_reply(int sock, unsigned char *buf, size_t len,
+			      struct sockaddr_nl *dest_addr, socklen_t fromlen)
+{
+	int result;
+
+	result = sendto(sock, buf, len, 0, (struct sockaddr *)dest_addr,
+			fromlen);
+	if (result < 0)
+		LLDPAD_ERR("%s:send error on netlink socket:%d\n", __func__,
+			   errno);
+	else
+		LLDPAD_DBG("%s:sentto pid %d bytes:%d\n", __func__,
+			   dest_addr->nl_pid, result);
+}
+
+/*
+ * Store an error reply for a request which was not processed.
+ * Returns the length of the reply.
+ */
+static size_t event_iface_errmsg(unsigned char *rbuf, struct nlmsghdr *nlh,
+				 int err)
+{
+	struct nlmsghdr *rnlh = (struct nlmsghdr *)rbuf;
+	struct nlmsgerr *e = NLMSG_DATA(rnlh);
+
+	memset(rnlh, 0, NLMSG_SPACE(sizeof(*e)));
+	rnlh->nlmsg_len = NLMSG_LENGTH(sizeof(*e));
+	rnlh->nlmsg_type = NLMSG_ERROR;
+	rnlh->nlmsg_seq = nlh->nlmsg_seq;
+	rnlh->nlmsg_pid = nlh->nlmsg_pid;
+	e->error = err;
+	memcpy(&e->msg, nlh, sizeof(*nlh));
+	return NLMSG_SPACE(sizeof(*e));
+}
+
+/*
+ * A datagram from a user space requestor and the range of its messages.
+ */
+struct event_if_dgram {
+	struct sockaddr_nl addr;
+	socklen_t fromlen;
+	unsigned int len;
+	bool multi;			/* Several messages */
+	unsigned int first;		/* Index of first message */
+	unsigned int cnt;		/* # of messages */
+	unsigned char buf[MAX_PAYLOAD];
+};
+
+/*
+ * Split the datagrams into their netlink messages. Only the first message
+ * of a datagram is used unless it carries several. A request too large to
+ * be answered in one reply datagram gets an error reply instead.
+ * Returns the number of messages, *msgp is set to the array.
+ */
+static unsigned int event_if_split(struct event_if_dgram *dg,
+				   unsigned int ndg, struct event_if_msg **msgp)
+{
+	struct event_if_msg *msg = NULL, *m;
+	unsigned int nmsg = 0, max = 0, i, len;
+	struct nlmsghdr *nlh;
+	size_t room, need;
+
+	for (i = 0; i < ndg; ++i) {
+		nlh = (struct nlmsghdr *)dg[i].buf;
+		len = dg[i].len;
+		dg[i].multi = NLMSG_OK(nlh, len) &&
+			      NLMSG_ALIGN(nlh->nlmsg_len) < len;
+		/* Leave room for NLMSG_DONE */
+		room = MAX_PAYLOAD - (dg[i].multi ? NLMSG_SPACE(0) : 0);
+		dg[i].first = nmsg;
+		for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nmsg == max) {
+				max = max ? 2 * max : EVENT_IFACE_BATCH;
+				m = realloc(msg, max * sizeof(*msg));
+				if (!m) {
+					LLDPAD_ERR("%s:no memory for %u "
+						   "messages\n", __func__, max);
+					break;
+				}
+				msg = m;
+			}
+			m = &msg[nmsg++];
+			memset(m, 0, sizeof(*m));
+			need = NLMSG_SPACE(sizeof(struct nlmsgerr));
+			if (nlh->nlmsg_type == RTM_GETLINK)
+				need = room;
+			need = MIN(MAX(need, (size_t)nlh->nlmsg_len), room);
+			m->buf = malloc(need);
+			if (!m->buf) {
+				LLDPAD_ERR("%s:no memory for request\n",
+					   __func__);
+			} else if (nlh->nlmsg_len > room) {
+				m->rc = event_iface_errmsg(m->buf, nlh,
+							   -EMSGSIZE);
+			} else {
+				memcpy(m->buf, nlh, nlh->nlmsg_len);
+				m->size = need;
+				m->shard = shard_of(event_if_ifindex(nlh));
+				m->pending = true;
+			}
+			if (!dg[i].multi)
+				break;
+		}
+		dg[i].cnt = nmsg - dg[i].first;
+	}
+	*msgp = msg;
+	return nmsg;
+}
+
+/*
+ * Send the replies to the messages of one datagram back to the requestor.
+ * A datagram with one message is answered with one reply message. Replies
+ * to a datagram with several messages are returned as one multipart reply
+ * terminated by NLMSG_DONE. The reply is split into several datagrams when
+ * it does not fit into one buffer.
+ */
+static void event_iface_user_replies(int sock, struct event_if_dgram *dg,
+				     struct event_if_msg *msg)
+{
+	unsigned char rbuf[MAX_PAYLOAD];
+	struct nlmsghdr *rnlh;
+	size_t rlen = 0, done = 0;
+	__u32 seq = 0, pid = 0;
+	unsigned int i;
+
+	if (dg->multi)
+		done = NLMSG_SPACE(0);		/* Room for NLMSG_DONE */
+	for (i = 0; i < dg->cnt; ++i) {
+		/* No data to send back */
+		if (!msg[i].buf || msg[i].rc <= 0)
+			continue;
+		if (rlen &&
+		    rlen + NLMSG_ALIGN(msg[i].rc) + done > sizeof(rbuf)) {
+			event_iface_reply(sock, rbuf, rlen, &dg->addr,
+					  dg->fromlen);
+			rlen = 0;
+		}
+		rnlh = (struct nlmsghdr *)(rbuf + rlen);
+		memcpy(rnlh, msg[i].buf, msg[i].rc);
+		if (dg->multi)
+			rnlh->nlmsg_flags |= NLM_F_MULTI;
+		seq = rnlh->nlmsg_seq;
+		pid = rnlh->nlmsg_pid;
+		rlen += NLMSG_ALIGN(msg[i].rc);
+	}
+	if (dg->multi && rlen) {
+		rnlh = (struct nlmsghdr *)(rbuf + rlen);
+		memset(rnlh, 0, done);
+		rnlh->nlmsg_len = done;
+		rnlh->nlmsg_type = NLMSG_DONE;
+		rnlh->nlmsg_flags = NLM_F_MULTI;
+		rnlh->nlmsg_seq = seq;
+		rnlh->nlmsg_pid = pid;
+		rlen += done;
+	}
+	if (rlen)
+		event_iface_reply(sock, rbuf, rlen, &dg->addr, dg->fromlen);
+}
+
+/*
+ * Read all datagrams queued on the socket (up to a limit to give other
+ * sockets a chance). Their messages are passed to the shards with one call
+ * per shard, which sends the resulting VDP22 transmissions to the switch
+ * together. The replies are sent when all messages are processed.
+ */
 static void
 event_iface_receive_user_space(int sock,
 			       UNUSED void *eloop_ctx, UNUSED void *sock_ctx)
 {
-	struct sockaddr_nl dest_addr;
-	unsigned char buf[MAX_PAYLOAD];
-	socklen_t fromlen = sizeof(dest_addr);
+	struct event_if_dgram *dg;
+	struct event_if_msg *msg = NULL;
+	unsigned int ndg, nmsg, i;
 	int result;
 
 	LLDPAD_DBG("Waiting for message\n");
-	result = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT,
-		       (struct sockaddr *) &dest_addr, &fromlen);
-	if(result < 0) {
-		LLDPAD_ERR("%s:receive error on netlink socket:%d\n", __func__,
-			    errno);
+	dg = malloc(EVENT_IFACE_BATCH * sizeof(*dg));
+	if (!dg) {
+		LLDPAD_ERR("%s:no memory for requests\n", __func__);
 		return;
 	}
-	LLDPAD_DBG("%s:recvfrom received %d bytes from pid %d\n", __func__,
-		   result, dest_addr.nl_pid);
-	result = vdpnl_recv(buf, sizeof buf);
-	if (result > 0) {		/* Data to send back */
-		result = sendto(sock, buf, result, 0,
-				(struct sockaddr *) &dest_addr, fromlen);
-		if (result < 0)
-			LLDPAD_ERR("%s:send error on netlink socket:%d\n",
-				   __func__, errno);
-		else
-			LLDPAD_DBG("%s:sentto pid %d bytes:%d\n", __func__,
-				   dest_addr.nl_pid, result);
+	for (ndg = 0; ndg < EVENT_IFACE_BATCH; ++ndg) {
+		dg[ndg].fromlen = sizeof(dg[ndg].addr);
+		result = recvfrom(sock, dg[ndg].buf, sizeof(dg[ndg].buf),
+				  MSG_DONTWAIT,
+				  (struct sockaddr *)&dg[ndg].addr,
+				  &dg[ndg].fromlen);
+		if (result < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				LLDPAD_ERR("%s:receive error on netlink "
+					   "socket:%d\n", __func__, errno);
+			break;
+		}
+		LLDPAD_DBG("%s:recvfrom received %d bytes from pid %d\n",
+			   __func__, result, dg[ndg].addr.nl_pid);
+		dg[ndg].len = result;
 	}
+
+	nmsg = event_if_split(dg, ndg, &msg);
+	event_if_vdpnl(msg, nmsg);
+	for (i = 0; i < ndg; ++i)
+		event_iface_user_replies(sock, &dg[i], msg + dg[i].first);
+
+	for (i = 0; i < nmsg; ++i)
+		free(msg[i].buf);
+	free(msg);
+	free(dg);
 }
 
 static void
@@ -390,14 +705,14 @@ event_iface_receive(int sock, UNUSED void *eloop_ctx, UNUSED void *sock_ctx)
 	struct sockaddr_nl dest_addr;
 	char buf[MAX_PAYLOAD];
 	socklen_t fromlen = sizeof(dest_addr);
-	int result;
+	int result, ifevent;
 
 	result = recvfrom(sock, buf, sizeof(buf), MSG_DONTWAIT,
 		       (struct sockaddr *) &dest_addr, &fromlen);
 
 	if (result < 0) {
 		perror("recvfrom(Event interface)");
-		eloop_register_timeout(INI_TIMER, 0, scan_port, NULL, NULL);
+		event_if_rescan();
 		return;
 	}
 
@@ -409,6 +724,30 @@ event_iface_receive(int sock, UNUSED void *eloop_ctx, UNUSED void *sock_ctx)
 		return;
 
 	nlh = (struct nlmsghdr *)buf;
+	ifevent = NLMSG_OK(nlh, (unsigned int)result) &&
+		  ((nlh->nlmsg_type >= RTM_NEWLINK &&
+		    nlh->nlmsg_type <= RTM_SETLINK) ||
+		   nlh->nlmsg_type == RTM_NEWADDR ||
+		   nlh->nlmsg_type == RTM_DELADDR);
+	/* Capabilities or the up flag may have changed */
+	if (ifevent && nlh->nlmsg_type != RTM_NEWADDR &&
+	    nlh->nlmsg_type != RTM_DELADDR)
+		hostinfo_flush(event_if_ifindex(nlh));
+	if (shard_count() && ifevent) {
+		void *copy = malloc(nlh->nlmsg_len);
+
+		if (!copy) {
+			event_if_rescan();
+			return;
+		}
+		memcpy(copy, nlh, nlh->nlmsg_len);
+		if (shard_post(shard_of(event_if_ifindex(nlh)),
+			       event_if_shard_recvmsg, copy)) {
+			free(copy);
+			event_if_rescan();
+		}
+		return;
+	}
 	event_if_process_recvmsg(nlh);
 }
 
@@ -430,7 +769,7 @@ int event_iface_init()
 
 	memset((void *)&snl, 0, sizeof(struct sockaddr_nl));
 	snl.nl_family = AF_NETLINK;
-	snl.nl_groups = RTMGRP_LINK;
+	snl.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
 
 	if (bind(fd, (struct sockaddr *)&snl, sizeof(struct sockaddr_nl)) < 0) {
 		close(fd);
@@ -443,7 +782,7 @@ int event_iface_init()
 int event_iface_init_user_space()
 {
 	int fd;
-	int rcv_size = MAX_PAYLOAD;
+	int rcv_size = MAX_PAYLOAD * EVENT_IFACE_BATCH;
 	struct sockaddr_nl snl;
 
 	fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
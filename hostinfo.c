@@ -0,0 +1,339 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include "lldp.h"
+#include "lldp_util.h"
+#include "hostinfo.h"
+#include "messages.h"
+
+#define SYSFS_INV_PATH	"/sys/class/dmi/id"
+#define PROC_INV_PATH	"/proc/sys/kernel"
+#define PATH_INV_HWREV		SYSFS_INV_PATH "/board_version"
+#define PATH_INV_FWREV		SYSFS_INV_PATH "/bios_version"
+#define PATH_INV_SWREV		PROC_INV_PATH "/osrelease"
+#define PATH_INV_MANUFACTURER	SYSFS_INV_PATH "/sys_vendor"
+#define PATH_INV_SERIAL		SYSFS_INV_PATH "/product_uuid"
+#define PATH_INV_MODELNAME	SYSFS_INV_PATH "/product_name"
+#define PATH_INV_ASSETID	SYSFS_INV_PATH "/chassis_serial"
+
+#define INV_FIRST	LLDP_MED_INV_HWREV
+#define INV_COUNT	(LLDP_MED_INV_ASSETID - LLDP_MED_INV_HWREV + 1)
+#define INV_SIZE	33	/* Max inventory TLV string + 1 */
+
+#define HOSTINFO_HASH_SIZE	64
+
+struct hostinfo_if {
+	LIST_ENTRY(hostinfo_if) entry;
+	char ifname[IFNAMSIZ];
+	int ifindex;
+	int rc4;			/* Return code of get_addr() */
+	int rc6;
+	int rcmac;
+	struct in_addr in;
+	struct in6_addr in6;
+	u8 mac[6];
+	u16 caps;
+	int active;
+};
+
+static LIST_HEAD(, hostinfo_if) hostinfo_hash[HOSTINFO_HASH_SIZE];
+static pthread_mutex_t hostinfo_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long hostinfo_gen;	/* Incremented by each flush */
+
+static pthread_once_t inv_once = PTHREAD_ONCE_INIT;
+static char inv_data[INV_COUNT][INV_SIZE];
+
+/*
+ * TODO: If supports IETF RFC 2737
+ */
+static void inv_read(u8 subtype, char *buf, size_t size)
+{
+	const char *path;
+	struct utsname uts;
+	FILE *f;
+
+	switch (subtype) {
+	case LLDP_MED_INV_HWREV:
+		path = PATH_INV_HWREV;
+		break;
+	case LLDP_MED_INV_FWREV:
+		path = PATH_INV_FWREV;
+		break;
+	case LLDP_MED_INV_SWREV:
+		if (!uname(&uts)) {
+			snprintf(buf, size, "%.*s", (int)size - 1,
+				 uts.release);
+			return;
+		}
+		LLDPAD_DBG("%s: uname() failed for %d, try"
+			" proc fs\n", __func__, subtype);
+		path = PATH_INV_SWREV;
+		break;
+	case LLDP_MED_INV_SERIAL:
+		path = PATH_INV_SERIAL;
+		break;
+	case LLDP_MED_INV_MANUFACTURER:
+		path = PATH_INV_MANUFACTURER;
+		break;
+	case LLDP_MED_INV_MODELNAME:
+		path = PATH_INV_MODELNAME;
+		break;
+	case LLDP_MED_INV_ASSETID:
+		path = PATH_INV_ASSETID;
+		break;
+	default:
+		return;
+	}
+	f = fopen(path, "r");
+	if (!f) {
+		LLDPAD_DBG("%s: fopen(%s) failed for type %d\n",
+			__func__, path, subtype);
+		return;
+	}
+	if (!fgets(buf, size, f)) {
+		LLDPAD_DBG("%s: fgets(%s) failed for type %d\n",
+			__func__, path, subtype);
+		memset(buf, 0, size);
+	}
+	fclose(f);
+}
+
+static void inv_load(void)
+{
+	int i;
+
+	for (i = 0; i < INV_COUNT; ++i)
+		inv_read(INV_FIRST + i, inv_data[i], sizeof(inv_data[i]));
+}
+
+/*
+ * Copy the inventory string of the subtype into buf, the DMI files and
+ * the kernel release are read on the first call.
+ * Returns the length of the string, 0 if there is none.
+ */
+int hostinfo_inventory(u8 subtype, char *buf, size_t size)
+{
+	memset(buf, 0, size);
+	if (subtype < INV_FIRST || subtype >= INV_FIRST + INV_COUNT) {
+		LLDPAD_DBG("%s: unknown inventory subtype %d\n",
+			__func__, subtype);
+		return 0;
+	}
+	pthread_once(&inv_once, inv_load);
+	if (size)
+		strncpy(buf, inv_data[subtype - INV_FIRST], size - 1);
+	return strlen(buf);
+}
+
+static unsigned int hostinfo_hashfn(const char *ifname)
+{
+	unsigned int h = 2166136261U;
+
+	while (*ifname)
+		h = (h ^ (unsigned char)*ifname++) * 16777619U;
+	return h % HOSTINFO_HASH_SIZE;
+}
+
+static struct hostinfo_if *hostinfo_find(const char *ifname)
+{
+	struct hostinfo_if *hi;
+
+	LIST_FOREACH(hi, &hostinfo_hash[hostinfo_hashfn(ifname)], entry)
+		if (!strncmp(hi->ifname, ifname, IFNAMSIZ))
+			return hi;
+	return NULL;
+}
+
+/*
+ * Probe the interface without holding the lock, the ioctls and the
+ * address dump may take a while.
+ */
+static void hostinfo_probe(struct hostinfo_if *hi, const char *ifname)
+{
+	memset(hi, 0, sizeof(*hi));
+	snprintf(hi->ifname, sizeof(hi->ifname), "%s", ifname);
+	hi->ifindex = if_nametoindex(ifname);
+	hi->rc4 = get_addr(ifname, AF_INET, &hi->in);
+	hi->rc6 = get_addr(ifname, AF_INET6, &hi->in6);
+	hi->rcmac = get_addr(ifname, AF_UNSPEC, hi->mac);
+	hi->caps = get_caps(ifname) & ~SYSCAP_ROUTER;
+	hi->active = is_active(ifname);
+}
+
+/*
+ * Copy the cached data of the interface into hi, probing it on a miss.
+ * The result is not cached when a flush ran during the probe or the
+ * interface does not exist, no event would flush it.
+ */
+static void hostinfo_get(const char *ifname, struct hostinfo_if *hi)
+{
+	struct hostinfo_if *new;
+	unsigned long gen;
+
+	pthread_mutex_lock(&hostinfo_lock);
+	new = hostinfo_find(ifname);
+	if (new) {
+		*hi = *new;
+		pthread_mutex_unlock(&hostinfo_lock);
+		return;
+	}
+	gen = hostinfo_gen;
+	pthread_mutex_unlock(&hostinfo_lock);
+
+	hostinfo_probe(hi, ifname);
+	if (!hi->ifindex)
+		return;
+
+	new = malloc(sizeof(*new));
+	if (!new)
+		return;
+	*new = *hi;
+	pthread_mutex_lock(&hostinfo_lock);
+	if (gen == hostinfo_gen && !hostinfo_find(ifname)) {
+		LIST_INSERT_HEAD(&hostinfo_hash[hostinfo_hashfn(ifname)], new,
+				 entry);
+		new = NULL;
+	}
+	pthread_mutex_unlock(&hostinfo_lock);
+	free(new);
+}
+
+/*
+ * Cached get_addr(): the IPv4 or IPv6 address for AF_INET or AF_INET6,
+ * the MAC address for AF_UNSPEC.
+ * Returns the return code of get_addr().
+ */
+int hostinfo_addr(const char *ifname, int domain, void *buf)
+{
+	struct hostinfo_if hi;
+
+	hostinfo_get(ifname, &hi);
+	switch (domain) {
+	case AF_INET:
+		if (!hi.rc4)
+			memcpy(buf, &hi.in, sizeof(hi.in));
+		return hi.rc4;
+	case AF_INET6:
+		if (!hi.rc6)
+			memcpy(buf, &hi.in6, sizeof(hi.in6));
+		return hi.rc6;
+	case AF_UNSPEC:
+		if (!hi.rcmac)
+			memcpy(buf, hi.mac, sizeof(hi.mac));
+		return hi.rcmac;
+	}
+	return -1;
+}
+
+/*
+ * Cached get_caps(). The router bit follows the forwarding sysctls, which
+ * raise no event, and is read on each call.
+ */
+u16 hostinfo_caps(const char *ifname)
+{
+	struct hostinfo_if hi;
+
+	hostinfo_get(ifname, &hi);
+	return is_router() ? hi.caps | SYSCAP_ROUTER : hi.caps;
+}
+
+/*
+ * Cached is_active().
+ */
+int hostinfo_active(const char *ifname)
+{
+	struct hostinfo_if hi;
+
+	hostinfo_get(ifname, &hi);
+	return hi.active;
+}
+
+/*
+ * Probe the addresses of the interface again and update its cached data.
+ * Called for address events, which often leave the advertised addresses
+ * as they are, e.g. when duplicate address detection completes.
+ * Returns 1 if an address changed or was not cached, 0 otherwise.
+ */
+int hostinfo_addr_update(const char *ifname)
+{
+	struct hostinfo_if hi, *old;
+	int changed = 1;
+
+	hi.rc4 = get_addr(ifname, AF_INET, &hi.in);
+	hi.rc6 = get_addr(ifname, AF_INET6, &hi.in6);
+
+	pthread_mutex_lock(&hostinfo_lock);
+	++hostinfo_gen;
+	old = hostinfo_find(ifname);
+	if (old) {
+		changed = old->rc4 != hi.rc4 || old->rc6 != hi.rc6 ||
+			  (!hi.rc4 && memcmp(&old->in, &hi.in, sizeof(hi.in))) ||
+			  (!hi.rc6 &&
+			   memcmp(&old->in6, &hi.in6, sizeof(hi.in6)));
+		old->rc4 = hi.rc4;
+		old->in = hi.in;
+		old->rc6 = hi.rc6;
+		old->in6 = hi.in6;
+	}
+	pthread_mutex_unlock(&hostinfo_lock);
+	return changed;
+}
+
+/*
+ * Drop the cached data of the interface, of all interfaces for ifindex 0.
+ * Called for link events.
+ */
+void hostinfo_flush(int ifindex)
+{
+	struct hostinfo_if *hi, *next;
+	unsigned int i;
+
+	pthread_mutex_lock(&hostinfo_lock);
+	++hostinfo_gen;
+	for (i = 0; i < HOSTINFO_HASH_SIZE; ++i)
+		for (hi = LIST_FIRST(&hostinfo_hash[i]); hi; hi = next) {
+			next = LIST_NEXT(hi, entry);
+			if (ifindex && hi->ifindex != ifindex)
+				continue;
+			LIST_REMOVE(hi, entry);
+			free(hi);
+		}
+	pthread_mutex_unlock(&hostinfo_lock);
+}
+
+void hostinfo_destroy(void)
+{
+	hostinfo_flush(0);
+}
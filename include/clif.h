@@ -44,10 +44,16 @@
  * an identifier for the client interface connection and use this as one of
  * the arguments for most of the client interface library functions.
  */
+struct clif_req;
+
 struct clif {
 	int s;
 	struct sockaddr_un local;
 	struct sockaddr_un dest;
+	int version;			/* From clif_version(), 0 if unknown */
+	unsigned int tag;		/* Last tag of a submitted request */
+	struct clif_req *head;		/* Outstanding requests, oldest first */
+	struct clif_req **tail;
 };
 
 /* lldpad client interface access */
@@ -95,6 +101,9 @@ void clif_close(struct clif *clif);
  * interface connections and use one of them for commands and the other one for
  * receiving event messages, in other words, call clif_attach() only for
  * the client interface connection that will be used for event messages.
+ *
+ * Replies to requests from clif_submit() received while waiting are passed
+ * to their callbacks.
  */
 #define CMD_RESPONSE_TIMEOUT 2
 int clif_request(struct clif *clif, const char *cmd, size_t cmd_len,
@@ -102,6 +111,71 @@ int clif_request(struct clif *clif, const char *cmd, size_t cmd_len,
 		     void (*msg_cb)(char *msg, size_t len));
 
 
+/**
+ * clif_reply_cb - Completion callback of an asynchronous request
+ * @clif: Control interface data from clif_open()
+ * @ctx: Context passed to clif_submit()
+ * @status: lldpad status code (cmd_success etc.) of the reply, or -ETIMEDOUT
+ *	    when no reply arrived in time, -ECANCELED when the connection was
+ *	    closed and -EBADMSG for a malformed reply
+ * @reply: Reply in the format returned by clif_request() or %NULL on error
+ * @reply_len: Length of the reply in bytes
+ */
+typedef void (*clif_reply_cb)(struct clif *clif, void *ctx, int status,
+			      char *reply, size_t reply_len);
+
+/**
+ * clif_submit - Send a command to lldpad without waiting for the reply
+ * @clif: Control interface data from clif_open()
+ * @cmd: Command as for clif_request()
+ * @cmd_len: Length of the cmd in bytes
+ * @cb: Callback function called with the reply
+ * @ctx: Context passed to cb
+ * Returns: The tag of the request (> 0) on success, -EAGAIN if the socket
+ * buffer is full, -EOPNOTSUPP if lldpad does not support tagged requests
+ * or another negative errno value on error
+ *
+ * The command is sent with a tag which lldpad echoes in front of the reply,
+ * any number of requests may be outstanding on one connection. The replies
+ * are received by clif_dispatch(), which calls cb for each of them. A request
+ * without a reply after CMD_RESPONSE_TIMEOUT seconds completes with
+ * -ETIMEDOUT. The first call asks lldpad for its message version with
+ * clif_version(), tagged requests need CLIF_MSG_VERSION_TAG.
+ */
+int clif_submit(struct clif *clif, const char *cmd, size_t cmd_len,
+		clif_reply_cb cb, void *ctx);
+
+/**
+ * clif_dispatch - Receive replies and events without blocking
+ * @clif: Control interface data from clif_open()
+ * @msg_cb: Callback function for unsolicited messages or %NULL if not used
+ * Returns: Number of completed requests or a negative errno value
+ *
+ * This function receives all pending messages, calls the callback of each
+ * request answered and msg_cb for each event message. Requests whose time
+ * has expired are completed with -ETIMEDOUT. Call it when the file
+ * descriptor from clif_get_fd() is readable, for example from epoll, and
+ * when clif_timeout() has expired.
+ */
+int clif_dispatch(struct clif *clif, void (*msg_cb)(char *msg, size_t len));
+
+/**
+ * clif_timeout - Time until the next outstanding request expires
+ * @clif: Control interface data from clif_open()
+ * Returns: Milliseconds, 0 if a request has expired or -1 without
+ * outstanding requests
+ *
+ * The value can be passed as timeout to poll() or epoll_wait().
+ */
+int clif_timeout(struct clif *clif);
+
+/**
+ * clif_outstanding - Number of requests waiting for a reply
+ * @clif: Control interface data from clif_open()
+ * Returns: The number of requests submitted and not yet completed
+ */
+unsigned int clif_outstanding(struct clif *clif);
+
 /**
  * clif_attach - Register as an event monitor for the client interface
  * @clif: Control interface data from clif_open()
@@ -167,7 +241,8 @@ int clif_pending_wait(struct clif *clif, int waittime);
  *
  * This function can be used to get the file descriptor that is used for the
  * client interface connection. The returned value can be used, e.g., with
- * select() while waiting for multiple events.
+ * select() while waiting for multiple events. The socket is not set to
+ * non-blocking mode, clif_dispatch() never blocks.
  *
  * The returned file descriptor must not be used directly for sending or
  * receiving packets; instead, the library functions clif_request() and
@@ -175,6 +250,31 @@ int clif_pending_wait(struct clif *clif, int waittime);
  */
 int clif_get_fd(struct clif *clif);
 
+/**
+ * clif_version - Get the highest message version supported by lldpad
+ * @clif: Control interface data from clif_open()
+ * Returns: The message version, CLIF_MSG_VERSION for lldpad versions
+ * without the version command, or a negative value on error as for
+ * clif_request(). The version is asked for once per connection.
+ *
+ * With CLIF_MSG_VERSION_BIN in the version field of get TLV and get
+ * statistics commands lldpad returns the TLVs and counters in binary, see
+ * clif_reply_data().
+ */
+int clif_version(struct clif *clif);
+
+/**
+ * clif_reply_data - Locate the binary data of a reply
+ * @reply: Reply to a command sent with CLIF_MSG_VERSION_BIN
+ * @reply_len: Length of the reply in bytes
+ * @len: Returns the number of bytes of binary data
+ * Returns: Pointer to the data or %NULL if the reply has none
+ *
+ * The data follows the NUL which terminates the text of the reply. TLVs are
+ * returned as in the LLDPDU, counters as struct clif_stats_bin.
+ */
+const void *clif_reply_data(const char *reply, size_t reply_len, size_t *len);
+
 /**
  * clif_getpid - Get PID of running lldpad process
  * Returns: The PID of lldpad or 0 on failure
@@ -246,8 +346,39 @@ int clif_vsievt(struct clif *clif, char *reply, size_t *reply_len, int waitime);
  *
  * This function is a combination of clif_vsi() and clif_vsievt(). It sends
  * the vsi command and on successful reception of the VSI command calls
- * clif_vsievt() to receive the response.
+ * clif_vsievt() to receive the response. Event messages with a sequence
+ * number different from the one returned for the VSI command are dropped.
  */
 int clif_vsiwait(struct clif *clif, char *ifname, unsigned int tlvid,
 		 char *cmd, char *reply, size_t *reply_len, int waittime);
+
+/**
+ * clif_vsiseq - Get sequence number of a VSI command accepted by lldpad
+ * @reply: Buffer with the reply data returned by clif_vsi()
+ * @reply_len: Number of bytes in the reply buffer
+ * Returns: The sequence number or 0 if the reply does not contain one.
+ *
+ * Lldpad assigns a sequence number to each accepted VSI command and returns
+ * it in the reply. The event message reporting the switch response to this
+ * command carries the same sequence number, see clif_vsicompl().
+ */
+unsigned long clif_vsiseq(char *reply, size_t reply_len);
+
+/**
+ * clif_vsicompl - Wait for VSI completion event message from lldpad
+ * @clif: Control interface data from clif_open()
+ * @reply: Buffer for the reply data
+ * @reply_len: Length of the reply buffer
+ * @seq: Sequence number of the completed VSI command
+ * @waittime: Maximum number of seconds to wait for event message
+ * Returns: see clif_vsievt().
+ *
+ * This function is clif_vsievt() and in addition returns the sequence number
+ * of the VSI command the event message belongs to. This allows a client to
+ * submit many VSI commands with clif_vsi() and wait for the responses on one
+ * connection. The sequence number is 0 for event messages not triggered by
+ * a VSI command, for example a disassociation sent by the switch.
+ */
+int clif_vsicompl(struct clif *clif, char *reply, size_t *reply_len,
+		  unsigned long *seq, int waittime);
 #endif /* CLIF_H */
@@ -41,8 +41,18 @@
  *   Priority Group feature adds 'number of TC's supported'
  *   Priority Flow Control feature adds 'number of TC's supported'
 */
+/* Version 4
+ *   Replies to get TLV and get statistics commands carry the TLVs and the
+ *   counters in binary after the NUL terminated reply header. Requests are
+ *   unchanged apart from the version, clients use it after the version
+ *   command has reported it.
+ *   Tagged requests (TAG_CMD) are accepted. Older versions answer them
+ *   with an untagged error.
+ */
 #define CLIF_EV_VERSION 2
 #define CLIF_MSG_VERSION 3
+#define CLIF_MSG_VERSION_BIN 4
+#define CLIF_MSG_VERSION_TAG 4
 #define CLIF_RSP_VERSION CLIF_MSG_VERSION
 
 /* Minimum DCB CLIF MSG version we can resolve */
@@ -51,6 +61,7 @@
 /* Client interface global command codes */
 #define UNKNOWN_CMD  '.'
 #define PING_CMD     'P'
+#define STATS_CMD    'S'
 #define LEVEL_CMD    'L'
 #define ATTACH_CMD   'A'
 #define DETACH_CMD   'D'
@@ -58,11 +69,28 @@
 #define MOD_CMD      'M'
 #define EVENT_MSG    'E'
 #define CMD_RESPONSE 'R'
+#define TAG_CMD      'T'  /* Tagged request, the tag is echoed in the reply */
+#define VERSION_CMD  'V'  /* Highest message version supported */
 #define CMD_REQUEST  DCB_CMD
 
 /* Remote Change Event ByteCode */
 #define LLDP_RCHANGE 1
 
+/*
+ * Neighbor delta events, sent only to clients which attached with this id.
+ * The event text is the sequence number of the agent (8 hex digits), the
+ * agent type (2), the length of the interface name (2) and the name,
+ * followed by the changed TLVs. Each change is one of the characters below
+ * and the complete TLV in hex, the TLV header gives its length. Removed
+ * TLVs carry their last received contents. The sequence number increases
+ * by one per event of an agent, a gap means events were lost and the
+ * client should fetch the neighbor TLVs again. A new agent starts at 1.
+ */
+#define NEIGH_DELTA_ID		0xfffffffe
+#define NEIGH_DELTA_ADD		'+'
+#define NEIGH_DELTA_CHANGE	'~'
+#define NEIGH_DELTA_REMOVE	'-'
+
 /* Offsets in client interface module request message
  */
 #define	MOD_ID 1
@@ -90,6 +118,11 @@
 #define CMD_IF_LEN 12  /* length of ifname field, '00' is ok */
 #define CMD_IF     14  /* ifname field */
 
+/* Tagged message, the request or response follows the tag */
+#define CLIF_TAG_OFF     1
+#define CLIF_TAG_LEN     8
+#define CLIF_TAG_HDR     (CLIF_TAG_OFF + CLIF_TAG_LEN)
+
 /* Client interface response message field offsets */
 #define CLIF_STAT_OFF    1
 #define CLIF_STAT_LEN    2
@@ -101,6 +134,24 @@
 /* max buffer length for a clif message */
 #define MAX_CLIF_MSGBUF 4096
 
+/* Counters of a binary get statistics reply, network byte order */
+struct clif_stats_bin {
+	__u32 frames_out;
+	__u32 frames_discarded;
+	__u32 frames_in_errors;
+	__u32 frames_in;
+	__u32 tlvs_discarded;
+	__u32 tlvs_unrecognized;
+	__u32 ageouts;
+	__u64 octets_out;
+	__u64 octets_in;
+	__u64 frames_dedup;
+	__u64 rx_parse_ns;
+	__u64 rx_parse_max_ns;
+	__u64 tx_build_ns;
+	__u64 tx_build_max_ns;
+} __attribute__((packed));
+
 struct cmd {
 	__u8 cmd;
 	__u32 module_id;
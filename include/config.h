@@ -108,7 +108,12 @@ int get_array_config(config_setting_t *s, char *attr, int int_type,
 
 int init_cfg(void);
 void destroy_cfg(void);
+void cfg_lock(void);
+void cfg_unlock(void);
+int write_cfg(void);
+int reload_cfg(void);
 int check_cfg_file(void);
 int check_for_old_file_format(void);
 void init_ports(void);
+void init_ports_cancel(void);
 #endif /* _CONFIG_H_ */
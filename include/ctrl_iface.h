@@ -43,8 +43,12 @@ struct ctrl_dst;
 struct clif_data {
 	int ctrl_sock;
 	struct ctrl_dst *ctrl_dst;
+	int rbin;		/* # of binary bytes after the reply text */
 };
 
+/* # of clients attached to neighbor delta events */
+extern int clif_delta_listeners;
+
 int ctrl_iface_init(struct clif_data *clifd);
 int ctrl_iface_register(struct clif_data *clifd);
 void ctrl_iface_deinit(struct clif_data *clifd);
@@ -71,6 +75,16 @@ int clif_iface_ping(struct clif_data *clifd,
 		    socklen_t fromlen,
 		    char *ibuf, int ilen,
 		    char *rbuf, int rlen);
+int clif_iface_version(struct clif_data *clifd,
+		       struct sockaddr_un *from,
+		       socklen_t fromlen,
+		       char *ibuf, int ilen,
+		       char *rbuf, int rlen);
+int clif_iface_stats(struct clif_data *clifd,
+		     struct sockaddr_un *from,
+		     socklen_t fromlen,
+		     char *ibuf, int ilen,
+		     char *rbuf, int rlen);
 int clif_iface_cmd_unknown(struct clif_data *clifd,
 			   struct sockaddr_un *from,
 			   socklen_t fromlen,
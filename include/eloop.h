@@ -23,6 +23,8 @@
 #ifndef ELOOP_H
 #define ELOOP_H
 
+#include <stddef.h>
+
 /**
  * ELOOP_ALL_CTX - eloop_cancel_timeout() magic number to match all timeouts
  */
@@ -85,6 +87,49 @@ typedef void (*eloop_signal_handler)(int sig, void *eloop_ctx,
  */
 int eloop_init(void *user_data);
 
+/**
+ * struct eloop_msg - Message posted to the event loop of another thread
+ * @next: Used by the event loop while the message is queued
+ * @handler: Function called by the receiving thread with the message
+ *
+ * The message is embedded as first member in the data it carries and is
+ * owned by the event loop until the handler is called.
+ */
+struct eloop_msg {
+	struct eloop_msg *next;
+	void (*handler)(struct eloop_msg *msg);
+};
+
+struct eloop_data;
+
+/**
+ * eloop_self - Get the event loop of the calling thread
+ * Returns: Event loop to pass to eloop_post() from other threads
+ *
+ * Every thread running eloop_run() has its own event loop, initialized with
+ * eloop_init(). The handlers registered by a thread are called by its own
+ * event loop.
+ */
+struct eloop_data *eloop_self(void);
+
+/**
+ * eloop_post - Post a message to the event loop of a thread
+ * @loop: Receiving event loop
+ * @msg: Message, its handler is called in the receiving thread
+ *
+ * This function may be called from any thread. Messages are delivered in
+ * the order they were posted.
+ */
+void eloop_post(struct eloop_data *loop, struct eloop_msg *msg);
+
+/**
+ * eloop_run_posted - Call the handlers of messages posted to this thread
+ *
+ * Normally called by the event loop, can be used to deliver pending
+ * messages when the event loop is no longer running.
+ */
+void eloop_run_posted(void);
+
 /**
  * eloop_register_read_sock - Register handler for read events
  * @sock: File descriptor number for the socket
@@ -291,6 +336,14 @@ void eloop_run(void);
  */
 void eloop_terminate(int sig, void *eloop_ctx, void *signal_ctx);
 
+/**
+ * eloop_stop - Terminate the event loop of the calling thread
+ *
+ * Same as eloop_terminate() for event loops of threads which do not handle
+ * signals.
+ */
+void eloop_stop(void);
+
 /**
  * eloop_destroy - Free any resources allocated for the event loop
  *
@@ -324,4 +377,24 @@ void eloop_wait_for_read_sock(int sock);
  */
 void * eloop_get_user_data(void);
 
+/**
+ * eloop_profile - Turn profiling of the event loop on or off
+ * @on: 1 = on, 0 = off
+ *
+ * When on, the number of calls and the time spent in each handler, the delay
+ * of timeout handlers and the time spent per event loop iteration are
+ * recorded. Turning profiling on clears all counters. Applies to the event
+ * loop of the calling thread and to event loops initialized later.
+ */
+void eloop_profile(int on);
+
+/**
+ * eloop_stats - Print the event loop profile of the calling thread
+ * @buf: Buffer for the output
+ * @len: Size of the buffer
+ * @arg: "on", "off" or "reset" to change profiling first, or NULL
+ * Returns: Number of bytes written to the buffer
+ */
+int eloop_stats(char *buf, size_t len, const char *arg);
+
 #endif /* ELOOP_H */
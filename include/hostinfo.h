@@ -0,0 +1,51 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+
+#ifndef HOSTINFO_H
+#define HOSTINFO_H
+
+#include <stddef.h>
+#include "lldp.h"
+
+/*
+ * Host wide cache of the data advertised in the basic management and
+ * LLDP-MED TLVs.
+ *
+ * The inventory (DMI and kernel release) is read once. Addresses, system
+ * capabilities and the up flag of an interface are probed on first use
+ * and kept until a link event for the interface flushes them. Address
+ * events probe the addresses again, and the router capability is read on
+ * each call. All functions may be called from any thread.
+ */
+int hostinfo_inventory(u8 subtype, char *buf, size_t size);
+int hostinfo_addr(const char *ifname, int domain, void *buf);
+u16 hostinfo_caps(const char *ifname);
+int hostinfo_active(const char *ifname);
+int hostinfo_addr_update(const char *ifname);
+void hostinfo_flush(int ifindex);
+void hostinfo_destroy(void);
+
+#endif /* HOSTINFO_H */
@@ -86,6 +86,8 @@
 #define IEEE_APP_DEL 1
 #define IEEE_APP_DONE 2
 
+#define IEEE_APP_HASH 32	/* # of APP hash chains, must be a power of 2 */
+
 /* ETSCFG WCRT field's Shift values */
 #define ETS_WILLING_SHIFT	7
 #define ETS_CBS_SHIFT		6
@@ -166,6 +168,7 @@ struct app_obj {
 	bool peer;
 	int hw;
 	LIST_ENTRY(app_obj) entry;
+	LIST_ENTRY(app_obj) hash;	/* Chain by priority/selector/pid */
 };
 
 /* @oper_param - 0: local_params, 1: remote_params
@@ -206,7 +209,13 @@ struct ieee8021qaz_tlvs {
 	struct ets_attrib *ets;
 	struct pfc_attrib *pfc;
 	LIST_HEAD(app_tlv_head, app_obj) app_head;
+	LIST_HEAD(app_hash_head, app_obj) app_hash[IEEE_APP_HASH];
 	struct port *port;
+	struct ieee_ets hw_ets;		/* Last ETS and PFC set in hardware */
+	struct ieee_pfc hw_pfc;
+	bool hw_ets_valid;
+	bool hw_pfc_valid;
+	bool hw_probe;			/* Hardware not queried yet */
 	LIST_ENTRY(ieee8021qaz_tlvs) entry;
 };
 
@@ -214,7 +223,7 @@ struct ieee8021qaz_user_data {
 	LIST_HEAD(ieee8021qaz_head, ieee8021qaz_tlvs) head;
 };
 
-int ieee8021qaz_mod_app(struct app_tlv_head *head, int peer,
+int ieee8021qaz_mod_app(struct ieee8021qaz_tlvs *tlvs, int peer,
 			u8 prio, u8 sel, u16 proto, u32 ops);
 int ieee8021qaz_app_sethw(char *ifname, struct app_tlv_head *head);
 
@@ -222,6 +231,7 @@ inline int get_prio_map(u32 prio_map, int tc);
 inline void set_prio_map(u32 *prio_map, u8 prio, int tc);
 
 struct ieee8021qaz_tlvs *ieee8021qaz_data(const char *);
+void ieee8021qaz_probe(struct ieee8021qaz_tlvs *tlvs);
 
 int ieee8021qaz_tlvs_rxed(const char *ifname);
 int ieee8021qaz_check_active(const char *ifname);
@@ -175,5 +175,8 @@ int get_hw_state(char *device_name, int *dcb_state);
 int init_drv_if(void);
 bool check_port_dcb_mode(char *device_name);
 int set_dcbx_mode(char *ifname, __u8 mode);
+void forget_dcbx_mode(const char *ifname);
+int set_hw_operstate(char *ifname, __u8 operstate);
+int get_hw_operstate(char *ifname);
 
 #endif
@@ -68,6 +68,8 @@ struct tlv {
 #define VAL_TX          "tx"
 #define VAL_DISABLED    "disabled"
 #define VAL_INVALID     "invalid"
+#define ARG_MAXNEIGHBORS "maxNeighbors"
+#define ARG_NEIGHBOR    "neighbor"
 
 #define ARG_TLVTXENABLE "enableTx"
 #define ARG_TLVINFO	"info"
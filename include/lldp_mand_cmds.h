@@ -33,6 +33,8 @@
 #define TTL_MIN_VAL 0x0
 #define TTL_MAX_VAL 0xFFFF
 
+struct cmd;
+
 struct arg_handlers *mand_get_arg_handlers();
 
 int mand_clif_cmd(void *data,
@@ -40,5 +42,7 @@ int mand_clif_cmd(void *data,
 		  socklen_t fromlen,
 		  char *ibuf, int ilen,
 		  char *rbuf, int rlen);
+int mand_apply_arg(struct cmd *cmd, char *arg, char *argvalue, char *obuf,
+		   int obuf_len);
 
 #endif
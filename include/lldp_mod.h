@@ -75,6 +75,7 @@ struct lldp_mod_ops {
 	int			(* timer)(struct port *, struct lldp_agent *);
 	struct arg_handlers *	(* get_arg_handler)(void);
 	int			(*lldp_mod_notify)(int, char *, void *);
+	void			(*lldp_mod_ckpt)(void);
 };
 
 /*
@@ -96,7 +97,7 @@ struct lldp_module {
 };
 
 LIST_HEAD(lldp_head, lldp_module);
-struct lldp_head lldp_head;
+extern __thread struct lldp_head lldp_head;
 
 static inline struct lldp_module *find_module_by_id(struct lldp_head *head, int id)
 {
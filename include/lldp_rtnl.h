@@ -31,8 +31,18 @@
 #define IFNAMSIZ 16
 #endif
 
+/* Link attributes from a dump of all links */
+struct rtnl_link {
+	int ifindex;
+	unsigned int flags;		/* IFF_* flags */
+	int carrier;
+	char ifname[IFNAMSIZ];
+	char kind[16];			/* IFLA_INFO_KIND, empty if none */
+};
+
 int get_operstate(char *ifname);
 int set_operstate(char *ifname, __u8 operstate);
 int set_linkmode(int ifindex, const char *ifname, __u8 linkmode);
+int rtnl_link_dump(struct rtnl_link **links);
 
 #endif
@@ -158,6 +158,7 @@ int get_saddr6(const char *ifname, struct sockaddr_in6 *saddr);
 int get_ipaddr6(const char *ifname, struct in6_addr *);
 int get_ipaddr6str(const char *ifname, char *ipaddr, size_t size);
 u16 get_caps(const char *ifname);
+int is_router(void);
 int mac2str(const u8 *mac, char *dst, size_t size);
 int str2mac(const char *src, u8 *mac, size_t size);
 int str2addr(int domain, const char *src, void *dst, size_t size);
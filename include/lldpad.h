@@ -36,6 +36,7 @@
 #include <asm/types.h>
 
 #define PID_FILE "/var/run/lldpad.pid"
+#define PROM_FILE "/var/run/lldpad.prom"
 void send_event(int level, __u32 type, char *ebuf);
 
 #endif /* LLDPAD_H */
@@ -0,0 +1,97 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#ifndef LLDPAD_CKPT_H
+#define LLDPAD_CKPT_H
+
+#include <sys/uio.h>
+#include "lldp.h"
+
+struct port;
+
+/*
+ * Checkpoint for warm restarts.
+ *
+ * With -w lldpad saves the protocol state of its agents and modules to
+ * LLDPAD_CKPT_FILE when it terminates instead of sending shutdown LLDPDUs.
+ * The next instance started with -w maps the file, restores the state on
+ * its ports and removes the file, a checkpoint is used once.
+ *
+ * The file is a header followed by records, each record a struct ckpt_rec
+ * and its data padded to 8 bytes. Records are matched by type, interface
+ * name and agent type. Files with another magic or version, or written
+ * before the last boot, are ignored.
+ */
+#define LLDPAD_CKPT_FILE	"/var/run/lldpad.ckpt"
+#define LLDPAD_CKPT_MAGIC	0x4c4c434b	/* "LLCK" */
+#define LLDPAD_CKPT_VER		2
+#define LLDPAD_CKPT_BOOTID	"/proc/sys/kernel/random/boot_id"
+
+#define CKPT_ALIGN(x)		(((x) + 7) & ~(size_t)7)
+
+enum ckpt_type {
+	CKPT_NONE,		/* Restored record */
+	CKPT_AGENT,		/* struct ckpt_agent and received LLDPDU */
+	CKPT_VSI22,		/* struct vdpnl_vsi and MAC/VLAN pairs */
+};
+
+struct ckpt_hdr {
+	u32 magic;
+	u16 version;
+	u16 hdrlen;		/* Size of this header */
+	u64 stamp;		/* CLOCK_BOOTTIME seconds when written */
+	u32 size;		/* Bytes of records following the header */
+	u32 count;		/* # of records */
+	char boot_id[40];	/* Boot the stamp belongs to */
+};
+
+struct ckpt_rec {
+	u16 type;
+	u16 agent;		/* Agent type */
+	u32 len;		/* Bytes of data following */
+	char ifname[IFNAMSIZ];
+};
+
+struct ckpt_agent {
+	u16 rxTTL;		/* Time to live of the neighbor information */
+	u16 txTTR;		/* Time until the next LLDPDU */
+	u16 txFast;		/* # of fast LLDPDUs left */
+	u16 sizein;		/* Length of the LLDPDU following */
+};
+
+int ckpt_init(int warm);
+void ckpt_destroy(void);
+int ckpt_warm(void);
+int ckpt_add(int type, const char *ifname, int agent,
+	     const struct iovec *iov, int iovcnt);
+void *ckpt_find(int type, const char *ifname, int agent, void *prev,
+		size_t *len);
+void ckpt_consume(void *data);
+unsigned int ckpt_age(void);
+int ckpt_write(void);
+void ckpt_save(void);
+void ckpt_restore_port(struct port *port);
+
+#endif /* LLDPAD_CKPT_H */
@@ -47,6 +47,7 @@ int lldpad_shm_get_msap(const char *device_name, int type, char *info, size_t *l
 int lldpad_shm_set_msap(const char *device_name, int type, char *info, size_t len);
 int lldpad_shm_get_dcbx(const char *device_name);
 int lldpad_shm_set_dcbx(const char *device_name, int dcbx_mode);
+int lldpad_shm_print(const char *ifname);
 
 #define SHM_CHASSISID_LEN 32
 #define SHM_PORTID_LEN 32
@@ -96,4 +97,39 @@ struct lldpad_shm_tbl_ver0 {
 	struct lldpad_shm_entry_ver0 ent[MAX_LLDPAD_SHM_ENTRIES];
 };
 
+/*
+ * Version 2 of the SHM segment. The segment starts with LLDPAD_SHM_SLOTS
+ * slots and doubles in size when three quarters of the slots are in use.
+ * Entries are hashed on the interface name (open addressing with linear
+ * probing) and are never removed.
+ *
+ * lldpad is the only writer and the only program which converts older
+ * layouts. Readers map the segment read-only and do not lock, each slot
+ * and the table itself carry a sequence number which is odd while lldpad
+ * updates the slot or rebuilds the table. A reader waits while it is odd
+ * and retries when it changed while the data was copied. lldpad sets the
+ * size before the number of slots when the table grows.
+ *
+ * The low order 16 bits of num_entries are all ones, so programs
+ * which only know version 1 treat the table as invalid and leave it alone.
+ * The pid field stays at the same offset.
+ */
+#define LLDPAD_SHM_VER2 2
+#define LLDPAD_SHM_SLOTS 64	/* Initial number of slots, power of 2 */
+
+struct lldpad_shm_slot {
+	u32 seq;		/* Odd while lldpad updates the entry */
+	struct lldpad_shm_entry ent;	/* Unused when ifname is empty */
+};
+
+struct lldpad_shm_tbl_ver2 {
+	pid_t pid;
+	u32 num_entries;	/* High order 16 bits used as a version # */
+	u32 seq;		/* Odd while lldpad rebuilds the table */
+	u32 size;		/* Size of segment in bytes */
+	u32 slots;		/* Number of slots, power of 2 */
+	u32 used;		/* Number of slots in use */
+	struct lldpad_shm_slot slot[];
+};
+
 #endif
@@ -26,19 +26,43 @@
 
 #ifndef _MESSAGES_H_
 #define _MESSAGES_H_
+#include <stddef.h>
 #include <syslog.h>
 #include <stdbool.h>
 
 extern bool daemonize;
 extern int loglvl;
 extern int omit_tstamp;
+extern unsigned int log_trace_size;
 
 void log_message(int loglvl, const char *pFormat, ...)
 	__attribute__((__format__(__printf__, 2, 3)));
+int log_trace_init(unsigned int);
+int log_trace_dump(char *, size_t, const char *);
 
-#define LLDPAD_ERR(...) log_message(LOG_ERR,  __VA_ARGS__)
-#define LLDPAD_WARN(...) log_message(LOG_WARNING, __VA_ARGS__)
-#define LLDPAD_INFO(...) log_message(LOG_INFO, __VA_ARGS__)
-#define LLDPAD_DBG(...) log_message(LOG_DEBUG, __VA_ARGS__)
+/*
+ * Highest log level compiled in, set with configure --with-max-log-level.
+ * Messages above it are removed by the compiler.
+ */
+#ifndef LLDPAD_LOG_MAX
+#define LLDPAD_LOG_MAX	LOG_DEBUG
+#endif
+
+/*
+ * Test if a message of this level is written to the log or to the trace
+ * ring. Use it to skip preparing arguments of messages nobody sees.
+ */
+static inline bool log_enabled(int level)
+{
+	return level <= LLDPAD_LOG_MAX && (level <= loglvl || log_trace_size);
+}
+
+#define LLDPAD_LOG(level, ...) \
+	(log_enabled(level) ? log_message(level, __VA_ARGS__) : (void)0)
+
+#define LLDPAD_ERR(...) LLDPAD_LOG(LOG_ERR,  __VA_ARGS__)
+#define LLDPAD_WARN(...) LLDPAD_LOG(LOG_WARNING, __VA_ARGS__)
+#define LLDPAD_INFO(...) LLDPAD_LOG(LOG_INFO, __VA_ARGS__)
+#define LLDPAD_DBG(...) LLDPAD_LOG(LOG_DEBUG, __VA_ARGS__)
 
 #endif
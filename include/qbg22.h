@@ -56,6 +56,8 @@ enum {				/* Identify data type in union below */
 	EVB22_TO_VDP22 = 2,	/* Data from EVB to VDP */
 	ECP22_TO_ULP = 3,	/* Data from ECP to VDP, etc */
 	VDP22_TO_ECP22 = 4,	/* Data from VDP to ECP */
+	VDP22_ECP22_GETBUF = 5,	/* VDP reserves ECP transmit buffer */
+	VDP22_ECP22_PUTBUF = 6,	/* VDP returns filled ECP transmit buffer */
 	/* ECP22 subtypes */
 	ECP22_VDP = 1,		/* VDP protocol */
 	ECP22_PECSP = 2		/* Port extender control and status protocol */
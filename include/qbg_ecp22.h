@@ -30,6 +30,7 @@
 
 #include "lldp_mod.h"
 #include "qbg22.h"
+#include "qbg_slab22.h"
 
 enum {					/* ECP Receive states */
 	ECP22_RX_BEGIN,
@@ -74,6 +75,7 @@ struct ecp22_buffer {			/* ECP payload buffer */
 	unsigned short last_seqno;	/* Seqno last acknowledged packet */
 	unsigned short seqno;		/* Seqno this packet */
 	unsigned long errors;		/* # of transmit errors */
+	u64 sent;			/* Time of last transmission */
 };
 
 struct ecp22_payload_node {		/* ECP Payload node */
@@ -93,15 +95,6 @@ struct ecp22_usedlist {			/* List of valid ecp_payload_nodes */
 	struct ecp22_payload_node *last;	/* Ptr to last entry in list */
 };
 
-struct ecp22_freelist {		/* List of free ecp_payload_nodes */
-	ecp22_list head;	/* ECP payload data free list */
-	u16 freecnt;		/* # of nodes on freelist */
-};
-
-enum {
-	ecp22_maxpayload = 64
-};
-
 struct ecp22 {			/* ECP protocol data per interface */
 	struct l2_packet_data *l2;
 	char ifname[IFNAMSIZ];		/* Interface name */
@@ -110,7 +103,7 @@ struct ecp22 {			/* ECP protocol data per interface */
 	struct ecp22_buffer tx;		/* Transmit buffer */
 	struct agentstats stats;
 	struct ecp22_usedlist inuse;	/* List of payload data */
-	struct ecp22_freelist isfree;	/* List of free payload nodes */
+	struct slab22_acct *mem;	/* Memory accounting for payload data */
 	unsigned char max_retries;	/* Max # of retries (via EVB) */
 	unsigned char max_rte;		/* Wait time for ack (via EVB) */
 };
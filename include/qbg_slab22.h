@@ -0,0 +1,47 @@
+/*******************************************************************************
+
+  Implementation of memory slabs for VDP22 and ECP22 data
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+*******************************************************************************/
+
+/*
+ * Size classed memory slabs for the small objects VDP22 and ECP22 allocate
+ * per VSI: vsi22 nodes, fid22 arrays, OUI data and ECP payload nodes.
+ * Memory is taken from the heap in chunks and never given back, freed
+ * objects are kept on per size class free lists. The memory footprint stays
+ * at the high water mark and does not fragment the heap with VM churn.
+ *
+ * Each object is charged to an account. There is one account per interface
+ * name, shared by all users of that interface.
+ */
+
+#ifndef QBG_SLAB22_H
+#define QBG_SLAB22_H
+
+#include <stddef.h>
+
+struct slab22_acct;
+
+struct slab22_acct *slab22_acct_get(const char *);
+void slab22_acct_put(struct slab22_acct *);
+void *slab22_zalloc(struct slab22_acct *, size_t);
+void slab22_free(void *);
+int slab22_stats(char *, size_t, const char *);
+
+#endif
@@ -129,12 +129,12 @@ struct vdp_data {
 	u8 enabletx;
 	u8 vdpbit_on;		/* Enable VDP Protocol */
 	struct ecp ecp;
-	struct unpacked_tlv *vdp;
 	int role;
 	int keepaliveTimer;
 	int ackTimer;
 	int nroftimers;
 	LIST_HEAD(profile_head, vsi_profile) profile_head;
+	struct vsi_profile *lastsent;	/* Profile of the last VSI TLV sent */
 	LIST_ENTRY(vdp_data) entry;
 };
 
@@ -145,7 +145,7 @@ struct vdp_user_data {
 struct lldp_module *vdp_register(void);
 void vdp_unregister(struct lldp_module *);
 struct vdp_data *vdp_data(char *);
-struct packed_tlv *vdp_gettlv(struct vdp_data *, struct vsi_profile *);
+int vdp_puttlv(struct vdp_data *, struct vsi_profile *, u8 *, size_t);
 void vdp_vsi_sm_station(struct vsi_profile *);
 struct vsi_profile *vdp_add_profile(struct vdp_data *, struct vsi_profile *);
 int vdp_remove_profile(struct vsi_profile *);
@@ -60,6 +60,7 @@
 
 #include	<qbg_vdp22def.h>
 #include        <qbg_vdp22_oui.h>
+#include	<qbg_slab22.h>
 
 enum vdp22_role {		/* State for VDP22 bridge processing */
 	VDP22_BRIDGE = 1,	/* Bridge role */
@@ -75,7 +76,8 @@ enum vsi22_flags {			/* Flags (or'ed in) */
 	VDP22_DELETE_ME = 2,		/* Deallocate this node */
 	VDP22_RETURN_VID = 4,		/* Return wildcard vlan id */
 	VDP22_NOTIFY = 8,		/* Send netlink message to requestor */
-	VDP22_NLCMD = 16		/* Netlink command pending */
+	VDP22_NLCMD = 16,		/* Netlink command pending */
+	VDP22_TXBATCH = 32		/* Queued in interface transmit batch */
 };
 
 enum {                                  /* VDP22 Protocol command responses */
@@ -128,6 +130,7 @@ struct vdp22smi {		/* Data structure for VDP22 state machine */
 
 struct vsi22 {
 	LIST_ENTRY(vsi22) node;		/* Node element */
+	LIST_ENTRY(vsi22) txnode;	/* Node element in transmit batch */
 	unsigned char mgrid[VDP22_MGRIDSZ];	/* Manager identifier */
 	unsigned char cc_vsi_mode;	/* currently confirmed VSI mode */
 	unsigned char vsi_mode;		/* VSI mode: ASSOC, PREASSOC, etc */
@@ -146,6 +149,8 @@ struct vsi22 {
 	struct vdp22 *vdp;		/* Back pointer to VDP head */
 	unsigned long flags;		/* Flags, see above */
 	struct vdp22smi smi;		/* State machine information */
+	LIST_ENTRY(vsi22) brnode;	/* Node element in bridge VSI index */
+	struct vdp22br_fid *brfid;	/* Bridge filter index entries */
 };
 
 struct vdp22 {				/* Per interface VSI/VDP data */
@@ -162,6 +167,12 @@ struct vdp22 {				/* Per interface VSI/VDP data */
 	unsigned short input_len;	/* Length of input data from ECP */
 	unsigned char input[ETH_DATA_LEN];	/* Input data from ECP */
 	LIST_HEAD(vsi22_head, vsi22) vsi22_que;	/* Active VSIs */
+	unsigned char *txbatch;		/* ECP buffer with batched output */
+	unsigned short txbatch_len;	/* Length of batched output data */
+	unsigned short txbatch_size;	/* Size of ECP buffer */
+	LIST_HEAD(vsi22_txhead, vsi22) txbatch_que;	/* VSIs in txbatch */
+	struct slab22_acct *mem;	/* Memory accounting for VSI data */
+	struct vdp22br *br;		/* Bridge role lookup tables */
 };
 
 struct vdp22_user_data {		/* Head for all VDP data */
@@ -187,12 +198,23 @@ int vdp22_clntback(struct vsi22 *);
 struct vsi22 *vdp22_copy_vsi(struct vsi22 *);
 void vdp22_listdel_vsi(struct vsi22 *);
 int vdp22br_resources(struct vsi22 *, int *);
+struct vdp22br *vdp22br_create(struct vdp22 *);
+void vdp22br_destroy(struct vdp22 *);
+void vdp22br_hashvsi(struct vsi22 *);
+void vdp22br_unhashvsi(struct vsi22 *);
+struct vsi22 *vdp22br_findvsi(struct vdp22 *, struct vsi22 *);
+int vdp22br_stats(char *, size_t, const char *);
+bool vdp22_vsi_equal(struct vsi22 *, struct vsi22 *);
 int vdp22_info(const char *);
 void vdp22_stop_timers(struct vsi22 *);
 int vdp22_start_localchange_timer(struct vsi22 *);
 bool vdp22_cmp_fdata(struct vsi22 *, struct vsi22 *);
 void vdp22_delete_vsi(struct vsi22 *);
 struct vdp22_oui_handler_s * vdp22_get_oui_hndlr(char *);
+void vdp22_txbatch_begin(void);
+void vdp22_txbatch_end(void);
+void vdp22_txbatch_remove(struct vsi22 *);
+void vdp22_txbatch_free(struct vdp22 *);
 
 /*
  * Functions to get and set vlan identifier and qos.
@@ -130,6 +130,7 @@ enum vdp22_cmderr {
 #define VSI22_ARG_HINTS_STR "hints"
 #define VSI22_ARG_FILTER_STR "filter"
 #define VSI22_ARG_OUI_STR "oui"
+#define VSI22_ARG_SEQ_STR "seq"
 
 #define VSI22_KATO_ERR_STR "Keepalive Timeout"
 #define VSI22_ACKTO_ERR_STR "Ack not received from bridge"
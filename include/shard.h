@@ -0,0 +1,49 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#ifndef SHARD_H
+#define SHARD_H
+
+/*
+ * Protocol engine shards.
+ *
+ * Each shard is a thread with its own event loop, modules, agents and
+ * ports. A port is owned by shard ifindex % count, all its frames, timers
+ * and state machines run there. The main thread keeps the signals, the
+ * command line interface and the netlink sockets and forwards requests
+ * and link events to the owning shard.
+ * Without shards all functions run in the caller.
+ */
+int shard_init(unsigned int count, int (*start)(void), void (*stop)(void));
+void shard_destroy(void);
+unsigned int shard_count(void);
+int shard_self(void);
+unsigned int shard_of(int ifindex);
+int shard_mine(int ifindex);
+int shard_call(unsigned int shard, int (*fn)(void *), void *arg);
+int shard_call_all(int (*fn)(void *), void *arg);
+int shard_post(int shard, void (*fn)(void *), void *arg);
+
+#endif /* SHARD_H */
@@ -0,0 +1,53 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stddef.h>
+
+/*
+ * Pool of threads for blocking requests to the kernel and device drivers.
+ *
+ * A request is a function which runs on a worker thread and must only use
+ * its argument, and an optional completion function which runs afterwards
+ * on the event loop of the submitting thread and releases the argument.
+ * Requests with the same key, the interface name, run on the same thread
+ * in the order submitted, completions are called in the same order.
+ * Without worker threads both functions run immediately in the caller.
+ */
+#define	WORKER_THREADS	4	/* Default # of threads */
+
+typedef int (*worker_fn)(void *arg);
+typedef void (*worker_done_fn)(void *arg, int rc);
+
+int worker_init(unsigned int threads);
+void worker_destroy(void);
+void worker_submit(const char *key, worker_fn fn, worker_done_fn done,
+		   void *arg);
+void worker_sync(const char *key);
+int worker_stats(char *buf, size_t len, const char *arg);
+
+#endif /* WORKER_H */
@@ -25,6 +25,8 @@
 *******************************************************************************/
 
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 #include "ports.h"
 #include "eloop.h"
 #include "states.h"
@@ -76,19 +78,23 @@ const char *agent_type2section(int agenttype)
 void lldp_init_agent(struct port *port, struct lldp_agent *agent, int type)
 {
 	char macstring[30];
+	int max;
 
 	memset(agent, 0, sizeof(struct lldp_agent));
 
 	memcpy(&agent->mac_addr, agent_groupmacs[type], ETH_ALEN);
 
-	mac2str(agent->mac_addr, macstring, 30);
-	LLDPAD_DBG("%s: creating new agent for %s (%s).\n", __func__,
-		   port->ifname, macstring);
+	if (log_enabled(LOG_DEBUG)) {
+		mac2str(agent->mac_addr, macstring, 30);
+		LLDPAD_DBG("%s: creating new agent for %s (%s).\n", __func__,
+			   port->ifname, macstring);
+	}
 
 	/* Initialize relevant agent variables */
 	agent->tx.state  = TX_LLDP_INITIALIZE;
 	agent->rx.state = LLDP_WAIT_PORT_OPERATIONAL;
 	agent->type = type;
+	agent->port = port;
 
 	if (get_config_setting(port->ifname, type, ARG_ADMINSTATUS,
 			(void *)&agent->adminStatus, CONFIG_TYPE_INT)) {
@@ -96,93 +102,401 @@ void lldp_init_agent(struct port *port, struct lldp_agent *agent, int type)
 		agent->adminStatus = disabled;
 	}
 
+	if (get_config_setting(port->ifname, type, ARG_MAXNEIGHBORS,
+			       (void *)&max, CONFIG_TYPE_INT) ||
+	    max < 1 || max > NEIGH_MAX_LIMIT)
+		max = NEIGH_MAX_DEFAULT;
+	neigh_init(agent, max);
+
 	/* init & enable RX path */
 	rxInitializeLLDP(port, agent);
 
 	/* init TX path */
 	txInitializeTimers(agent);
 	txInitializeLLDP(port, agent);
+	lldp_agent_kick(agent);
 }
 
-int lldp_add_agent(const char *ifname, enum agent_type type)
+static struct lldp_agent *agent_find(struct port *port, int type)
 {
-	int count;
-	struct port *port = port_find_by_ifindex(get_ifidx(ifname));
-	struct lldp_agent *agent, *newagent;
+	struct lldp_agent *agent;
 
-	if (!port)
-		return -1;
+	LIST_FOREACH(agent, &port->agent_head, entry)
+		if ((int)agent->type == type)
+			return agent;
+	return NULL;
+}
+
+static struct lldp_agent *agent_add(struct port *port, enum agent_type type)
+{
+	struct lldp_agent *newagent;
 
 	/* check if lldp_agents for this if already exist */
-	count = 0;
-	LIST_FOREACH(agent, &port->agent_head, entry) {
-		count++;
-		if (agent->type != type)
-			continue;
-		return -1;
-	}
+	if (agent_find(port, type))
+		return NULL;
 
 	/* if not, create one and initialize it */
 	LLDPAD_DBG("%s: creating new agent for port %s.\n", __func__,
-		   ifname);
+		   port->ifname);
 	newagent = malloc(sizeof(*newagent));
 	if (!newagent) {
 		LLDPAD_DBG("%s: creation of new agent failed !.\n", __func__);
-		return -1;
+		return NULL;
 	}
 
 	lldp_init_agent(port, newagent, type);
 
 	LIST_INSERT_HEAD(&port->agent_head, newagent, entry);
+	return newagent;
+}
+
+int lldp_add_agent(const char *ifname, enum agent_type type)
+{
+	struct port *port = port_find_by_ifindex(get_ifidx(ifname));
+
+	if (!port)
+		return -1;
+	return agent_add(port, type) ? 0 : -1;
+}
 
-	LLDPAD_DBG("%s: %i agents on if %s.\n", __func__, count, port->ifname);
+/*
+ * Add the agents in use when a port comes up: the nearest bridge agent and
+ * the agents with an adminStatus other than disabled. The others are
+ * added on demand, they would only take memory and timer ticks.
+ */
+void lldp_add_agents(struct port *port)
+{
+	int type, admin;
+
+	for (type = NEAREST_BRIDGE; type < AGENT_MAX; ++type) {
+		if (type != NEAREST_BRIDGE &&
+		    (get_config_setting(port->ifname, type, ARG_ADMINSTATUS,
+					&admin, CONFIG_TYPE_INT) ||
+		     admin == disabled))
+			continue;
+		agent_add(port, type);
+	}
+}
+
+/*
+ * Return the agent of a type, create it if the port is up but the agent
+ * was not in use so far. Called when the adminStatus is enabled or a
+ * frame arrives for the group MAC address of the agent.
+ */
+struct lldp_agent *lldp_agent_demand(struct port *port, enum agent_type type)
+{
+	struct lldp_module *np;
+	struct lldp_agent *agent;
+
+	agent = agent_find(port, type);
+	/* No agents until the link is up */
+	if (agent || LIST_EMPTY(&port->agent_head))
+		return agent;
+	agent = agent_add(port, type);
+	if (!agent)
+		return NULL;
+	LLDPAD_DBG("%s: %s agent %d added on demand\n", __func__,
+		   port->ifname, type);
+
+	LIST_FOREACH(np, &lldp_head, lldp)
+		if (np->ops->lldp_mod_ifup)
+			np->ops->lldp_mod_ifup(port->ifname, agent);
+	run_tx_sm(port, agent);
+	run_rx_sm(port, agent);
+	return agent;
+}
+
+struct lldp_agent *lldp_agent_demand_mac(struct port *port, const u8 *mac)
+{
+	int type;
+
+	for (type = NEAREST_BRIDGE; type < AGENT_MAX; ++type)
+		if (!memcmp(mac, agent_groupmacs[type], ETH_ALEN))
+			return lldp_agent_demand(port, type);
+	return NULL;
+}
+
+/*
+ * The timers of all agents of a thread are deadlines. Agents with a
+ * running timer are kept in a heap ordered by their earliest deadline and
+ * one event loop timeout waits for the first of them. An agent is only
+ * visited when a timer expires or it was kicked because something changed
+ * which its state machines have to look at.
+ */
+static __thread struct {
+	struct lldp_agent **a;
+	unsigned int count;
+	unsigned int size;
+	u64 armed;		/* Deadline of the registered timeout */
+	int running;		/* Agents are being run, arm afterwards */
+} heap;
+
+static __thread int dormant_armed;
+
+static u64 agent_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static void heap_set(unsigned int i, struct lldp_agent *agent)
+{
+	heap.a[i] = agent;
+	agent->timers.heap = i + 1;
+}
+
+static void heap_up(unsigned int i)
+{
+	struct lldp_agent *agent = heap.a[i];
+	unsigned int parent;
+
+	while (i) {
+		parent = (i - 1) / 2;
+		if (heap.a[parent]->timers.due <= agent->timers.due)
+			break;
+		heap_set(i, heap.a[parent]);
+		i = parent;
+	}
+	heap_set(i, agent);
+}
 
+static void heap_down(unsigned int i)
+{
+	struct lldp_agent *agent = heap.a[i];
+	unsigned int child;
+
+	for (;;) {
+		child = 2 * i + 1;
+		if (child >= heap.count)
+			break;
+		if (child + 1 < heap.count &&
+		    heap.a[child + 1]->timers.due < heap.a[child]->timers.due)
+			child++;
+		if (agent->timers.due <= heap.a[child]->timers.due)
+			break;
+		heap_set(i, heap.a[child]);
+		i = child;
+	}
+	heap_set(i, agent);
+}
+
+static void heap_del(struct lldp_agent *agent)
+{
+	unsigned int i = agent->timers.heap - 1;
+	struct lldp_agent *last;
+
+	agent->timers.heap = 0;
+	if (i == --heap.count)
+		return;
+	last = heap.a[heap.count];
+	heap_set(i, last);
+	heap_up(i);
+	heap_down(last->timers.heap - 1);
+}
+
+static int heap_add(struct lldp_agent *agent)
+{
+	struct lldp_agent **a;
+	unsigned int size;
+
+	if (heap.count == heap.size) {
+		size = heap.size ? 2 * heap.size : 64;
+		a = realloc(heap.a, size * sizeof(*a));
+		if (!a)
+			return -ENOMEM;
+		heap.a = a;
+		heap.size = size;
+	}
+	heap_set(heap.count, agent);
+	heap_up(heap.count++);
 	return 0;
 }
 
-static void timer(UNUSED void *eloop_data, UNUSED void *user_ctx)
+static void agent_timeout(void *eloop_data, void *user_ctx);
+
+/*
+ * Register the timeout for the first deadline unless it is registered.
+ */
+static void heap_arm(void)
+{
+	u64 due, now;
+
+	if (heap.running)
+		return;
+	due = heap.count ? heap.a[0]->timers.due : 0;
+	if (due == heap.armed)
+		return;
+	if (heap.armed)
+		eloop_cancel_timeout(agent_timeout, NULL, NULL);
+	heap.armed = due;
+	if (!due)
+		return;
+	now = agent_now();
+	due = due > now ? due - now : 0;
+	eloop_register_timeout(due / 1000, (due % 1000) * 1000, agent_timeout,
+			       NULL, NULL);
+}
+
+static void agent_schedule(struct lldp_agent *agent)
+{
+	struct agenttimers *t = &agent->timers;
+	u64 d[] = { t->txTTRDue, t->txTickDue, t->tooManyNghbrsDue,
+		    t->rxTTLDue, t->kickDue };
+	unsigned int i;
+
+	t->due = 0;
+	for (i = 0; i < sizeof(d) / sizeof(d[0]); i++)
+		if (d[i] && (!t->due || d[i] < t->due))
+			t->due = d[i];
+	if (!t->due) {
+		if (t->heap)
+			heap_del(agent);
+	} else if (t->heap) {
+		heap_up(t->heap - 1);
+		heap_down(t->heap - 1);
+	} else if (heap_add(agent)) {
+		LLDPAD_ERR("%s: no memory for the timers of agent %d\n",
+			   __func__, agent->type);
+	}
+	heap_arm();
+}
+
+/*
+ * Start a timer of an agent, a time of 0 stops it.
+ */
+void lldp_agent_timer(struct lldp_agent *agent, u64 *due, unsigned int secs)
+{
+	*due = secs ? agent_now() + secs * 1000ULL : 0;
+	agent_schedule(agent);
+}
+
+/*
+ * Returns the seconds left until a deadline, rounded up.
+ */
+unsigned int lldp_agent_timeleft(u64 due)
+{
+	u64 now = agent_now();
+
+	return due > now ? (due - now + 999) / 1000 : 0;
+}
+
+/*
+ * Run the state machines of an agent from the event loop, for changes made
+ * outside of them.
+ */
+void lldp_agent_kick(struct lldp_agent *agent)
+{
+	if (agent->timers.kickDue)
+		return;
+	agent->timers.kickDue = agent_now();
+	agent_schedule(agent);
+}
+
+void lldp_agent_unschedule(struct lldp_agent *agent)
 {
+	if (agent->timers.heap) {
+		heap_del(agent);
+		heap_arm();
+	}
+}
+
+static void agent_run(struct lldp_agent *agent, u64 now)
+{
+	struct port *port = agent->port;
 	struct lldp_module *n;
-	struct lldp_agent *agent;
-	struct port *port = porthead;
 
-	while (port != NULL) {
-		/* execute rx and tx sm for all agents on a port */
-		LIST_FOREACH(agent, &port->agent_head, entry) {
-			char macstring[30];
-			mac2str(&agent->mac_addr[0], macstring, 29);
+	agent->timers.kickDue = 0;
+	update_tx_timers(agent, now);
+	run_tx_timers_sm(port, agent);
+	run_tx_sm(port, agent);
+	update_rx_timers(agent, now);
+	run_rx_sm(port, agent);
 
-			update_tx_timers(agent);
-			run_tx_timers_sm(port, agent);
-			run_tx_sm(port, agent);
-			run_rx_sm(port, agent);
-			update_rx_timers(agent);
+	LIST_FOREACH(n, &lldp_head, lldp) {
+		if (n->ops && n->ops->timer)
+			n->ops->timer(port, agent);
+	}
+	agent_schedule(agent);
+}
 
+/*
+ * Run the agents whose deadline has passed. Agents due again meanwhile
+ * wait for the next turn of the event loop.
+ */
+static void agent_timeout(UNUSED void *eloop_data, UNUSED void *user_ctx)
+{
+	struct lldp_agent *agent;
+	u64 now = agent_now();
+	unsigned int n = heap.count;
+
+	heap.armed = 0;
+	heap.running = 1;
+	while (n-- && heap.count && heap.a[0]->timers.due <= now) {
+		agent = heap.a[0];
+		heap_del(agent);
+		agent_run(agent, now);
+	}
+	heap.running = 0;
+	heap_arm();
+}
+
+/*
+ * Ports which came up recently may still flap, the modules look at them
+ * once per second until the dormant delay is over.
+ */
+static void dormant_timeout(UNUSED void *eloop_data, UNUSED void *user_ctx)
+{
+	struct lldp_module *n;
+	struct lldp_agent *agent;
+	struct port *port;
+	int pending = 0;
+
+	for (port = porthead; port; port = port->next) {
+		if (!port->dormantDelay)
+			continue;
+		LIST_FOREACH(agent, &port->agent_head, entry) {
 			LIST_FOREACH(n, &lldp_head, lldp) {
 				if (n->ops && n->ops->timer)
 					n->ops->timer(port, agent);
 			}
 		}
+		if (--port->dormantDelay)
+			pending = 1;
+	}
+	dormant_armed = pending;
+	if (pending)
+		eloop_register_timeout(1, 0, dormant_timeout, NULL, NULL);
+}
 
-		if (port->dormantDelay)
-			port->dormantDelay--;
-
-		port = port->next;
-	};
-
-	/* Load new timer */
-	eloop_register_timeout(1, 0, timer, NULL, NULL);
+/*
+ * Called when the dormant delay of a port has been set.
+ */
+void lldp_dormant_start(void)
+{
+	if (dormant_armed)
+		return;
+	dormant_armed = 1;
+	eloop_register_timeout(1, 0, dormant_timeout, NULL, NULL);
 }
 
 int start_lldp_agents(void)
 {
-	eloop_register_timeout(1, 0, timer, NULL, NULL);
 	return 1;
 }
 
 void stop_lldp_agents(void)
 {
-	eloop_cancel_timeout(timer, NULL, NULL);
+	eloop_cancel_timeout(agent_timeout, NULL, NULL);
+	eloop_cancel_timeout(dormant_timeout, NULL, NULL);
+	while (heap.count)
+		heap_del(heap.a[0]);
+	free(heap.a);
+	heap.a = NULL;
+	heap.size = 0;
+	heap.armed = 0;
+	dormant_armed = 0;
 }
 
 void clean_lldp_agents(void)
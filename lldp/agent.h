@@ -29,6 +29,7 @@
 
 #include "lldp.h"
 #include "mibdata.h"
+#include "neigh.h"
 
 #ifndef ETH_ALEN
 #define ETH_ALEN    6
@@ -52,6 +53,8 @@ static const u8 nearest_bridge[ETH_ALEN] = {0x01,0x80,0xc2,0x00,0x00,0x0e};
 static const u8 nearest_nontpmr_bridge[ETH_ALEN] = {0x01,0x80,0xc2,0x00,0x00,0x03};
 static const u8 nearest_customer_bridge[ETH_ALEN] = {0x01,0x80,0xc2,0x00,0x00,0x00};
 
+struct port;
+
 struct agenttimers {
 /* Tx */
 	u16 state;
@@ -60,15 +63,20 @@ struct agenttimers {
 	u16 msgTxInterval;
 	u16 msgFastTx;
 	u16 txFastInit;
-	u16 txTTR;
 	u16 txShutdownWhile;
 	u16 txCredit;
 	u16 txMaxCredit;
 	bool txTick;
 /* Rx */
-	u16 tooManyNghbrsTimer;
-	u16 rxTTL;
 	u16 lastrxTTL;  /* cache last received */
+/* Deadlines in monotonic milliseconds, 0 when expired or not running */
+	u64 txTTRDue;
+	u64 txTickDue;		/* Next txTick while below txMaxCredit */
+	u64 tooManyNghbrsDue;
+	u64 rxTTLDue;
+	u64 kickDue;		/* Run the state machines */
+	u64 due;		/* Earliest of the above */
+	unsigned int heap;	/* Position in the deadline heap + 1 */
 };
 
 struct agenttx {
@@ -82,7 +90,7 @@ struct agenttx {
 };
 
 /* per agent statistical counter as in chapter 9.2.6
- * of IEEE 802.1AB-2009 */
+ * of IEEE 802.1AB-2009, followed by lldpad extensions */
 struct agentstats {
 /* Tx */
 	u32 statsFramesOutTotal;
@@ -93,6 +101,14 @@ struct agentstats {
 	u32 statsFramesInTotal;
 	u32 statsTLVsDiscardedTotal;
 	u32 statsTLVsUnrecognizedTotal;
+/* Extensions, times in nanoseconds */
+	u64 statsOctetsOutTotal;
+	u64 statsOctetsInTotal;
+	u64 statsFramesDedupTotal;	/* Same as last frame, not parsed */
+	u64 statsRxParseNs;		/* Time spent processing TLVs */
+	u64 statsRxParseMaxNs;
+	u64 statsTxBuildNs;		/* Time spent building TLVs */
+	u64 statsTxBuildMaxNs;
 };
 
 typedef struct rxmanifest{
@@ -119,6 +135,9 @@ struct agentrx {
 	u8 dcbx_st;
 	bool newNeighbor;
 	rxmanifest *manifest;
+	u8 *lastin;		/* Last frame published as neighbor delta */
+	u16 sizelast;
+	u32 deltaSeq;		/* Sequence number of neighbor delta events */
 };
 
 enum agentAdminStatus {
@@ -144,14 +163,19 @@ struct lldp_agent {
 	u8	rxChanges;
 	u16	lldpdu;
 	struct	msap msap;
+	struct	neigh_mib neigh;	/* Further neighbors */
 
 	enum	agent_type type;
+	struct	port *port;
 
         LIST_ENTRY(lldp_agent) entry;
 };
 
 struct lldp_agent *lldp_agent_find_by_type(const char *, enum agent_type);
 int lldp_add_agent(const char *ifname, enum agent_type);
+void lldp_add_agents(struct port *port);
+struct lldp_agent *lldp_agent_demand(struct port *port, enum agent_type);
+struct lldp_agent *lldp_agent_demand_mac(struct port *port, const u8 *mac);
 
 void set_lldp_agent_admin(const char *ifname, int type, int enable);
 int get_lldp_agent_admin(const char *ifname, int type);
@@ -159,6 +183,12 @@ int get_lldp_agent_statistics(const char *ifname, struct agentstats *, int);
 
 const char *agent_type2section(int agenttype);
 
+void lldp_agent_timer(struct lldp_agent *, u64 *due, unsigned int secs);
+unsigned int lldp_agent_timeleft(u64 due);
+void lldp_agent_kick(struct lldp_agent *);
+void lldp_agent_unschedule(struct lldp_agent *);
+void lldp_dormant_start(void);
+
 int start_lldp_agents(void);
 void stop_lldp_agents(void);
 void clean_lldp_agents(void);
@@ -128,4 +128,6 @@ void l2_packet_get_remote_addr(struct l2_packet_data *l2, u8 *addr);
 int l2_packet_send(struct l2_packet_data *l2, const u8 *dst_addr, u16 proto,
 			const u8 *buf, size_t len);
 
+void l2_packet_inject(struct l2_packet_data *l2, const u8 *buf, size_t len);
+
 #endif /* L2_PACKET_H */
@@ -154,6 +154,15 @@ static void l2_packet_receive(int sock, void *eloop_ctx, UNUSED void *sock_ctx)
 	l2->rx_callback(l2->rx_callback_ctx, ll.sll_ifindex, buf, res);
 }
 
+/*
+ * Pass a frame to the receive handler as if it had been read from the
+ * socket. Used to feed frames into the protocol code in-process.
+ */
+void l2_packet_inject(struct l2_packet_data *l2, const u8 *buf, size_t len)
+{
+	l2->rx_callback(l2->rx_callback_ctx, l2->ifindex, buf, len);
+}
+
 
 struct l2_packet_data * l2_packet_init(
 	const char *ifname, UNUSED const u8 *own_addr, unsigned short protocol,
@@ -0,0 +1,318 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "eloop.h"
+#include "messages.h"
+#include "ports.h"
+#include "l2_packet.h"
+#include "neigh.h"
+
+#define NEIGH_WHEEL_SIZE	256	/* Slots of one second */
+
+/* Aging of the neighbors of all agents of the thread */
+static __thread struct {
+	struct lldp_neigh *slot[NEIGH_WHEEL_SIZE];
+	unsigned int count;		/* # of neighbors on the wheel */
+	time_t last;			/* Last second processed */
+	int armed;			/* Tick timeout registered */
+} wheel;
+
+static time_t neigh_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static void neigh_tick(void *eloop_data, void *user_ctx);
+
+static void wheel_link(struct lldp_neigh *n)
+{
+	struct lldp_neigh **slot = &wheel.slot[n->expires % NEIGH_WHEEL_SIZE];
+
+	n->wnext = *slot;
+	if (*slot)
+		(*slot)->wprev = &n->wnext;
+	*slot = n;
+	n->wprev = slot;
+	if (!wheel.count++ && !wheel.armed) {
+		wheel.last = neigh_now();
+		wheel.armed = 1;
+		eloop_register_timeout(1, 0, neigh_tick, NULL, NULL);
+	}
+}
+
+static void wheel_unlink(struct lldp_neigh *n)
+{
+	*n->wprev = n->wnext;
+	if (n->wnext)
+		n->wnext->wprev = n->wprev;
+	n->wnext = NULL;
+	n->wprev = NULL;
+	wheel.count--;
+}
+
+static void neigh_del(struct lldp_neigh *n)
+{
+	struct neigh_mib *mib = &n->agent->neigh;
+	struct lldp_neigh **pp;
+
+	for (pp = &mib->hash[n->hash & (NEIGH_HASH_SIZE - 1)]; *pp;
+	     pp = &(*pp)->hnext)
+		if (*pp == n) {
+			*pp = n->hnext;
+			break;
+		}
+	TAILQ_REMOVE(&mib->list, n, entry);
+	wheel_unlink(n);
+	mib->count--;
+	free(n->frame);
+	free(n);
+}
+
+/*
+ * Age the neighbors of the seconds passed since the last tick, a late tick
+ * handles each slot once.
+ */
+static void neigh_tick(UNUSED void *eloop_data, UNUSED void *user_ctx)
+{
+	struct lldp_neigh *n, *next;
+	time_t now = neigh_now();
+
+	wheel.armed = 0;
+	if (now - wheel.last > NEIGH_WHEEL_SIZE)
+		wheel.last = now - NEIGH_WHEEL_SIZE;
+	while (wheel.last < now) {
+		wheel.last++;
+		for (n = wheel.slot[wheel.last % NEIGH_WHEEL_SIZE]; n;
+		     n = next) {
+			next = n->wnext;
+			if (n->expires > now)
+				continue;
+			n->agent->stats.statsAgeoutsTotal++;
+			neigh_del(n);
+		}
+	}
+	if (wheel.count) {
+		wheel.armed = 1;
+		eloop_register_timeout(1, 0, neigh_tick, NULL, NULL);
+	}
+}
+
+/*
+ * Return the length of the MSAP of a frame, the chassis ID and port ID
+ * TLVs, and its TTL. Returns 0 if the frame does not start with the three
+ * mandatory TLVs, the receive state machine reports such frames.
+ */
+static u16 neigh_msap(const u8 *buf, size_t len, u16 *ttl)
+{
+	size_t off = sizeof(struct l2_ethhdr);
+	u16 hdr, tlen;
+	int type;
+
+	for (type = CHASSIS_ID_TLV; type <= TIME_TO_LIVE_TLV; type++) {
+		if (off + 2 > len)
+			return 0;
+		hdr = (buf[off] << 8) | buf[off + 1];
+		tlen = hdr & 0x01ff;
+		if ((hdr >> 9) != type || off + 2 + tlen > len)
+			return 0;
+		if (type == TIME_TO_LIVE_TLV) {
+			if (tlen != 2)
+				return 0;
+			*ttl = (buf[off + 2] << 8) | buf[off + 3];
+			break;
+		}
+		off += 2 + tlen;
+	}
+	return off - sizeof(struct l2_ethhdr);
+}
+
+/*
+ * Returns true if the MSAP is the one of the neighbor handled by the
+ * receive state machine.
+ */
+static bool neigh_is_first(struct lldp_agent *agent, const u8 *msap)
+{
+	u16 len1 = ((msap[0] << 8) | msap[1]) & 0x01ff;
+	const u8 *port = msap + 2 + len1;
+	u16 len2 = ((port[0] << 8) | port[1]) & 0x01ff;
+
+	return len1 == agent->msap.length1 && len2 == agent->msap.length2 &&
+	       !memcmp(msap + 2, agent->msap.msap1, len1) &&
+	       !memcmp(port + 2, agent->msap.msap2, len2);
+}
+
+static u32 neigh_hash(const u8 *msap, u16 len)
+{
+	u32 h = 2166136261U;
+
+	while (len--)
+		h = (h ^ *msap++) * 16777619U;
+	return h;
+}
+
+static struct lldp_neigh *neigh_find(struct neigh_mib *mib, u32 hash,
+				     const u8 *msap, u16 len)
+{
+	struct lldp_neigh *n;
+
+	for (n = mib->hash[hash & (NEIGH_HASH_SIZE - 1)]; n; n = n->hnext)
+		if (n->hash == hash && n->msaplen == len &&
+		    !memcmp(n->frame, msap, len))
+			return n;
+	return NULL;
+}
+
+void neigh_init(struct lldp_agent *agent, unsigned int max)
+{
+	struct neigh_mib *mib = &agent->neigh;
+
+	memset(mib->hash, 0, sizeof(mib->hash));
+	TAILQ_INIT(&mib->list);
+	mib->count = 0;
+	mib->max = max ? max : 1;
+}
+
+/*
+ * Store a frame of a further neighbor of the agent.
+ * Returns 1 if the frame was taken by the remote MIB and 0 if the receive
+ * state machine processes it: frames of the first neighbor, frames of any
+ * neighbor once the first one is gone, malformed frames and frames of new
+ * neighbors when the table is full.
+ */
+int neigh_rx(struct lldp_agent *agent, const u8 *buf, size_t len)
+{
+	struct neigh_mib *mib = &agent->neigh;
+	const u8 *tlvs = buf + sizeof(struct l2_ethhdr);
+	struct lldp_neigh *n;
+	u16 msaplen, ttl, size;
+	u32 hash;
+	u8 *frame;
+
+	msaplen = neigh_msap(buf, len, &ttl);
+	if (!msaplen)
+		return 0;
+	hash = neigh_hash(tlvs, msaplen);
+	n = neigh_find(mib, hash, tlvs, msaplen);
+	if (!agent->msap.msap1) {
+		/* The first neighbor is gone, this one takes its place */
+		if (n)
+			neigh_del(n);
+		return 0;
+	}
+	if (neigh_is_first(agent, tlvs))
+		return 0;
+	if (!ttl) {
+		/* Shutdown */
+		if (n)
+			neigh_del(n);
+		return 1;
+	}
+
+	size = len - sizeof(struct l2_ethhdr);
+	if (n) {
+		if (n->size != size || memcmp(n->frame, tlvs, size)) {
+			frame = malloc(size);
+			if (!frame) {
+				LLDPAD_DBG("%s: no memory for neighbor frame\n",
+					   __func__);
+				return 1;
+			}
+			memcpy(frame, tlvs, size);
+			free(n->frame);
+			n->frame = frame;
+			n->size = size;
+		}
+		wheel_unlink(n);
+	} else {
+		if (mib->count + 1 >= mib->max)
+			return 0;
+		n = calloc(1, sizeof(*n));
+		frame = malloc(size);
+		if (!n || !frame) {
+			LLDPAD_DBG("%s: no memory for neighbor\n", __func__);
+			free(frame);
+			free(n);
+			return 1;
+		}
+		memcpy(frame, tlvs, size);
+		n->frame = frame;
+		n->size = size;
+		n->msaplen = msaplen;
+		n->hash = hash;
+		n->agent = agent;
+		n->hnext = mib->hash[hash & (NEIGH_HASH_SIZE - 1)];
+		mib->hash[hash & (NEIGH_HASH_SIZE - 1)] = n;
+		TAILQ_INSERT_TAIL(&mib->list, n, entry);
+		mib->count++;
+		LLDPAD_DBG("%s: %u further neighbors\n", __func__, mib->count);
+	}
+	n->expires = neigh_now() + ttl;
+	wheel_link(n);
+	return 1;
+}
+
+/*
+ * Delete all further neighbors, the port is down or the agent removed.
+ */
+void neigh_flush(struct lldp_agent *agent)
+{
+	struct lldp_neigh *n;
+
+	while ((n = TAILQ_FIRST(&agent->neigh.list)))
+		neigh_del(n);
+}
+
+/*
+ * Change the maximum number of neighbors, the newest ones are deleted when
+ * there are too many.
+ */
+void neigh_set_max(struct lldp_agent *agent, unsigned int max)
+{
+	struct neigh_mib *mib = &agent->neigh;
+
+	mib->max = max ? max : 1;
+	while (mib->count + 1 > mib->max)
+		neigh_del(TAILQ_LAST(&mib->list, neigh_list));
+}
+
+/*
+ * Return a further neighbor by its position, 1 for the oldest.
+ */
+struct lldp_neigh *neigh_get(struct lldp_agent *agent, unsigned int index)
+{
+	struct lldp_neigh *n;
+
+	if (!index)
+		return NULL;
+	TAILQ_FOREACH(n, &agent->neigh.list, entry)
+		if (!--index)
+			return n;
+	return NULL;
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#ifndef NEIGH_H
+#define NEIGH_H
+
+#include <time.h>
+#include <sys/queue.h>
+#include "lldp.h"
+
+/*
+ * Remote MIB of the further neighbors of an agent.
+ *
+ * The first neighbor seen by an agent is handled by the receive state
+ * machine and the modules as before. Frames with another MSAP, the
+ * chassis ID and port ID TLVs, are kept here up to the configured number
+ * of neighbors per agent, each aged by its own TTL on a timer wheel of the
+ * thread. Only when the table is full a further MSAP is reported as too
+ * many neighbors. When the first neighbor is gone, the next frame of any
+ * neighbor takes its place.
+ */
+#define NEIGH_MAX_DEFAULT	8	/* Neighbors per agent, first included */
+#define NEIGH_MAX_LIMIT		256
+#define NEIGH_HASH_SIZE		16	/* Power of 2 */
+
+struct port;
+struct lldp_agent;
+
+struct lldp_neigh {
+	struct lldp_neigh *hnext;	/* MSAP hash chain */
+	struct lldp_neigh *wnext;	/* Timer wheel slot */
+	struct lldp_neigh **wprev;
+	TAILQ_ENTRY(lldp_neigh) entry;	/* Order of arrival */
+	struct lldp_agent *agent;
+	time_t expires;			/* Monotonic seconds */
+	u32 hash;
+	u16 msaplen;			/* Chassis ID and port ID TLVs */
+	u16 size;
+	u8 *frame;			/* Last frame, MSAP at the start */
+};
+
+struct neigh_mib {
+	struct lldp_neigh *hash[NEIGH_HASH_SIZE];
+	TAILQ_HEAD(neigh_list, lldp_neigh) list;
+	unsigned int count;		/* # of further neighbors */
+	unsigned int max;		/* Max # of neighbors, first included */
+};
+
+void neigh_init(struct lldp_agent *agent, unsigned int max);
+int neigh_rx(struct lldp_agent *agent, const u8 *buf, size_t len);
+void neigh_flush(struct lldp_agent *agent);
+void neigh_set_max(struct lldp_agent *agent, unsigned int max);
+struct lldp_neigh *neigh_get(struct lldp_agent *agent, unsigned int index);
+
+#endif /* NEIGH_H */
@@ -43,19 +43,47 @@
 #include "lldp_dcbx_nl.h"
 #include "lldp_util.h"
 
-struct port *porthead = NULL; /* port Head pointer */
+__thread struct port *porthead = NULL; /* port Head pointer */
+__thread struct port *port_hash[PORT_HASH_SIZE];
+
+static void port_hash_del(struct port *port)
+{
+	struct port **pp;
+
+	pp = &port_hash[(unsigned int)port->ifindex % PORT_HASH_SIZE];
+	for (; *pp; pp = &(*pp)->hnext)
+		if (*pp == port) {
+			*pp = port->hnext;
+			break;
+		}
+}
 
 void agent_receive(void *, const u8 *, const u8 *, size_t);
 
 /* Port routines used for command processing -- return cmd_xxx codes */
 
+/*
+ * Agents not in use are not instantiated, on a port which is up they have
+ * no TLVs and no counters.
+ */
+static int agent_not_in_use(const char *ifname)
+{
+	struct port *port = port_find_by_ifindex(get_ifidx(ifname));
+
+	if (port && !LIST_EMPTY(&port->agent_head))
+		return cmd_success;
+	return cmd_agent_not_found;
+}
+
 int get_lldp_agent_statistics(const char *ifname, struct agentstats *stats, int type)
 {
 	struct lldp_agent *agent;
 
 	agent = lldp_agent_find_by_type(ifname, type);
-	if (!agent)
-		return cmd_agent_not_found;
+	if (!agent) {
+		memset(stats, 0, sizeof(*stats));
+		return agent_not_in_use(ifname);
+	}
 
 	memcpy((void *)stats, (void *)&agent->stats, sizeof(struct agentstats));
 
@@ -67,8 +95,10 @@ int get_local_tlvs(char *ifname, int type, unsigned char *tlvs, int *size)
 	struct lldp_agent *agent;
 
 	agent = lldp_agent_find_by_type(ifname, type);
-	if (!agent)
-		return cmd_agent_not_found;
+	if (!agent) {
+		*size = 0;
+		return agent_not_in_use(ifname);
+	}
 
 	if (agent->tx.frameout == NULL) {
 		*size = 0;
@@ -84,13 +114,32 @@ int get_local_tlvs(char *ifname, int type, unsigned char *tlvs, int *size)
 	return cmd_success;
 }
 
-int get_neighbor_tlvs(char *ifname, int type, unsigned char *tlvs, int *size)
+/*
+ * Copy the TLVs of a neighbor, index 0 is the one handled by the receive
+ * state machine and the further neighbors follow in order of arrival.
+ */
+int get_neighbor_tlvs(char *ifname, int type, unsigned int index,
+		      unsigned char *tlvs, int *size)
 {
 	struct lldp_agent *agent;
+	struct lldp_neigh *n;
 
 	agent = lldp_agent_find_by_type(ifname, type);
-	if (!agent)
-		return cmd_agent_not_found;
+	if (!agent) {
+		*size = 0;
+		return index ? cmd_bad_params : agent_not_in_use(ifname);
+	}
+
+	if (index) {
+		n = neigh_get(agent, index);
+		if (!n) {
+			*size = 0;
+			return cmd_bad_params;
+		}
+		*size = n->size;
+		memcpy(tlvs, n->frame, n->size);
+		return cmd_success;
+	}
 
 	if (agent->rx.framein == NULL) {
 		*size = 0;
@@ -140,6 +189,8 @@ void set_lldp_agent_admin(const char *ifname, int type, int admin)
 		return;
 
 	agent = lldp_agent_find_by_type(port->ifname, type);
+	if (!agent && admin != disabled)
+		agent = lldp_agent_demand(port, type);
 	if (!agent)
 		return;
 
@@ -174,6 +225,7 @@ void set_lldp_port_enable(const char *ifname, int enable)
 	LIST_FOREACH(agent, &port->agent_head, entry) {
 		run_tx_sm(port, agent);
 		run_rx_sm(port, agent);
+		lldp_agent_kick(agent);
 	}
 }
 
@@ -185,6 +237,7 @@ void set_port_oper_delay(const char *ifname)
 		return;
 
 	port->dormantDelay = DORMANT_DELAY;
+	lldp_dormant_start();
 
 	return;
 }
@@ -243,7 +296,9 @@ int reinit_port(const char *ifname)
 		/* init TX path */
 		txInitializeTimers(agent);
 		txInitializeLLDP(port, agent);
+		lldp_agent_kick(agent);
 	}
+	lldp_dormant_start();
 
 	return 0;
 }
@@ -251,10 +306,10 @@ int reinit_port(const char *ifname)
 struct port *add_port(int ifindex, const char *ifname)
 {
 	struct port *newport;
+	unsigned int h;
 
-	for (newport = porthead; newport; newport = newport->next)
-		if (ifindex == newport->ifindex)
-			return NULL;
+	if (port_find_by_ifindex(ifindex))
+		return NULL;
 
 	newport = malloc(sizeof(*newport));
 	if (!newport) {
@@ -283,12 +338,16 @@ struct port *add_port(int ifindex, const char *ifname)
 
 	/* init TX path */
 	newport->dormantDelay = DORMANT_DELAY;
+	lldp_dormant_start();
 
 	/* enable TX path */
 	if (porthead)
 		newport->next = porthead;
 
 	porthead = newport;
+	h = (unsigned int)ifindex % PORT_HASH_SIZE;
+	newport->hnext = port_hash[h];
+	port_hash[h] = newport;
 	return newport;
 
 fail:
@@ -350,6 +409,9 @@ int remove_port(const char *ifname)
 
 		if (agent->rx.framein)
 			free(agent->rx.framein);
+		free(agent->rx.lastin);
+		neigh_flush(agent);
+		lldp_agent_unschedule(agent);
 
 		if (agent->tx.frameout)
 			free(agent->tx.frameout);
@@ -365,6 +427,7 @@ int remove_port(const char *ifname)
 		parent->next = port->next;
 	else
 		return -1;
+	port_hash_del(port);
 
 	free(port);
 
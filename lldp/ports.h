@@ -77,6 +77,7 @@ enum portEnableStatus {
 /* lldp port specific structure */
 struct port {
 	struct port *next;
+	struct port *hnext;	/* Next in port_hash chain */
 	int ifindex;
 	u8 hw_resetting;
 	u8 portEnabled;
@@ -91,7 +92,12 @@ struct port {
 	char ifname[IFNAMSIZ];
 };
 
-extern struct port *porthead;
+extern __thread struct port *porthead;
+
+/* Ports hashed by interface index, for hosts with thousands of ports */
+#define PORT_HASH_SIZE	1024
+
+extern __thread struct port *port_hash[PORT_HASH_SIZE];
 
 #ifdef __cplusplus
 extern "C" {
@@ -106,7 +112,8 @@ int get_port_hw_resetting(const char *ifname);
 void set_lldp_port_enable(const char *ifname, int enable);
 
 int get_local_tlvs(char *ifname, int type, unsigned char *tlvs, int *size);
-int get_neighbor_tlvs(char *ifname, int type, unsigned char *tlvs, int *size);
+int get_neighbor_tlvs(char *ifname, int type, unsigned int index,
+		      unsigned char *tlvs, int *size);
 
 int port_needs_shutdown(struct port *port);
 
@@ -120,9 +127,10 @@ void set_agent_oper_delay(const char *ifname, int type);
 
 static inline struct port *port_find_by_ifindex(int ifindex)
 {
-	struct port *port = porthead;
+	struct port *port;
 
-	for (port = porthead; port; port = port->next)
+	for (port = port_hash[(unsigned int)ifindex % PORT_HASH_SIZE]; port;
+	     port = port->hnext)
 		if (ifindex == port->ifindex)
 			return port;
 	return NULL;
@@ -40,6 +40,9 @@
 #include "lldp_mand.h"
 #include "lldp_tlv.h"
 #include "agent.h"
+#include "stats.h"
+#include "ctrl_iface.h"
+#include "lldp_util.h"
 
 void rxInitializeLLDP(struct port *port, struct lldp_agent *agent)
 {
@@ -54,6 +57,7 @@ void rxInitializeLLDP(struct port *port, struct lldp_agent *agent)
 	agent->rx.sizein = 0;
 
 	mibDeleteObjects(port, agent);
+	neigh_flush(agent);
 	return;
 }
 
@@ -77,8 +81,11 @@ void rxReceiveFrame(void *ctx, UNUSED int ifindex, const u8 *buf, size_t len)
 		if (agent->rx.framein &&
 		    agent->rx.sizein == len &&
 		    (memcmp(buf, agent->rx.framein, len) == 0)) {
-			agent->timers.rxTTL = agent->timers.lastrxTTL;
+			lldp_agent_timer(agent, &agent->timers.rxTTLDue,
+					 agent->timers.lastrxTTL);
 			agent->stats.statsFramesInTotal++;
+			agent->stats.statsFramesDedupTotal++;
+			agent->stats.statsOctetsInTotal += len;
 			return;
 		}
 
@@ -98,12 +105,23 @@ void rxReceiveFrame(void *ctx, UNUSED int ifindex, const u8 *buf, size_t len)
 			break;
 	}
 
+	/* Agents other than the nearest bridge agent start on demand */
+	if (agent == NULL)
+		agent = lldp_agent_demand_mac(port,
+					      ((struct l2_ethhdr *)buf)->h_dest);
 	if (agent == NULL)
 		return;
 
 	if (agent->adminStatus == disabled || agent->adminStatus == enabledTxOnly)
 		return;
 
+	/* Frames of further neighbors are kept by the remote MIB */
+	if (neigh_rx(agent, buf, len)) {
+		agent->stats.statsFramesInTotal++;
+		agent->stats.statsOctetsInTotal += len;
+		return;
+	}
+
 	if (agent->rx.framein)
 		free(agent->rx.framein);
 
@@ -118,10 +136,169 @@ void rxReceiveFrame(void *ctx, UNUSED int ifindex, const u8 *buf, size_t len)
 
 	if (!frame_error) {
 		agent->stats.statsFramesInTotal++;
+		agent->stats.statsOctetsInTotal += len;
 		agent->rx.rcvFrame = 1;
 	}
 
 	run_rx_sm(port, agent);
+	lldp_agent_kick(agent);
+}
+
+/* Room for a delta event after the module and level prefix */
+#define DELTA_EVENT_LEN	(MAX_CLIF_MSGBUF - 16)
+
+struct delta_tlv {
+	const u8 *tlv;		/* TLV including its header */
+	u16 size;
+	u32 key;		/* Type, TLVID for organizationally specific */
+	u16 nth;		/* # of earlier TLVs with the same key */
+	bool seen;
+};
+
+struct delta_event {
+	struct port *port;
+	struct lldp_agent *agent;
+	int start;		/* Length of the event header */
+	int used;
+	char buf[DELTA_EVENT_LEN];
+};
+
+/*
+ * Split a received frame into TLVs, the End of LLDPDU TLV is not included.
+ * Returns the number of TLVs.
+ */
+static int delta_parse(const u8 *frame, u16 size, struct delta_tlv *t,
+		       int max)
+{
+	u16 off = sizeof(struct l2_ethhdr);
+	u16 hdr, len;
+	int n = 0, i;
+
+	while (n < max && off + 2 <= size) {
+		hdr = (frame[off] << 8) | frame[off + 1];
+		len = hdr & 0x01ff;
+		if (!(hdr >> 9) || off + 2 + len > size)
+			break;
+		t[n].tlv = frame + off;
+		t[n].size = 2 + len;
+		t[n].key = hdr >> 9;
+		if (t[n].key == ORG_SPECIFIC_TLV && len >= 4)
+			t[n].key = TLVID((frame[off + 2] << 16) |
+					 (frame[off + 3] << 8) | frame[off + 4],
+					 frame[off + 5]);
+		t[n].nth = 0;
+		t[n].seen = false;
+		for (i = 0; i < n; i++)
+			if (t[i].key == t[n].key)
+				t[n].nth++;
+		off += t[n].size;
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Write the event header. The sequence number is filled in when the event
+ * is sent, so numbers are only used by events clients receive.
+ */
+static void delta_start(struct delta_event *ev)
+{
+	ev->start = snprintf(ev->buf, sizeof(ev->buf), "%08x%02x%02zx%s",
+			     0, ev->agent->type,
+			     strlen(ev->port->ifname), ev->port->ifname);
+	ev->used = ev->start;
+}
+
+static void delta_flush(struct delta_event *ev)
+{
+	char seq[9];
+
+	if (ev->used == ev->start)
+		return;
+	snprintf(seq, sizeof(seq), "%08x", ++ev->agent->rx.deltaSeq);
+	memcpy(ev->buf, seq, 8);
+	send_event(MSG_EVENT, NEIGH_DELTA_ID, ev->buf);
+	ev->used = ev->start;
+	ev->buf[ev->used] = '\0';
+}
+
+static void delta_add(struct delta_event *ev, char op, struct delta_tlv *t)
+{
+	if (ev->used + 1 + 2 * t->size >= (int)sizeof(ev->buf))
+		delta_flush(ev);
+	ev->buf[ev->used++] = op;
+	bin2hexstr(t->tlv, t->size, ev->buf + ev->used,
+		   sizeof(ev->buf) - ev->used);
+	ev->used += 2 * t->size;
+	ev->buf[ev->used] = '\0';
+}
+
+/*
+ * Publish the TLVs which differ between the last published frame and the
+ * new one, NULL when the neighbor is gone. TLVs are matched by type, or
+ * OUI and subtype, and by their position among TLVs with the same key.
+ * The new frame becomes the last published one.
+ */
+static void rx_publish_delta(struct port *port, struct lldp_agent *agent,
+			     const u8 *frame, u16 size)
+{
+	struct delta_tlv *old = NULL, *new = NULL;
+	struct delta_event *ev = NULL;
+	int nold, nnew, i, j;
+
+	if (!clif_delta_listeners) {
+		free(agent->rx.lastin);
+		agent->rx.lastin = NULL;
+		agent->rx.sizelast = 0;
+		return;
+	}
+
+	old = malloc((agent->rx.sizelast / 2 + 1) * sizeof(*old));
+	new = malloc((size / 2 + 1) * sizeof(*new));
+	ev = malloc(sizeof(*ev));
+	if (!old || !new || !ev) {
+		/* Skip a number to let the clients see the loss */
+		agent->rx.deltaSeq++;
+		goto out;
+	}
+	nold = delta_parse(agent->rx.lastin, agent->rx.sizelast, old,
+			   agent->rx.sizelast / 2 + 1);
+	nnew = delta_parse(frame, size, new, size / 2 + 1);
+
+	ev->port = port;
+	ev->agent = agent;
+	delta_start(ev);
+	for (i = 0; i < nnew; i++) {
+		for (j = 0; j < nold; j++)
+			if (old[j].key == new[i].key && old[j].nth == new[i].nth)
+				break;
+		if (j == nold) {
+			delta_add(ev, NEIGH_DELTA_ADD, &new[i]);
+			continue;
+		}
+		old[j].seen = true;
+		if (old[j].size != new[i].size ||
+		    memcmp(old[j].tlv, new[i].tlv, new[i].size))
+			delta_add(ev, NEIGH_DELTA_CHANGE, &new[i]);
+	}
+	for (j = 0; j < nold; j++)
+		if (!old[j].seen)
+			delta_add(ev, NEIGH_DELTA_REMOVE, &old[j]);
+	delta_flush(ev);
+out:
+	free(ev);
+	free(new);
+	free(old);
+	free(agent->rx.lastin);
+	agent->rx.lastin = NULL;
+	agent->rx.sizelast = 0;
+	if (!size)
+		return;
+	agent->rx.lastin = malloc(size);
+	if (!agent->rx.lastin)
+		return;
+	memcpy(agent->rx.lastin, frame, size);
+	agent->rx.sizelast = size;
 }
 
 void rxProcessFrame(struct port *port, struct lldp_agent *agent)
@@ -320,15 +497,20 @@ void rxProcessFrame(struct port *port, struct lldp_agent *agent)
 			}
 			if ((agent->rx.tooManyNghbrs == true) &&
 				(good_neighbor == false)) {
+				u16 ttl = ntohs(*(u16 *)tlv->info);
+				u64 *due = &agent->timers.tooManyNghbrsDue;
+
 				LLDPAD_INFO("** set tooManyNghbrsTimer\n");
-				agent->timers.tooManyNghbrsTimer =
-					max(ntohs(*(u16 *)tlv->info),
-					agent->timers.tooManyNghbrsTimer);
+				if (ttl > lldp_agent_timeleft(*due))
+					lldp_agent_timer(agent, due, ttl);
 				msap_compare_1 = false;
 				msap_compare_2 = false;
 			} else {
-				agent->timers.rxTTL = ntohs(*(u16 *)tlv->info);
-				agent->timers.lastrxTTL = agent->timers.rxTTL;
+				agent->timers.lastrxTTL =
+					ntohs(*(u16 *)tlv->info);
+				lldp_agent_timer(agent,
+						 &agent->timers.rxTTLDue,
+						 agent->timers.lastrxTTL);
 				good_neighbor = false;
 			}
 		}
@@ -390,6 +572,9 @@ out:
 		agent->stats.statsFramesDiscardedTotal++;
 		agent->stats.statsFramesInErrorsTotal++;
 		agent->rx.badFrame = true;
+	} else {
+		rx_publish_delta(port, agent, agent->rx.framein,
+				 agent->rx.sizein);
 	}
 
 	agent->lldpdu = 0;
@@ -407,6 +592,8 @@ u8 mibDeleteObjects(struct port *port, struct lldp_agent *agent)
 			continue;
 		np->ops->lldp_mod_mibdelete(port, agent);
 	}
+	if (agent->rx.lastin)
+		rx_publish_delta(port, agent, NULL, 0);
 
 	/* Clear history */
 	agent->msap.length1 = 0;
@@ -498,10 +685,10 @@ bool set_rx_state(struct port *port, struct lldp_agent *agent)
 		rx_change_state(agent, RX_WAIT_FOR_FRAME);
 		return true;
 	case RX_FRAME:
-		if (agent->timers.rxTTL == 0) {
+		if (agent->timers.rxTTLDue == 0) {
 			rx_change_state(agent, DELETE_INFO);
 			return true;
-		} else if ((agent->timers.rxTTL != 0) &&
+		} else if ((agent->timers.rxTTLDue != 0) &&
 			(agent->rxChanges == true)) {
 			rx_change_state(agent, UPDATE_INFO);
 			return true;
@@ -541,10 +728,16 @@ void process_wait_for_frame(struct lldp_agent *agent)
 
 void process_rx_frame(struct port *port, struct lldp_agent *agent)
 {
+	u64 start = stats_ns(), ns;
+
 	agent->rx.remoteChange = false;
 	agent->rxChanges = false;
 	agent->rx.rcvFrame = false;
 	rxProcessFrame(port, agent);
+	ns = stats_ns() - start;
+	agent->stats.statsRxParseNs += ns;
+	if (ns > agent->stats.statsRxParseMaxNs)
+		agent->stats.statsRxParseMaxNs = ns;
 	return;
 }
 
@@ -568,27 +761,27 @@ void process_update_info(struct lldp_agent *agent)
 	return;
 }
 
-void update_rx_timers(struct lldp_agent *agent)
+/*
+ * Age the neighbor information and the too many neighbors condition when
+ * their deadlines have passed.
+ */
+void update_rx_timers(struct lldp_agent *agent, u64 now)
 {
-
-	if (agent->timers.rxTTL) {
-		agent->timers.rxTTL--;
-		if (agent->timers.rxTTL == 0) {
-			agent->rx.rxInfoAge = true;
-			if (agent->timers.tooManyNghbrsTimer != 0) {
-				LLDPAD_DBG("** clear tooManyNghbrsTimer\n");
-				agent->timers.tooManyNghbrsTimer = 0;
-				agent->rx.tooManyNghbrs = false;
-			}
-		}
-	}
-	if (agent->timers.tooManyNghbrsTimer) {
-		agent->timers.tooManyNghbrsTimer--;
-		if (agent->timers.tooManyNghbrsTimer == 0) {
-			LLDPAD_DBG("** tooManyNghbrsTimer timeout\n");
+	if (agent->timers.rxTTLDue && agent->timers.rxTTLDue <= now) {
+		agent->timers.rxTTLDue = 0;
+		agent->rx.rxInfoAge = true;
+		if (agent->timers.tooManyNghbrsDue != 0) {
+			LLDPAD_DBG("** clear tooManyNghbrsTimer\n");
+			agent->timers.tooManyNghbrsDue = 0;
 			agent->rx.tooManyNghbrs = false;
 		}
 	}
+	if (agent->timers.tooManyNghbrsDue &&
+	    agent->timers.tooManyNghbrsDue <= now) {
+		agent->timers.tooManyNghbrsDue = 0;
+		LLDPAD_DBG("** tooManyNghbrsTimer timeout\n");
+		agent->rx.tooManyNghbrs = false;
+	}
 }
 
 void rx_change_state(struct lldp_agent *agent, u8 newstate)
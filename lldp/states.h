@@ -87,7 +87,7 @@ void process_tx_initialize_sm(struct port *);
 void process_tx_idle(struct lldp_agent *);
 void process_tx_shutdown_frame(struct port *, struct lldp_agent *);
 void process_tx_info_frame(struct port *, struct lldp_agent *);
-void update_tx_timers(struct lldp_agent *);
+void update_tx_timers(struct lldp_agent *, u64 now);
 void run_tx_timers_sm(struct port *, struct lldp_agent *);
 bool set_tx_state(struct port *, struct lldp_agent *);
 void txInitializeTimers(struct lldp_agent *);
@@ -165,6 +165,6 @@ void process_wait_for_frame(struct lldp_agent *);
 void process_rx_frame(struct port *, struct lldp_agent *);
 void process_delete_info(struct port *, struct lldp_agent *);
 void process_update_info(struct lldp_agent *);
-void update_rx_timers(struct lldp_agent *);
+void update_rx_timers(struct lldp_agent *, u64 now);
 void clear_manifest(struct lldp_agent *);
 #endif /* STATES_H */
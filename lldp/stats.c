@@ -0,0 +1,403 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include "ports.h"
+#include "stats.h"
+#include "lldpad.h"
+#include "messages.h"
+#include "shard.h"
+
+#define	MODSTATS_HASH	256	/* Power of 2 */
+
+static __thread LIST_HEAD(modstats_head, modstats) modstats_hash[MODSTATS_HASH];
+
+static unsigned int modstats_key(const char *ifname, const char *module)
+{
+	unsigned int h = 2166136261U;
+
+	while (*ifname)
+		h = (h ^ (unsigned char)*ifname++) * 16777619U;
+	while (*module)
+		h = (h ^ (unsigned char)*module++) * 16777619U;
+	return h & (MODSTATS_HASH - 1);
+}
+
+/*
+ * Return the counters of a module on an interface. Create them when not
+ * found. Parameter module is the module name, it must be a constant string.
+ * Returns NULL when out of memory, all functions below accept NULL.
+ */
+struct modstats *modstats_get(const char *ifname, const char *module)
+{
+	struct modstats_head *head;
+	struct modstats *ms;
+
+	head = &modstats_hash[modstats_key(ifname, module)];
+	LIST_FOREACH(ms, head, node)
+		if (!strncmp(ms->ifname, ifname, sizeof(ms->ifname))
+		    && !strcmp(ms->module, module))
+			return ms;
+	ms = calloc(1, sizeof(*ms));
+	if (!ms) {
+		LLDPAD_ERR("%s:%s unable to allocate %s counters\n", __func__,
+			   ifname, module);
+		return NULL;
+	}
+	strncpy(ms->ifname, ifname, sizeof(ms->ifname) - 1);
+	ms->module = module;
+	LIST_INSERT_HEAD(head, ms, node);
+	return ms;
+}
+
+/*
+ * Account a hardware programming request which took ns nanoseconds.
+ */
+void modstats_hw(struct modstats *ms, u64 ns, int failed)
+{
+	if (!ms)
+		return;
+	++ms->hwCalls;
+	if (failed)
+		++ms->hwErrors;
+	ms->hwNs += ns;
+	if (ns > ms->hwMaxNs)
+		ms->hwMaxNs = ns;
+}
+
+void modstats_retransmit(struct modstats *ms)
+{
+	if (ms)
+		++ms->retransmits;
+}
+
+/*
+ * Account the round trip time of an acknowledged frame. Bucket 0 counts
+ * times below 1 microsecond, bucket n times below 2^n microseconds and the
+ * last bucket all larger times.
+ */
+void modstats_rtt(struct modstats *ms, u64 ns)
+{
+	unsigned int b = 0;
+	u64 us = ns / 1000;
+
+	if (!ms)
+		return;
+	while (us && b < MODSTATS_RTT_BUCKETS - 1) {
+		us >>= 1;
+		++b;
+	}
+	++ms->rtt[b];
+	++ms->acks;
+	ms->rttNs += ns;
+}
+
+/*
+ * Count the entry into a state. Parameter names is the table of state names
+ * indexed by state.
+ */
+void modstats_state(struct modstats *ms, const char *const *names,
+		    unsigned int nstates, unsigned int state)
+{
+	if (!ms || state >= nstates || state >= MODSTATS_MAX_STATES)
+		return;
+	ms->states = names;
+	ms->nstates = nstates;
+	++ms->transitions[state];
+}
+
+/*
+ * Prometheus text exposition format. All samples of a metric family must
+ * be printed in one group, so each family is a pass over all agents or
+ * all module counters.
+ */
+#define	AGENT_STAT(f)	offsetof(struct agentstats, f), \
+			sizeof(((struct agentstats *)0)->f)
+
+static const struct agent_metric {
+	const char *name;
+	const char *type;
+	const char *help;
+	size_t off;		/* Offset in struct agentstats */
+	size_t size;		/* Size of counter */
+	int ns;			/* Counter in nanoseconds, print seconds */
+} agent_metrics[] = {
+	{ "frames_out_total", "counter", "LLDPDUs transmitted",
+	  AGENT_STAT(statsFramesOutTotal), 0 },
+	{ "frames_in_total", "counter", "LLDPDUs received",
+	  AGENT_STAT(statsFramesInTotal), 0 },
+	{ "frames_discarded_total", "counter", "LLDPDUs discarded",
+	  AGENT_STAT(statsFramesDiscardedTotal), 0 },
+	{ "frames_in_errors_total", "counter", "LLDPDUs received in error",
+	  AGENT_STAT(statsFramesInErrorsTotal), 0 },
+	{ "tlvs_discarded_total", "counter", "TLVs discarded",
+	  AGENT_STAT(statsTLVsDiscardedTotal), 0 },
+	{ "tlvs_unrecognized_total", "counter", "TLVs not recognized",
+	  AGENT_STAT(statsTLVsUnrecognizedTotal), 0 },
+	{ "ageouts_total", "counter", "Neighbor information aged out",
+	  AGENT_STAT(statsAgeoutsTotal), 0 },
+	{ "octets_out_total", "counter", "Bytes of LLDPDUs transmitted",
+	  AGENT_STAT(statsOctetsOutTotal), 0 },
+	{ "octets_in_total", "counter", "Bytes of LLDPDUs received",
+	  AGENT_STAT(statsOctetsInTotal), 0 },
+	{ "frames_dedup_total", "counter",
+	  "LLDPDUs identical to the previous one and not parsed",
+	  AGENT_STAT(statsFramesDedupTotal), 0 },
+	{ "rx_parse_seconds_total", "counter",
+	  "Time spent parsing received TLVs",
+	  AGENT_STAT(statsRxParseNs), 1 },
+	{ "rx_parse_max_seconds", "gauge", "Longest parse of an LLDPDU",
+	  AGENT_STAT(statsRxParseMaxNs), 1 },
+	{ "tx_build_seconds_total", "counter",
+	  "Time spent building TLVs for transmission",
+	  AGENT_STAT(statsTxBuildNs), 1 },
+	{ "tx_build_max_seconds", "gauge", "Longest build of an LLDPDU",
+	  AGENT_STAT(statsTxBuildMaxNs), 1 }
+};
+
+#define	MOD_STAT(f)	offsetof(struct modstats, f)
+
+static const struct mod_metric {
+	const char *name;
+	const char *type;
+	const char *help;
+	size_t off;		/* Offset in struct modstats */
+	int ns;			/* Counter in nanoseconds, print seconds */
+} mod_metrics[] = {
+	{ "hw_calls_total", "counter", "Hardware programming requests",
+	  MOD_STAT(hwCalls), 0 },
+	{ "hw_errors_total", "counter", "Failed hardware programming requests",
+	  MOD_STAT(hwErrors), 0 },
+	{ "hw_seconds_total", "counter", "Time spent programming hardware",
+	  MOD_STAT(hwNs), 1 },
+	{ "hw_max_seconds", "gauge", "Longest hardware programming request",
+	  MOD_STAT(hwMaxNs), 1 },
+	{ "retransmits_total", "counter", "Retransmitted frames",
+	  MOD_STAT(retransmits), 0 }
+};
+
+static const char *agent_name(struct lldp_agent *agent)
+{
+	if (agent->type == NEAREST_BRIDGE)
+		return "nearest_bridge";
+	return agent_type2section(agent->type);
+}
+
+static void prom_value(FILE *fp, u64 value, int ns)
+{
+	if (ns)
+		fprintf(fp, " %llu.%09llu\n", (unsigned long long)value /
+			1000000000, (unsigned long long)value % 1000000000);
+	else
+		fprintf(fp, " %llu\n", (unsigned long long)value);
+}
+
+/*
+ * Samples are collected from each shard, which owns the ports and their
+ * counters, while the help and type lines are printed once per metric.
+ */
+struct prom_req {
+	FILE *fp;
+	const struct agent_metric *am;
+	const struct mod_metric *mm;
+};
+
+static int prom_agent_samples(void *arg)
+{
+	struct prom_req *req = arg;
+	const struct agent_metric *mp = req->am;
+	struct lldp_agent *agent;
+	struct port *port;
+
+	for (port = porthead; port; port = port->next)
+		LIST_FOREACH(agent, &port->agent_head, entry) {
+			char *p = (char *)&agent->stats + mp->off;
+			u64 value;
+
+			if (mp->size == sizeof(u32))
+				value = *(u32 *)p;
+			else
+				value = *(u64 *)p;
+			fprintf(req->fp, "lldpad_%s{ifname=\"%s\","
+				"agent=\"%s\"}", mp->name,
+				port->ifname, agent_name(agent));
+			prom_value(req->fp, value, mp->ns);
+		}
+	return 0;
+}
+
+static void prom_agents(FILE *fp)
+{
+	struct prom_req req = { .fp = fp };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(agent_metrics) / sizeof(agent_metrics[0]);
+	     ++i) {
+		req.am = &agent_metrics[i];
+		fprintf(fp, "# HELP lldpad_%s %s\n# TYPE lldpad_%s %s\n",
+			req.am->name, req.am->help, req.am->name,
+			req.am->type);
+		shard_call_all(prom_agent_samples, &req);
+	}
+}
+
+static int prom_module_samples(void *arg)
+{
+	struct prom_req *req = arg;
+	const struct mod_metric *mp = req->mm;
+	struct modstats *ms;
+	unsigned int j;
+
+	for (j = 0; j < MODSTATS_HASH; ++j)
+		LIST_FOREACH(ms, &modstats_hash[j], node) {
+			u64 value = *(u64 *)((char *)ms + mp->off);
+
+			if (!value)
+				continue;
+			fprintf(req->fp, "lldpad_%s{ifname=\"%s\","
+				"module=\"%s\"}", mp->name, ms->ifname,
+				ms->module);
+			prom_value(req->fp, value, mp->ns);
+		}
+	return 0;
+}
+
+static int prom_rtt_samples(void *arg)
+{
+	struct prom_req *req = arg;
+	FILE *fp = req->fp;
+	struct modstats *ms;
+	unsigned int j, b;
+
+	for (j = 0; j < MODSTATS_HASH; ++j)
+		LIST_FOREACH(ms, &modstats_hash[j], node) {
+			u64 cnt = 0;
+
+			if (!ms->acks)
+				continue;
+			for (b = 0; b < MODSTATS_RTT_BUCKETS - 1; ++b) {
+				cnt += ms->rtt[b];
+				fprintf(fp, "lldpad_ack_rtt_seconds_bucket"
+					"{ifname=\"%s\",module=\"%s\","
+					"le=\"%g\"} %llu\n", ms->ifname,
+					ms->module, (1UL << b) / 1e6,
+					(unsigned long long)cnt);
+			}
+			fprintf(fp, "lldpad_ack_rtt_seconds_bucket{ifname="
+				"\"%s\",module=\"%s\",le=\"+Inf\"} %llu\n",
+				ms->ifname, ms->module,
+				(unsigned long long)ms->acks);
+			fprintf(fp, "lldpad_ack_rtt_seconds_sum{ifname=\"%s\","
+				"module=\"%s\"}", ms->ifname, ms->module);
+			prom_value(fp, ms->rttNs, 1);
+			fprintf(fp, "lldpad_ack_rtt_seconds_count{ifname="
+				"\"%s\",module=\"%s\"} %llu\n", ms->ifname,
+				ms->module, (unsigned long long)ms->acks);
+		}
+	return 0;
+}
+
+static int prom_state_samples(void *arg)
+{
+	struct prom_req *req = arg;
+	struct modstats *ms;
+	unsigned int j, b;
+
+	for (j = 0; j < MODSTATS_HASH; ++j)
+		LIST_FOREACH(ms, &modstats_hash[j], node)
+			for (b = 0; ms->states && b < ms->nstates; ++b) {
+				if (!ms->transitions[b])
+					continue;
+				fprintf(req->fp, "lldpad_state_transitions_"
+					"total{ifname=\"%s\",module=\"%s\","
+					"state=\"%s\"} %llu\n", ms->ifname,
+					ms->module, ms->states[b],
+					(unsigned long long)ms->transitions[b]);
+			}
+	return 0;
+}
+
+static void prom_modules(FILE *fp)
+{
+	struct prom_req req = { .fp = fp };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(mod_metrics) / sizeof(mod_metrics[0]); ++i) {
+		req.mm = &mod_metrics[i];
+		fprintf(fp, "# HELP lldpad_%s %s\n# TYPE lldpad_%s %s\n",
+			req.mm->name, req.mm->help, req.mm->name,
+			req.mm->type);
+		shard_call_all(prom_module_samples, &req);
+	}
+
+	fprintf(fp, "# HELP lldpad_ack_rtt_seconds Acknowledgement round "
+		"trip time\n# TYPE lldpad_ack_rtt_seconds histogram\n");
+	shard_call_all(prom_rtt_samples, &req);
+
+	fprintf(fp, "# HELP lldpad_state_transitions_total Entries into "
+		"a state machine state\n"
+		"# TYPE lldpad_state_transitions_total counter\n");
+	shard_call_all(prom_state_samples, &req);
+}
+
+/*
+ * Write all agent and module counters in Prometheus text format to file
+ * PROM_FILE, for example to be read by the textfile collector of the node
+ * exporter. The file is replaced atomically.
+ * Returns the number of bytes written to the buffer.
+ */
+int stats_prom(char *buf, size_t len, UNUSED const char *arg)
+{
+	char tmp[sizeof(PROM_FILE) + 4];
+	FILE *fp;
+	long size;
+	int c, err;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", PROM_FILE);
+	fp = fopen(tmp, "w");
+	if (!fp)
+		goto err;
+	prom_agents(fp);
+	prom_modules(fp);
+	size = ftell(fp);
+	err = ferror(fp);
+	if (fclose(fp) || err || rename(tmp, PROM_FILE)) {
+		if (!errno)
+			errno = EIO;
+		c = snprintf(buf, len, "%s: %s\n", PROM_FILE, strerror(errno));
+		unlink(tmp);
+		return c < 0 || (size_t)c >= len ? 0 : c;
+	}
+	c = snprintf(buf, len, "%s %ld bytes\n", PROM_FILE, size);
+	return c < 0 || (size_t)c >= len ? 0 : c;
+err:
+	c = snprintf(buf, len, "%s: %s\n", PROM_FILE, strerror(errno));
+	return c < 0 || (size_t)c >= len ? 0 : c;
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <time.h>
+#include <sys/queue.h>
+#include "lldp.h"
+
+#ifndef IFNAMSIZ
+#define IFNAMSIZ    16
+#endif
+
+/*
+ * Performance counters of a module on one interface. Counters are created
+ * on first use and kept until lldpad exits, so they count across link
+ * flaps and module restarts.
+ */
+#define	MODSTATS_RTT_BUCKETS	24	/* Log2 of ack round trip time in us */
+#define	MODSTATS_MAX_STATES	32	/* Max # of state machine states */
+
+struct modstats {
+	LIST_ENTRY(modstats) node;
+	char ifname[IFNAMSIZ];
+	const char *module;		/* Module name */
+	const char *const *states;	/* State names, NULL if none counted */
+	unsigned int nstates;		/* # of state names */
+	u64 hwCalls;			/* # of hardware programming requests */
+	u64 hwErrors;			/* # of failed requests */
+	u64 hwNs;			/* Time spent programming hardware */
+	u64 hwMaxNs;			/* Longest request */
+	u64 retransmits;		/* # of retransmitted frames */
+	u64 acks;			/* # of round trip times measured */
+	u64 rttNs;			/* Sum of round trip times */
+	u64 rtt[MODSTATS_RTT_BUCKETS];	/* Round trip time histogram */
+	u64 transitions[MODSTATS_MAX_STATES];	/* # of entries per state */
+};
+
+/*
+ * Monotonic time stamp in nanoseconds for the time counters.
+ */
+static inline u64 stats_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct modstats *modstats_get(const char *ifname, const char *module);
+void modstats_hw(struct modstats *, u64 ns, int failed);
+void modstats_retransmit(struct modstats *);
+void modstats_rtt(struct modstats *, u64 ns);
+void modstats_state(struct modstats *, const char *const *names,
+		    unsigned int nstates, unsigned int state);
+int stats_prom(char *buf, size_t len, const char *arg);
+
+#endif /* STATS_H */
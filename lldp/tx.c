@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "ports.h"
+#include "stats.h"
 #include "l2_packet.h"
 #include "states.h"
 #include "messages.h"
@@ -52,9 +53,11 @@ bool mibConstrInfoLLDPDU(struct port *port, struct lldp_agent *agent)
 		agent->tx.frameout = NULL;
 	}
 
-	mac2str(agent->mac_addr, macstring, 30);
-	LLDPAD_DBG("%s: port %s mac %s type %i.\n", __func__, port->ifname,
-		   macstring, agent->type);
+	if (log_enabled(LOG_DEBUG)) {
+		mac2str(agent->mac_addr, macstring, 30);
+		LLDPAD_DBG("%s: port %s mac %s type %i.\n", __func__,
+			   port->ifname, macstring, agent->type);
+	}
 
 	memcpy(eth.h_dest, agent->mac_addr, ETH_ALEN);
 	l2_packet_get_own_src_addr(port->l2,(u8 *)&own_addr);
@@ -164,7 +167,8 @@ void txInitializeTimers(struct lldp_agent *agent)
 	agent->timers.txTick = false;
 	agent->tx.txNow = false;
 	agent->tx.localChange = false;
-	agent->timers.txTTR = 0;
+	agent->timers.txTTRDue = 0;
+	agent->timers.txTickDue = 0;
 	agent->tx.txFast = 0;
 	agent->timers.txShutdownWhile = 0;
 	agent->rx.newNeighbor = false;
@@ -190,8 +194,10 @@ bool mibConstrShutdownLLDPDU(struct port *port, struct lldp_agent *agent)
 		agent->tx.frameout = NULL;
 	}
 
-	mac2str(agent->mac_addr, macstring, 30);
-	LLDPAD_DBG("%s: mac %s.\n", __func__, macstring);
+	if (log_enabled(LOG_DEBUG)) {
+		mac2str(agent->mac_addr, macstring, 30);
+		LLDPAD_DBG("%s: mac %s.\n", __func__, macstring);
+	}
 
 	memcpy(eth.h_dest, agent->mac_addr, ETH_ALEN);
 	l2_packet_get_own_src_addr(port->l2,(u8 *)&own_addr);
@@ -253,6 +259,7 @@ u8 txFrame(struct port *port, struct lldp_agent *agent)
 		htons(ETH_P_LLDP), agent->tx.frameout, agent->tx.sizeout);
 
 	agent->stats.statsFramesOutTotal++;
+	agent->stats.statsOctetsOutTotal += agent->tx.sizeout;
 
 	return 0;
 }
@@ -342,21 +349,36 @@ void process_tx_shutdown_frame(struct port *port, struct lldp_agent *agent)
 
 void process_tx_info_frame(struct port *port, struct lldp_agent *agent)
 {
+	u64 start = stats_ns(), ns;
+
 	mibConstrInfoLLDPDU(port, agent);
+	ns = stats_ns() - start;
+	agent->stats.statsTxBuildNs += ns;
+	if (ns > agent->stats.statsTxBuildMaxNs)
+		agent->stats.statsTxBuildMaxNs = ns;
 
 	txFrame(port, agent);
 	if (agent->timers.txCredit > 0)
 		agent->timers.txCredit--;
+	if (!agent->timers.txTickDue)
+		lldp_agent_timer(agent, &agent->timers.txTickDue, 1);
 	agent->tx.txNow = false;
 	return;
 }
 
-void update_tx_timers(struct lldp_agent *agent)
+/*
+ * Clear the transmit deadlines which have passed, txTick is only running
+ * while credit is missing.
+ */
+void update_tx_timers(struct lldp_agent *agent, u64 now)
 {
-	if (agent->timers.txTTR)
-		agent->timers.txTTR--;
+	if (agent->timers.txTTRDue && agent->timers.txTTRDue <= now)
+		agent->timers.txTTRDue = 0;
 
-	agent->timers.txTick = true;
+	if (agent->timers.txTickDue && agent->timers.txTickDue <= now) {
+		agent->timers.txTickDue = 0;
+		agent->timers.txTick = true;
+	}
 	return;
 }
 
@@ -405,7 +427,7 @@ bool	set_tx_timers_state(struct port *port, struct lldp_agent *agent)
 			return true;
 		}
 
-		if (agent->timers.txTTR == 0) {
+		if (agent->timers.txTTRDue == 0) {
 			tx_timer_change_state(agent, TX_TIMER_EXPIRES);
 			return true;
 		}
@@ -454,14 +476,17 @@ void	run_tx_timers_sm(struct port *port, struct lldp_agent *agent)
 			agent->timers.txTick = false;
 			if (agent->timers.txCredit < agent->timers.txMaxCredit)
 				agent->timers.txCredit++;
+			if (agent->timers.txCredit < agent->timers.txMaxCredit)
+				lldp_agent_timer(agent,
+						 &agent->timers.txTickDue, 1);
 			break;
 		case SIGNAL_TX:
 			agent->tx.txNow = true;
 			agent->tx.localChange = false;
-			if (agent->tx.txFast)
-				agent->timers.txTTR = agent->timers.msgFastTx;
-			else
-				agent->timers.txTTR = agent->timers.msgTxInterval;
+			lldp_agent_timer(agent, &agent->timers.txTTRDue,
+					 agent->tx.txFast ?
+					 agent->timers.msgFastTx :
+					 agent->timers.msgTxInterval);
 			break;
 		case TX_FAST_START:
 			agent->rx.newNeighbor = false;
@@ -39,6 +39,7 @@
 #include "lldp_dcbx_nl.h"
 #include "lldp/l2_packet.h"
 #include "lldp/ports.h"
+#include "lldp/stats.h"
 #include "lldpad_status.h"
 #include "lldp_8021qaz_cmds.h"
 #include "lldp_mand_clif.h"
@@ -46,15 +47,19 @@
 #include "include/linux/rtnetlink.h"
 #include "include/linux/netlink.h"
 #include "lldp_dcbx.h"
+#include "worker.h"
 
 
-struct lldp_head lldp_head;
 struct config_t lldpad_cfg;
 
 static int ieee8021qaz_check_pending(struct port *port, struct lldp_agent *);
 static void run_all_sm(struct port *port, struct lldp_agent *agent);
 static void ieee8021qaz_mibUpdateObjects(struct port *port);
 static void ieee8021qaz_app_reset(struct app_tlv_head *head);
+static struct app_obj *ieee8021qaz_find_app(struct ieee8021qaz_tlvs *tlvs,
+					    u8 prio, u8 sel, u16 proto);
+static int ieee_app_hw(const char *ifname, int cmd, struct app_obj *app,
+		       int napp);
 static int get_ieee_hw(const char *ifname, struct ieee_ets **ets,
 		       struct ieee_pfc **pfc, struct app_prio **app,
 		       int *cnt);
@@ -388,8 +393,7 @@ static int read_cfg_file(char *ifname, struct lldp_agent *agent,
 		errno = 0;
 		pid = strtol(app_tuple, NULL, 0);
 		if (!errno)
-			ieee8021qaz_mod_app(&tlvs->app_head, 0,
-					    prio, sel, (u16) pid, 0);
+			ieee8021qaz_mod_app(tlvs, 0, prio, sel, (u16) pid, 0);
 		free(parse);
 	}
 
@@ -424,7 +428,7 @@ int get_dcbx_hw(const char *ifname, __u8 *dcbx)
 	int err = 0;
 	struct nlattr *attr;
 	struct sockaddr_nl dest_addr;
-	static struct nl_sock *nlsocket;
+	static __thread struct nl_sock *nlsocket;
 	struct nl_msg *nlm = NULL;
 	unsigned char *msg = NULL;
 	struct nlmsghdr *hdr;
@@ -445,6 +449,7 @@ int get_dcbx_hw(const char *ifname, __u8 *dcbx)
 		nl_socket_set_local_port(nlsocket, 0);
 	}
 
+	worker_sync(ifname);
 	err = nl_connect(nlsocket, NETLINK_ROUTE);
 	if (err < 0) {
 		LLDPAD_WARN("%s: %s nlconnect failed abort get ieee, %s\n",
@@ -515,17 +520,57 @@ out:
  * as new defaults. If NO, load defaults. Also, check for TLV values via cmd
  * prompt. Then initialize FSMs for each tlv and finally build the tlvs
  */
+/*
+ * ieee8021qaz_probe - query the DCB attributes of the hardware
+ *
+ * Sets the maximum number of TCs and the PFC capability and remembers the
+ * settings in the format they are set, after a restart unchanged settings
+ * are not set again. Deferred from ifup until a TLV is built, received or
+ * configured, most ports never see an 802.1Qaz peer.
+ */
+void ieee8021qaz_probe(struct ieee8021qaz_tlvs *tlvs)
+{
+	struct ieee_ets *ets = NULL;
+	struct ieee_pfc *pfc = NULL;
+	struct app_prio *data = NULL;
+	int cnt, len;
+
+	if (!tlvs->hw_probe)
+		return;
+	tlvs->hw_probe = false;
+
+	len = get_ieee_hw(tlvs->ifname, &ets, &pfc, &data, &cnt);
+	if (len <= 0)
+		return;
+	if (ets) {
+		tlvs->ets->cfgl->max_tcs = ets->ets_cap;
+		tlvs->hw_ets = *ets;
+		tlvs->hw_ets.willing = 0;
+		tlvs->hw_ets.ets_cap = 0;
+		tlvs->hw_ets.cbs = 0;
+		tlvs->hw_ets_valid = true;
+	}
+	if (pfc) {
+		tlvs->pfc->local.pfc_cap = pfc->pfc_cap;
+		memset(&tlvs->hw_pfc, 0, sizeof(tlvs->hw_pfc));
+		tlvs->hw_pfc.pfc_en = pfc->pfc_en;
+		tlvs->hw_pfc.mbc = pfc->mbc;
+		tlvs->hw_pfc.delay = pfc->delay;
+		tlvs->hw_pfc_valid = true;
+	}
+	free(ets);
+	free(pfc);
+	free(data);
+}
+
 void ieee8021qaz_ifup(char *ifname, struct lldp_agent *agent)
 {
 	struct port *port = NULL;
 	struct ieee8021qaz_tlvs *tlvs;
 	struct ieee8021qaz_user_data *iud;
-	int adminstatus, cnt, len;
+	int adminstatus;
 	__u8 dcbx = 0;
-	struct ieee_ets *ets = NULL;
-	struct ieee_pfc *pfc = NULL;
-	struct app_prio *data = NULL;
-	int err, no_set_status;
+	int err, no_set_status, i;
 
 	if (agent->type != NEAREST_BRIDGE)
 		return;
@@ -626,24 +671,16 @@ void ieee8021qaz_ifup(char *ifname, struct lldp_agent *agent)
 	tlvs->pfc->remote_param = 0;
 
 	LIST_INIT(&tlvs->app_head);
+	for (i = 0; i < IEEE_APP_HASH; i++)
+		LIST_INIT(&tlvs->app_hash[i]);
 	read_cfg_file(port->ifname, agent, tlvs);
 
 	iud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_8021QAZ);
 	LIST_INSERT_HEAD(&iud->head, tlvs, entry);
 
 initialized:
-	/* Query hardware and set maximum number of TCs with hardware values */
-	len = get_ieee_hw(ifname, &ets, &pfc, &data, &cnt);
-	if (len > 0) {
-		if (ets)
-			tlvs->ets->cfgl->max_tcs = ets->ets_cap;
-		if (pfc)
-			tlvs->pfc->local.pfc_cap = pfc->pfc_cap;
-
-		free(ets);
-		free(pfc);
-		free(data);
-	}
+	/* Query hardware when the TLVs are first needed */
+	tlvs->hw_probe = true;
 
 	/* if the dcbx field is filled in by the dcbx query then the
 	 * kernel is supports IEEE mode, so make IEEE DCBX active by default.
@@ -946,114 +983,292 @@ out1:
 	return err;
 }
 
-static int del_ieee_hw(const char *ifname, struct dcb_app *app_data)
+/*
+ * Add the APP entries app[0] to app[cnt - 1] to the message, nested in
+ * one DCB_ATTR_IEEE_APP_TABLE attribute.
+ */
+static int put_ieee_apps(struct nl_msg *nlm, struct app_obj *app, int cnt)
 {
-	int err = 0;
-	struct nlattr *ieee, *app;
-	struct sockaddr_nl dest_addr;
-	struct nl_sock *nlsocket;
+	struct nlattr *table;
+	int i, err;
+
+	table = nla_nest_start(nlm, DCB_ATTR_IEEE_APP_TABLE);
+	if (!table)
+		return -ENOMEM;
+	for (i = 0; i < cnt; i++) {
+		err = nla_put(nlm, DCB_ATTR_IEEE_APP, sizeof(app[i].app),
+			      &app[i].app);
+		if (err < 0)
+			return err;
+	}
+	nla_nest_end(nlm, table);
+	return 0;
+}
+
+/*
+ * Set requests are built on the event loop thread and sent by the worker
+ * thread of the interface, each on its own netlink socket. APP requests
+ * keep a copy of their entries: the kernel stops at the first entry the
+ * driver rejects, so a failed batch is retried one entry at a time.
+ */
+struct ieee_hw_req {
+	char ifname[IFNAMSIZ];
 	struct nl_msg *nlm;
-	struct dcbmsg d = {
-			   .dcb_family = AF_UNSPEC,
-			   .cmd = DCB_CMD_IEEE_DEL,
-			   .dcb_pad = 0
-			  };
+	int cmd;			/* DCB_CMD_IEEE_SET or _DEL */
+	struct app_obj *app;		/* APP entries of the request */
+	int napp;
+	struct ieee_ets *ets;		/* ETS and PFC of the request */
+	struct ieee_pfc *pfc;
+	u64 ns;				/* Duration of request */
+};
+
+/*
+ * Wait for the reply to a set or delete request. The kernel returns the
+ * driver status in DCB_ATTR_IEEE, or an error message if it rejected the
+ * request. Returns 1 on success and a negative value on failure.
+ */
+static int ieee_hw_status(struct nl_sock *nlsocket)
+{
+	struct sockaddr_nl addr;
+	struct nlmsghdr *hdr;
+	struct nlattr *attr;
+	unsigned char *msg = NULL;
+	int err;
+
+	err = nl_recv(nlsocket, &addr, &msg, NULL);
+	if (err <= 0)
+		return -EIO;
+
+	hdr = (struct nlmsghdr *) msg;
+	if (!nlmsg_ok(hdr, err)) {
+		err = -EIO;
+	} else if (hdr->nlmsg_type == NLMSG_ERROR) {
+		struct nlmsgerr *nlerr = nlmsg_data(hdr);
+
+		err = nlerr->error ? nlerr->error : 1;
+	} else {
+		attr = nlmsg_find_attr(hdr, sizeof(struct dcbmsg),
+				       DCB_ATTR_IEEE);
+		err = (attr && nla_get_u8(attr)) ? -EIO : 1;
+	}
+	free(msg);
+	return err;
+}
+
+static int ieee_hw_send(void *arg)
+{
+	struct ieee_hw_req *req = arg;
+	struct nl_sock *nlsocket;
+	u64 start = stats_ns();
+	int err;
 
 	nlsocket = nl_socket_alloc();
 	if (!nlsocket) {
-		LLDPAD_WARN("%s: %s: nl_handle_alloc failed\n",
-			    __func__, ifname);
-		return -ENOMEM;
+		err = -ENOMEM;
+		goto out;
 	}
 	nl_socket_set_local_port(nlsocket, 0);
 
 	err = nl_connect(nlsocket, NETLINK_ROUTE);
-	if (err < 0) {
-		LLDPAD_WARN("%s: %s nlconnect failed abort hardware set, %s\n",
-			    __func__, ifname, nl_geterror(err));
+	if (err < 0)
 		err = -EIO;
-		goto out1;
-	}
+	else
+		err = nl_send_auto_complete(nlsocket, req->nlm);
+	if (err > 0)
+		err = ieee_hw_status(nlsocket);
+	nl_close(nlsocket);
+	nl_socket_free(nlsocket);
+out:
+	nlmsg_free(req->nlm);
+	req->ns = stats_ns() - start;
+	return err;
+}
 
-	nlm = nlmsg_alloc_simple(RTM_SETDCB, NLM_F_REQUEST);
-	if (!nlm) {
-		err = -ENOMEM;
-		goto out2;
+/*
+ * Return an APP entry the driver rejected to its pending state, so the
+ * next update of the port programs it again.
+ */
+static void ieee_app_pending(struct ieee8021qaz_tlvs *tlvs, int cmd,
+			     struct app_obj *app)
+{
+	u8 prio = app->app.priority;
+	u8 sel = app->app.selector;
+	u16 proto = app->app.protocol;
+	struct app_obj *np;
+
+	LLDPAD_DBG("%s: app %i %i %i stays pending\n", __func__,
+		   sel, proto, prio);
+	np = ieee8021qaz_find_app(tlvs, prio, sel, proto);
+	if (cmd == DCB_CMD_IEEE_SET) {
+		if (np && np->hw == IEEE_APP_DONE)
+			np->hw = IEEE_APP_SET;
+		return;
 	}
 
-	memset(&dest_addr, 0, sizeof(dest_addr));
-	dest_addr.nl_family = AF_NETLINK;
-	nlmsg_set_dst(nlm, &dest_addr);
+	/* Deleted entries are gone from the list, add it back */
+	if (!np && !ieee8021qaz_mod_app(tlvs, app->peer, prio, sel, proto, 0))
+		ieee8021qaz_mod_app(tlvs, app->peer, prio, sel, proto,
+				    op_delete);
+}
 
-	err = nlmsg_append(nlm, &d, sizeof(d), NLMSG_ALIGNTO);
-	if (err < 0)
-		goto out;
+static void ieee_hw_free(struct ieee_hw_req *req)
+{
+	free(req->app);
+	free(req->ets);
+	free(req->pfc);
+	free(req);
+}
 
-	err = nla_put(nlm, DCB_ATTR_IFNAME, strlen(ifname)+1, ifname);
-	if (err < 0)
-		goto out;
+static void ieee_hw_done(void *arg, int err)
+{
+	struct ieee_hw_req *req = arg;
+	struct ieee8021qaz_tlvs *tlvs;
+	int i;
 
-	ieee = nla_nest_start(nlm, DCB_ATTR_IEEE);
-	if (!ieee) {
-		err = -ENOMEM;
-		goto out;
-	}
-	if (app_data) {
-		app = nla_nest_start(nlm, DCB_ATTR_IEEE_APP_TABLE);
-		if (!app) {
-			err = -ENOMEM;
-			goto out;
+	modstats_hw(modstats_get(req->ifname, "ieee8021qaz"), req->ns,
+		    err <= 0);
+	tlvs = ieee8021qaz_data(req->ifname);
+	if (err > 0 && tlvs) {
+		/* Cache what the driver acknowledged */
+		if (req->ets) {
+			tlvs->hw_ets = *req->ets;
+			tlvs->hw_ets_valid = true;
+		}
+		if (req->pfc) {
+			tlvs->hw_pfc = *req->pfc;
+			tlvs->hw_pfc_valid = true;
+		}
+	} else if (err <= 0) {
+		LLDPAD_WARN("%s: %s 802.1Qaz set attributes failed %d\n",
+			    __func__, req->ifname, err);
+		if (req->napp > 1) {
+			/* Find the entries the driver rejects */
+			for (i = 0; i < req->napp; i++)
+				ieee_app_hw(req->ifname, req->cmd,
+					    &req->app[i], 1);
+		} else if (req->napp && tlvs) {
+			ieee_app_pending(tlvs, req->cmd, req->app);
+		} else if (tlvs) {
+			/* Hardware state unknown, set it again next time */
+			tlvs->hw_ets_valid = false;
+			tlvs->hw_pfc_valid = false;
 		}
-
-		err = nla_put(nlm, DCB_ATTR_IEEE_APP,
-			      sizeof(*app_data), app_data);
-		if (err < 0)
-			goto out;
-		nla_nest_end(nlm, app);
 	}
-	nla_nest_end(nlm, ieee);
-	err = nl_send_auto_complete(nlsocket, nlm);
-	if (err <= 0)
-		LLDPAD_WARN("%s: %s 802.1Qaz set attributes failed\n",
-			    __func__, ifname);
+	ieee_hw_free(req);
+}
 
-out:
-	nlmsg_free(nlm);
-out2:
-	nl_close(nlsocket);
-	nl_socket_free(nlsocket);
-out1:
-	return err;
+/*
+ * Allocate a request with command cmd for interface ifname, with room
+ * for napp APP entries. Returns NULL on failure.
+ */
+static struct ieee_hw_req *ieee_hw_req(const char *ifname, int cmd, int napp)
+{
+	struct ieee_hw_req *req = calloc(1, sizeof(*req));
 
+	if (!req)
+		return NULL;
+	if (napp) {
+		req->app = calloc(napp, sizeof(*req->app));
+		if (!req->app) {
+			free(req);
+			return NULL;
+		}
+	}
+	strncpy(req->ifname, ifname, sizeof(req->ifname) - 1);
+	req->cmd = cmd;
+	req->napp = napp;
+	return req;
+}
 
+/*
+ * Queue request req with message nlm for the worker thread of the
+ * interface.
+ */
+static int ieee_hw_submit(struct ieee_hw_req *req, struct nl_msg *nlm)
+{
+	req->nlm = nlm;
+	worker_submit(req->ifname, ieee_hw_send, ieee_hw_done, req);
+	return 0;
 }
 
-static int set_ieee_hw(const char *ifname, struct ieee_ets *ets_data,
-		       struct ieee_pfc *pfc_data, struct dcb_app *app_data)
+/*
+ * Allocate a request with command cmd for interface ifname and open the
+ * IEEE attribute nest. Returns NULL on failure.
+ */
+static struct nl_msg *ieee_hw_msg(const char *ifname, int cmd,
+				  struct nlattr **ieee)
 {
-	int err = 0;
-	struct nlattr *ieee, *app;
 	struct sockaddr_nl dest_addr;
-	struct nl_sock *nlsocket;
 	struct nl_msg *nlm;
 	struct dcbmsg d = {
 			   .dcb_family = AF_UNSPEC,
-			   .cmd = DCB_CMD_IEEE_SET,
+			   .cmd = cmd,
 			   .dcb_pad = 0
 			  };
 
-	nlsocket = nl_socket_alloc();
-	if (!nlsocket) {
-		LLDPAD_WARN("%s: %s: nl_handle_alloc failed\n",
-			    __func__, ifname);
+	nlm = nlmsg_alloc_simple(RTM_SETDCB, NLM_F_REQUEST);
+	if (!nlm)
+		return NULL;
+
+	memset(&dest_addr, 0, sizeof(dest_addr));
+	dest_addr.nl_family = AF_NETLINK;
+	nlmsg_set_dst(nlm, &dest_addr);
+
+	if (nlmsg_append(nlm, &d, sizeof(d), NLMSG_ALIGNTO) < 0 ||
+	    nla_put(nlm, DCB_ATTR_IFNAME, strlen(ifname)+1, ifname) < 0)
+		goto out;
+
+	*ieee = nla_nest_start(nlm, DCB_ATTR_IEEE);
+	if (*ieee)
+		return nlm;
+out:
+	nlmsg_free(nlm);
+	return NULL;
+}
+
+/*
+ * Send the APP entries app[0] to app[napp - 1] to the driver with command
+ * cmd, either DCB_CMD_IEEE_SET or DCB_CMD_IEEE_DEL.
+ */
+static int ieee_app_hw(const char *ifname, int cmd, struct app_obj *app,
+		       int napp)
+{
+	struct ieee_hw_req *req;
+	struct nlattr *ieee;
+	struct nl_msg *nlm;
+	int err;
+
+	req = ieee_hw_req(ifname, cmd, napp);
+	if (!req)
 		return -ENOMEM;
-	}
-	nl_socket_set_local_port(nlsocket, 0);
+	memcpy(req->app, app, napp * sizeof(*app));
 
-	if (!ets_data && !pfc_data && !app_data) {
-		err = 0;
-		goto out1;
+	nlm = ieee_hw_msg(ifname, cmd, &ieee);
+	if (!nlm) {
+		LLDPAD_WARN("%s: %s: nlmsg_alloc failed\n", __func__, ifname);
+		ieee_hw_free(req);
+		return -ENOMEM;
 	}
+	err = put_ieee_apps(nlm, app, napp);
+	if (err < 0) {
+		nlmsg_free(nlm);
+		ieee_hw_free(req);
+		return err;
+	}
+	nla_nest_end(nlm, ieee);
+	return ieee_hw_submit(req, nlm);
+}
+
+static int set_ieee_hw(const char *ifname, struct ieee_ets *ets_data,
+		       struct ieee_pfc *pfc_data)
+{
+	int err = -ENOMEM;
+	struct ieee_hw_req *req;
+	struct nlattr *ieee;
+	struct nl_msg *nlm;
+
+	if (!ets_data && !pfc_data)
+		return 0;
 
 #ifdef LLDPAD_8021QAZ_DEBUG
 	if (ets_data)
@@ -1062,36 +1277,26 @@ static int set_ieee_hw(const char *ifname, struct ieee_ets *ets_data,
 		print_pfc(pfc_data);
 #endif
 
-	err = nl_connect(nlsocket, NETLINK_ROUTE);
-	if (err < 0) {
-		LLDPAD_WARN("%s: %s nlconnect failed abort hardware set, %s\n",
-			    __func__, ifname, nl_geterror(err));
-		err = -EIO;
-		goto out1;
+	req = ieee_hw_req(ifname, DCB_CMD_IEEE_SET, 0);
+	if (!req)
+		return -ENOMEM;
+	if (ets_data) {
+		req->ets = malloc(sizeof(*req->ets));
+		if (!req->ets)
+			goto out_req;
+		*req->ets = *ets_data;
 	}
-
-	nlm = nlmsg_alloc_simple(RTM_SETDCB, NLM_F_REQUEST);
-	if (!nlm) {
-		err = -ENOMEM;
-		goto out2;
+	if (pfc_data) {
+		req->pfc = malloc(sizeof(*req->pfc));
+		if (!req->pfc)
+			goto out_req;
+		*req->pfc = *pfc_data;
 	}
 
-	memset(&dest_addr, 0, sizeof(dest_addr));
-	dest_addr.nl_family = AF_NETLINK;
-	nlmsg_set_dst(nlm, &dest_addr);
-
-	err = nlmsg_append(nlm, &d, sizeof(d), NLMSG_ALIGNTO);
-	if (err < 0)
-		goto out;
-
-	err = nla_put(nlm, DCB_ATTR_IFNAME, strlen(ifname)+1, ifname);
-	if (err < 0)
-		goto out;
-
-	ieee = nla_nest_start(nlm, DCB_ATTR_IEEE);
-	if (!ieee) {
-		err = -ENOMEM;
-		goto out;
+	nlm = ieee_hw_msg(ifname, DCB_CMD_IEEE_SET, &ieee);
+	if (!nlm) {
+		LLDPAD_WARN("%s: %s: nlmsg_alloc failed\n", __func__, ifname);
+		goto out_req;
 	}
 
 	if (ets_data) {
@@ -1107,31 +1312,13 @@ static int set_ieee_hw(const char *ifname, struct ieee_ets *ets_data,
 		if (err < 0)
 			goto out;
 	}
-	if (app_data) {
-		app = nla_nest_start(nlm, DCB_ATTR_IEEE_APP_TABLE);
-		if (!app) {
-			err = -ENOMEM;
-			goto out;
-		}
-
-		err = nla_put(nlm, DCB_ATTR_IEEE_APP,
-			      sizeof(*app_data), app_data);
-		if (err < 0)
-			goto out;
-		nla_nest_end(nlm, app);
-	}
 	nla_nest_end(nlm, ieee);
-	err = nl_send_auto_complete(nlsocket, nlm);
-	if (err <= 0)
-		LLDPAD_WARN("%s: %s 802.1Qaz set attributes failed\n",
-			    __func__, ifname);
+	return ieee_hw_submit(req, nlm);
 
 out:
 	nlmsg_free(nlm);
-out2:
-	nl_close(nlsocket);
-	nl_socket_free(nlsocket);
-out1:
+out_req:
+	ieee_hw_free(req);
 	return err;
 }
 
@@ -1175,11 +1362,25 @@ static void ets_rec_to_ieee(struct ieee_ets *ieee, struct etsrec_obj *rec)
 	return;
 }
 
+/*
+ * Clear the ETS and PFC settings which equal those the driver acknowledged
+ * last. The drivers reset their queues on each request, and the state
+ * machines run for every LLDPDU sent.
+ */
+static void ieee_hw_filter(struct ieee8021qaz_tlvs *tlvs,
+			   struct ieee_ets **ets, struct ieee_pfc **pfc)
+{
+	if (tlvs->hw_ets_valid && !memcmp(&tlvs->hw_ets, *ets, sizeof(**ets)))
+		*ets = NULL;
+	if (tlvs->hw_pfc_valid && !memcmp(&tlvs->hw_pfc, *pfc, sizeof(**pfc)))
+		*pfc = NULL;
+}
+
 void run_all_sm(struct port *port, struct lldp_agent *agent)
 {
 	struct ieee8021qaz_tlvs *tlvs;
-	struct ieee_ets *ets;
-	struct ieee_pfc *pfc;
+	struct ieee_ets *ets, *set_ets;
+	struct ieee_pfc *pfc, *set_pfc;
 	struct pfc_obj *pfc_obj;
 
 	if (agent->type != NEAREST_BRIDGE)
@@ -1188,6 +1389,7 @@ void run_all_sm(struct port *port, struct lldp_agent *agent)
 	tlvs = ieee8021qaz_data(port->ifname);
 	if (!tlvs)
 		return;
+	ieee8021qaz_probe(tlvs);
 
 	ets_sm(tlvs->ets->cfgl, tlvs->ets->recr, &tlvs->ets->current_state);
 
@@ -1228,7 +1430,10 @@ void run_all_sm(struct port *port, struct lldp_agent *agent)
 	if (ieee8021qaz_check_active(port->ifname)) {
 		set_dcbx_mode(port->ifname,
 			      DCB_CAP_DCBX_VER_IEEE | DCB_CAP_DCBX_HOST);
-		set_ieee_hw(port->ifname, ets, pfc, NULL);
+		set_ets = ets;
+		set_pfc = pfc;
+		ieee_hw_filter(tlvs, &set_ets, &set_pfc);
+		set_ieee_hw(port->ifname, set_ets, set_pfc);
 		ieee8021qaz_app_sethw(port->ifname, &tlvs->app_head);
 	}
 
@@ -1757,22 +1962,40 @@ static void process_ieee8021qaz_pfc_tlv(struct port *port)
 	tlvs->pfc->remote_param = true;
 }
 
-int ieee8021qaz_mod_app(struct app_tlv_head *head, int peer,
+static struct app_hash_head *app_hash(struct ieee8021qaz_tlvs *tlvs,
+				       u8 prio, u8 sel, u16 proto)
+{
+	unsigned int h = proto ^ (proto >> 8) ^ (sel << 3) ^ prio;
+
+	return &tlvs->app_hash[h & (IEEE_APP_HASH - 1)];
+}
+
+static struct app_obj *ieee8021qaz_find_app(struct ieee8021qaz_tlvs *tlvs,
+					    u8 prio, u8 sel, u16 proto)
+{
+	struct app_obj *np;
+
+	LIST_FOREACH(np, app_hash(tlvs, prio, sel, proto), hash)
+		if (np->app.selector == sel &&
+		    np->app.protocol == proto &&
+		    np->app.priority == prio)
+			break;
+	return np;
+}
+
+int ieee8021qaz_mod_app(struct ieee8021qaz_tlvs *tlvs, int peer,
 			u8 prio, u8 sel, u16 proto, u32 ops)
 {
 	struct app_obj *np;
 
-	/* Search list for existing match and abort
+	/* Search for existing match and abort
 	 * Mark entry for deletion if delete option supplied
 	 */
-	LIST_FOREACH(np, head, entry) {
-		if (np->app.selector == sel &&
-		    np->app.protocol == proto &&
-		    np->app.priority == prio) {
-			if (ops & op_delete)
-				np->hw = IEEE_APP_DEL;
-			return 1;
-		}
+	np = ieee8021qaz_find_app(tlvs, prio, sel, proto);
+	if (np) {
+		if (ops & op_delete)
+			np->hw = IEEE_APP_DEL;
+		return 1;
 	}
 
 	if (ops & op_delete)
@@ -1791,7 +2014,8 @@ int ieee8021qaz_mod_app(struct app_tlv_head *head, int peer,
 	np->app.selector = sel;
 	np->app.protocol = proto;
 
-	LIST_INSERT_HEAD(head, np, entry);
+	LIST_INSERT_HEAD(&tlvs->app_head, np, entry);
+	LIST_INSERT_HEAD(app_hash(tlvs, prio, sel, proto), np, hash);
 	return 0;
 }
 
@@ -1805,30 +2029,57 @@ static void ieee8021qaz_app_reset(struct app_tlv_head *head)
 	}
 }
 
+/*
+ * Program all pending APP changes of a port with one set and one delete
+ * request. Entries the driver rejects go back to their pending state in
+ * ieee_hw_done().
+ */
 static int __ieee8021qaz_app_sethw(char *ifname, struct app_tlv_head *head)
 {
-	struct app_obj *np, *np_tmp;
-	int set = 0;
+	struct app_obj *np, *np_tmp, *app;
+	int set = 0, cnt = 0, nset = 0, ndel;
+
+	LIST_FOREACH(np, head, entry)
+		cnt++;
+	if (!cnt)
+		return 0;
+	app = malloc(cnt * sizeof(*app));
+	if (!app)
+		return -ENOMEM;
 
+	/* Set entries fill the array from the front, deletes from the back */
+	ndel = cnt;
 	LIST_FOREACH(np, head, entry) {
-		if (np->hw != IEEE_APP_SET)
-			continue;
-		set = set_ieee_hw(ifname, NULL, NULL, &np->app);
-		np->hw = IEEE_APP_DONE;
+		if (np->hw == IEEE_APP_SET)
+			app[nset++] = *np;
+		else if (np->hw == IEEE_APP_DEL)
+			app[--ndel] = *np;
+	}
+
+	if (nset) {
+		set = ieee_app_hw(ifname, DCB_CMD_IEEE_SET, app, nset);
+		LIST_FOREACH(np, head, entry)
+			if (np->hw == IEEE_APP_SET)
+				np->hw = IEEE_APP_DONE;
 	}
 
+	if (ndel == cnt)
+		goto out;
+	set = ieee_app_hw(ifname, DCB_CMD_IEEE_DEL, app + ndel, cnt - ndel);
 	np = LIST_FIRST(head);
 	while (np) {
 		if (np->hw == IEEE_APP_DEL) {
 			np_tmp = np;
 			np = LIST_NEXT(np, entry);
 			LIST_REMOVE(np_tmp, entry);
-			set = del_ieee_hw(ifname, &np_tmp->app);
+			LIST_REMOVE(np_tmp, hash);
 			free(np_tmp);
 		} else {
 			np = LIST_NEXT(np, entry);
 		}
 	}
+out:
+	free(app);
 	return set;
 }
 
@@ -1854,27 +2105,17 @@ static void process_ieee8021qaz_app_tlv(struct port *port)
 
 	while (offset < tlvs->rx->app->length) {
 		struct app_obj *np;
-		int set = 0;
 		u8 prio  = (tlvs->rx->app->info[offset] & 0xE0) >> 5;
 		u8 sel = (tlvs->rx->app->info[offset] & 0x07);
 		u16 proto = (tlvs->rx->app->info[offset + 1] << 8) |
 			     tlvs->rx->app->info[offset + 2];
 
-		/* Search list for existing match and mark set */
-		LIST_FOREACH(np, &tlvs->app_head, entry) {
-			if (np->app.selector == sel &&
-			    np->app.protocol == proto &&
-			    np->app.priority == prio) {
-				np->hw = IEEE_APP_SET;
-				set = 1;
-				break;
-			}
-		}
-
-		/* If APP data not found in LIST add APP entry */
-		if (!set)
-			ieee8021qaz_mod_app(&tlvs->app_head, 1,
-					    prio, sel, proto, 0);
+		/* Search for existing match and mark set */
+		np = ieee8021qaz_find_app(tlvs, prio, sel, proto);
+		if (np)
+			np->hw = IEEE_APP_SET;
+		else	/* If APP data not found add APP entry */
+			ieee8021qaz_mod_app(tlvs, 1, prio, sel, proto, 0);
 		offset += 3;
 	}
 }
@@ -2161,7 +2402,7 @@ void ieee8021qaz_ifdown(char *device_name, struct lldp_agent *agent)
 
 	ieee8021qaz_free_rx(tlvs->rx);
 	free(tlvs->rx);
-	tlvs->rx = NULL;
+	tlvs->rx = NULL;	forget_dcbx_mode(device_name);
 }
 
 /*
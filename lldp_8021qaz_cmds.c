@@ -448,6 +448,7 @@ _set_arg_up2tc(struct cmd *cmd, char *args, const char *arg_value,
 	switch (cmd->tlvid) {
 	case (OUI_IEEE_8021 << 8) | LLDP_8021QAZ_ETSCFG:
 		if (tlvs) {
+			ieee8021qaz_probe(tlvs);
 			pmap = &tlvs->ets->cfgl->prio_map;
 			max = tlvs->ets->cfgl->max_tcs;
 		}
@@ -1357,7 +1358,7 @@ static int _set_arg_app(struct cmd *cmd, char *args, char *arg_value,
 	if (!tlvs)
 		goto write_app_config;
 
-	ieee8021qaz_mod_app(&tlvs->app_head, 0, (u8) prio, (u8) sel, (u16) pid,
+	ieee8021qaz_mod_app(tlvs, 0, (u8) prio, (u8) sel, (u16) pid,
 		(cmd->ops & op_delete) ? op_delete : 0);
 	ieee8021qaz_app_sethw(cmd->ifname, &tlvs->app_head);
 
@@ -39,7 +39,6 @@
 #include "lldp_8023_clif.h"
 #include "lldp_8023_cmds.h"
 
-extern struct lldp_head lldp_head;
 
 struct tlv_info_8023_maccfg {
 	u8 oui[3];
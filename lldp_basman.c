@@ -41,6 +41,7 @@
 #include "lldp_mand_clif.h"
 #include "lldp_basman_cmds.h"
 #include "lldp_util.h"
+#include "hostinfo.h"
 
 #define SYSNAME_DEFAULT "localhost"
 
@@ -75,7 +76,6 @@ struct tlv_info_manaddr {
 	struct tlv_info_maoid o;
 } __attribute__ ((__packed__));
 
-extern struct lldp_head lldp_head;
 
 static const struct lldp_mod_ops basman_ops =  {
 	.lldp_mod_register 	= basman_register,
@@ -326,8 +326,8 @@ static int basman_bld_syscaps_tlv(struct basman_data *bd,
 				   &syscaps, sizeof(syscaps))) {
 		LLDPAD_DBG("%s:%s:Build System Caps from scratch\n",
 			__func__, bd->ifname);
-		syscaps[0] = htons(get_caps(bd->ifname));
-		syscaps[1] = (is_active(bd->ifname)) ? syscaps[0] : 0;
+		syscaps[0] = htons(hostinfo_caps(bd->ifname));
+		syscaps[1] = (hostinfo_active(bd->ifname)) ? syscaps[0] : 0;
 	}
 
 	tlv = create_tlv();
@@ -422,8 +422,8 @@ static int basman_get_manaddr_sub(struct basman_data *bd,
 
 out_bld:
 	/* failed to get from config, so build from scratch */
-	if (get_addr(bd->ifname, domain, &m->a)) {
-		LLDPAD_DBG("%s:%s:get_addr() for domain %d failed\n",
+	if (hostinfo_addr(bd->ifname, domain, &m->a)) {
+		LLDPAD_DBG("%s:%s:hostinfo_addr() for domain %d failed\n",
 			__func__, bd->ifname, domain);
 		goto out_err;
 	}
@@ -53,7 +53,7 @@
 #include "lldpad_shm.h"
 #include "dcb_driver_interface.h"
 
-extern u8 gdcbx_subtype;
+extern __thread u8 gdcbx_subtype;
 
 void dcbx_free_tlv(struct dcbx_tlvs *tlvs);
 static int dcbx_check_operstate(struct port *port, struct lldp_agent *agent);
@@ -111,8 +111,8 @@ static int dcbx_check_operstate(struct port *port, struct lldp_agent *agent)
 			pfc_data.protocol.OperMode,
 			app_data.protocol.OperMode);
 		tlvs->operup = true;
-		if (get_operstate(port->ifname) != IF_OPER_UP)
-			set_operstate(port->ifname, IF_OPER_UP);
+		if (get_hw_operstate(port->ifname) != IF_OPER_UP)
+			set_hw_operstate(port->ifname, IF_OPER_UP);
 		else
 			set_hw_all(port->ifname);
 	}
@@ -120,7 +120,7 @@ static int dcbx_check_operstate(struct port *port, struct lldp_agent *agent)
 	return 0;
 
 err_out:
-	set_operstate(port->ifname, IF_OPER_UP);
+	set_hw_operstate(port->ifname, IF_OPER_UP);
 	return -1;
 }
 
@@ -491,6 +491,7 @@ void dcbx_ifup(char *ifname, struct lldp_agent *agent)
 	struct dcbx_manifest *manifest;
 	feature_support dcb_support;
 	int dcb_enable, exists;
+	int have_caps = 0;
 	int adminstatus;
 	int enabletx;
 	char arg_path[256];
@@ -530,6 +531,7 @@ void dcbx_ifup(char *ifname, struct lldp_agent *agent)
 	get_dcb_capabilities(ifname, &dcb_support);
 	if (dcb_support.dcbx && !(dcb_support.dcbx & DCB_CAP_DCBX_HOST))
 		return;
+	have_caps = 1;
 
 	/* if no adminStatus setting default to enabled for DCBX */
 	ret = get_config_setting(ifname, agent->type,
@@ -609,9 +611,11 @@ initialized:
 	 * query, then the kernel is older and does not support
 	 * IEEE mode, lacking any specified behavior in the cfg
 	 * file DCBX is put in a default mode and will be enabled
-	 * if a peer DCBX TLV is received.
+	 * if a peer DCBX TLV is received. The capabilities were already
+	 * queried when the port is new.
 	 */
-	get_dcb_capabilities(ifname, &dcb_support);
+	if (!have_caps)
+		get_dcb_capabilities(ifname, &dcb_support);
 	get_dcb_enable_state(ifname, &dcb_enable);
 
 	if ((dcb_enable != LLDP_DCBX_DISABLED) &&
@@ -626,7 +630,7 @@ initialized:
 		tlvs->active = false;
 	}
 
-	if (tlvs->active && (get_operstate(ifname) == IF_OPER_UP))
+	if (tlvs->active && (get_hw_operstate(ifname) == IF_OPER_UP))
 		set_hw_all(ifname);
 
 	return;
@@ -650,6 +654,7 @@ void dcbx_ifdown(char *device_name, struct lldp_agent *agent)
 	/* remove dcb port */
 	if (check_port_dcb_mode(device_name))
 		dcbx_remove_adapter(device_name);
+	forget_dcbx_mode(device_name);
 
 	LIST_REMOVE(tlvs, entry);
 	dcbx_free_tlv(tlvs);
@@ -297,7 +297,7 @@ set_error:
 	return NULL;
 }
 
-int dcbx_default_cfg_file(void)
+static int _dcbx_default_cfg_file(void)
 {
 	config_setting_t *root_setting = NULL;
 	config_setting_t *dcbx_setting = NULL;
@@ -323,7 +323,7 @@ int dcbx_default_cfg_file(void)
 	if (!tmp_setting || !config_setting_set_int(tmp_setting, DCBX_SUBTYPE2))
 		goto error;
 
-	config_write_file(&lldpad_cfg, cfg_file_name);
+	write_cfg();
 
 	return 0;
 error:
@@ -331,6 +331,16 @@ error:
 	return 1;
 }
 
+int dcbx_default_cfg_file(void)
+{
+	int rc;
+
+	cfg_lock();
+	rc = _dcbx_default_cfg_file();
+	cfg_unlock();
+	return rc;
+}
+
 void cfg_fixup(config_setting_t *eth_settings)
 {
 	config_setting_t *setting = NULL;
@@ -693,7 +703,7 @@ static int _set_persistent(char *device_name, int dcb_enable,
 	}
 
 
-	config_write_file(&lldpad_cfg, cfg_file_name);
+	write_cfg();
 
 	return 0;
 
@@ -731,31 +741,42 @@ static int get_default_persistent(const char *ifname, full_dcb_attribs *attribs)
 
 int save_dcb_enable_state(char *device_name, int dcb_enable)
 {
-	return _set_persistent(device_name, dcb_enable, NULL, NULL, NULL, NULL, 
-				0, NULL, 0);
+	int rc;
+
+	cfg_lock();
+	rc = _set_persistent(device_name, dcb_enable, NULL, NULL, NULL, NULL,
+			     0, NULL, 0);
+	cfg_unlock();
+	return rc;
 }
 
 int save_dcbx_version(int dcbx_version)
 {
 	config_setting_t *dcbx_setting;
 	config_setting_t *setting;
+	int rc = 1;
 
+	cfg_lock();
 	dcbx_setting = config_lookup(&lldpad_cfg, DCBX_SETTING);
 	if (!dcbx_setting)
-		return 1;
+		goto out;
 
 	setting = config_setting_get_member(dcbx_setting, "dcbx_version");
-	if (!setting || !config_setting_set_int(setting, dcbx_version) ||
-		!config_write_file(&lldpad_cfg, cfg_file_name))
-		return 1;
-
-	return 0;
+	if (setting && config_setting_set_int(setting, dcbx_version) &&
+		write_cfg())
+		rc = 0;
+out:
+	cfg_unlock();
+	return rc;
 }
 
 int set_persistent(char *device_name, full_dcb_attrib_ptrs *attribs)
 {
 	int enabled = 0;
-	int not_present = get_dcb_enable_state(device_name, &enabled);
+	int not_present, rc;
+
+	cfg_lock();
+	not_present = get_dcb_enable_state(device_name, &enabled);
 
 	/* When the 'dcb_enable' config param does not exist put DCBX
 	 * into DEFAULT mode. This will cause DCBX to be enabled when
@@ -764,13 +785,15 @@ int set_persistent(char *device_name, full_dcb_attrib_ptrs *attribs)
 	if (not_present)
 		enabled = LLDP_DCBX_DEFAULT;
 
-	return _set_persistent(device_name, enabled, attribs->pg, attribs->pfc,
-			attribs->pgid, attribs->app, attribs->app_subtype, 
+	rc = _set_persistent(device_name, enabled, attribs->pg, attribs->pfc,
+			attribs->pgid, attribs->app, attribs->app_subtype,
 			attribs->llink, LLINK_FCOE_STYPE);
+	cfg_unlock();
+	return rc;
 }
 
 
-int get_persistent(char *device_name, full_dcb_attribs *attribs)
+static int _get_persistent(char *device_name, full_dcb_attribs *attribs)
 {
 	config_setting_t *dcbx_setting = NULL;
 	config_setting_t *eth_settings = NULL;
@@ -1059,6 +1082,16 @@ set_default:
 	return result;
 }
 
+int get_persistent(char *device_name, full_dcb_attribs *attribs)
+{
+	int rc;
+
+	cfg_lock();
+	rc = _get_persistent(device_name, attribs);
+	cfg_unlock();
+	return rc;
+}
+
 /*
  * get_dcb_enable_state - check config for dcb_enable
  * @ifname: the port name
@@ -1074,6 +1107,7 @@ int get_dcb_enable_state(char *ifname, int *result)
 
 	memset(path, 0, sizeof(path));
 	snprintf(path, sizeof(path), "%s.%s.dcb_enable", DCBX_SETTING, ifname);
+	cfg_lock();
 	settings = config_lookup(&lldpad_cfg, path);
 	if (!settings) {
 		LLDPAD_INFO("### %s:%s:failed on %s\n", __func__, ifname, path);
@@ -1088,6 +1122,7 @@ int get_dcb_enable_state(char *ifname, int *result)
 	*result = (int)config_setting_get_int(settings);
 	rc = 0;
 out_err:
+	cfg_unlock();
 	return rc;
 }
 
@@ -1096,6 +1131,7 @@ int get_dcbx_version(int *result)
 	config_setting_t *dcbx_setting = NULL;
 	int rval = 0;
 
+	cfg_lock();
 	dcbx_setting = config_lookup(&lldpad_cfg, DCBX_SETTING);
 	if (!dcbx_setting) {
 		create_default_cfg_file();
@@ -1115,6 +1151,7 @@ int get_dcbx_version(int *result)
 		}
 	}
 
+	cfg_unlock();
 	return rval;
 }
 
@@ -45,7 +45,7 @@
 #include "messages.h"
 #include "lldp_util.h"
 
-extern u8 gdcbx_subtype;
+extern __thread u8 gdcbx_subtype;
 
 static char *hexlist = "0123456789abcdef";
 static char *hexlistcaps = "0123456789ABCDEF";
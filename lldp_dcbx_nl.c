@@ -47,9 +47,11 @@
 #include "messages.h"
 #include "lldp_rtnl.h"
 #include "lldp/ports.h"
+#include "lldp/stats.h"
+#include "worker.h"
 
-static int nl_sd = 0;
-static int rtseq = 0;
+static __thread int nl_sd = 0;
+static __thread int rtseq = 0;
 
 static int next_rtseq(void)
 {
@@ -148,7 +150,7 @@ static struct rtattr *add_rta(struct nlmsghdr *nlh, __u16 rta_type,
 }
 
 /* free's nlh which was allocated by start_msg */
-static int send_msg(struct nlmsghdr *nlh)
+static int send_msg(int sd, struct nlmsghdr *nlh)
 {
 	struct sockaddr_nl nladdr;
 	void *buf = (void *)nlh;
@@ -161,7 +163,7 @@ static int send_msg(struct nlmsghdr *nlh)
 	nladdr.nl_family = AF_NETLINK;
 	
 	do {
-		r = sendto(nl_sd, buf, len, 0, (struct sockaddr *)&nladdr,
+		r = sendto(sd, buf, len, 0, (struct sockaddr *)&nladdr,
 			sizeof(nladdr));
 		LLDPAD_DBG("send_msg: sendto = %d\n", r);
 
@@ -175,7 +177,7 @@ static int send_msg(struct nlmsghdr *nlh)
 		return 0;
 }
 
-static struct nlmsghdr *get_msg(unsigned int seq)
+static struct nlmsghdr *get_msg(int sd, unsigned int seq)
 {
 	struct nlmsghdr *nlh;
 	unsigned len;
@@ -189,7 +191,7 @@ static struct nlmsghdr *get_msg(unsigned int seq)
 	memset(nlh, 0, MAX_MSG_SIZE);
 
 	while (!found) {
-		res = recv(nl_sd, (void *)nlh, MAX_MSG_SIZE, MSG_DONTWAIT);
+		res = recv(sd, (void *)nlh, MAX_MSG_SIZE, MSG_DONTWAIT);
 		if (res < 0) {
 			if (errno == EINTR)
 				continue;
@@ -224,14 +226,14 @@ static struct nlmsghdr *get_msg(unsigned int seq)
 	return nlh;
 }
 
-static int recv_msg(int cmd, int attr, unsigned int seq)
+static int recv_msg(int sd, int cmd, int attr, unsigned int seq)
 {
 	struct nlmsghdr *nlh;
 	struct dcbmsg *d;
 	struct rtattr *rta;
 	int rval;
 
-	nlh = get_msg(seq);
+	nlh = get_msg(sd, seq);
 
 	if (NULL == nlh)
 		return -EIO;
@@ -250,6 +252,87 @@ static int recv_msg(int cmd, int attr, unsigned int seq)
 	return rval;
 }
 
+/*
+ * Send a set request and wait for the reply. Count the request and its
+ * duration in the DCBX hardware programming counters of the interface.
+ */
+static int set_msg(char *ifname, struct nlmsghdr *nlh, int cmd, int attr)
+{
+	u64 start;
+	int seq = nlh->nlmsg_seq;
+	int rc;
+
+	worker_sync(ifname);
+	start = stats_ns();
+	rc = send_msg(nl_sd, nlh) ? -EIO : recv_msg(nl_sd, cmd, attr, seq);
+	modstats_hw(modstats_get(ifname, "dcbx"), stats_ns() - start, rc != 0);
+	return rc;
+}
+
+/*
+ * Set requests executed by a worker thread, each on its own netlink socket.
+ */
+struct dcb_req {
+	char ifname[IFNAMSIZ];
+	struct nlmsghdr *nlh;
+	int cmd;
+	int attr;
+	__u8 val;			/* Value of attr in the request */
+	u64 ns;				/* Duration of request */
+};
+
+static int dcb_req_run(void *arg)
+{
+	struct dcb_req *req = arg;
+	u64 start = stats_ns();
+	int seq = req->nlh->nlmsg_seq;
+	int sd, rc;
+
+	sd = init_socket();
+	if (sd < 0) {
+		free(req->nlh);
+		rc = -EIO;
+	} else {
+		rc = send_msg(sd, req->nlh) ? -EIO
+				: recv_msg(sd, req->cmd, req->attr, seq);
+		close(sd);
+	}
+	req->ns = stats_ns() - start;
+	return rc;
+}
+
+static void dcb_req_done(void *arg, int rc)
+{
+	struct dcb_req *req = arg;
+
+	if (rc)
+		LLDPAD_DBG("%s:%s command %d failed %d\n", __func__,
+			   req->ifname, req->cmd, rc);
+	modstats_hw(modstats_get(req->ifname, "dcbx"), req->ns, rc != 0);
+	free(req);
+}
+
+/*
+ * Queue a set request for the worker thread of the interface.
+ */
+static int dcb_req_submit(char *ifname, struct nlmsghdr *nlh, int cmd,
+			  int attr, __u8 val, worker_done_fn done)
+{
+	struct dcb_req *req = calloc(1, sizeof(*req));
+
+	if (!req) {
+		free(nlh);
+		return -ENOMEM;
+	}
+	strncpy(req->ifname, ifname, sizeof(req->ifname) - 1);
+	req->nlh = nlh;
+	req->cmd = cmd;
+	req->attr = attr;
+	req->val = val;
+	worker_submit(ifname, dcb_req_run, done, req);
+	return 0;
+}
+
 static int get_state(char *ifname, __u8 *state)
 {
 	struct nlmsghdr *nlh;
@@ -266,10 +349,11 @@ static int get_state(char *ifname, __u8 *state)
 	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 
-	if (send_msg(nlh))
+	worker_sync(ifname);
+	if (send_msg(nl_sd, nlh))
 		return -EIO;
 
-	nlh = get_msg(seq);
+	nlh = get_msg(nl_sd, seq);
 	if (NULL == nlh)
 		return -EIO;
 
@@ -294,20 +378,15 @@ static int get_state(char *ifname, __u8 *state)
 static int set_state(char *ifname, __u8 state)
 {
 	struct nlmsghdr *nlh;
-	int seq;
 
 	nlh = start_msg(RTM_SETDCB, DCB_CMD_SSTATE);
 	if (NULL == nlh)
 		return -EIO;
 
-	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 	add_rta(nlh, DCB_ATTR_STATE, (void *)&state, sizeof(__u8));
 
-	if (send_msg(nlh))
-		return -EIO;
-
-	return(recv_msg(DCB_CMD_SSTATE, DCB_ATTR_STATE, seq));
+	return set_msg(ifname, nlh, DCB_CMD_SSTATE, DCB_ATTR_STATE);
 }
 
 
@@ -319,14 +398,12 @@ static int set_pfc_cfg(char *ifname, __u8 *pfc)
 	struct nlmsghdr *nlh;
 	struct rtattr *rta_parent, *rta_child;
 	int i;
-	int seq;
 
 	LLDPAD_DBG("set_pfc_cfg: %s\n", ifname);
 	nlh = start_msg(RTM_SETDCB, DCB_CMD_PFC_SCFG);
 	if (NULL == nlh)
 		return -EIO;
 
-	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 	rta_parent = add_rta(nlh, DCB_ATTR_PFC_CFG, NULL, 0);
 	for (i = DCB_PFC_UP_ATTR_0; i < DCB_PFC_UP_ATTR_MAX; i++) {
@@ -335,10 +412,7 @@ static int set_pfc_cfg(char *ifname, __u8 *pfc)
 		pfc++;
 	}
 
-	if (send_msg(nlh))
-		return -EIO;
-
-	return(recv_msg(DCB_CMD_PFC_SCFG, DCB_ATTR_PFC_CFG, seq));
+	return set_msg(ifname, nlh, DCB_CMD_PFC_SCFG, DCB_ATTR_PFC_CFG);
 }
 
 /* returns: 0 on success
@@ -347,21 +421,16 @@ static int set_pfc_cfg(char *ifname, __u8 *pfc)
 static int set_pfc_state(char *ifname, __u8 state)
 {
 	struct nlmsghdr *nlh;
-	int seq;
 
 	LLDPAD_DBG("set_pfc_state: %s\n", ifname);
 	nlh = start_msg(RTM_SETDCB, DCB_CMD_PFC_SSTATE);
 	if (NULL == nlh)
 		return -EIO;
 
-	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 	add_rta(nlh, DCB_ATTR_PFC_STATE, (void *)&state, sizeof(__u8));
 
-	if (send_msg(nlh))
-		return -EIO;
-
-	return(recv_msg(DCB_CMD_PFC_SSTATE, DCB_ATTR_PFC_STATE, seq));
+	return set_msg(ifname, nlh, DCB_CMD_PFC_SSTATE, DCB_ATTR_PFC_STATE);
 	return 0;
 }
 /* returns: 0 on success
@@ -374,13 +443,11 @@ static int set_pg_cfg(char *ifname, struct tc_config *tc, __u8 *bwg, int cmd)
 	__u8 *p = (__u8 *)tc;
 	__u8 *b = (__u8 *)bwg;
 	int i, j;
-	int seq;
 
 	nlh = start_msg(RTM_SETDCB, cmd);
 	if (NULL == nlh)
 		return -EIO;
 
-	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 	class_parent = add_rta(nlh, DCB_ATTR_PG_CFG, NULL, 0);
 	for (i = DCB_PG_ATTR_TC_0; i < DCB_PG_ATTR_TC_MAX; i++) {
@@ -399,10 +466,7 @@ static int set_pg_cfg(char *ifname, struct tc_config *tc, __u8 *bwg, int cmd)
 		b++;
 	}
 
-	if (send_msg(nlh))
-		return -EIO;
-
-	return(recv_msg(cmd, DCB_ATTR_PG_CFG, seq));
+	return set_msg(ifname, nlh, cmd, DCB_ATTR_PG_CFG);
 }
 
 
@@ -436,23 +500,95 @@ int deinit_drv_if(void)
 }
 		
 
+/*
+ * DCBX mode the driver of an interface acknowledged last. The state
+ * machines request the mode on each run, it is sent only when it changes.
+ */
+struct dcbx_mode {
+	LIST_ENTRY(dcbx_mode) node;
+	char ifname[IFNAMSIZ];
+	__u8 mode;
+};
+
+#define	DCBX_MODE_HASH	64		/* Must be a power of 2 */
+
+static __thread LIST_HEAD(dcbx_mode_head, dcbx_mode)
+	dcbx_mode_hash[DCBX_MODE_HASH];
+
+static struct dcbx_mode_head *dcbx_mode_chain(const char *ifname)
+{
+	unsigned int h = 2166136261u;
+
+	while (*ifname)
+		h = (h ^ (unsigned char)*ifname++) * 16777619u;
+	return &dcbx_mode_hash[h & (DCBX_MODE_HASH - 1)];
+}
+
+static struct dcbx_mode *dcbx_mode_find(const char *ifname)
+{
+	struct dcbx_mode *dm;
+
+	LIST_FOREACH(dm, dcbx_mode_chain(ifname), node)
+		if (!strcmp(dm->ifname, ifname))
+			break;
+	return dm;
+}
+
+/*
+ * Forget the DCBX mode of an interface, the next set_dcbx_mode() call
+ * sends it to the driver again.
+ */
+void forget_dcbx_mode(const char *ifname)
+{
+	struct dcbx_mode *dm = dcbx_mode_find(ifname);
+
+	if (dm) {
+		LIST_REMOVE(dm, node);
+		free(dm);
+	}
+}
+
+static void set_dcbx_mode_done(void *arg, int rc)
+{
+	struct dcb_req *req = arg;
+	struct dcbx_mode *dm;
+
+	if (rc) {
+		forget_dcbx_mode(req->ifname);
+	} else {
+		dm = dcbx_mode_find(req->ifname);
+		if (!dm) {
+			dm = calloc(1, sizeof(*dm));
+			if (dm) {
+				strncpy(dm->ifname, req->ifname,
+					sizeof(dm->ifname) - 1);
+				LIST_INSERT_HEAD(dcbx_mode_chain(dm->ifname),
+						 dm, node);
+			}
+		}
+		if (dm)
+			dm->mode = req->val;
+	}
+	dcb_req_done(req, rc);
+}
+
 int set_dcbx_mode(char *ifname, __u8 mode)
 {
 	struct nlmsghdr *nlh;
-	int seq;
+	struct dcbx_mode *dm = dcbx_mode_find(ifname);
+
+	if (dm && dm->mode == mode)
+		return 0;
 
 	nlh = start_msg(RTM_SETDCB, DCB_CMD_SDCBX);
 	if (NULL == nlh)
 		return -EIO;
 
-	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 	add_rta(nlh, DCB_ATTR_DCBX, (void *)&mode, sizeof(__u8));
 
-	if (send_msg(nlh))
-		return -EIO;
-
-	return recv_msg(DCB_CMD_SDCBX, DCB_ATTR_DCBX, seq);
+	return dcb_req_submit(ifname, nlh, DCB_CMD_SDCBX, DCB_ATTR_DCBX, mode,
+			      set_dcbx_mode_done);
 }
 
 int get_dcb_capabilities(char *ifname,
@@ -481,10 +617,11 @@ int get_dcb_capabilities(char *ifname,
 	rta_child = add_rta(nlh, DCB_CAP_ATTR_ALL, NULL, 0);
 	rta_parent->rta_len += NLMSG_ALIGN(rta_child->rta_len);
 
-	if (send_msg(nlh))
+	worker_sync(ifname);
+	if (send_msg(nl_sd, nlh))
 		return -EIO;
 
-	nlh = get_msg(seq);
+	nlh = get_msg(nl_sd, seq);
 	if (!nlh)
 		return -EIO;
 
@@ -568,10 +705,11 @@ int get_dcb_numtcs(const char *ifname, u8 *pgtcs, u8 *pfctcs)
 	rta_child = add_rta(nlh, DCB_NUMTCS_ATTR_ALL, NULL, 0);
 	rta_parent->rta_len += NLMSG_ALIGN(rta_child->rta_len);
 
-	if (send_msg(nlh))
+	worker_sync(ifname);
+	if (send_msg(nl_sd, nlh))
 		return -EIO;
 
-	nlh = get_msg(seq);
+	nlh = get_msg(nl_sd, seq);
 	if (!nlh)
 		return -EIO;
 
@@ -645,6 +783,7 @@ int set_hw_state(char *ifname, int dcb_state)
 	int err;
 	int ifindex = get_ifidx(ifname);
 
+	worker_sync(ifname);
 	err = set_linkmode(ifindex, ifname, dcb_state);
 
 	if (err)
@@ -771,7 +910,6 @@ int set_hw_app(char *ifname, appgroup_attribs *app_data)
 {
 	struct nlmsghdr *nlh;
 	struct rtattr *rta_parent, *rta_child;
-	int seq;
 
 	LLDPAD_DBG("set_hw_app: %s\n", ifname);
 
@@ -779,7 +917,6 @@ int set_hw_app(char *ifname, appgroup_attribs *app_data)
 	if (NULL == nlh)
 		return -EIO;
 
-	seq = nlh->nlmsg_seq;
 	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
 	rta_parent = add_rta(nlh, DCB_ATTR_APP, NULL, 0);
 
@@ -795,10 +932,7 @@ int set_hw_app(char *ifname, appgroup_attribs *app_data)
 		(void *)&app_data->dcb_app_priority, sizeof(__u8));
 	rta_parent->rta_len += NLA_ALIGN(rta_child->rta_len);
 
-	if (send_msg(nlh))
-		return -EIO;
-
-	return(recv_msg(DCB_CMD_SAPP, DCB_ATTR_APP, seq));
+	return set_msg(ifname, nlh, DCB_CMD_SAPP, DCB_ATTR_APP);
 }
 
 int run_cmd(char *cmd, ...)
@@ -812,34 +946,80 @@ int run_cmd(char *cmd, ...)
 	return system(cbuf);
 }
 
-int set_hw_all(char *ifname)
+struct operstate_req {
+	char ifname[IFNAMSIZ];
+	__u8 operstate;
+};
+
+static int operstate_run(void *arg)
 {
-	struct nlmsghdr *nlh;
-	int status = 1; /* status is always true */
-	int retval = -EIO;
-	int seq;
+	struct operstate_req *req = arg;
 
-	nlh = start_msg(RTM_SETDCB, DCB_CMD_SET_ALL);
-	if (NULL == nlh)
-		return -EIO;
+	return set_operstate(req->ifname, req->operstate);
+}
 
-	seq = nlh->nlmsg_seq;
-	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
-	add_rta(nlh, DCB_ATTR_SET_ALL, (void *)&status, sizeof(__u8));
+static void operstate_done(void *arg, int rc)
+{
+	struct operstate_req *req = arg;
 
-	if (send_msg(nlh))
-		return -EIO;
+	if (rc < 0)
+		LLDPAD_DBG("%s:%s set operstate %d failed %d\n", __func__,
+			   req->ifname, req->operstate, rc);
+	free(req);
+}
+
+/*
+ * Queue a change of the operational state behind the pending DCB requests
+ * of the interface.
+ */
+int set_hw_operstate(char *ifname, __u8 operstate)
+{
+	struct operstate_req *req = calloc(1, sizeof(*req));
+
+	if (!req)
+		return -ENOMEM;
+	strncpy(req->ifname, ifname, sizeof(req->ifname) - 1);
+	req->operstate = operstate;
+	worker_submit(ifname, operstate_run, operstate_done, req);
+	return 0;
+}
+
+int get_hw_operstate(char *ifname)
+{
+	worker_sync(ifname);
+	return get_operstate(ifname);
+}
+
+static void set_hw_all_done(void *arg, int rc)
+{
+	struct dcb_req *req = arg;
 
-	retval = recv_msg(DCB_CMD_SET_ALL, DCB_ATTR_SET_ALL, seq);
+	modstats_hw(modstats_get(req->ifname, "dcbx"), req->ns, rc < 0);
 
 	/* driver will respond with 
 	 * 0 = hw config changes made - with link reset
 	 * 1 = no hw config changes were necessary
 	 * 2 = hw config changes made - with no link reset
 	*/
-	if (retval == 0)
-		set_port_hw_resetting(ifname, 1);
+	if (rc == 0)
+		set_port_hw_resetting(req->ifname, 1);
+	free(req);
+}
+
+int set_hw_all(char *ifname)
+{
+	struct nlmsghdr *nlh;
+	int status = 1; /* status is always true */
+
+	nlh = start_msg(RTM_SETDCB, DCB_CMD_SET_ALL);
+	if (NULL == nlh)
+		return -EIO;
+
+	add_rta(nlh, DCB_ATTR_IFNAME, (void *)ifname, strlen(ifname) + 1);
+	add_rta(nlh, DCB_ATTR_SET_ALL, (void *)&status, sizeof(__u8));
 
+	dcb_req_submit(ifname, nlh, DCB_CMD_SET_ALL, DCB_ATTR_SET_ALL, status,
+		       set_hw_all_done);
 	return 0;
 }
 
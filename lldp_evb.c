@@ -36,7 +36,6 @@
 #include "messages.h"
 #include "config.h"
 
-extern struct lldp_head lldp_head;
 
 struct evb_data *evb_data(char *ifname, enum agent_type type)
 {
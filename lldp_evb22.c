@@ -37,7 +37,6 @@
 #include "messages.h"
 #include "config.h"
 
-extern struct lldp_head lldp_head;
 
 struct evb22_data *evb22_data(char *ifname, enum agent_type type)
 {
@@ -42,7 +42,6 @@
 #include "lldp/l2_packet.h"
 #include "lldp_tlv.h"
 
-extern struct lldp_head lldp_head;
 
 static const struct lldp_mod_ops mand_ops = {
 	.lldp_mod_register 	= mand_register,
@@ -694,5 +693,6 @@ void mand_update_ttl(const char *ifname, u16 ttl_val)
 		agent->tx.txTTL = ttl_val;
 		agent->tx.localChange = 1;
 		agent->tx.txFast = agent->timers.txFastInit;
+		lldp_agent_kick(agent);
 	}
 }
@@ -48,6 +48,9 @@
 static int get_arg_adminstatus(struct cmd *, char *, char *, char *, int);
 static int set_arg_adminstatus(struct cmd *, char *, char *, char *, int);
 static int test_arg_adminstatus(struct cmd *, char *, char *, char *, int);
+static int get_arg_maxneighbors(struct cmd *, char *, char *, char *, int);
+static int set_arg_maxneighbors(struct cmd *, char *, char *, char *, int);
+static int test_arg_maxneighbors(struct cmd *, char *, char *, char *, int);
 static int get_arg_tlvtxenable(struct cmd *, char *, char *, char *, int);
 static int set_arg_tlvtxenable(struct cmd *, char *, char *, char *, int);
 static int handle_get_arg(struct cmd *, char *, char *, char *, int);
@@ -68,6 +71,10 @@ static struct arg_handlers arg_handlers[] = {
 		.handle_get = get_arg_adminstatus,
 		.handle_set = set_arg_adminstatus,
 		.handle_test = test_arg_adminstatus, },
+	{	.arg = ARG_MAXNEIGHBORS, .arg_class = LLDP_ARG,
+		.handle_get = get_arg_maxneighbors,
+		.handle_set = set_arg_maxneighbors,
+		.handle_test = test_arg_maxneighbors, },
 	{	.arg = ARG_TLVTXENABLE, .arg_class = TLV_ARG,
 		.handle_get = get_arg_tlvtxenable,
 		.handle_set = set_arg_tlvtxenable,
@@ -561,6 +568,66 @@ int set_arg_adminstatus(struct cmd *cmd, char *arg, char *argvalue,
 	return _set_arg_adminstatus(cmd, arg, argvalue, obuf, obuf_len, false);
 }
 
+static int get_arg_maxneighbors(struct cmd *cmd, char *arg,
+				UNUSED char *argvalue, char *obuf, int obuf_len)
+{
+	int value;
+	char string[8];
+
+	if (cmd->cmd != cmd_get_lldp || cmd->tlvid != INVALID_TLVID)
+		return cmd_bad_params;
+
+	if (get_config_setting(cmd->ifname, cmd->type, arg, &value,
+			       CONFIG_TYPE_INT))
+		value = NEIGH_MAX_DEFAULT;
+
+	snprintf(string, sizeof(string), "%d", value);
+	snprintf(obuf, obuf_len, "%02x%s%04x%s", (unsigned int)strlen(arg), arg,
+		 (unsigned int)strlen(string), string);
+	return cmd_success;
+}
+
+static int _set_arg_maxneighbors(struct cmd *cmd, char *arg, char *argvalue,
+				 char *obuf, int obuf_len, bool test)
+{
+	struct lldp_agent *agent;
+	int value;
+	char *end;
+
+	if (cmd->cmd != cmd_set_lldp || cmd->tlvid != INVALID_TLVID)
+		return cmd_bad_params;
+
+	value = strtol(argvalue, &end, 0);
+	if (*end || !*argvalue || value < 1 || value > NEIGH_MAX_LIMIT)
+		return cmd_bad_params;
+
+	if (test)
+		return cmd_success;
+
+	if (set_config_setting(cmd->ifname, cmd->type, arg, &value,
+			       CONFIG_TYPE_INT))
+		return cmd_failed;
+
+	agent = lldp_agent_find_by_type(cmd->ifname, cmd->type);
+	if (agent)
+		neigh_set_max(agent, value);
+
+	snprintf(obuf, obuf_len, "%s = %d\n", arg, value);
+	return cmd_success;
+}
+
+static int test_arg_maxneighbors(struct cmd *cmd, char *arg, char *argvalue,
+				 char *obuf, int obuf_len)
+{
+	return _set_arg_maxneighbors(cmd, arg, argvalue, obuf, obuf_len, true);
+}
+
+static int set_arg_maxneighbors(struct cmd *cmd, char *arg, char *argvalue,
+				char *obuf, int obuf_len)
+{
+	return _set_arg_maxneighbors(cmd, arg, argvalue, obuf, obuf_len, false);
+}
+
 int
 set_arg_tlvtxenable(struct cmd *cmd, UNUSED char *arg, UNUSED char *argvalue,
 		    UNUSED char *obuf, UNUSED int obuf_len)
@@ -644,11 +711,32 @@ int handle_set_arg(struct cmd *cmd, char *arg, char *argvalue,
 }
 
 
-int get_tlvs(struct cmd *cmd, char *rbuf, int rlen)
+/*
+ * Test and set an argument of an agent or TLV through the argument
+ * handlers of the modules, the way a client command would. Used to apply
+ * a reloaded configuration file.
+ * Returns cmd_success if a module accepted the argument.
+ */
+int mand_apply_arg(struct cmd *cmd, char *arg, char *argvalue, char *obuf,
+		   int obuf_len)
+{
+	int rc;
+
+	rc = handle_test_arg(cmd, arg, argvalue, obuf, obuf_len);
+	if (rc != cmd_success && rc != cmd_not_applicable)
+		return rc;
+	rc = handle_set_arg(cmd, arg, argvalue, obuf, obuf_len);
+	return rc == cmd_not_applicable ? cmd_bad_params : rc;
+}
+
+/*
+ * Copy the local or neighbor TLVs of an agent, only those with the
+ * requested TLV identifier if any. The index selects the neighbor.
+ */
+static int get_tlv_data(struct cmd *cmd, unsigned int nbr, u8 *tlvs,
+			int *psize)
 {
-	u8 tlvs[2048];
 	int size = 0;
-	int i;
 	u32 tlvid;
 	int off = 0;
 	int moff = 0;
@@ -660,11 +748,12 @@ int get_tlvs(struct cmd *cmd, char *rbuf, int rlen)
 	    && cmd->type != NEAREST_CUSTOMER_BRIDGE)
 		return cmd_agent_not_supported;
 	if (cmd->ops & op_local) {
-		res = get_local_tlvs(cmd->ifname, cmd->type, &tlvs[0], &size);
+		res = get_local_tlvs(cmd->ifname, cmd->type, tlvs, &size);
 		if (res)
 			return res;
 	} else if (cmd->ops & op_neighbor) {
-		res = get_neighbor_tlvs(cmd->ifname, cmd->type, &tlvs[0], &size);
+		res = get_neighbor_tlvs(cmd->ifname, cmd->type, nbr, tlvs,
+					&size);
 		if (res)
 			return res;
 	} else
@@ -694,6 +783,19 @@ int get_tlvs(struct cmd *cmd, char *rbuf, int rlen)
 		}
 		size = moff;
 	}
+	*psize = size;
+	return cmd_success;
+}
+
+int get_tlvs(struct cmd *cmd, unsigned int nbr, char *rbuf, int rlen)
+{
+	u8 tlvs[2048];
+	int size = 0;
+	int i, res;
+
+	res = get_tlv_data(cmd, nbr, tlvs, &size);
+	if (res)
+		return res;
 
 	for (i = 0; i < size; i++) {
 		snprintf(rbuf + 2*i, rlen - strlen(rbuf), "%02x", tlvs[i]);
@@ -730,11 +832,76 @@ int get_agent_stats(struct cmd *cmd, char *rbuf, int rlen)
 	offset+=8;
 	snprintf(rbuf+offset, rlen - strlen(rbuf),
 		"%08x", stats.statsAgeoutsTotal);
+	offset+=8;
+	/* Extensions, older clients ignore them */
+	snprintf(rbuf+offset, rlen - strlen(rbuf),
+		"%016llx%016llx%016llx%016llx%016llx%016llx%016llx",
+		(unsigned long long)stats.statsOctetsOutTotal,
+		(unsigned long long)stats.statsOctetsInTotal,
+		(unsigned long long)stats.statsFramesDedupTotal,
+		(unsigned long long)stats.statsRxParseNs,
+		(unsigned long long)stats.statsRxParseMaxNs,
+		(unsigned long long)stats.statsTxBuildNs,
+		(unsigned long long)stats.statsTxBuildMaxNs);
 
 	return cmd_success;
 }
 
-int mand_clif_cmd(UNUSED void  *data,
+/*
+ * Binary replies of message version CLIF_MSG_VERSION_BIN. The data follows
+ * the NUL which terminates the reply text, the number of bytes after the
+ * text is returned in the client interface data.
+ */
+static int get_tlvs_bin(struct cmd *cmd, unsigned int nbr,
+			struct clif_data *cd, char *rbuf, int rlen)
+{
+	u8 tlvs[2048];
+	int size = 0;
+	int res;
+
+	res = get_tlv_data(cmd, nbr, tlvs, &size);
+	if (res)
+		return res;
+	if (size + 1 > rlen)
+		return cmd_failed;
+	rbuf[0] = '\0';
+	memcpy(rbuf + 1, tlvs, size);
+	cd->rbin = size + 1;
+	return cmd_success;
+}
+
+static int get_agent_stats_bin(struct cmd *cmd, struct clif_data *cd,
+			       char *rbuf, int rlen)
+{
+	struct agentstats stats;
+	struct clif_stats_bin sb;
+
+	if (get_lldp_agent_statistics(cmd->ifname, &stats, cmd->type))
+		return cmd_device_not_found;
+	if ((int)sizeof(sb) + 1 > rlen)
+		return cmd_failed;
+
+	sb.frames_out = htonl(stats.statsFramesOutTotal);
+	sb.frames_discarded = htonl(stats.statsFramesDiscardedTotal);
+	sb.frames_in_errors = htonl(stats.statsFramesInErrorsTotal);
+	sb.frames_in = htonl(stats.statsFramesInTotal);
+	sb.tlvs_discarded = htonl(stats.statsTLVsDiscardedTotal);
+	sb.tlvs_unrecognized = htonl(stats.statsTLVsUnrecognizedTotal);
+	sb.ageouts = htonl(stats.statsAgeoutsTotal);
+	sb.octets_out = htobe64(stats.statsOctetsOutTotal);
+	sb.octets_in = htobe64(stats.statsOctetsInTotal);
+	sb.frames_dedup = htobe64(stats.statsFramesDedupTotal);
+	sb.rx_parse_ns = htobe64(stats.statsRxParseNs);
+	sb.rx_parse_max_ns = htobe64(stats.statsRxParseMaxNs);
+	sb.tx_build_ns = htobe64(stats.statsTxBuildNs);
+	sb.tx_build_max_ns = htobe64(stats.statsTxBuildMaxNs);
+	rbuf[0] = '\0';
+	memcpy(rbuf + 1, &sb, sizeof(sb));
+	cd->rbin = sizeof(sb) + 1;
+	return cmd_success;
+}
+
+int mand_clif_cmd(void  *data,
 		  UNUSED struct sockaddr_un *from,
 		  UNUSED socklen_t fromlen,
 		  char *ibuf, int ilen,
@@ -747,6 +914,9 @@ int mand_clif_cmd(UNUSED void  *data,
 	char **args;
 	char **argvals;
 	bool test_failed = false;
+	bool bin;
+	unsigned int nbr = 0;
+	char *end;
 	int numargs = 0;
 	int i, offset;
 
@@ -766,7 +936,7 @@ int mand_clif_cmd(UNUSED void  *data,
 	cmd.ifname[len] = '\0';
 	ioff += len;
 
-	if (version == CLIF_MSG_VERSION) {
+	if (version == CLIF_MSG_VERSION || version == CLIF_MSG_VERSION_BIN) {
 		hexstr2bin(ibuf+ioff, &cmd.type, sizeof(cmd.type));
 		ioff += 2*sizeof(cmd.type);
 	} else {
@@ -809,8 +979,10 @@ int mand_clif_cmd(UNUSED void  *data,
 	else if (cmd.ops & op_arg)
 		numargs = get_arg_list(ibuf, ilen, &ioff, args);
 
+	/* Binary replies only to clients asking for them */
+	bin = version == CLIF_MSG_VERSION_BIN && data;
 	snprintf(rbuf, rlen, "%c%1x%02x%08x%02x%s",
-		 CMD_REQUEST, CLIF_MSG_VERSION,
+		 CMD_REQUEST, bin ? CLIF_MSG_VERSION_BIN : CLIF_MSG_VERSION,
 		 cmd.cmd, cmd.ops,
 		(unsigned int)strlen(cmd.ifname), cmd.ifname);
 	roff = strlen(rbuf);
@@ -826,11 +998,31 @@ int mand_clif_cmd(UNUSED void  *data,
 	case cmd_getstats:
 		if (numargs)
 			break;
-		rstatus = get_agent_stats(&cmd, rbuf + roff, rlen - roff);
+		if (bin)
+			rstatus = get_agent_stats_bin(&cmd, data, rbuf + roff,
+						      rlen - roff);
+		else
+			rstatus = get_agent_stats(&cmd, rbuf + roff,
+						  rlen - roff);
 		break;
 	case cmd_gettlv:
 		snprintf(rbuf + roff, rlen - roff, "%08x", cmd.tlvid);
 		roff+=8;
+		/* neighbor=<index> selects one of several neighbors */
+		if (numargs && (cmd.ops & op_neighbor) &&
+		    !(cmd.ops & op_config)) {
+			if (numargs != 1 || !argvals[0] ||
+			    strcasecmp(args[0], ARG_NEIGHBOR)) {
+				rstatus = cmd_bad_params;
+				break;
+			}
+			nbr = strtoul(argvals[0], &end, 0);
+			if (*end || !*argvals[0]) {
+				rstatus = cmd_bad_params;
+				break;
+			}
+			numargs = 0;
+		}
 		if (!numargs) {
 			if (cmd.ops & op_config) {
 				if (cmd.ops & op_neighbor)
@@ -838,8 +1030,12 @@ int mand_clif_cmd(UNUSED void  *data,
 				rstatus = handle_get_args(&cmd, NULL, NULL,
 							 rbuf + strlen(rbuf),
 							 rlen - strlen(rbuf));
+			} else if (bin) {
+				rstatus = get_tlvs_bin(&cmd, nbr, data,
+						       rbuf + roff, rlen - roff);
 			} else {
-				rstatus = get_tlvs(&cmd, rbuf+roff, rlen-roff);
+				rstatus = get_tlvs(&cmd, nbr, rbuf + roff,
+						   rlen - roff);
 			}
 		} else if ((cmd.ops & op_config) && !(cmd.ops & op_neighbor)) {
 			for (i = 0; i < numargs; i++)
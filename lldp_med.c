@@ -30,7 +30,6 @@
 #include <sys/queue.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
-#include <sys/utsname.h>
 #include <linux/if_bridge.h>
 #include "lldp.h"
 #include "lldp_med.h"
@@ -39,8 +38,8 @@
 #include "libconfig.h"
 #include "lldp_mand_clif.h"
 #include "lldp_med_cmds.h"
+#include "hostinfo.h"
 
-extern struct lldp_head lldp_head;
 
 struct tlv_info_medcaps {
 	u8 oui[OUI_SIZE];
@@ -223,76 +222,6 @@ out_err:
 	return rc;
 }
 
-#define SYSFS_INV_PATH	"/sys/class/dmi/id"
-#define PROC_INV_PATH	"/proc/sys/kernel"
-#define PATH_INV_HWREV		SYSFS_INV_PATH "/board_version"
-#define PATH_INV_FWREV		SYSFS_INV_PATH "/bios_version"
-#define PATH_INV_SWREV		PROC_INV_PATH "/osrelease"
-#define PATH_INV_MANUFACTURER	SYSFS_INV_PATH "/sys_vendor"
-#define PATH_INV_SERIAL		SYSFS_INV_PATH "/product_uuid"
-#define PATH_INV_MODELNAME	SYSFS_INV_PATH "/product_name"
-#define PATH_INV_ASSETID	SYSFS_INV_PATH "/chassis_serial"
-
-/*
- * TODO: If supports IETF RFC 2737
- */
-int med_read_inventory(u8 subtype, char *buf, size_t size)
-{
-	char path[256];
-	struct utsname uts;
-	FILE *f = NULL;
-
-	memset(buf, 0, size);
-	memset(path, 0, sizeof(path));
-	switch (subtype) {
-	case LLDP_MED_INV_HWREV:
-		strncpy(path, PATH_INV_HWREV, sizeof(path) - 1);
-		break;
-	case LLDP_MED_INV_FWREV:
-		strncpy(path, PATH_INV_FWREV, sizeof(path) - 1);
-		break;
-	case LLDP_MED_INV_SWREV:
-		if (!uname(&uts)) {
-			strncpy(buf, uts.release, size - 1);
-			goto out_err;
-		}
-		LLDPAD_DBG("%s: uname() failed for %d, try"
-			" proc fs\n", __func__, subtype);
-		strncpy(path, PATH_INV_SWREV, sizeof(path) - 1);
-		break;
-	case LLDP_MED_INV_SERIAL:
-		strncpy(path, PATH_INV_SERIAL, sizeof(path) - 1);
-		break;
-	case LLDP_MED_INV_MANUFACTURER:
-		strncpy(path, PATH_INV_MANUFACTURER, sizeof(path) - 1);
-		break;
-	case LLDP_MED_INV_MODELNAME:
-		strncpy(path, PATH_INV_MODELNAME, sizeof(path) - 1);
-		break;
-	case LLDP_MED_INV_ASSETID:
-		strncpy(path, PATH_INV_ASSETID, sizeof(path) - 1);
-		break;
-	default:
-		LLDPAD_DBG("%s: unknown inventory subtype %d\n",
-			__func__, subtype);
-		goto out_err;
-	}
- 	f = fopen(path, "r");
-	if (!f) {
-		LLDPAD_DBG("%s: fopen(%s) failed for type %d\n",
-			__func__, path, subtype);
-		goto out_err;
-	}
-	if (!fgets(buf, size, f)) {
-		LLDPAD_DBG("%s: fgets(%s) failed for type %d\n",
-			__func__, path, subtype);
-		memset(buf, 0, size);
-	}
-	fclose(f);
-out_err:
-	return strlen(buf);
-}
-
 /*
  * med_bld_invtlv - builds inventory tlv by subtype
  * @md: the med data struct
@@ -313,9 +242,9 @@ static struct unpacked_tlv *med_bld_invtlv(struct med_data *md,
 		goto out_err;
 	}
 
-	length = med_read_inventory(subtype, (char *)desc, sizeof(desc));
+	length = hostinfo_inventory(subtype, (char *)desc, sizeof(desc));
 	if (!length) {
-		LLDPAD_DBG("%s:%s:med_read_inventory(%d) failed\n",
+		LLDPAD_DBG("%s:%s:hostinfo_inventory(%d) failed\n",
 			__func__, md->ifname, subtype);
 		goto out_err;
 	}
@@ -329,3 +329,134 @@ out:
 out_nosock:
 	return rc;
 }
+
+#define RTNL_DUMP_SIZE	32768
+
+static int rtnl_parse_link(struct nlmsghdr *nh, struct rtnl_link *link)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(nh);
+	struct rtattr *rta, *info;
+	int attrlen, infolen;
+
+	attrlen = NLMSG_PAYLOAD(nh, 0) - sizeof(struct ifinfomsg);
+	if (attrlen < 0)
+		return -EINVAL;
+
+	memset(link, 0, sizeof(*link));
+	link->ifindex = ifi->ifi_index;
+	link->flags = ifi->ifi_flags;
+	link->carrier = !!(ifi->ifi_flags & IFF_LOWER_UP);
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, attrlen);
+	     rta = RTA_NEXT(rta, attrlen)) {
+		switch (rta->rta_type) {
+		case IFLA_IFNAME:
+			snprintf(link->ifname, sizeof(link->ifname), "%s",
+				 (char *)RTA_DATA(rta));
+			break;
+		case IFLA_CARRIER:
+			link->carrier = *(__u8 *)RTA_DATA(rta);
+			break;
+		case IFLA_LINKINFO:
+			infolen = RTA_PAYLOAD(rta);
+			for (info = RTA_DATA(rta); RTA_OK(info, infolen);
+			     info = RTA_NEXT(info, infolen))
+				if (info->rta_type == IFLA_INFO_KIND)
+					snprintf(link->kind, sizeof(link->kind),
+						 "%s", (char *)RTA_DATA(info));
+			break;
+		default:
+			break;
+		}
+	}
+	return link->ifname[0] ? 0 : -EINVAL;
+}
+
+/**
+ * rtnl_link_dump - get all links with a single dump request
+ * @links: returns an array of links, freed by the caller
+ *
+ * Replaces a query per interface for name, flags, carrier and link type.
+ *
+ * Returns:	the number of links
+ *		<0 on error
+ */
+int rtnl_link_dump(struct rtnl_link **links)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct ifinfomsg ifm;
+	} req = {
+		.nh = {
+			.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)),
+			.nlmsg_type = RTM_GETLINK,
+			.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+		},
+		.ifm = {
+			.ifi_family = AF_UNSPEC,
+		},
+	};
+	struct rtnl_link *tmp;
+	struct nlmsghdr *nh;
+	char *buf;
+	int s, res, rc, count = 0, size = 0;
+	unsigned len;
+	bool done = false;
+
+	*links = NULL;
+	s = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+	if (s < 0)
+		return -errno;
+	buf = malloc(RTNL_DUMP_SIZE);
+	if (!buf) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	if (send(s, &req, req.nh.nlmsg_len, 0) < 0) {
+		rc = -errno;
+		goto out;
+	}
+
+	while (!done) {
+		res = recv(s, buf, RTNL_DUMP_SIZE, 0);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0) {
+			rc = res < 0 ? -errno : -EIO;
+			goto out;
+		}
+		len = res;
+		for (nh = NLMSG(buf); NLMSG_OK(nh, len);
+		     nh = NLMSG_NEXT(nh, len)) {
+			if (nh->nlmsg_type == NLMSG_DONE) {
+				done = true;
+				break;
+			}
+			if (nh->nlmsg_type == NLMSG_ERROR) {
+				rc = ((struct nlmsgerr *)NLMSG_DATA(nh))->error;
+				goto out;
+			}
+			if (nh->nlmsg_type != RTM_NEWLINK)
+				continue;
+			if (count == size) {
+				size = size ? 2 * size : 64;
+				tmp = realloc(*links, size * sizeof(**links));
+				if (!tmp) {
+					rc = -ENOMEM;
+					goto out;
+				}
+				*links = tmp;
+			}
+			if (!rtnl_parse_link(nh, &(*links)[count]))
+				++count;
+		}
+	}
+	rc = count;
+out:
+	if (rc < 0) {
+		free(*links);
+		*links = NULL;
+	}
+	free(buf);
+	close(s);
+	return rc;
+}
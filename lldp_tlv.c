@@ -45,6 +45,7 @@ void somethingChangedLocal(const char *ifname, int type)
 
 	agent->tx.localChange = 1;
 	agent->tx.txFast = agent->timers.txFastInit;
+	lldp_agent_kick(agent);
 
 	return;
 }
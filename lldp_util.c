@@ -136,7 +136,7 @@ char *print_mac(char *mac, char *buf)
 
 static int get_ioctl_socket(void)
 {
-	static int ioctl_socket = -1;
+	static __thread int ioctl_socket = -1;
 
 	if (ioctl_socket >= 0)
 		return ioctl_socket;
@@ -731,7 +731,7 @@ out:
 	return false;
 }
 
-static int is_router(void)
+int is_router(void)
 {
 	int rc = 0;
 	char path[256];
@@ -61,6 +61,10 @@
 #include "lldp/agent.h"
 #include "lldp/l2_packet.h"
 #include "clif.h"
+#include "worker.h"
+#include "shard.h"
+#include "hostinfo.h"
+#include "lldpad_ckpt.h"
 
 /*
  * insert to head, so first one is last
@@ -125,7 +129,8 @@ static void usage(void)
 {
 	fprintf(stderr,
 		"\n"
-		"usage: lldpad [-hdksptv] [-f configfile] [-V level]"
+		"usage: lldpad [-hdksptvwP] [-f configfile] [-T entries] "
+		"[-V level] [-W threads] [-S shards]"
 		"\n"
 		"options:\n"
 		"   -h  show this usage\n"
@@ -135,12 +140,32 @@ static void usage(void)
 		"   -p  Do not create PID file\n"
 		"   -t  omit timestamps in log messages\n"
 		"   -v  show version\n"
+		"   -w  save and restore protocol state for warm restart\n"
 		"   -f  use configfile instead of default\n"
-		"   -V  set syslog level\n");
+		"   -T  keep last entries log messages in trace ring\n"
+		"   -P  profile event loop handlers\n"
+		"   -V  set syslog level\n"
+		"   -W  use threads workers for hardware programming\n"
+		"   -S  run the protocol engine in shards threads\n");
 
 	exit(1);
 }
 
+/* Event of a shard, sent by the main thread which owns the clients */
+struct lldpad_event {
+	int level;
+	u32 moduleid;
+	char msg[];
+};
+
+static void send_shard_event(void *arg)
+{
+	struct lldpad_event *ev = arg;
+
+	send_event(ev->level, ev->moduleid, ev->msg);
+	free(ev);
+}
+
 /*
  * send_event: Send message to attach clients.
  * @moduleid - module identification of sender or 0 for legacy format
@@ -149,9 +174,21 @@ static void usage(void)
 void send_event(int level, u32 moduleid, char *msg)
 {
 	struct clif_data *cd = NULL;
+	struct lldpad_event *ev;
 
 	LLDPAD_DBG("lldpad: send_event level=%d moduleid=%d msg=%s\n",
 		   level, moduleid, msg);
+	if (shard_self() >= 0) {
+		ev = malloc(sizeof(*ev) + strlen(msg) + 1);
+		if (!ev)
+			return;
+		ev->level = level;
+		ev->moduleid = moduleid;
+		strcpy(ev->msg, msg);
+		if (shard_post(-1, send_shard_event, ev))
+			free(ev);
+		return;
+	}
 	cd = (struct clif_data *) eloop_get_user_data();
 	if (cd)
 		ctrl_iface_send(cd, level, moduleid, msg, strlen(msg));
@@ -169,20 +206,70 @@ static void remove_all_adapters(void)
 	return;
 }
 
+/*
+ * Start the protocol engine of the calling thread: the modules, the agent
+ * timer and the ports owned by it.
+ */
+static int lldpad_start(void)
+{
+	init_modules();
+	if (!start_lldp_agents()) {
+		LLDPAD_ERR("failed to initialize LLDP agent\n");
+		return -EIO;
+	}
+	/* Find available interfaces and add adapters */
+	init_ports();
+	return 0;
+}
+
+/*
+ * Send LLDP SHUTDOWN frames, remove the ports and deinit the modules of
+ * the calling thread. For a warm restart their state is saved instead of
+ * sending SHUTDOWN frames.
+ */
+static void lldpad_stop(void)
+{
+	init_ports_cancel();
+	if (ckpt_warm())
+		ckpt_save();
+	else
+		clean_lldp_agents();
+	deinit_modules();
+	remove_all_adapters();
+	stop_lldp_agents();
+}
+
+static int lldpad_start_call(UNUSED void *arg)
+{
+	init_modules();
+	init_ports();
+	return 0;
+}
+
+static int lldpad_stop_call(UNUSED void *arg)
+{
+	init_ports_cancel();
+	clean_lldp_agents();
+	deinit_modules();
+	remove_all_adapters();
+	return 0;
+}
+
 void
 lldpad_reconfig(UNUSED int sig, UNUSED void *eloop_ctx, UNUSED void *signal_ctx)
 {
 	LLDPAD_WARN("lldpad: SIGHUP received reinit...");
+	/* Apply only what changed if possible */
+	if (!reload_cfg())
+		return;
+
 	/* Send LLDP SHUTDOWN frames and deinit modules */
-	clean_lldp_agents();
-	deinit_modules();
-	remove_all_adapters();
+	shard_call_all(lldpad_stop_call, NULL);
 	destroy_cfg();
 
 	/* Reinit config file and modules */
 	init_cfg();
-	init_modules();
-	init_ports();
+	shard_call_all(lldpad_start_call, NULL);
 
 	return;
 }
@@ -230,13 +317,18 @@ int main(int argc, char *argv[])
 	int shm_remove = 0;
 	int killme = 0;
 	int print_v = 0;
+	int profile = 0;
+	int warm = 0;
 	int pid_file = 1;
+	unsigned int trace_size = 0;
+	unsigned int threads = WORKER_THREADS;
+	unsigned int shards = 0;
 	pid_t pid;
 	int cnt;
 	int rc = 1;
 
 	for (;;) {
-		c = getopt(argc, argv, "hdksptvf:V:");
+		c = getopt(argc, argv, "hdksptvwPf:S:T:V:W:");
 		if (c < 0)
 			break;
 		switch (c) {
@@ -265,6 +357,15 @@ int main(int argc, char *argv[])
 		case 'v':
 			print_v = 1;
 			break;
+		case 'w':
+			warm = 1;
+			break;
+		case 'P':
+			profile = 1;
+			break;
+		case 'T':
+			trace_size = strtoul(optarg, NULL, 0);
+			break;
 		case 'V':
 			loglvl = atoi(optarg);
 			if (loglvl > LOG_DEBUG)
@@ -272,6 +373,12 @@ int main(int argc, char *argv[])
 			if (loglvl < LOG_EMERG)
 				loglvl = LOG_EMERG;
 			break;
+		case 'W':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			shards = strtoul(optarg, NULL, 0);
+			break;
 		case 'h':
 		default:
 			usage();
@@ -338,6 +445,11 @@ int main(int argc, char *argv[])
 
 	lldpad_oom_adjust();
 
+	if (log_trace_init(trace_size)) {
+		LLDPAD_ERR("failed to allocate trace ring\n");
+		exit(1);
+	}
+
 	/* initialize lldpad user data */
 	clifd = malloc(sizeof(struct clif_data));
 	if (clifd == NULL) {
@@ -355,6 +467,7 @@ int main(int argc, char *argv[])
 		LLDPAD_ERR("failed to initialize event loop\n");
 		exit(1);
 	}
+	eloop_profile(profile);
 
 	/* initialize the client interface socket before daemonize */
 	if (ctrl_iface_init(clifd) < 0) {
@@ -418,6 +531,11 @@ int main(int argc, char *argv[])
 	openlog("lldpad", LOG_CONS | LOG_PID, LOG_DAEMON);
 	setlogmask(LOG_UPTO(loglvl));
 
+	/* start the threads after daemon(), they do not survive a fork */
+	if (worker_init(threads) < 0)
+		LLDPAD_ERR("failed to start worker threads, "
+			   "programming hardware from event loop\n");
+
 	/* setup event netlink interface for user space processes.
 	 * This needs to be setup first to ensure it gets lldpads
 	 * pid as netlink address.
@@ -429,42 +547,55 @@ int main(int argc, char *argv[])
 		goto out_fail;
 	}
 
-	init_modules();
-
 	eloop_register_signal_terminate(eloop_terminate, NULL);
 	eloop_register_signal_reconfig(lldpad_reconfig, NULL);
 
-	/* setup LLDP agent */
-	if (!start_lldp_agents()) {
-		LLDPAD_ERR("failed to initialize LLDP agent\n");
-		goto out;
-	}
-
 	/* setup event RT netlink interface */
 	if (event_iface_init() < 0) {
 		LLDPAD_ERR("failed to register event interface\n");
 		goto out;
 	}
 
-	/* Find available interfaces and add adapters */
-	init_ports();
+	/* state saved by the previous instance, restored on init_ports */
+	if (ckpt_init(warm))
+		LLDPAD_WARN("cannot read checkpoint, starting cold\n");
+
+	/* without shards the protocol engine runs in the main thread */
+	if (shards) {
+		if (shard_init(shards, lldpad_start, lldpad_stop) < 0) {
+			LLDPAD_ERR("failed to start %u shards\n", shards);
+			goto out;
+		}
+	} else if (lldpad_start()) {
+		goto out;
+	}
 
 	if (ctrl_iface_register(clifd) < 0) {
 		LLDPAD_ERR("lldpad failed to start - "
 			   "failed to register control interface\n");
-		goto out;
+		goto out_stop;
 	}
 
 	rc = 0;
 	eloop_run();
 
-	clean_lldp_agents();
-	deinit_modules();
-	remove_all_adapters();
+out_stop:
+	/* finish pending hardware requests while the modules exist */
+	worker_destroy();
+	if (shard_count())
+		shard_destroy();
+	else
+		lldpad_stop();
+	/* deliver the events of the shards while stopping */
+	eloop_run_posted();
+	if (ckpt_warm())
+		ckpt_write();
 	ctrl_iface_deinit(clifd);  /* free's clifd */
 	event_iface_deinit();
-	stop_lldp_agents();
 out:
+	worker_destroy();
+	hostinfo_destroy();
+	ckpt_destroy();
 	eloop_destroy();
 	if (!eloop_terminated())
 		rc = 1;
@@ -0,0 +1,406 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lldp.h"
+#include "lldp_mod.h"
+#include "lldp/ports.h"
+#include "lldp/agent.h"
+#include "lldp/states.h"
+#include "lldpad_ckpt.h"
+#include "messages.h"
+
+static struct {
+	pthread_mutex_t lock;		/* Protects the records to save */
+	int warm;			/* Warm restart requested */
+	u8 *map;			/* Checkpoint read at start */
+	size_t maplen;
+	unsigned int age;		/* Seconds since it was written */
+	u8 *buf;			/* Records to save */
+	size_t len;
+	size_t size;
+	u32 count;
+} ckpt = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/*
+ * Seconds since boot, including suspended time.
+ */
+static u64 ckpt_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return ts.tv_sec;
+}
+
+/*
+ * Read the boot ID of the kernel, the stamps are only comparable within
+ * one boot. Returns 0 on success and -1 otherwise.
+ */
+static int ckpt_boot_id(char *buf, size_t size)
+{
+	FILE *f = fopen(LLDPAD_CKPT_BOOTID, "r");
+	int rc = -1;
+
+	memset(buf, 0, size);
+	if (!f)
+		return rc;
+	if (fgets(buf, size, f)) {
+		buf[strcspn(buf, "\n")] = '\0';
+		rc = *buf ? 0 : -1;
+	}
+	fclose(f);
+	return rc;
+}
+
+/*
+ * Select warm restarts and read the checkpoint of the previous instance,
+ * which is removed. A missing or invalid checkpoint is not an error, the
+ * ports start cold then.
+ * Returns 0 on success and a negative errno value otherwise.
+ */
+int ckpt_init(int warm)
+{
+	char boot_id[sizeof(((struct ckpt_hdr *)0)->boot_id)];
+	struct ckpt_hdr *hdr;
+	struct stat st;
+	u64 now = ckpt_now();
+	void *map;
+	int fd, rc = 0;
+
+	ckpt.warm = warm;
+	if (!warm)
+		return 0;
+	fd = open(LLDPAD_CKPT_FILE, O_RDONLY);
+	if (fd < 0)
+		return errno == ENOENT ? 0 : -errno;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*hdr)) {
+		rc = -EINVAL;
+		goto out;
+	}
+	/* Private and writable, restored records are marked */
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+		   0);
+	if (map == MAP_FAILED) {
+		rc = -errno;
+		goto out;
+	}
+	hdr = map;
+	if (hdr->magic != LLDPAD_CKPT_MAGIC ||
+	    hdr->version != LLDPAD_CKPT_VER || hdr->hdrlen != sizeof(*hdr) ||
+	    sizeof(*hdr) + hdr->size > (size_t)st.st_size ||
+	    ckpt_boot_id(boot_id, sizeof(boot_id)) ||
+	    strncmp(hdr->boot_id, boot_id, sizeof(boot_id)) ||
+	    hdr->stamp > now) {
+		LLDPAD_WARN("%s:%s ignored, version %u\n", __func__,
+			    LLDPAD_CKPT_FILE, hdr->version);
+		munmap(map, st.st_size);
+		rc = -EINVAL;
+		goto out;
+	}
+	ckpt.map = map;
+	ckpt.maplen = st.st_size;
+	ckpt.age = now - hdr->stamp;
+	LLDPAD_INFO("%s:restoring %u records saved %us ago\n", __func__,
+		    hdr->count, ckpt.age);
+out:
+	close(fd);
+	unlink(LLDPAD_CKPT_FILE);
+	return rc;
+}
+
+void ckpt_destroy(void)
+{
+	if (ckpt.map)
+		munmap(ckpt.map, ckpt.maplen);
+	ckpt.map = NULL;
+	free(ckpt.buf);
+	ckpt.buf = NULL;
+	ckpt.len = ckpt.size = 0;
+	ckpt.count = 0;
+}
+
+int ckpt_warm(void)
+{
+	return ckpt.warm;
+}
+
+/*
+ * Seconds since the restored checkpoint was written.
+ */
+unsigned int ckpt_age(void)
+{
+	return ckpt.age;
+}
+
+/*
+ * Add a record with the data of the iovec to the checkpoint. Called by
+ * all shards while they stop.
+ * Returns 0 on success and -ENOMEM otherwise.
+ */
+int ckpt_add(int type, const char *ifname, int agent,
+	     const struct iovec *iov, int iovcnt)
+{
+	struct ckpt_rec *rec;
+	size_t len = 0, need;
+	u8 *p;
+	int i;
+
+	for (i = 0; i < iovcnt; ++i)
+		len += iov[i].iov_len;
+	need = CKPT_ALIGN(sizeof(*rec) + len);
+
+	pthread_mutex_lock(&ckpt.lock);
+	if (ckpt.len + need > ckpt.size) {
+		size_t size = ckpt.size ? 2 * ckpt.size : 4096;
+
+		while (size < ckpt.len + need)
+			size *= 2;
+		p = realloc(ckpt.buf, size);
+		if (!p) {
+			pthread_mutex_unlock(&ckpt.lock);
+			LLDPAD_ERR("%s:%s no memory for record %d\n", __func__,
+				   ifname, type);
+			return -ENOMEM;
+		}
+		ckpt.buf = p;
+		ckpt.size = size;
+	}
+	rec = (struct ckpt_rec *)(ckpt.buf + ckpt.len);
+	memset(rec, 0, need);
+	rec->type = type;
+	rec->agent = agent;
+	rec->len = len;
+	snprintf(rec->ifname, sizeof(rec->ifname), "%s", ifname);
+	p = (u8 *)(rec + 1);
+	for (i = 0; i < iovcnt; ++i) {
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+	ckpt.len += need;
+	++ckpt.count;
+	pthread_mutex_unlock(&ckpt.lock);
+	return 0;
+}
+
+/*
+ * Find the next record after prev of a type for an interface and an agent
+ * type, agent -1 matches any. The records of an interface are only used
+ * by the shard owning it.
+ * Returns a pointer to the data and its length, NULL if none is left.
+ */
+void *ckpt_find(int type, const char *ifname, int agent, void *prev,
+		size_t *len)
+{
+	struct ckpt_hdr *hdr = (struct ckpt_hdr *)ckpt.map;
+	struct ckpt_rec *rec;
+	u8 *p, *end, *next;
+
+	if (!hdr)
+		return NULL;
+	end = ckpt.map + sizeof(*hdr) + hdr->size;
+	p = ckpt.map + sizeof(*hdr);
+	if (prev) {
+		rec = (struct ckpt_rec *)prev - 1;
+		p = (u8 *)rec + CKPT_ALIGN(sizeof(*rec) + rec->len);
+	}
+	for (; p + sizeof(*rec) <= end; p = next) {
+		rec = (struct ckpt_rec *)p;
+		next = p + CKPT_ALIGN(sizeof(*rec) + rec->len);
+		if (next > end)
+			break;
+		if (rec->type != type ||
+		    strncmp(rec->ifname, ifname, sizeof(rec->ifname)) ||
+		    (agent >= 0 && rec->agent != agent))
+			continue;
+		*len = rec->len;
+		return rec + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Mark a record as restored, it is not found again.
+ */
+void ckpt_consume(void *data)
+{
+	struct ckpt_rec *rec = (struct ckpt_rec *)data - 1;
+
+	rec->type = CKPT_NONE;
+}
+
+/*
+ * Write the saved records to the checkpoint file. The file is replaced
+ * atomically.
+ * Returns 0 on success and a negative errno value otherwise.
+ */
+int ckpt_write(void)
+{
+	struct ckpt_hdr hdr = {
+		.magic = LLDPAD_CKPT_MAGIC,
+		.version = LLDPAD_CKPT_VER,
+		.hdrlen = sizeof(hdr),
+		.stamp = ckpt_now(),
+		.size = ckpt.len,
+		.count = ckpt.count
+	};
+	struct iovec iov[2] = {
+		{ .iov_base = &hdr, .iov_len = sizeof(hdr) },
+		{ .iov_base = ckpt.buf, .iov_len = ckpt.len }
+	};
+	const char *tmp = LLDPAD_CKPT_FILE ".tmp";
+	ssize_t n;
+	int fd, rc = 0;
+
+	if (ckpt_boot_id(hdr.boot_id, sizeof(hdr.boot_id))) {
+		rc = -EIO;
+		goto out;
+	}
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		rc = -errno;
+		goto out;
+	}
+	n = writev(fd, iov, 2);
+	if (n != (ssize_t)(sizeof(hdr) + ckpt.len))
+		rc = n < 0 ? -errno : -EIO;
+	if (close(fd) && !rc)
+		rc = -errno;
+	if (!rc && rename(tmp, LLDPAD_CKPT_FILE))
+		rc = -errno;
+	if (rc)
+		unlink(tmp);
+out:
+	if (rc)
+		LLDPAD_ERR("%s:cannot write %s:%d\n", __func__,
+			   LLDPAD_CKPT_FILE, rc);
+	else
+		LLDPAD_INFO("%s:saved %u records\n", __func__, ckpt.count);
+	return rc;
+}
+
+/*
+ * Save the agents and modules of the calling thread: the last LLDPDU
+ * received with its remaining time to live and the transmit timers.
+ */
+void ckpt_save(void)
+{
+	struct lldp_module *np;
+	struct lldp_agent *agent;
+	struct ckpt_agent ca;
+	struct port *port;
+
+	for (port = porthead; port; port = port->next) {
+		LIST_FOREACH(agent, &port->agent_head, entry) {
+			struct iovec iov[2] = {
+				{ .iov_base = &ca, .iov_len = sizeof(ca) },
+				{ .iov_base = agent->rx.framein }
+			};
+
+			memset(&ca, 0, sizeof(ca));
+			ca.txTTR = lldp_agent_timeleft(agent->timers.txTTRDue);
+			ca.txFast = agent->tx.txFast;
+			if (agent->rx.framein && agent->timers.rxTTLDue) {
+				ca.rxTTL = lldp_agent_timeleft(
+						agent->timers.rxTTLDue);
+				ca.sizein = agent->rx.sizein;
+				iov[1].iov_len = agent->rx.sizein;
+			}
+			ckpt_add(CKPT_AGENT, port->ifname, agent->type, iov,
+				 ca.sizein ? 2 : 1);
+		}
+	}
+	LIST_FOREACH(np, &lldp_head, lldp)
+		if (np->ops->lldp_mod_ckpt)
+			np->ops->lldp_mod_ckpt();
+}
+
+/*
+ * Restore the agents of a port which has just been enabled. The saved
+ * LLDPDU is passed to the receive state machine as if received again and
+ * the modules rebuild their neighbor information from it, the time to
+ * live is reduced by the time lldpad was not running. Transmission
+ * continues with the saved timers, the neighbor is not new and no fast
+ * transmission is started.
+ */
+void ckpt_restore_port(struct port *port)
+{
+	struct lldp_agent *agent;
+	struct ckpt_agent ca;
+	size_t len;
+	void *p;
+	int type;
+
+	if (!ckpt.map)
+		return;
+	/* Agents in use before the restart, even if started on demand */
+	for (type = NEAREST_BRIDGE; type < AGENT_MAX; ++type)
+		if (ckpt_find(CKPT_AGENT, port->ifname, type, NULL, &len))
+			lldp_agent_demand(port, type);
+	LIST_FOREACH(agent, &port->agent_head, entry) {
+		p = ckpt_find(CKPT_AGENT, port->ifname, agent->type, NULL,
+			      &len);
+		if (!p || len < sizeof(ca))
+			continue;
+		memcpy(&ca, p, sizeof(ca));
+		ckpt_consume(p);
+		if (len < sizeof(ca) + ca.sizein)
+			continue;
+
+		if (ca.sizein && ca.rxTTL > ckpt.age) {
+			rxReceiveFrame(port, port->ifindex,
+				       (u8 *)p + sizeof(ca), ca.sizein);
+			if (agent->rx.framein) {
+				lldp_agent_timer(agent,
+						 &agent->timers.rxTTLDue,
+						 ca.rxTTL - ckpt.age);
+				agent->rx.newNeighbor = false;
+				agent->stats.statsFramesInTotal = 0;
+				agent->stats.statsOctetsInTotal = 0;
+			}
+		}
+
+		txInitializeTimers(agent);
+		agent->timers.state = TX_TIMER_IDLE;
+		lldp_agent_timer(agent, &agent->timers.txTTRDue,
+				 ca.txTTR > ckpt.age ? ca.txTTR - ckpt.age : 0);
+		agent->tx.txFast = ca.txFast;
+		LLDPAD_DBG("%s:%s agent %d rxTTL %u txTTR %u\n", __func__,
+			   port->ifname, agent->type,
+			   lldp_agent_timeleft(agent->timers.rxTTLDue),
+			   lldp_agent_timeleft(agent->timers.txTTRDue));
+	}
+}
@@ -35,15 +35,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include "dcb_protocol.h"
 #include "lldpad_shm.h"
 #include "lldp.h"
 
-void mark_lldpad_shm_for_removal()
-{
-	shm_unlink(LLDPAD_SHM_PATH);
-}
-
 /* return: 1 = success, 0 = failed */
 void lldpad_shm_ver0_to_ver1(struct lldpad_shm_tbl_ver0 *shmold,
 			    int num_old_entries)
@@ -83,440 +80,577 @@ void lldpad_shm_ver0_to_ver1(struct lldpad_shm_tbl_ver0 *shmold,
 		sizeof(struct lldpad_shm_entry) * num_entries);
 }
 
-/* return: 1 = success, 0 = failed */
-int lldpad_shm_get_msap(const char *device_name, int type, char *info, size_t *len)
-{
-	char *p;
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	pid_t rval = 0;
-	unsigned i;
-	unsigned num_entries;
-	int version;
+static struct lldpad_shm_tbl_ver2 *shm_tbl;	/* Mapped segment of lldpad */
+static size_t shm_len;				/* Size of mapping */
+static struct lldpad_shm_tbl_ver2 *shm_ro;	/* Read-only mapping */
+static size_t shm_ro_len;
 
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+/*
+ * Serializes the shards of lldpad. The mappings change when the table
+ * grows, so readers in lldpad take the lock as well.
+ */
+static pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-	if (shmid < 0)
-		return rval;
+#define SHM_READ_TRIES 100	/* Retries of a reader before giving up */
 
-	if (ftruncate(shmid, LLDPAD_SHM_SIZE)) {
-		close(shmid);
-		return rval;
-	}
+static void lldpad_shm_unmap(void)
+{
+	if (shm_tbl)
+		munmap(shm_tbl, shm_len);
+	shm_tbl = NULL;
+	shm_len = 0;
+}
 
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
+static void lldpad_shm_unmap_ro(void)
+{
+	if (shm_ro)
+		munmap(shm_ro, shm_ro_len);
+	shm_ro = NULL;
+	shm_ro_len = 0;
+}
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
+void mark_lldpad_shm_for_removal()
+{
+	pthread_mutex_lock(&shm_mutex);
+	shm_unlink(LLDPAD_SHM_PATH);
+	lldpad_shm_unmap();
+	lldpad_shm_unmap_ro();
+	pthread_mutex_unlock(&shm_mutex);
+}
 
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
+/*
+ * Sequence number handling. The writer sets the sequence number odd before
+ * it changes data and makes it even again afterwards. A sequence number
+ * left odd by a writer which died is made even by the next update.
+ */
+static void shm_write_begin(u32 *seq)
+{
+	*seq |= 1;
+	__sync_synchronize();
+}
 
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
+static void shm_write_end(u32 *seq)
+{
+	__sync_synchronize();
+	++*seq;
+}
 
-	/* check for invalid number of shm table entries */
-	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
+static u32 shm_read_begin(u32 *seq)
+{
+	u32 rc = *(volatile u32 *)seq;
 
-	/* search for existing entry */
-	for (i = 0; i < num_entries; i++)
-		if (strcmp(shmaddr->ent[i].ifname, device_name) == 0)
-			break;
+	__sync_synchronize();
+	return rc;
+}
 
-	if (i == shmaddr->num_entries)
-		goto done;
+/* return: 1 = data changed while read, 0 = data is consistent */
+static int shm_read_retry(u32 *seq, u32 start)
+{
+	__sync_synchronize();
+	return (start & 1) || *(volatile u32 *)seq != start;
+}
 
-	if (type == CHASSIS_ID_TLV) {
-		p = &shmaddr->ent[i].chassisid[0];
-		*len = shmaddr->ent[i].chassisid_len;
-	} else if (type == PORT_ID_TLV) {
-		p = &shmaddr->ent[i].portid[0];
-		*len = shmaddr->ent[i].portid_len;
-	} else
-		goto done;
+static u32 shm_hash(const char *ifname)
+{
+	u32 h = 2166136261U;
 
-	if (*len) {
-		memcpy(info, p, *len);
-		rval = 1;
+	while (*ifname) {
+		h ^= (unsigned char)*ifname++;
+		h *= 16777619U;
 	}
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
-
-	return rval;
+	return h;
 }
 
-/* return: 1 = success, 0 = failed */
-int lldpad_shm_set_msap(const char *device_name, int type, char *info, size_t len)
+static size_t shm_ver2_size(u32 slots)
 {
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	pid_t rval = 0;
-	unsigned i;
-	int version;
-	unsigned num_entries;
-
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-
-	if (shmid < 0)
-		return rval;
+	return sizeof(struct lldpad_shm_tbl_ver2)
+		+ slots * sizeof(struct lldpad_shm_slot);
+}
 
-	if (ftruncate(shmid, LLDPAD_SHM_SIZE)) {
-		close(shmid);
-		return rval;
-	}
+/*
+ * Change the size of the segment and map it again.
+ * return: 0 = success, -1 = failed (old mapping is kept)
+ */
+static int lldpad_shm_remap(int fd, size_t len)
+{
+	void *addr;
+
+	if (ftruncate(fd, len))
+		return -1;
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED)
+		return -1;
+	lldpad_shm_unmap();
+	shm_tbl = addr;
+	shm_len = len;
+	return 0;
+}
 
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
+/* Add an entry while the table sequence number is odd */
+static void lldpad_shm_insert(struct lldpad_shm_tbl_ver2 *tbl,
+			      struct lldpad_shm_entry *ent)
+{
+	u32 mask = tbl->slots - 1;
+	u32 i = shm_hash(ent->ifname) & mask;
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
+	while (tbl->slot[i].ent.ifname[0])
+		i = (i + 1) & mask;
+	tbl->slot[i].ent = *ent;
+	++tbl->used;
+}
 
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
+/* return: 0 = success, -1 = failed */
+static int lldpad_shm_ver1_to_ver2(int fd)
+{
+	struct lldpad_shm_tbl *old = (struct lldpad_shm_tbl *)shm_tbl;
+	struct lldpad_shm_entry ent[MAX_LLDPAD_SHM_ENTRIES];
+	struct lldpad_shm_tbl_ver2 *tbl;
+	unsigned num_entries = old->num_entries & SHM_NUM_ENT_MASK;
+	pid_t pid = old->pid;
+	unsigned i;
 
-	/* check for invalid number of shm table entries */
 	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
-
-	/* search for existing entry */
-	for (i = 0; i < num_entries; i++)
-		if (strcmp(shmaddr->ent[i].ifname, device_name) == 0)
-			break;
-
-	if (i < MAX_LLDPAD_SHM_ENTRIES) {
-		if (type == CHASSIS_ID_TLV && len <= SHM_CHASSISID_LEN) {
-			memset(&shmaddr->ent[i].chassisid[0], 0, SHM_CHASSISID_LEN);
-			memcpy(&shmaddr->ent[i].chassisid[0], info, len);
-			shmaddr->ent[i].chassisid_len = len;
-		} else if (type == PORT_ID_TLV && len <= SHM_PORTID_LEN) {
-			memset(&shmaddr->ent[i].portid[0], 0, SHM_PORTID_LEN);
-			memcpy(&shmaddr->ent[i].portid[0], info, len);
-			shmaddr->ent[i].portid_len = len;
-		} else
-			goto done;
-
-		if (i == num_entries) {
-			shmaddr->num_entries++;
-			sprintf(shmaddr->ent[i].ifname, "%.*s",
-				IFNAMSIZ, device_name);
-		}
-
-		rval = 1;
+		num_entries = 0;
+	memcpy(ent, old->ent, num_entries * sizeof(ent[0]));
+	if (lldpad_shm_remap(fd, shm_ver2_size(LLDPAD_SHM_SLOTS)))
+		return -1;
+
+	tbl = shm_tbl;
+	memset(tbl, 0, shm_len);
+	tbl->pid = pid;
+	tbl->seq = 1;
+	tbl->size = shm_len;
+	tbl->slots = LLDPAD_SHM_SLOTS;
+	for (i = 0; i < num_entries; i++) {
+		ent[i].ifname[IFNAMSIZ] = '\0';
+		if (ent[i].ifname[0])
+			lldpad_shm_insert(tbl, &ent[i]);
 	}
-
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
-
-	return rval;
+	tbl->num_entries = SHM_NUM_ENT_MASK |
+				(LLDPAD_SHM_VER2 << SHM_VER_SHIFT);
+	shm_write_end(&tbl->seq);
+	return 0;
 }
 
-int lldpad_shm_get_dcbx(const char *device_name)
+/*
+ * Map the segment and keep the mapping. Older layouts are converted to
+ * version 2. The segment is mapped again when lldpad has grown it.
+ * return: pointer to segment, NULL = failed
+ */
+static struct lldpad_shm_tbl_ver2 *lldpad_shm_map(void)
 {
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr = NULL;
-	pid_t rval = 0;  /* zero is default DCBX auto mode */
-	unsigned i;
-	unsigned num_entries;
+	struct stat st;
+	size_t len;
+	void *addr;
 	int version;
+	int shmid;
 
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (shm_tbl && shm_tbl->size <= shm_len)
+		return shm_tbl;
+	lldpad_shm_unmap();
 
+	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
 	if (shmid < 0)
-		return rval;
-
-	if (ftruncate(shmid, LLDPAD_SHM_SIZE)) {
-		close(shmid);
-		return rval;
+		return NULL;
+
+	if (fstat(shmid, &st))
+		goto fail;
+	len = st.st_size;
+	if (len < LLDPAD_SHM_SIZE) {
+		len = LLDPAD_SHM_SIZE;
+		if (ftruncate(shmid, len))
+			goto fail;
 	}
 
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, shmid, 0);
+	if (addr == MAP_FAILED)
+		goto fail;
+	shm_tbl = addr;
+	shm_len = len;
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
+	version = (shm_tbl->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
 
 	if (version == 0)
-		goto done;
-
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
-
-	/* check for invalid number of shm table entries */
-	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
-
-	/* search for existing entry */
-	for (i = 0; i < num_entries; i++) {
-		if (strcmp(shmaddr->ent[i].ifname, device_name) == 0) {
-			switch (shmaddr->ent[i].dcbx_mode) {
-			case DCBX_SUBTYPE1:
-			case DCBX_SUBTYPE2:
-				rval = shmaddr->ent[i].dcbx_mode;
-				break;
-			default:
-				;
-			}
-		}
+		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shm_tbl,
+				shm_tbl->num_entries & SHM_NUM_ENT_MASK);
+	if (version < LLDPAD_SHM_VER2 && lldpad_shm_ver1_to_ver2(shmid)) {
+		lldpad_shm_unmap();
+		goto fail;
 	}
 
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
-
-	return rval;
+	close(shmid);
+	return shm_tbl;
+fail:
+	close(shmid);
+	return NULL;
 }
 
-/* return: 1 = success, 0 = failed */
-int lldpad_shm_set_dcbx(const char *device_name, int dcbx_mode)
+/*
+ * Map the segment read-only for readers, again when lldpad has grown it.
+ * Older layouts are left to lldpad to convert.
+ * return: pointer to segment, NULL = failed or not version 2
+ */
+static struct lldpad_shm_tbl_ver2 *lldpad_shm_map_ro(void)
 {
+	struct stat st;
+	void *addr;
 	int shmid;
-	struct lldpad_shm_tbl *shmaddr = NULL;
-	pid_t rval = 0;
-	unsigned i;
-	unsigned num_entries;
-	int version;
 
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (shm_ro && *(volatile u32 *)&shm_ro->size <= shm_ro_len)
+		return shm_ro;
+	lldpad_shm_unmap_ro();
 
+	shmid = shm_open(LLDPAD_SHM_PATH, O_RDONLY, 0);
 	if (shmid < 0)
-		return rval;
-
-	if (ftruncate(shmid, LLDPAD_SHM_SIZE)) {
+		return NULL;
+	if (fstat(shmid, &st) || (size_t)st.st_size < sizeof(*shm_ro)) {
 		close(shmid);
-		return rval;
+		return NULL;
 	}
-
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, shmid, 0);
 	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
-
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
-
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
-
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
-
-	/* check for invalid number of shm table entries */
-	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
+	if (addr == MAP_FAILED)
+		return NULL;
+	shm_ro = addr;
+	shm_ro_len = st.st_size;
+
+	if ((shm_ro->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT !=
+	    LLDPAD_SHM_VER2) {
+		lldpad_shm_unmap_ro();
+		return NULL;
+	}
+	return shm_ro;
+}
 
-	if ((dcbx_mode != DCBX_SUBTYPE0) && (dcbx_mode != DCBX_SUBTYPE1) &&
-	    (dcbx_mode != DCBX_SUBTYPE2))
-		goto done;
+/*
+ * Start a read of the table. Waits while lldpad rebuilds the table.
+ * return: number of slots, 0 = table not consistent yet, retry
+ */
+static u32 shm_read_table(struct lldpad_shm_tbl_ver2 *tbl, u32 *seq)
+{
+	u32 slots;
 
-	/* search for existing entry */
-	for (i = 0; i < num_entries; i++) {
-		if (strcmp(shmaddr->ent[i].ifname, device_name) == 0) {
-			shmaddr->ent[i].dcbx_mode = dcbx_mode;
-			rval = 1;
-			break;
-		}
+	*seq = shm_read_begin(&tbl->seq);
+	if (*seq & 1) {
+		sched_yield();
+		return 0;
 	}
+	slots = *(volatile u32 *)&tbl->slots;
+	/* Grown meanwhile, the next lldpad_shm_map_ro() maps it again */
+	if (!slots || (slots & (slots - 1)) ||
+	    shm_ver2_size(slots) > shm_ro_len)
+		return 0;
+	return slots;
+}
 
-	/* make a new entry if no existing entry */
-	if ((i == num_entries) && (i < MAX_LLDPAD_SHM_ENTRIES)) {
-		shmaddr->num_entries++;
-		sprintf(shmaddr->ent[i].ifname, "%.*s", IFNAMSIZ, device_name);
-		memset(&shmaddr->ent[i].chassisid[0], 0, SHM_CHASSISID_LEN);
-		shmaddr->ent[i].chassisid_len = 0;
-		memset(&shmaddr->ent[i].portid[0], 0, SHM_PORTID_LEN);
-		shmaddr->ent[i].portid_len = 0;
-		memset((void *)&shmaddr->ent[i].st, 0, sizeof(dcbx_state));
-		shmaddr->ent[i].dcbx_mode = dcbx_mode;
-		rval = 1;
+/* Copy a slot, return: 1 = consistent copy, 0 = failed */
+static int shm_read_slot(struct lldpad_shm_slot *sp,
+			 struct lldpad_shm_entry *ent)
+{
+	int tries;
+	u32 seq;
+
+	for (tries = 0; tries < SHM_READ_TRIES; tries++) {
+		seq = shm_read_begin(&sp->seq);
+		memcpy(ent, &sp->ent, sizeof(*ent));
+		if (!shm_read_retry(&sp->seq, seq))
+			return 1;
+		sched_yield();
 	}
-
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
-
-	return rval;
+	return 0;
 }
 
-/* return: -1 = failed, >=0 = success
- * Should always be called first by lldpad.  This is the
- * only routine which creates the shared memory segment.
+/*
+ * Double the number of slots. Readers see an odd table sequence number
+ * while the entries are hashed into the larger table.
+ * return: 0 = success, -1 = failed
  */
-pid_t lldpad_shm_getpid()
+static int lldpad_shm_grow(void)
 {
+	struct lldpad_shm_slot *old;
+	u32 i, slots = shm_tbl->slots;
 	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	pid_t rval = -1;
-	int version;
-
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	int rval = -1;
 
-	if (shmid < 0)
+	old = malloc(slots * sizeof(*old));
+	if (!old)
 		return rval;
+	memcpy(old, shm_tbl->slot, slots * sizeof(*old));
 
-	if (ftruncate(shmid, LLDPAD_SHM_SIZE)) {
-		close(shmid);
-		return rval;
+	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
+	if (shmid < 0)
+		goto out;
+
+	shm_write_begin(&shm_tbl->seq);
+	if (!lldpad_shm_remap(shmid, shm_ver2_size(slots * 2))) {
+		memset(shm_tbl->slot, 0, shm_len - sizeof(*shm_tbl));
+		/* Readers check the size before they use the slots */
+		shm_tbl->size = shm_len;
+		__sync_synchronize();
+		shm_tbl->slots = slots * 2;
+		shm_tbl->used = 0;
+		for (i = 0; i < slots; i++)
+			if (old[i].ent.ifname[0])
+				lldpad_shm_insert(shm_tbl, &old[i].ent);
+		rval = 0;
 	}
-
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
+	shm_write_end(&shm_tbl->seq);
 	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
+out:
+	free(old);
+	return rval;
+}
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
+/*
+ * Return the slot of an interface. Used by lldpad, the only writer.
+ * With create set add a new entry if none exists.
+ * return: pointer to slot, NULL = not found or failed
+ */
+static struct lldpad_shm_slot *lldpad_shm_slot(const char *device_name,
+					       int create)
+{
+	struct lldpad_shm_tbl_ver2 *tbl = lldpad_shm_map();
+	struct lldpad_shm_slot *sp;
+	u32 i, mask;
 
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
+	if (!tbl)
+		return NULL;
+
+	mask = tbl->slots - 1;
+	for (i = shm_hash(device_name) & mask;; i = (i + 1) & mask) {
+		sp = &tbl->slot[i];
+		if (!sp->ent.ifname[0])
+			break;
+		if (!strncmp(sp->ent.ifname, device_name, IFNAMSIZ))
+			return sp;
+	}
+	if (!create)
+		return NULL;
 
-	rval = shmaddr->pid;
+	if ((tbl->used + 1) * 4 > tbl->slots * 3) {
+		if (lldpad_shm_grow())
+			return NULL;
+		return lldpad_shm_slot(device_name, create);
+	}
 
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
+	shm_write_begin(&sp->seq);
+	memset(&sp->ent, 0, sizeof(sp->ent));
+	sprintf(sp->ent.ifname, "%.*s", IFNAMSIZ, device_name);
+	shm_write_end(&sp->seq);
+	++tbl->used;
+	return sp;
+}
 
+/*
+ * Copy the entry of an interface from the read-only mapping. lldpad does
+ * not lock out readers, the copy is retried while lldpad changes the table
+ * or the slot.
+ * return: 1 = found, 0 = not found or failed
+ */
+static int lldpad_shm_read(const char *device_name,
+			   struct lldpad_shm_entry *ent)
+{
+	struct lldpad_shm_tbl_ver2 *tbl;
+	u32 seq, i, n, mask, slots;
+	int tries, found, rval = 0;
+
+	pthread_mutex_lock(&shm_mutex);
+	for (tries = 0; tries < SHM_READ_TRIES; tries++) {
+		tbl = lldpad_shm_map_ro();
+		if (!tbl)
+			break;
+		slots = shm_read_table(tbl, &seq);
+		if (!slots)
+			continue;
+
+		found = 0;
+		mask = slots - 1;
+		i = shm_hash(device_name) & mask;
+		for (n = 0; n <= mask; n++, i = (i + 1) & mask) {
+			if (!shm_read_slot(&tbl->slot[i], ent))
+				break;
+			if (!ent->ifname[0])
+				break;
+			if (!strncmp(ent->ifname, device_name, IFNAMSIZ)) {
+				found = 1;
+				break;
+			}
+		}
+		if (!shm_read_retry(&tbl->seq, seq)) {
+			rval = found;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&shm_mutex);
 	return rval;
 }
 
 /* return: 1 = success, 0 = failed */
-int lldpad_shm_setpid(pid_t pid)
+int lldpad_shm_get_msap(const char *device_name, int type, char *info, size_t *len)
 {
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	pid_t rval = 0;
-	int version;
-
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
-
-	if (shmid < 0)
-		return rval;
-
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
-
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
-
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
+	struct lldpad_shm_entry ent;
+	char *p;
 
-	shmaddr->pid = pid;
+	if (!lldpad_shm_read(device_name, &ent))
+		return 0;
 
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
+	if (type == CHASSIS_ID_TLV) {
+		p = &ent.chassisid[0];
+		*len = ent.chassisid_len;
+		if (*len > SHM_CHASSISID_LEN)
+			return 0;
+	} else if (type == PORT_ID_TLV) {
+		p = &ent.portid[0];
+		*len = ent.portid_len;
+		if (*len > SHM_PORTID_LEN)
+			return 0;
+	} else
+		return 0;
 
+	if (!*len)
+		return 0;
+	memcpy(info, p, *len);
 	return 1;
 }
 
 /* return: 1 = success, 0 = failed */
-int clear_dcbx_state()
+int lldpad_shm_set_msap(const char *device_name, int type, char *info, size_t len)
 {
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	unsigned i;
-	int version;
-	unsigned num_entries;
-
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
+	struct lldpad_shm_slot *sp;
 
-	if (shmid < 0)
+	if (!(type == CHASSIS_ID_TLV && len <= SHM_CHASSISID_LEN) &&
+	    !(type == PORT_ID_TLV && len <= SHM_PORTID_LEN))
 		return 0;
 
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
+	pthread_mutex_lock(&shm_mutex);
+	sp = lldpad_shm_slot(device_name, 1);
+	if (!sp) {
+		pthread_mutex_unlock(&shm_mutex);
 		return 0;
+	}
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
-
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
-
-	/* check for invalid number of shm table entries */
-	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
-
-	/* clear out dcbx_state for all entries */
-	for (i = 0; i < num_entries; i++)
-		if (strlen(shmaddr->ent[i].ifname))
-			memset((void *)&shmaddr->ent[i].st, 0,
-				sizeof(dcbx_state));
-
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
+	shm_write_begin(&sp->seq);
+	if (type == CHASSIS_ID_TLV) {
+		memset(&sp->ent.chassisid[0], 0, SHM_CHASSISID_LEN);
+		memcpy(&sp->ent.chassisid[0], info, len);
+		sp->ent.chassisid_len = len;
+	} else {
+		memset(&sp->ent.portid[0], 0, SHM_PORTID_LEN);
+		memcpy(&sp->ent.portid[0], info, len);
+		sp->ent.portid_len = len;
+	}
+	shm_write_end(&sp->seq);
+	pthread_mutex_unlock(&shm_mutex);
 	return 1;
 }
 
-/* return: 1 = success, 0 = failed */
-int set_dcbx_state(const char *device_name, dcbx_state *state)
+int lldpad_shm_get_dcbx(const char *device_name)
 {
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	unsigned i;
-	int rval = 0;
-	int version;
-	unsigned num_entries;
+	struct lldpad_shm_entry ent;
 
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
+	if (!lldpad_shm_read(device_name, &ent))
+		return 0;	/* zero is default DCBX auto mode */
 
-	if (shmid < 0)
-		return rval;
+	switch (ent.dcbx_mode) {
+	case DCBX_SUBTYPE1:
+	case DCBX_SUBTYPE2:
+		return ent.dcbx_mode;
+	default:
+		return 0;
+	}
+}
 
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
+/* return: 1 = success, 0 = failed */
+int lldpad_shm_set_dcbx(const char *device_name, int dcbx_mode)
+{
+	struct lldpad_shm_slot *sp;
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
+	if ((dcbx_mode != DCBX_SUBTYPE0) && (dcbx_mode != DCBX_SUBTYPE1) &&
+	    (dcbx_mode != DCBX_SUBTYPE2))
+		return 0;
 
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
+	pthread_mutex_lock(&shm_mutex);
+	sp = lldpad_shm_slot(device_name, 1);
+	if (sp) {
+		shm_write_begin(&sp->seq);
+		sp->ent.dcbx_mode = dcbx_mode;
+		shm_write_end(&sp->seq);
+	}
+	pthread_mutex_unlock(&shm_mutex);
+	return sp != NULL;
+}
 
-	/* check for invalid number of shm table entries */
-	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
+/* return: -1 = failed, >=0 = success
+ * Should always be called first by lldpad.  This is the
+ * only routine which creates the shared memory segment.
+ */
+pid_t lldpad_shm_getpid()
+{
+	struct lldpad_shm_tbl_ver2 *tbl;
+	pid_t pid = -1;
+
+	pthread_mutex_lock(&shm_mutex);
+	tbl = lldpad_shm_map();
+	if (tbl)
+		pid = tbl->pid;
+	pthread_mutex_unlock(&shm_mutex);
+	return pid;
+}
 
-	/* search for existing entry */
-	for (i = 0; i < num_entries; i++)
-		if (strcmp(shmaddr->ent[i].ifname, device_name) == 0)
-			break;
+/* return: 1 = success, 0 = failed */
+int lldpad_shm_setpid(pid_t pid)
+{
+	struct lldpad_shm_tbl_ver2 *tbl;
+
+	pthread_mutex_lock(&shm_mutex);
+	tbl = lldpad_shm_map();
+	if (tbl)
+		tbl->pid = pid;
+	pthread_mutex_unlock(&shm_mutex);
+	return tbl != NULL;
+}
 
-	if (i < MAX_LLDPAD_SHM_ENTRIES) {
-		if (i == num_entries) {
-			shmaddr->num_entries++;
-			sprintf(shmaddr->ent[i].ifname, "%.*s",
-				IFNAMSIZ, device_name);
-		}
-		memcpy((void *)&shmaddr->ent[i].st, state, sizeof(dcbx_state));
-		rval = 1;
+/* return: 1 = success, 0 = failed */
+int clear_dcbx_state()
+{
+	struct lldpad_shm_tbl_ver2 *tbl;
+	struct lldpad_shm_slot *sp;
+	u32 i;
+
+	pthread_mutex_lock(&shm_mutex);
+	tbl = lldpad_shm_map();
+	if (!tbl) {
+		pthread_mutex_unlock(&shm_mutex);
+		return 0;
 	}
 
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
+	/* clear out dcbx_state for all entries */
+	for (i = 0; i < tbl->slots; i++) {
+		sp = &tbl->slot[i];
+		if (!sp->ent.ifname[0])
+			continue;
+		shm_write_begin(&sp->seq);
+		memset((void *)&sp->ent.st, 0, sizeof(dcbx_state));
+		shm_write_end(&sp->seq);
+	}
+	pthread_mutex_unlock(&shm_mutex);
+	return 1;
+}
 
-	return rval;
+/* return: 1 = success, 0 = failed */
+int set_dcbx_state(const char *device_name, dcbx_state *state)
+{
+	struct lldpad_shm_slot *sp;
+
+	pthread_mutex_lock(&shm_mutex);
+	sp = lldpad_shm_slot(device_name, 1);
+	if (sp) {
+		shm_write_begin(&sp->seq);
+		memcpy((void *)&sp->ent.st, state, sizeof(dcbx_state));
+		shm_write_end(&sp->seq);
+	}
+	pthread_mutex_unlock(&shm_mutex);
+	return sp != NULL;
 }
 
 /* find and return a dcbx_state for the given device_name.
@@ -525,152 +659,119 @@ done:
  * return: 1 = success, 0 = failed */
 int get_dcbx_state(const char *device_name, dcbx_state *state)
 {
-	int shmid;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	unsigned i;
-	int rval = 0;
-	int version;
-	unsigned num_entries;
-
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
-
-	if (shmid < 0)
-		return rval;
-
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	close(shmid);
-	if (shmaddr == MAP_FAILED)
-		return rval;
+	struct lldpad_shm_slot *sp;
+
+	pthread_mutex_lock(&shm_mutex);
+	sp = lldpad_shm_slot(device_name, 0);
+	if (sp) {
+		shm_write_begin(&sp->seq);
+		memcpy(state, (void *)&sp->ent.st, sizeof(dcbx_state));
+		memset((void *)&sp->ent.st, 0, sizeof(dcbx_state));
+		shm_write_end(&sp->seq);
+	}
+	pthread_mutex_unlock(&shm_mutex);
+	return sp != NULL;
+}
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
 
-	if (version == 0)
-		lldpad_shm_ver0_to_ver1((struct lldpad_shm_tbl_ver0 *) shmaddr,
-				shmaddr->num_entries & SHM_NUM_ENT_MASK);
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
-
-	/* check for invalid number of shm table entries */
-	if (num_entries > MAX_LLDPAD_SHM_ENTRIES)
-		goto done;
-
-	/* search for existing entry */
-	for (i = 0; i < num_entries; i++)
-		if (strcmp(shmaddr->ent[i].ifname, device_name) == 0) {
-			memcpy(state, (void *)&shmaddr->ent[i].st,
-				sizeof(dcbx_state));
-			memset((void *)&shmaddr->ent[i].st, 0,
-				sizeof(dcbx_state));
+/*
+ * Print the entries of the segment, only the entry of ifname if it is not
+ * NULL. Reads the segment like lldpad_shm_read() and can be used while
+ * lldpad runs.
+ * return: 1 = success, 0 = failed
+ */
+int lldpad_shm_print(const char *ifname)
+{
+	struct lldpad_shm_tbl_ver2 *tbl;
+	struct lldpad_shm_entry *ent = NULL, *tmp;
+	u32 i, seq, slots = 0, size = 0, used = 0;
+	int tries, j, version = 0, rval = 0;
+	pid_t pid = 0;
+
+	pthread_mutex_lock(&shm_mutex);
+	for (tries = 0; tries < SHM_READ_TRIES; tries++) {
+		tbl = lldpad_shm_map_ro();
+		if (!tbl)
+			break;
+		slots = shm_read_table(tbl, &seq);
+		if (!slots)
+			continue;
+		tmp = realloc(ent, slots * sizeof(*ent));
+		if (!tmp)
+			break;
+		ent = tmp;
+		pid = tbl->pid;
+		version = (tbl->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
+		size = tbl->size;
+		used = tbl->used;
+		for (i = 0; i < slots; i++)
+			if (!shm_read_slot(&tbl->slot[i], &ent[i]))
+				break;
+		if (i == slots && !shm_read_retry(&tbl->seq, seq)) {
 			rval = 1;
 			break;
 		}
-
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
-
-	return rval;
-}
-
-
-#ifdef SHM_UTL
-/* compile utility to print out lldpad shared memory segment as follows:
- *    gcc -o lldpad_shm -I. -Iinclude -DSHM_UTL lldpad_shm.c
-*/
-
-int print_lldpad_shm()
-{
-	int shmid;
-	struct lldpad_shm_tbl_ver0 *shmaddr_ver0 = NULL;
-	struct lldpad_shm_tbl *shmaddr=NULL;
-	unsigned i;
-	int j;
-	int rval = 0;
-	int version;
-	unsigned num_entries;
-	unsigned max_entries;
-	int ent_size;
-	struct lldpad_shm_entry *entry_ptr = NULL;
-
-	shmid = shm_open(LLDPAD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
-
-	if (shmid < 0) {
-		printf("failed to shm_open\n");
-		return rval;
 	}
-
-	shmaddr = (struct lldpad_shm_tbl *) mmap(NULL, LLDPAD_SHM_SIZE,
-			                         PROT_READ | PROT_WRITE,
-						 MAP_SHARED, shmid, 0);
-	shmaddr_ver0 = (struct lldpad_shm_tbl_ver0 *)shmaddr;
-	close(shmid);
-	if (shmaddr == MAP_FAILED) {
-		printf("failed to mmap\n");
-		return rval;
+	pthread_mutex_unlock(&shm_mutex);
+	if (!rval) {
+		printf("failed to read lldpad shared memory\n");
+		free(ent);
+		return 0;
 	}
 
-	version = (shmaddr->num_entries & SHM_VER_MASK) >> SHM_VER_SHIFT;
-	if (version == 0) {
-		max_entries = MAX_LLDPAD_SHM_ENTRIES_VER0;
-		ent_size = sizeof(struct lldpad_shm_entry_ver0);
-	} else {
-		max_entries = MAX_LLDPAD_SHM_ENTRIES;
-		ent_size = sizeof(struct lldpad_shm_entry);
+	if (!ifname) {
+		printf("pid = %d\n", pid);
+		printf("version = %d\n", version);
+		printf("size = %u\n", size);
+		printf("num_entries = %u\n", used);
+		printf("max num_entries = %u\n", slots);
 	}
-	num_entries = shmaddr->num_entries & SHM_NUM_ENT_MASK;
-	printf("pid = %d\n", shmaddr->pid);
-	printf("version = %d\n", version);
-	printf("num_entries = %d\n", num_entries);
-	printf("max num_entries = %d\n", max_entries);
 
-	/* check for invalid number of shm table entries */
-	if (num_entries > max_entries)
-		goto done;
-
-	for (i = 0; i < num_entries; i++) {
-		if (version == 0)
-			entry_ptr = (struct lldpad_shm_entry *)&shmaddr_ver0->ent[i];
-		else
-			entry_ptr = &shmaddr->ent[i];
+	for (i = 0; i < slots; i++) {
+		if (!ent[i].ifname[0])
+			continue;
+		ent[i].ifname[IFNAMSIZ] = '\0';
+		if (ifname && strncmp(ent[i].ifname, ifname, IFNAMSIZ))
+			continue;
 
-		printf("ifname:     %s\n", entry_ptr->ifname);
+		printf("ifname:     %s\n", ent[i].ifname);
 		printf("chassisid:  ");
-		for (j = 0; j < entry_ptr->chassisid_len; j++)
-			printf("%02x", (unsigned char)entry_ptr->chassisid[j]);
+		for (j = 0; j < ent[i].chassisid_len && j < SHM_CHASSISID_LEN;
+		     j++)
+			printf("%02x", (unsigned char)ent[i].chassisid[j]);
 		printf("\n");
 		printf("portid:     ");
-		for (j = 0; j < entry_ptr->portid_len; j++)
-			printf("%02x", (unsigned char)entry_ptr->portid[j]);
+		for (j = 0; j < ent[i].portid_len && j < SHM_PORTID_LEN; j++)
+			printf("%02x", (unsigned char)ent[i].portid[j]);
 		printf("\n");
-		printf("SeqNo:       %d\n", entry_ptr->st.SeqNo);
-		printf("AckNo:       %d\n", entry_ptr->st.AckNo);
-		printf("FCoEenable:  %d\n", entry_ptr->st.FCoEenable);
-		printf("iSCSIenable: %d\n", entry_ptr->st.iSCSIenable);
-		if (version) {
-			printf("DCBX mode: ");
-			switch (entry_ptr->dcbx_mode) {
-			case dcbx_subtype0:
-				printf("Auto (IEEE)\n");
-				break;
-			case dcbx_subtype1:
-				printf("CIN\n");
-				break;
-			case dcbx_subtype2:
-				printf("CEE\n");
-				break;
-			default:
-				printf("unknown\n");
-			}
+		printf("SeqNo:       %d\n", ent[i].st.SeqNo);
+		printf("AckNo:       %d\n", ent[i].st.AckNo);
+		printf("FCoEenable:  %d\n", ent[i].st.FCoEenable);
+		printf("iSCSIenable: %d\n", ent[i].st.iSCSIenable);
+		printf("DCBX mode: ");
+		switch (ent[i].dcbx_mode) {
+		case DCBX_SUBTYPE0:
+			printf("Auto (IEEE)\n");
+			break;
+		case DCBX_SUBTYPE1:
+			printf("CIN\n");
+			break;
+		case DCBX_SUBTYPE2:
+			printf("CEE\n");
+			break;
+		default:
+			printf("unknown\n");
 		}
 	}
-	rval = 1;
-
-done:
-	munmap(shmaddr, LLDPAD_SHM_SIZE);
-
-	return rval;
+	free(ent);
+	return 1;
 }
 
+#ifdef SHM_UTL
+/* compile utility to print out lldpad shared memory segment as follows:
+ *    gcc -o lldpad_shm -I. -Iinclude -DSHM_UTL lldpad_shm.c -lpthread -lrt
+*/
+
 static void usage(void)
 {
         fprintf(stderr,
@@ -685,6 +786,6 @@ static void usage(void)
 
 main()
 {
-	print_lldpad_shm();
+	lldpad_shm_print(NULL);
 }
 #endif
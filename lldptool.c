@@ -64,6 +64,8 @@
 #include "lldp_util.h"
 #include "lldpad_status.h"
 
+__thread struct lldp_head lldp_head;
+
 static int show_raw;
 
 static const char *cli_version =
@@ -160,6 +162,12 @@ static const char *commands_help =
 "  -p|ping                              ping lldpad and query pid of lldpad\n"
 "  -q|quit                              exit lldptool (interactive mode)\n"
 "  -S|stats                             get LLDP statistics for ifname\n"
+"  -S|stats [mem|vdp22br [ifname]]      get lldpad statistics without -i\n"
+"  -S|stats trace [seq]                 get lldpad trace ring without -i\n"
+"  -S|stats eloop [on|off|reset]        get lldpad event loop profile\n"
+"  -S|stats prom                        write counters in Prometheus format\n"
+"  -S|stats worker                      get lldpad worker thread queues\n"
+"  -S|stats shm [ifname]                print lldpad shared memory state\n"
 "  -t|get-tlv                           get TLVs from ifname\n"
 "  -T|set-tlv                           set arg for tlvid to value\n"
 "  -l|get-lldp                          get the LLDP parameters for ifname\n"
@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include "clif.h"
 #include "dcb_types.h"
@@ -38,6 +39,7 @@
 #include "messages.h"
 #include "lldp_util.h"
 #include "lldpad_status.h"
+#include "lldpad_shm.h"
 
 static char *print_status(cmd_status status);
 
@@ -97,12 +99,27 @@ void get_arg_value(char *str, char **arg, char **argval)
 	*arg = str;
 }
 
-int cli_cmd_getstats(struct clif *clif, int argc, UNUSED char *argv[],
+int cli_cmd_getstats(struct clif *clif, int argc, char *argv[],
 		     struct cmd *cmd, int raw)
 {
 	char **args;
 	char **argvals;
 
+	/*
+	 * Without an interface ask for the daemon statistics. An optional
+	 * section name and interface name select what is printed.
+	 */
+	if (!cmd->ifname[0]) {
+		/* Read by lldptool itself, lldpad does not take part */
+		if (argc > 0 && !strcmp(argv[0], "shm"))
+			return lldpad_shm_print(argc > 1 ? argv[1] : NULL) ?
+			       cmd_success : cmd_failed;
+		snprintf(cmd->obuf, sizeof(cmd->obuf), "%c%s%s%s", STATS_CMD,
+			 argc > 0 ? argv[0] : "", argc > 1 ? " " : "",
+			 argc > 1 ? argv[1] : "");
+		return clif_command(clif, cmd->obuf, raw);
+	}
+
 	args = calloc(argc, sizeof(char *));
 	if (!args)
 		return cmd_failed;
@@ -144,6 +161,20 @@ int cli_cmd_gettlv(struct clif *clif, int argc, char *argv[],
 	if (!(cmd->ops & op_neighbor))
 		cmd->ops |= op_local;
 
+	/* Neighbor TLVs take the index of the neighbor only */
+	if (numargs && (cmd->ops & op_neighbor) && !(cmd->ops & op_config)) {
+		if (numargs != 1 || !argvals[0] ||
+		    strcasecmp(args[0], ARG_NEIGHBOR)) {
+			printf("%s\n", print_status(cmd_invalid));
+			goto out;
+		}
+		cmd->ops |= op_arg | op_argval;
+		render_cmd(cmd, argc, args, argvals);
+		free(args);
+		free(argvals);
+		return clif_command(clif, cmd->obuf, raw);
+	}
+
 	if (numargs) {
 		/* Only commands with the config option should have
 		 * arguments.
@@ -506,6 +537,15 @@ static void print_port_stats(char *ibuf)
 		"Total Unrecognized TLVs        ",
 		"Total Ageouts                  ",
 		"" };
+	static char *xstat_names[] = {
+		"Total Octets Transmitted       ",
+		"Total Octets Received          ",
+		"Total Unchanged Frames Received",
+		"Total RX Parse Time (ms)       ",
+		"Max RX Parse Time (ms)         ",
+		"Total TX Build Time (ms)       ",
+		"Max TX Build Time (ms)         ",
+		"" };
 	int i;
 	int offset = 0;
 	u32 value;
@@ -516,6 +556,21 @@ static void print_port_stats(char *ibuf)
 		printf("%s = %u\n", stat_names[i], value);
 		offset += 8;
 	}
+
+	/* Extensions of lldpad, times in nanoseconds */
+	for (i = 0; strlen(xstat_names[i]); i++) {
+		unsigned long long xvalue;
+
+		if (strlen(ibuf + offset) < 16)
+			break;
+		sscanf(ibuf + offset, "%16llx", &xvalue);
+		if (i >= 3)
+			printf("%s = %llu.%03llu\n", xstat_names[i],
+			       xvalue / 1000000, xvalue / 1000 % 1000);
+		else
+			printf("%s = %llu\n", xstat_names[i], xvalue);
+		offset += 16;
+	}
 }
 
 void print_cmd_response(char *ibuf, int status)
@@ -579,6 +634,12 @@ void print_response(char *buf, int status)
 		else
 			printf("%s\n", buf+CLIF_RSP_OFF+5);
 		break;
+	case STATS_CMD:
+		if (status)
+			printf("FAILED:%s\n", print_status(status));
+		else
+			printf("%s", buf+CLIF_RSP_OFF+1);
+		break;
 	case ATTACH_CMD:
 	case DETACH_CMD:
 	case LEVEL_CMD:
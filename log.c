@@ -25,6 +25,9 @@
 *******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <syslog.h>
 #include <stdarg.h>
 #include <string.h>
@@ -33,6 +36,375 @@
 
 #include "messages.h"
 
+/*
+ * Trace ring. When enabled with lldpad -T entries, each log message is also
+ * stored in binary form: time stamp, level, format string and arguments.
+ * Nothing is formatted and nothing is allocated when a message is stored.
+ * Formatting is done when the ring is dumped with lldptool -S trace.
+ * String arguments are copied into the record and truncated if needed.
+ */
+#define	TRACE_ARGS	8	/* Max # of arguments stored per message */
+#define	TRACE_STRSZ	64	/* Bytes for string arguments per message */
+
+enum trace_type {		/* Argument types */
+	TRACE_NONE,
+	TRACE_INT,
+	TRACE_LONG,
+	TRACE_LLONG,
+	TRACE_SIZE,
+	TRACE_PTRDIFF,
+	TRACE_INTMAX,
+	TRACE_DOUBLE,
+	TRACE_LDOUBLE,
+	TRACE_PTR,
+	TRACE_STR
+};
+
+union trace_arg {
+	long long ll;
+	double d;
+	const void *p;
+	int str;		/* Offset in string area, -1 if truncated */
+};
+
+struct trace_rec {
+	unsigned long seq;	/* Sequence number + 1, 0 while written */
+	struct timeval tv;
+	const char *fmt;
+	unsigned char level;
+	unsigned char nargs;	/* # of arguments stored */
+	union trace_arg arg[TRACE_ARGS];
+	char str[TRACE_STRSZ];
+};
+
+unsigned int log_trace_size;		/* # of records, 0 if disabled */
+static struct trace_rec *trace_ring;
+static unsigned long trace_head;	/* Next sequence number */
+
+/*
+ * Parse one conversion specification after the percent sign.
+ * Return the argument type and the number of '*' width and precision
+ * arguments. The format pointer is advanced behind the conversion.
+ */
+static enum trace_type trace_conv(const char **fmt, int *stars)
+{
+	const char *cp = *fmt;
+	int lng = 0;
+	enum trace_type type = TRACE_INT;
+
+	*stars = 0;
+	while (*cp && strchr("-+ #0'", *cp))
+		++cp;
+	for (; *cp == '*' || (*cp >= '0' && *cp <= '9') || *cp == '.'; ++cp)
+		if (*cp == '*')
+			++*stars;
+	for (; *cp && strchr("hlLqjzt", *cp); ++cp)
+		switch (*cp) {
+		case 'l':
+			++lng;
+			break;
+		case 'q':
+		case 'L':
+			lng = 2;
+			break;
+		case 'j':
+			type = TRACE_INTMAX;
+			break;
+		case 'z':
+			type = TRACE_SIZE;
+			break;
+		case 't':
+			type = TRACE_PTRDIFF;
+			break;
+		}
+	if (type == TRACE_INT && lng)
+		type = lng == 1 ? TRACE_LONG : TRACE_LLONG;
+	switch (*cp) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'c':
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		type = lng == 2 ? TRACE_LDOUBLE : TRACE_DOUBLE;
+		break;
+	case 'p':
+		type = TRACE_PTR;
+		break;
+	case 's':
+		type = TRACE_STR;
+		break;
+	default:			/* %% and unsupported conversions */
+		type = TRACE_NONE;
+		*stars = 0;
+		break;
+	}
+	*fmt = *cp ? cp + 1 : cp;
+	return type;
+}
+
+/*
+ * Store a message in the trace ring. Writers reserve a record with an atomic
+ * increment, readers skip records which are being written.
+ */
+static void log_trace(int level, const char *format, va_list va)
+{
+	unsigned long seq = __sync_fetch_and_add(&trace_head, 1);
+	struct trace_rec *rp = &trace_ring[seq % log_trace_size];
+	const char *cp = format;
+	size_t stroff = 0;
+	int i, stars;
+
+	rp->seq = 0;
+	__sync_synchronize();
+	gettimeofday(&rp->tv, NULL);
+	rp->fmt = format;
+	rp->level = level;
+	rp->nargs = 0;
+	while ((cp = strchr(cp, '%')) != NULL) {
+		enum trace_type type;
+
+		++cp;
+		type = trace_conv(&cp, &stars);
+		if (type == TRACE_NONE)
+			continue;
+		if (rp->nargs + stars + 1 > TRACE_ARGS)
+			break;
+		for (i = 0; i < stars; ++i)
+			rp->arg[rp->nargs++].ll = va_arg(va, int);
+		switch (type) {
+		case TRACE_INT:
+			rp->arg[rp->nargs].ll = va_arg(va, int);
+			break;
+		case TRACE_LONG:
+			rp->arg[rp->nargs].ll = va_arg(va, long);
+			break;
+		case TRACE_LLONG:
+			rp->arg[rp->nargs].ll = va_arg(va, long long);
+			break;
+		case TRACE_SIZE:
+			rp->arg[rp->nargs].ll = va_arg(va, size_t);
+			break;
+		case TRACE_PTRDIFF:
+			rp->arg[rp->nargs].ll = va_arg(va, ptrdiff_t);
+			break;
+		case TRACE_INTMAX:
+			rp->arg[rp->nargs].ll = va_arg(va, intmax_t);
+			break;
+		case TRACE_DOUBLE:
+			rp->arg[rp->nargs].d = va_arg(va, double);
+			break;
+		case TRACE_LDOUBLE:
+			rp->arg[rp->nargs].d = va_arg(va, long double);
+			break;
+		case TRACE_PTR:
+			rp->arg[rp->nargs].p = va_arg(va, void *);
+			break;
+		case TRACE_STR: {
+			const char *str = va_arg(va, const char *);
+			size_t len;
+
+			if (!str)
+				str = "(null)";
+			len = strlen(str) + 1;
+			if (stroff + len > sizeof(rp->str)) {
+				rp->arg[rp->nargs].str = -1;
+				break;
+			}
+			memcpy(rp->str + stroff, str, len);
+			rp->arg[rp->nargs].str = stroff;
+			stroff += len;
+			break;
+		}
+		default:
+			break;
+		}
+		++rp->nargs;
+	}
+	__sync_synchronize();
+	rp->seq = seq + 1;
+}
+
+/*
+ * Format a stored message into buffer. Returns the number of bytes written
+ * like snprintf(). The conversions are taken from the stored format string,
+ * which is a literal of the caller.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+static int trace_format(struct trace_rec *rp, char *buf, size_t len)
+{
+	const char *cp = rp->fmt, *pct;
+	char spec[32];
+	size_t used = 0;
+	int c = 0, i, stars, n = 0;
+
+	pct = NULL;
+	while (*cp) {
+		enum trace_type type;
+		int w[2] = { 0, 0 };
+		union trace_arg *ap;
+
+		pct = strchr(cp, '%');
+		if (!pct) {
+			c = snprintf(buf + used, len - used, "%s", cp);
+			break;
+		}
+		c = snprintf(buf + used, len - used, "%.*s", (int)(pct - cp),
+			     cp);
+		if (c < 0 || (size_t)c >= len - used)
+			return len;
+		used += c;
+		cp = pct + 1;
+		type = trace_conv(&cp, &stars);
+		snprintf(spec, sizeof(spec), "%.*s",
+			 (int)(cp - pct) < (int)sizeof(spec) ? (int)(cp - pct)
+							     : 0, pct);
+		if (type == TRACE_NONE) {
+			c = snprintf(buf + used, len - used, "%s",
+				     cp[-1] == '%' ? "%" : spec);
+			goto next;
+		}
+		if (!*spec || n + stars + 1 > rp->nargs) {
+			c = snprintf(buf + used, len - used, "...");
+			used += c > 0 ? c : 0;
+			break;
+		}
+		for (i = 0; i < stars; ++i)
+			w[i] = rp->arg[n++].ll;
+		ap = &rp->arg[n++];
+
+#define	TRACE_PRINT(val)						\
+	(stars == 2 ? snprintf(buf + used, len - used, spec, w[0], w[1], val) \
+	 : stars == 1 ? snprintf(buf + used, len - used, spec, w[0], val) \
+	 : snprintf(buf + used, len - used, spec, val))
+
+		switch (type) {
+		case TRACE_INT:
+			c = TRACE_PRINT((int)ap->ll);
+			break;
+		case TRACE_LONG:
+			c = TRACE_PRINT((long)ap->ll);
+			break;
+		case TRACE_LLONG:
+			c = TRACE_PRINT(ap->ll);
+			break;
+		case TRACE_SIZE:
+			c = TRACE_PRINT((size_t)ap->ll);
+			break;
+		case TRACE_PTRDIFF:
+			c = TRACE_PRINT((ptrdiff_t)ap->ll);
+			break;
+		case TRACE_INTMAX:
+			c = TRACE_PRINT((intmax_t)ap->ll);
+			break;
+		case TRACE_DOUBLE:
+			c = TRACE_PRINT(ap->d);
+			break;
+		case TRACE_LDOUBLE:
+			c = TRACE_PRINT((long double)ap->d);
+			break;
+		case TRACE_PTR:
+			c = TRACE_PRINT(ap->p);
+			break;
+		case TRACE_STR:
+			c = TRACE_PRINT(ap->str < 0 ? "..." : rp->str + ap->str);
+			break;
+		default:
+			c = 0;
+			break;
+		}
+#undef	TRACE_PRINT
+next:
+		if (c < 0 || (size_t)c >= len - used)
+			return len;
+		used += c;
+	}
+	if (c > 0 && !pct)
+		used += (size_t)c < len - used ? (size_t)c : len - used - 1;
+	return used;
+}
+#pragma GCC diagnostic pop
+
+/*
+ * Print the trace ring into buffer, oldest message first. The optional
+ * argument is the sequence number of the first message to print. The last
+ * line shows the sequence number to continue with.
+ * Returns the number of bytes written to the buffer.
+ */
+int log_trace_dump(char *buf, size_t len, const char *arg)
+{
+	unsigned long seq, head = trace_head;
+	char msg[1024];
+	size_t used = 0;
+	int c;
+
+	if (!log_trace_size) {
+		c = snprintf(buf, len, "disabled\n");
+		return (c < 0 || (size_t)c >= len) ? 0 : c;
+	}
+	if (len < 32)
+		return 0;
+	len -= 32;			/* Reserve space for last line */
+	seq = head > log_trace_size ? head - log_trace_size : 0;
+	if (arg && *arg) {
+		unsigned long start = strtoul(arg, NULL, 0);
+
+		if (start > seq)
+			seq = start;
+	}
+	for (; seq < head; ++seq) {
+		struct trace_rec *rp = &trace_ring[seq % log_trace_size];
+		struct tm now;
+		int m;
+
+		if (rp->seq != seq + 1)
+			continue;
+		m = trace_format(rp, msg, sizeof(msg));
+		if (m > 0 && msg[m - 1] == '\n')
+			msg[--m] = '\0';
+		localtime_r(&rp->tv.tv_sec, &now);
+		c = snprintf(buf + used, len - used,
+			     "%lu %02d:%02d:%02d.%06ld <%d> %s\n", seq,
+			     now.tm_hour, now.tm_min, now.tm_sec,
+			     rp->tv.tv_usec, rp->level, msg);
+		if (rp->seq != seq + 1)		/* Overwritten while read */
+			continue;
+		if (c < 0 || (size_t)c >= len - used)
+			break;
+		used += c;
+	}
+	c = snprintf(buf + used, len + 32 - used, "next: %lu\n", seq);
+	if (c > 0 && (size_t)c < len + 32 - used)
+		used += c;
+	return used;
+}
+
+/*
+ * Allocate the trace ring with the given number of records.
+ * Returns 0 on success and -1 when out of memory.
+ */
+int log_trace_init(unsigned int entries)
+{
+	if (!entries)
+		return 0;
+	trace_ring = calloc(entries, sizeof(*trace_ring));
+	if (!trace_ring)
+		return -1;
+	log_trace_size = entries;
+	return 0;
+}
+
 /*
  * Prepend each entry with a time stamp.
  */
@@ -51,18 +423,28 @@ static void showtime(void)
 /* Helper macros for handling struct os_time */
 void log_message(int level, const char *format, ...)
 {
-	static int bypass_time;
+	static __thread int bypass_time;
 	va_list va, vb;
 	va_start(va, format);
-	va_copy(vb, va);
 
+	if (log_trace_size) {
+		va_copy(vb, va);
+		log_trace(level, format, vb);
+		va_end(vb);
+	}
+	if (loglvl < level)
+		goto out;
+
+	va_copy(vb, va);
 	if (daemonize)
 		vsyslog(level, format, vb);
-	else if (loglvl >= level) {
+	else {
 		if (!omit_tstamp && !bypass_time)
 			showtime();
 		vprintf(format, vb);
 		bypass_time = strchr(format, '\n') == 0;
 	}
+	va_end(vb);
+out:
 	va_end(va);
 }
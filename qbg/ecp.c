@@ -254,7 +254,6 @@ static bool ecp_build_ECPDU(struct vdp_data *vd)
 	struct ecp_hdr ecp_hdr;
 	u8  own_addr[ETH_ALEN];
 	u32 fb_offset = 0;
-	struct packed_tlv *ptlv =  NULL;
 	struct vsi_profile *p;
 	int rc;
 
@@ -289,21 +288,21 @@ static bool ecp_build_ECPDU(struct vdp_data *vd)
 			continue;
 		}
 
-		ptlv = vdp_gettlv(vd, p);
+		/* build the packed tlv directly in the transmit frame */
+		rc = vdp_puttlv(vd, p, vd->ecp.tx.frame + fb_offset,
+				ETH_FRAME_LEN - sizeof end_tlv - fb_offset);
 
-		if (!ptlv) {
+		if (rc < 0) {
 			LLDPAD_DBG("%s:%s ptlv not created\n", __func__,
 				   vd->ecp.ifname);
 			continue;
 		}
 
-		rc = ecp_append(vd->ecp.tx.frame, &fb_offset, ptlv->tlv,
-				ptlv->size);
-		ptlv = free_pkd_tlv(ptlv);
-		if (rc)
-			p->seqnr = vd->ecp.lastSequence;
-		else
+		if (!rc)
 			break;
+		fb_offset += rc;
+		p->seqnr = vd->ecp.lastSequence;
+		vd->lastsent = p;
 	}
 	ecp_append(vd->ecp.tx.frame, &fb_offset, end_tlv, sizeof end_tlv);
 	vd->ecp.tx.frame_len = MAX(fb_offset, (unsigned)ETH_ZLEN);
@@ -35,6 +35,7 @@
 #include "qbg_utils.h"
 #include "lldp/l2_packet.h"
 #include "lldp_tlv.h"
+#include "lldp/stats.h"
 
 #define ECP22_MAX_RETRIES_DEFAULT	(3)	/* Default # of max retries */
 #define ECP22_ACK_TIMER_STOPPED		(-1)
@@ -115,17 +116,11 @@ static void ecp22_append(u8 *buffer, u32 *pos, void *data, u32 len)
 }
 
 /*
- * Return a payload node to the freelist.
+ * Return a payload node and its data to the slab.
  */
-void ecp22_putnode(struct ecp22_freelist *list, struct ecp22_payload_node *elm)
+static void ecp22_putnode(struct ecp22_payload_node *elm)
 {
-	elm->ptlv = free_pkd_tlv(elm->ptlv);
-	if (list->freecnt > ecp22_maxpayload)
-		free(elm);
-	else {
-		++list->freecnt;
-		LIST_INSERT_HEAD(&list->head, elm, node);
-	}
+	slab22_free(elm);
 }
 
 /*
@@ -165,7 +160,7 @@ static bool ecp22_build_ecpdu(struct ecp22 *ecp)
 	ecp22_append(ecp->tx.frame, &fb_offset, ptlv->tlv, ptlv->size);
 	ecp->tx.frame_len = MAX(fb_offset, (unsigned)ETH_ZLEN);
 	LIST_REMOVE(p, node);
-	ecp22_putnode(&ecp->isfree, p);
+	ecp22_putnode(p);
 	LLDPAD_DBG("%s:%s seqno %#hx frame_len %#hx\n", __func__,
 		   ecp->ifname, ecp->tx.seqno, ecp->tx.frame_len);
 	return true;
@@ -296,7 +291,9 @@ static int ecp22_es_txmit(struct ecp22 *ecp)
 {
 	int rc = 0;
 
-	++ecp->tx.retries;
+	if (++ecp->tx.retries > 1)
+		modstats_retransmit(modstats_get(ecp->ifname, "ecp22"));
+	ecp->tx.sent = stats_ns();
 	ecp22_txframe(ecp, "ecp-out", ecp->tx.frame, ecp->tx.frame,
 		      ecp->tx.frame_len);
 	ecp22_tx_start_acktimer(ecp);
@@ -649,8 +646,13 @@ static void ecp22_recack_frame(struct ecp22 *ecp, unsigned short seqno)
 	LLDPAD_DBG("%s:%s txmit:%d seqno %#hx ack-seqno %#hx\n", __func__,
 		   ecp->ifname, ecp->tx.ecpdu_received, ecp->tx.seqno, seqno);
 	if (ecp->tx.ecpdu_received) {
-		if (ecp->tx.seqno == seqno)
+		if (ecp->tx.seqno == seqno && !ecp->tx.ack_received) {
 			ecp->tx.ack_received = true;
+			/* Round trip time is ambiguous after retransmission */
+			if (ecp->tx.retries == 1)
+				modstats_rtt(modstats_get(ecp->ifname, "ecp22"),
+					     stats_ns() - ecp->tx.sent);
+		}
 	}
 }
 
@@ -750,12 +752,14 @@ static struct ecp22 *ecp22_create(char *ifname, struct ecp22_user_data *eud)
 		return NULL;
 	}
 	strncpy(ecp->ifname, ifname, sizeof ecp->ifname);
+	ecp->mem = slab22_acct_get(ifname);
 	ecp->l2 = l2_packet_init(ecp->ifname, 0, ETH_P_ECP22,
 				 ecp22_rx_receiveframe, ecp, 1);
 
 	if (!ecp->l2) {
 		LLDPAD_ERR("%s:%s error open layer 2 ETH_P_ECP\n", __func__,
 			   ifname);
+		slab22_acct_put(ecp->mem);
 		free(ecp);
 		return NULL;
 	}
@@ -786,8 +790,6 @@ void ecp22_start(char *ifname)
 	ecp->max_rte = ECP22_ACK_TIMER_DEFAULT;
 	LIST_INIT(&ecp->inuse.head);
 	ecp->inuse.last = 0;
-	LIST_INIT(&ecp->isfree.head);
-	ecp->isfree.freecnt = 0;
 	ecp->rx.state = ECP22_RX_BEGIN;
 	ecp22_rx_run_sm(ecp);
 	ecp->tx.state = ECP22_TX_BEGIN;
@@ -803,8 +805,7 @@ static void ecp22_removelist(ecp22_list *ptr)
 
 	while ((np = LIST_FIRST(ptr))) {
 		LIST_REMOVE(np, node);
-		np->ptlv = free_pkd_tlv(np->ptlv);
-		free(np);
+		ecp22_putnode(np);
 	}
 }
 
@@ -813,9 +814,8 @@ static void ecp22_remove(struct ecp22 *ecp)
 	LLDPAD_DBG("%s:%s remove ecp\n", __func__, ecp->ifname);
 	ecp22_removelist(&ecp->inuse.head);
 	ecp->inuse.last = 0;
-	ecp22_removelist(&ecp->isfree.head);
-	ecp->isfree.freecnt = 0;
 	LIST_REMOVE(ecp, node);
+	slab22_acct_put(ecp->mem);
 	free(ecp);
 }
 
@@ -875,39 +875,32 @@ static void ecp22_add_payload(struct ecp22 *ecp,
 }
 
 /*
- * Copy the payload data.
+ * Create a node for size bytes of ecp payload data. Node, packed TLV and its
+ * data are one object allocated from the slab.
  */
-static struct packed_tlv *copy_ptlv(struct packed_tlv *from)
+static struct ecp22_payload_node *ecp22_getnode(struct ecp22 *ecp,
+						unsigned short size)
 {
-	struct packed_tlv *ptlv = create_ptlv();
-
-	if (!ptlv)
-		return NULL;
-	ptlv->size = from->size;
-	ptlv->tlv = calloc(ptlv->size, sizeof(unsigned char));
-	if (!ptlv->tlv) {
-		free_pkd_tlv(ptlv);
-		return NULL;
+	struct ecp22_payload_node *elem;
+
+	elem = slab22_zalloc(ecp->mem, sizeof(*elem) + sizeof(*elem->ptlv)
+			     + size);
+	if (elem) {
+		elem->ptlv = (struct packed_tlv *)(elem + 1);
+		elem->ptlv->size = size;
+		elem->ptlv->tlv = (u8 *)(elem->ptlv + 1);
 	}
-	memcpy(ptlv->tlv, from->tlv, from->size);
-	return ptlv;
+	return elem;
 }
 
 /*
- * Create a node for the ecp payload data. Get it from the free list if not
- * empty. Otherwise allocate from heap.
+ * Return the payload node of payload data created by ecp22_getnode().
  */
-static struct ecp22_payload_node *ecp22_getnode(struct ecp22_freelist *list)
+static struct ecp22_payload_node *ecp22_data2node(void *data)
 {
-	struct ecp22_payload_node *elem = LIST_FIRST(&list->head);
+	struct packed_tlv *ptlv = (struct packed_tlv *)data - 1;
 
-	if (!elem)
-		elem = calloc(1, sizeof *elem);
-	else {
-		LIST_REMOVE(elem, node);
-		--list->freecnt;
-	}
-	return elem;
+	return (struct ecp22_payload_node *)ptlv - 1;
 }
 
 /*
@@ -920,7 +913,6 @@ static int ecp22_req2send(char *ifname, unsigned short subtype,
 	struct ecp22_user_data *eud;
 	struct ecp22 *ecp;
 	struct ecp22_payload_node *payda;
-	struct packed_tlv *ptlv = copy_ptlv(du);
 	int rc = 0;
 
 	LLDPAD_DBG("%s:%s subtype:%d\n", __func__, ifname, subtype);
@@ -931,21 +923,16 @@ static int ecp22_req2send(char *ifname, unsigned short subtype,
 		rc = -ENODEV;
 		goto out;
 	}
-	if (!ptlv) {
-		rc = -ENOMEM;
-		goto out;
-	}
-	if (ptlv->size >= ECP22_MAXPAYLOAD_LEN) {
+	if (du->size >= ECP22_MAXPAYLOAD_LEN) {
 		rc = -E2BIG;
 		goto out;
 	}
-	payda = ecp22_getnode(&ecp->isfree);
+	payda = ecp22_getnode(ecp, du->size);
 	if (!payda) {
-		free_pkd_tlv(ptlv);
 		rc = -ENOMEM;
 		goto out;
 	}
-	payda->ptlv = ptlv;
+	memcpy(payda->ptlv->tlv, du->tlv, du->size);
 	payda->subtype = subtype;
 	memcpy(payda->mac, mac, sizeof payda->mac);
 	ecp22_add_payload(ecp, payda);
@@ -967,6 +954,60 @@ static int data_from_vdp(char *ifname, struct ecp22_to_ulp *ptr)
 	return ecp22_req2send(ifname, ECP22_VDP, nearest_customer_bridge, &d);
 }
 
+/*
+ * Reserve a transmit buffer for the VDP module. The VDP module builds its
+ * packed TLVs directly in this buffer and returns it with data_put_vdp().
+ * Returns zero on success and errno else.
+ */
+static int data_get_vdp(char *ifname, struct ecp22_to_ulp *ptr)
+{
+	struct ecp22_user_data *eud;
+	struct ecp22 *ecp;
+	struct ecp22_payload_node *payda;
+
+	eud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_ECP22);
+	ecp = find_ecpdata(ifname, eud);
+	if (!ecp)
+		return -ENODEV;
+	if (ptr->len >= ECP22_MAXPAYLOAD_LEN)
+		return -E2BIG;
+	payda = ecp22_getnode(ecp, ptr->len);
+	if (!payda)
+		return -ENOMEM;
+	ptr->data = payda->ptlv->tlv;
+	LLDPAD_DBG("%s:%s len:%hd\n", __func__, ifname, ptr->len);
+	return 0;
+}
+
+/*
+ * Queue a transmit buffer filled by the VDP module. The length may be less
+ * than reserved, a length of zero releases the buffer.
+ * Returns zero on success and errno else. The buffer is released on error.
+ */
+static int data_put_vdp(char *ifname, struct ecp22_to_ulp *ptr)
+{
+	struct ecp22_user_data *eud;
+	struct ecp22 *ecp;
+	struct ecp22_payload_node *payda = ecp22_data2node(ptr->data);
+
+	LLDPAD_DBG("%s:%s len:%hd\n", __func__, ifname, ptr->len);
+	if (!ptr->len || ptr->len > payda->ptlv->size) {
+		ecp22_putnode(payda);
+		return ptr->len ? -EINVAL : 0;
+	}
+	eud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_ECP22);
+	ecp = find_ecpdata(ifname, eud);
+	if (!ecp) {
+		ecp22_putnode(payda);
+		return -ENODEV;
+	}
+	payda->ptlv->size = ptr->len;
+	payda->subtype = ECP22_VDP;
+	memcpy(payda->mac, nearest_customer_bridge, sizeof payda->mac);
+	ecp22_add_payload(ecp, payda);
+	return 0;
+}
+
 /*
  * Handle notifications from other modules. Check if sender-id and data type
  * indicator match. Return false when data could not be delivered.
@@ -981,6 +1022,10 @@ static int ecp22_notify(int sender_id, char *ifname, void *data)
 		return ecp22_data_from_evb(ifname, &qbg->u.a);
 	if (sender_id == LLDP_MOD_VDP22 && qbg->data_type == VDP22_TO_ECP22)
 		return data_from_vdp(ifname, &qbg->u.c);
+	if (sender_id == LLDP_MOD_VDP22 && qbg->data_type == VDP22_ECP22_GETBUF)
+		return data_get_vdp(ifname, &qbg->u.c);
+	if (sender_id == LLDP_MOD_VDP22 && qbg->data_type == VDP22_ECP22_PUTBUF)
+		return data_put_vdp(ifname, &qbg->u.c);
 	return 0;
 }
 
@@ -0,0 +1,279 @@
+/*******************************************************************************
+
+  Implementation of memory slabs for VDP22 and ECP22 data
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <net/if.h>
+#include <sys/queue.h>
+
+#include "lldp.h"
+#include "messages.h"
+#include "qbg_slab22.h"
+
+#define	SLAB22_CHUNK	16384	/* Bytes taken from heap per refill */
+
+struct slab22_acct {		/* Memory usage per interface */
+	LIST_ENTRY(slab22_acct) node;
+	char ifname[IFNAMSIZ];
+	int users;		/* # of owners holding this account */
+	unsigned long objs;	/* # of objects in use */
+	size_t bytes;		/* # of bytes in use */
+	size_t hiwat;		/* High water mark of bytes in use */
+	unsigned long allocs;	/* # of successful allocations */
+	unsigned long fails;	/* # of failed allocations */
+};
+
+struct slab22_obj {		/* Header in front of each object */
+	union {
+		struct slab22_obj *next;	/* Free list successor */
+		struct slab22_acct *acct;	/* Account when in use */
+	} u;
+	unsigned int cls;	/* Size class index */
+	unsigned int size;	/* Size charged to account */
+};
+
+struct slab22_class {		/* Objects of one size */
+	unsigned int size;	/* Object size without header */
+	struct slab22_obj *free;	/* Free list */
+	unsigned long total;	/* # of objects carved from chunks */
+	unsigned long nfree;	/* # of objects on free list */
+	unsigned long hiwat;	/* High water mark of objects in use */
+};
+
+static __thread struct slab22_class slab22_cls[] = {
+	{ .size = 32 },
+	{ .size = 64 },
+	{ .size = 128 },
+	{ .size = 256 },
+	{ .size = 512 },
+	{ .size = 1024 },
+	{ .size = 2048 }
+};
+
+#define	SLAB22_CLASSES	(sizeof(slab22_cls) / sizeof(slab22_cls[0]))
+
+static __thread struct {	/* Objects too large for a size class */
+	unsigned long inuse;
+	unsigned long hiwat;
+} slab22_heap;
+
+static __thread LIST_HEAD(slab22_accthead, slab22_acct) slab22_accts =
+	LIST_HEAD_INITIALIZER(slab22_accts);
+
+/*
+ * Return the account for an interface. Create it when not found.
+ */
+struct slab22_acct *slab22_acct_get(const char *ifname)
+{
+	struct slab22_acct *ap;
+
+	LIST_FOREACH(ap, &slab22_accts, node)
+		if (!strncmp(ap->ifname, ifname, sizeof(ap->ifname)))
+			break;
+	if (!ap) {
+		ap = calloc(1, sizeof(*ap));
+		if (!ap) {
+			LLDPAD_ERR("%s:%s unable to allocate account\n",
+				   __func__, ifname);
+			return NULL;
+		}
+		strncpy(ap->ifname, ifname, sizeof(ap->ifname) - 1);
+		LIST_INSERT_HEAD(&slab22_accts, ap, node);
+	}
+	++ap->users;
+	return ap;
+}
+
+/*
+ * Delete an account when no owner and no object refer to it.
+ */
+static void slab22_acct_release(struct slab22_acct *ap)
+{
+	if (ap->users || ap->objs)
+		return;
+	LIST_REMOVE(ap, node);
+	free(ap);
+}
+
+void slab22_acct_put(struct slab22_acct *ap)
+{
+	if (!ap)
+		return;
+	--ap->users;
+	slab22_acct_release(ap);
+}
+
+/*
+ * Get a new chunk of memory from the heap and put all objects on the free
+ * list of the size class.
+ */
+static int slab22_refill(struct slab22_class *cp)
+{
+	size_t stride = sizeof(struct slab22_obj) + cp->size;
+	size_t i, cnt = MAX(SLAB22_CHUNK / stride, (size_t)1);
+	char *chunk = malloc(cnt * stride);
+	struct slab22_obj *op;
+
+	if (!chunk)
+		return -ENOMEM;
+	for (i = 0; i < cnt; ++i) {
+		op = (struct slab22_obj *)(chunk + i * stride);
+		op->u.next = cp->free;
+		cp->free = op;
+	}
+	cp->total += cnt;
+	cp->nfree += cnt;
+	return 0;
+}
+
+/*
+ * Allocate an object of at least size bytes and clear it. The object is
+ * charged to the account, which can be NULL.
+ * Returns NULL when out of memory.
+ */
+void *slab22_zalloc(struct slab22_acct *ap, size_t size)
+{
+	struct slab22_obj *op;
+	unsigned int cls;
+
+	for (cls = 0; cls < SLAB22_CLASSES; ++cls)
+		if (size <= slab22_cls[cls].size)
+			break;
+	if (cls < SLAB22_CLASSES) {
+		struct slab22_class *cp = &slab22_cls[cls];
+
+		if (!cp->free && slab22_refill(cp))
+			goto fail;
+		op = cp->free;
+		cp->free = op->u.next;
+		--cp->nfree;
+		cp->hiwat = MAX(cp->hiwat, cp->total - cp->nfree);
+		size = cp->size;
+	} else {
+		op = malloc(sizeof(*op) + size);
+		if (!op)
+			goto fail;
+		++slab22_heap.inuse;
+		slab22_heap.hiwat = MAX(slab22_heap.hiwat, slab22_heap.inuse);
+	}
+	op->u.acct = ap;
+	op->cls = cls;
+	op->size = size;
+	memset(op + 1, 0, size);
+	if (ap) {
+		++ap->objs;
+		++ap->allocs;
+		ap->bytes += size;
+		ap->hiwat = MAX(ap->hiwat, ap->bytes);
+	}
+	return op + 1;
+fail:
+	if (ap)
+		++ap->fails;
+	return NULL;
+}
+
+/*
+ * Return an object to its size class.
+ */
+void slab22_free(void *ptr)
+{
+	struct slab22_obj *op;
+	struct slab22_acct *ap;
+
+	if (!ptr)
+		return;
+	op = (struct slab22_obj *)ptr - 1;
+	ap = op->u.acct;
+	if (ap) {
+		--ap->objs;
+		ap->bytes -= op->size;
+		slab22_acct_release(ap);
+	}
+	if (op->cls < SLAB22_CLASSES) {
+		struct slab22_class *cp = &slab22_cls[op->cls];
+
+		op->u.next = cp->free;
+		cp->free = op;
+		++cp->nfree;
+	} else {
+		--slab22_heap.inuse;
+		free(op);
+	}
+}
+
+/*
+ * Print the usage of each size class and of each account into buffer.
+ * Parameter ifname selects one account, all accounts are printed if NULL
+ * or empty.
+ * Returns the number of bytes written to the buffer.
+ */
+int slab22_stats(char *buf, size_t len, const char *ifname)
+{
+	struct slab22_acct *ap;
+	size_t used = 0;
+	unsigned int i;
+	int c;
+
+	c = snprintf(buf, len, "%-16s %8s %8s %8s %8s\n", "slab size",
+		     "objects", "free", "inuse", "hiwat");
+	if (c < 0 || (size_t)c >= len)
+		return 0;
+	used += c;
+	for (i = 0; i < SLAB22_CLASSES; ++i) {
+		struct slab22_class *cp = &slab22_cls[i];
+
+		c = snprintf(buf + used, len - used,
+			     "%-16u %8lu %8lu %8lu %8lu\n", cp->size,
+			     cp->total, cp->nfree, cp->total - cp->nfree,
+			     cp->hiwat);
+		if (c < 0 || (size_t)c >= len - used)
+			return used;
+		used += c;
+	}
+	c = snprintf(buf + used, len - used, "%-16s %8s %8s %8lu %8lu\n",
+		     "heap", "-", "-", slab22_heap.inuse, slab22_heap.hiwat);
+	if (c < 0 || (size_t)c >= len - used)
+		return used;
+	used += c;
+
+	c = snprintf(buf + used, len - used, "%-16s %8s %8s %8s %8s %8s\n",
+		     "interface", "objects", "bytes", "hiwat", "allocs",
+		     "fails");
+	if (c < 0 || (size_t)c >= len - used)
+		return used;
+	used += c;
+	LIST_FOREACH(ap, &slab22_accts, node) {
+		if (ifname && *ifname && strcmp(ifname, ap->ifname))
+			continue;
+		c = snprintf(buf + used, len - used,
+			     "%-16s %8lu %8zu %8zu %8lu %8lu\n", ap->ifname,
+			     ap->objs, ap->bytes, ap->hiwat, ap->allocs,
+			     ap->fails);
+		if (c < 0 || (size_t)c >= len - used)
+			break;
+		used += c;
+	}
+	return used;
+}
@@ -198,27 +198,12 @@ struct vdp_data *vdp_data(char *ifname)
 	return NULL;
 }
 
-/* vdp_free_tlv - free tlv in vdp_data
- * @vd: vdp_data
- *
- * no return value
- *
- * frees up tlv in vdp_data. used in vdp_free_data.
- */
-static void vdp_free_tlv(struct vdp_data *vd)
-{
-	if (vd) {
-		FREE_UNPKD_TLV(vd, vdp);
-	}
-}
-
 /* vdp_free_data - frees up vdp data
  * @ud: user data structure
  *
  * no return value
  *
- * removes vd_structure from the user_data list. frees up tlv in vdp_data.
- * used in vdp_unregister.
+ * removes vd_structure from the user_data list. used in vdp_unregister.
  */
 static void vdp_free_data(struct vdp_user_data *ud)
 {
@@ -227,7 +212,6 @@ static void vdp_free_data(struct vdp_user_data *ud)
 		while (!LIST_EMPTY(&ud->head)) {
 			vd = LIST_FIRST(&ud->head);
 			LIST_REMOVE(vd, entry);
-			vdp_free_tlv(vd);
 			free(vd);
 		}
 	}
@@ -1210,35 +1194,33 @@ out_err:
 }
 
 /*
- * vdp_bld_vsi_tlv - build the VDP VSI TLV
- * @vd: vdp_data structure for this port
+ * vdp_bld_vsi_tlv - build the packed VDP VSI TLV in place
  * @profile: profile the vsi tlv is created from
+ * @buf: buffer receiving the packed TLV
+ * @len: size of the buffer
  *
- * Returns 0 on success, ENOMEM otherwise
+ * Returns the size of the packed TLV, 0 if it does not fit into the buffer
  *
- * creates a vdp structure from an existing profile
+ * creates a packed vdp tlv from an existing profile
  */
-static int vdp_bld_vsi_tlv(struct vdp_data *vd, struct vsi_profile *profile)
+static size_t vdp_bld_vsi_tlv(struct vsi_profile *profile, u8 *buf,
+			      size_t len)
 {
 	struct mac_vlan *mv;
 	struct mac_vlan_p *mv_p;
 	struct tlv_info_vdp *vdp;
-	int rc = 0;
-	struct unpacked_tlv *tlv = NULL;
-	int size = sizeof(struct tlv_info_vdp) +
+	u16 tl;
+	size_t size = sizeof(struct tlv_info_vdp) +
 		profile->entries * sizeof(struct mac_vlan_p);
 
-	vdp = malloc(size);
-
-	if (!vdp) {
-		LLDPAD_DBG("%s: unable to allocate memory for VDP TLV\n",
-			   __func__);
-		rc = ENOMEM;
-		goto out_err;
-	}
+	if (sizeof(tl) + size > len)
+		return 0;
 
-	memset(vdp, 0, size);
+	tl = htons(ORG_SPECIFIC_TLV << 9 | (size & 0x01ff));
+	memcpy(buf, &tl, sizeof(tl));
 
+	vdp = (struct tlv_info_vdp *)(buf + sizeof(tl));
+	memset(vdp, 0, sizeof(*vdp));
 	hton24(vdp->oui, OUI_IEEE_8021Qbg);
 	vdp->sub = LLDP_VDP_SUBTYPE;
 	vdp->mode = profile->mode;
@@ -1258,109 +1240,28 @@ static int vdp_bld_vsi_tlv(struct vdp_data *vd, struct vsi_profile *profile)
 		mv_p++;
 	}
 
-	tlv = create_tlv();
-	if (!tlv) {
-		rc = ENOMEM;
-		goto out_free;
-	}
-
-	tlv->type = ORG_SPECIFIC_TLV;
-	tlv->length = size;
-	tlv->info = (u8 *)malloc(tlv->length);
-	if(!tlv->info) {
-		free(tlv);
-		tlv = NULL;
-		rc = ENOMEM;
-		goto out_free;
-	}
-
-	FREE_UNPKD_TLV(vd, vdp);
-
-	memcpy(tlv->info, vdp, tlv->length);
-
-	vd->vdp = tlv;
-
-out_free:
-	free(vdp);
-
-out_err:
-	return rc;
+	return sizeof(tl) + size;
 }
 
-/* vdp_bld_tlv - builds a tlv from a profile
+/* vdp_puttlv - put the tlv for a profile into a buffer
  * @vd: vdp_data structure for this port
  * @profile: profile the vsi tlv is created from
+ * @buf: buffer receiving the packed TLV
+ * @len: size of the buffer
  *
- * returns 0 on success, != 0 on error
+ * returns the size of the packed tlv, 0 if it does not fit into the buffer
+ * and < 0 on error
  *
- * wrapper function around vdp_bld_vsi_tlv. adds some checks and calls
- * vdp_bld_vsi_tlv.
+ * this is the interface function called from ecp_build_ECPDU. It builds the
+ * packed tlv for a profile directly in the ecp transmit frame.
  */
-
-static int vdp_bld_tlv(struct vdp_data *vd, struct vsi_profile *profile)
+int vdp_puttlv(struct vdp_data *vd, struct vsi_profile *profile, u8 *buf,
+	       size_t len)
 {
 	if (!port_find_by_ifindex(get_ifidx(vd->ifname)))
 		return -EEXIST;
 
-	if (vdp_bld_vsi_tlv(vd, profile)) {
-		LLDPAD_ERR("%s: %s vdp_bld_vsi_tlv() failed\n",
-				__func__, vd->ifname);
-		return -EINVAL;
-	}
-
-	return 0;
-}
-
-/* vdp_gettlv - get the tlv for a profile
- * @port: the port on which the tlv was received
- * @profile: profile the vsi tlv is created from
- *
- * returns 0 on success
- *
- * this is the interface function called from ecp_build_ECPDU. It returns the
- * packed tlv for a profile.
- */
-struct packed_tlv *vdp_gettlv(struct vdp_data *vd, struct vsi_profile *profile)
-{
-	int size;
-	struct packed_tlv *ptlv = NULL;
-
-	/* frees the unpacked_tlv in vdp_data
-	 * also done in vdp_bld_vsi_tlv */
-	vdp_free_tlv(vd);
-
-	if (vdp_bld_tlv(vd, profile)) {
-		LLDPAD_ERR("%s: %s vdp_bld_tlv failed\n",
-			__func__, vd->ifname);
-		goto out_err;
-	}
-
-	size = TLVSIZE(vd->vdp);
-
-	if (!size) {
-		LLDPAD_ERR("%s: size %i of unpacked_tlv not correct\n",
-			   __func__, size);
-		goto out_err;
-	}
-
-	ptlv = create_ptlv();
-	if (!ptlv)
-		goto out_err;
-
-	ptlv->tlv = malloc(size);
-	if (!ptlv->tlv)
-		goto out_free;
-
-	ptlv->size = 0;
-	PACK_TLV_AFTER(vd->vdp, ptlv, size, out_free);
-
-	return ptlv;
-
-out_free:
-	ptlv = free_pkd_tlv(ptlv);
-out_err:
-	LLDPAD_ERR("%s: %s failed\n", __func__, vd->ifname);
-	return NULL;
+	return vdp_bld_vsi_tlv(profile, buf, len);
 }
 
 /* vdp_macvlan_equal - checks for equality of 2 mac/vlan pairs
@@ -1515,6 +1416,8 @@ int vdp_remove_profile(struct vsi_profile *profile)
 	/* Check if profile exists. If yes, remove it. */
 	p = vdp_find_profile(vd, profile);
 	if (p) {
+		if (vd->lastsent == p)
+			vd->lastsent = NULL;
 		LIST_REMOVE(p, profile);
 		vdp_delete_profile(p);
 		return 0;
@@ -43,6 +43,7 @@
 #include "qbg_utils.h"
 #include "qbg_vdp22_cmds.h"
 #include "qbg_vdp22def.h"
+#include "lldpad_ckpt.h"
 
 #define INIT_FN(name) name##_oui_init
 #define EXTERN_FN(name)\
@@ -59,8 +60,8 @@ struct vdp22_oui_init_s vdp22_oui_init_list[] = {
 	{{0x00, 0x00, 0x0c}, "cisco", INIT_FN(cisco)}
 };
 
-struct vdp22_oui_handler_s vdp22_oui_list[MAX_NUM_OUI];
-unsigned char g_oui_index;
+__thread struct vdp22_oui_handler_s vdp22_oui_list[MAX_NUM_OUI];
+__thread unsigned char g_oui_index;
 
 /*
  * VDP22 helper functions
@@ -262,7 +263,7 @@ static void vdp22_delete_oui(struct vsi22 *p)
 				   ret);
 		}
 	}
-	free(p->oui_str_data);
+	slab22_free(p->oui_str_data);
 }
 
 /*
@@ -272,9 +273,11 @@ void vdp22_delete_vsi(struct vsi22 *p)
 {
 	LLDPAD_DBG("%s:%s vsi:%p(%02x)\n", __func__, p->vdp->ifname, p,
 		   p->vsi[0]);
-	free(p->fdata);
+	vdp22_txbatch_remove(p);
+	vdp22br_unhashvsi(p);
+	slab22_free(p->fdata);
 	vdp22_delete_oui(p);
-	free(p);
+	slab22_free(p);
 }
 
 /*
@@ -533,9 +536,10 @@ static void vdpnl_alloc_vsi_oui(struct vdpnl_vsi *vsi, struct vsi22 *p)
 	if (vsi->ouisz == 0)
 		return;
 	p->no_ouidata = vsi->ouisz;
-	p->oui_str_data = calloc(vsi->ouisz, sizeof(struct vdp22_oui_data_s));
+	p->oui_str_data = slab22_zalloc(p->vdp->mem, vsi->ouisz *
+					sizeof(struct vdp22_oui_data_s));
 	if (!p->oui_str_data) {
-		LLDPAD_ERR("%s: calloc return failure\n", __func__);
+		LLDPAD_ERR("%s: slab22_zalloc return failure\n", __func__);
 		return;
 	}
 	for (idx = 0; idx < vsi->ouisz; idx++) {
@@ -570,16 +574,16 @@ static struct vsi22 *vdp22_alloc_vsi_int(struct vdpnl_vsi *vsi,
 	*rc = -EINVAL;
 	if (vsinl_chk && (!check_vsinl(vsi)))
 		return NULL;
-	p = calloc(1, sizeof(*p));
+	p = slab22_zalloc(vdp->mem, sizeof(*p));
 	if (!p) {
 		*rc = -ENOMEM;
 		return p;
 	}
 
 	p->no_fdata = vsi->macsz;
-	p->fdata = calloc(vsi->macsz, sizeof(struct fid22));
+	p->fdata = slab22_zalloc(vdp->mem, vsi->macsz * sizeof(struct fid22));
 	if (!p->fdata) {
-		free(p);
+		slab22_free(p);
 		*rc = -ENOMEM;
 		return NULL;
 	}
@@ -653,13 +657,16 @@ struct vsi22 *vdp22_copy_vsi(struct vsi22 *old)
 
 	if (!check_vsi(old))
 		return NULL;
-	p = calloc(1, sizeof(*p));
+	p = slab22_zalloc(old->vdp->mem, sizeof(*p));
 	if (!p)
 		return p;
 	*p = *old;
 	p->flags = 0;
 	p->cc_vsi_mode = VDP22_DEASSOC;
-	p->fdata = calloc(p->no_fdata, sizeof(struct fid22));
+	p->brnode.le_prev = NULL;
+	p->brfid = NULL;
+	p->fdata = slab22_zalloc(p->vdp->mem,
+				 p->no_fdata * sizeof(struct fid22));
 	if (!p->fdata)
 		goto error1;
 
@@ -726,6 +733,90 @@ static int data_from_ecp(char *ifname, struct ecp22_to_ulp *ptr)
 	return rc;
 }
 
+static void copy_fid(struct vdpnl_vsi *, struct vsi22 *);
+
+/*
+ * Resubmit the VSIs saved for a warm restart once the VDP protocol is
+ * enabled again on a station. The switch receives the same request, like
+ * a keep alive, and the requestor is not involved.
+ */
+static void vdp22_ckpt_restore(struct vdp22 *vdp)
+{
+	struct vdpnl_vsi vsi;
+	size_t len;
+	void *p;
+	int rc;
+
+	while ((p = ckpt_find(CKPT_VSI22, vdp->ifname, -1, NULL, &len))) {
+		ckpt_consume(p);
+		if (len < sizeof(vsi))
+			continue;
+		memcpy(&vsi, p, sizeof(vsi));
+		if (len != sizeof(vsi) + vsi.macsz * sizeof(*vsi.maclist))
+			continue;
+		vsi.maclist = vsi.macsz ? (struct vdpnl_mac *)((u8 *)p +
+							      sizeof(vsi))
+					: NULL;
+		vsi.oui_list = NULL;
+		vsi.ouisz = 0;
+		rc = vdp22_request(&vsi, 1);
+		LLDPAD_DBG("%s:%s vsi:%02x rc:%d\n", __func__, vdp->ifname,
+			   vsi.vsi_uuid[0], rc);
+	}
+}
+
+/*
+ * Save the associated VSIs of the stations for a warm restart. VSIs with
+ * OUI data are not saved, their format is owned by the OUI handlers.
+ */
+static void vdp22_ckpt_save(void)
+{
+	struct vdp22_user_data *vud;
+	struct vdpnl_vsi vsi;
+	struct vdp22 *vdp;
+	struct vsi22 *p;
+
+	vud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_VDP22);
+	if (!vud)
+		return;
+	LIST_FOREACH(vdp, &vud->head, node) {
+		if (vdp->br)
+			continue;
+		LIST_FOREACH(p, &vdp->vsi22_que, node) {
+			struct iovec iov[2];
+
+			if ((p->flags & VDP22_DELETE_ME) || p->no_ouidata ||
+			    p->cc_vsi_mode == VDP22_DEASSOC)
+				continue;
+			memset(&vsi, 0, sizeof(vsi));
+			copy_fid(&vsi, p);
+			if (p->no_fdata && !vsi.maclist)
+				continue;
+			snprintf(vsi.ifname, sizeof(vsi.ifname), "%s",
+				 vdp->ifname);
+			vsi.nl_version = vdpnl_nlf2;
+			vsi.request = p->vsi_mode;
+			vsi.hints = p->hints;
+			vsi.vsi_typeid = p->type_id;
+			vsi.vsi_typeversion = p->type_ver;
+			vsi.vsi_idfmt = p->vsi_fmt;
+			memcpy(vsi.vsi_mgrid2, p->mgrid, sizeof(vsi.vsi_mgrid2));
+			memcpy(vsi.vsi_uuid, p->vsi, sizeof(vsi.vsi_uuid));
+			if (p->no_fdata) {
+				vsi.req_pid = p->fdata[0].requestor.req_pid;
+				vsi.req_seq = p->fdata[0].requestor.req_seq;
+			}
+			iov[0].iov_base = &vsi;
+			iov[0].iov_len = sizeof(vsi);
+			iov[1].iov_base = vsi.maclist;
+			iov[1].iov_len = vsi.macsz * sizeof(*vsi.maclist);
+			ckpt_add(CKPT_VSI22, vdp->ifname, NEAREST_CUSTOMER_BRIDGE,
+				 iov, 2);
+			free(vsi.maclist);
+		}
+	}
+}
+
 /*
  * Update data exchanged via EVB protocol.
  * Calculate the various time out values based in input parameters.
@@ -748,6 +839,8 @@ static int data_from_evb(char *ifname, struct evb22_to_vdp22 *ptr)
 		LLDPAD_DBG("%s:%s rwd:%d rka:%d gpid:%d retry:%d rte:%d evb:%d\n",
 			   __func__, ifname, ptr->max_rwd, ptr->max_rka,
 			   ptr->gpid, ptr->max_retry, ptr->max_rte, ptr->evbon);
+		if (vdp->evbon && !vdp->br)
+			vdp22_ckpt_restore(vdp);
 		rc = 0;
 	}
 	return rc;
@@ -780,7 +873,10 @@ static void vdp22_free_elem(struct vdp22 *vdp)
 
 		vdp22_listdel_vsi(p);
 	}
+	vdp22_txbatch_free(vdp);
+	vdp22br_destroy(vdp);
 	LIST_REMOVE(vdp, node);
+	slab22_acct_put(vdp->mem);
 	free(vdp);
 }
 
@@ -835,8 +931,12 @@ static struct vdp22 *vdp22_create(const char *ifname,
 		return NULL;
 	}
 	strncpy(vdp->ifname, ifname, sizeof vdp->ifname);
+	vdp->mem = slab22_acct_get(ifname);
 	vdp->myrole = role;
+	if (role == VDP22_BRIDGE)
+		vdp->br = vdp22br_create(vdp);
 	LIST_INIT(&vdp->vsi22_que);
+	LIST_INIT(&vdp->txbatch_que);
 	LIST_INSERT_HEAD(&eud->head, vdp, node);
 	LLDPAD_DBG("%s:%s role:%d\n", __func__, ifname, role);
 	return vdp;
@@ -965,6 +1065,7 @@ static const struct lldp_mod_ops vdp22_ops =  {
 	.lldp_mod_notify	= vdp22_notify,
 	.get_arg_handler	= vdp22_arg_handlers,
 	.client_cmd		= clnt,
+	.lldp_mod_ckpt		= vdp22_ckpt_save,
 };
 
 struct lldp_module *vdp22_register(void)
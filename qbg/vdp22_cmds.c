@@ -190,6 +190,12 @@ static int handle_set_arg(struct cmd *cmd, char *arg, char *argvalue,
  * TLVs for pretty printing. This is currently not supported.
  *
  * With flag op_config being set return all currently active VSI associations.
+ *
+ * An accepted set command returns the sequence number assigned to the VSI
+ * request as argument "seq" after the TLV identifier in the reply. The event
+ * message sent when the request completes carries the same "seq" argument.
+ * This allows a client to submit many VSI requests and wait for all of them
+ * on one attached connection.
  */
 int vdp22_clif_cmd(UNUSED void *data, UNUSED struct sockaddr_un *from,
 		   UNUSED socklen_t fromlen,
@@ -356,8 +362,25 @@ static int get_vdp22_retval(int rc)
 	}
 }
 
+/*
+ * Return the next sequence number for a VSI request received via the
+ * control interface. It is returned to the client in the command reply and
+ * again in the event message reporting the completion of the request.
+ * Zero is never used, it means no sequence number.
+ */
+static unsigned long vdp22_nextseq(void)
+{
+	static unsigned long seq;
+	unsigned long n;
+
+	do
+		n = __sync_add_and_fetch(&seq, 1);
+	while (!n);
+	return n;
+}
+
 static int set_arg_vsi3(struct cmd *cmd, char *argvalue, bool test, int size,
-			int oui_size)
+			int oui_size, char *obuf, int obuf_len)
 {
 	cmd_status good_cmd = vdp22_cmdok(cmd, cmd_settlv);
 	int rc;
@@ -387,14 +410,21 @@ static int set_arg_vsi3(struct cmd *cmd, char *argvalue, bool test, int size,
 	good_cmd = ifok(cmd);
 	if (good_cmd != cmd_success || test)
 		goto out;
+	vsi.req_seq = vdp22_nextseq();
 	rc = vdp22_request(&vsi, 1);
 	good_cmd = get_vdp22_retval(rc);
+	if (good_cmd == cmd_success)
+		snprintf(obuf, obuf_len, "%02x%s%04x%lu",
+			 (unsigned int)strlen(VSI22_ARG_SEQ_STR),
+			 VSI22_ARG_SEQ_STR,
+			 snprintf(NULL, 0, "%lu", vsi.req_seq), vsi.req_seq);
 
 out:
 	return good_cmd;
 }
 
-static int set_arg_vsi2(struct cmd *cmd, char *argvalue, bool test)
+static int set_arg_vsi2(struct cmd *cmd, char *argvalue, bool test,
+			char *obuf, int obuf_len)
 {
 	int no = (cmd->ops >> OP_FID_POS) & 0xff;
 	int oui_no = (cmd->ops >> OP_OUI_POS) & 0xff;
@@ -402,21 +432,22 @@ static int set_arg_vsi2(struct cmd *cmd, char *argvalue, bool test)
 	if (no <= 0)
 		return -EINVAL;
 	if ((cmd->ops & op_arg) && (cmd->ops & op_argval))
-		return set_arg_vsi3(cmd, argvalue, test, no, oui_no);
+		return set_arg_vsi3(cmd, argvalue, test, no, oui_no, obuf,
+				    obuf_len);
 	else /* Not supported for now */
 		return cmd_failed;
 }
 
 static int set_arg_vsi(struct cmd *cmd, UNUSED char *arg, char *argvalue,
-			UNUSED char *obuf, UNUSED int obuf_len)
+			char *obuf, int obuf_len)
 {
-	return set_arg_vsi2(cmd, argvalue, false);
+	return set_arg_vsi2(cmd, argvalue, false, obuf, obuf_len);
 }
 
 static int test_arg_vsi(struct cmd *cmd, UNUSED char *arg, char *argvalue,
-			 UNUSED char *obuf, UNUSED int obuf_len)
+			 char *obuf, int obuf_len)
 {
-	return set_arg_vsi2(cmd, argvalue, true);
+	return set_arg_vsi2(cmd, argvalue, true, obuf, obuf_len);
 }
 
 /*
@@ -24,11 +24,18 @@
 ******************************************************************************/
 
 /*
- * VDP22 bridge simulation code. For now return true all the time.
+ * VDP22 bridge simulation code. Resources are granted unless the filter
+ * data conflicts with the filter data of another VSI on the same port.
  * When configured with --enable-debug option
  * special combination of input parameters trigger errors decribed
  * below.
  *
+ * Each bridge port keeps hash indexes of its VSIs (by VSI identifier), of
+ * the filter data in use (by MAC address and VLAN identifier) and of the
+ * group identifiers which were assigned a VLAN identifier by the bridge.
+ * Lookup, conflict check and VLAN identifier allocation do not depend on
+ * the number of VSIs on the port.
+ *
  * TODO
  * Will be replaced by lldpad configuration file section to allow
  * rejection and acception of VSI profiles on a configurable bases.
@@ -36,6 +43,7 @@
  */
 
 #define _GNU_SOURCE
+#include <stdlib.h>
 #include <string.h>
 
 #include <net/if.h>
@@ -48,11 +56,374 @@
 #include "qbg22.h"
 #include "qbg_vdp22.h"
 #include "qbg_utils.h"
+#include "lldp_mod.h"
+#include "lldp.h"
+
+#define	VDP22BR_HASHSZ	1024		/* Buckets per index, power of 2 */
+#define	VDP22BR_VIDMIN	2		/* Lowest VLAN ID assigned to groups */
+#define	VDP22BR_VIDMAX	4094		/* Highest VLAN ID assigned to groups */
+
+struct vdp22br_grp {			/* Group with assigned VLAN ID */
+	LIST_ENTRY(vdp22br_grp) node;	/* Hash chain */
+	unsigned long grpid;		/* Group identifier */
+	unsigned short vid;		/* Assigned VLAN identifier */
+	unsigned long refs;		/* # of filter entries using group */
+};
+
+struct vdp22br_fid {			/* Index entry per filter data entry */
+	LIST_ENTRY(vdp22br_fid) node;	/* Hash chain for MAC,VLAN */
+	struct vsi22 *vsi;		/* Owner, NULL when unused */
+	struct vdp22br_grp *grp;	/* Group when VLAN ID was assigned */
+	unsigned char mac[ETH_ALEN];	/* MAC address */
+	unsigned short vid;		/* VLAN identifier */
+	bool hashed;			/* True when on hash chain */
+};
+
+struct vdp22br {			/* Lookup tables per bridge port */
+	LIST_HEAD(vdp22br_vsihead, vsi22) vsi[VDP22BR_HASHSZ];
+	LIST_HEAD(vdp22br_fidhead, vdp22br_fid) fid[VDP22BR_HASHSZ];
+	LIST_HEAD(vdp22br_grphead, vdp22br_grp) grp[VDP22BR_HASHSZ];
+	unsigned int vidref[VDP22BR_VIDMAX + 1];	/* Users per VLAN ID */
+	unsigned short nextvid;		/* Next VLAN ID to try for a group */
+	unsigned long vsis;		/* # of VSIs in index */
+	unsigned long fids;		/* # of MAC,VLAN entries in index */
+	unsigned long grps;		/* # of groups with assigned VLAN ID */
+	unsigned long conflicts;	/* # of requests rejected */
+};
+
+/*
+ * FNV-1a hash of a byte string, folded to the number of buckets.
+ */
+static unsigned int vdp22br_hash(const void *data, size_t len,
+				 unsigned int seed)
+{
+	const unsigned char *cp = data;
+	unsigned int h = 2166136261U ^ seed;
+
+	while (len--) {
+		h ^= *cp++;
+		h *= 16777619U;
+	}
+	return h & (VDP22BR_HASHSZ - 1);
+}
+
+/*
+ * Allocate the lookup tables for a bridge port. Without tables the bridge
+ * falls back to scan the VSI list and does not check filter data.
+ */
+struct vdp22br *vdp22br_create(struct vdp22 *vdp)
+{
+	struct vdp22br *br = calloc(1, sizeof(*br));
+
+	if (!br) {
+		LLDPAD_ERR("%s:%s unable to allocate bridge tables\n",
+			   __func__, vdp->ifname);
+		return NULL;
+	}
+	br->nextvid = VDP22BR_VIDMIN;
+	return br;
+}
+
+/*
+ * Free the lookup tables of a bridge port. All VSIs have been removed.
+ */
+void vdp22br_destroy(struct vdp22 *vdp)
+{
+	free(vdp->br);
+	vdp->br = NULL;
+}
+
+/*
+ * Return the group entry for a group identifier, NULL if none.
+ */
+static struct vdp22br_grp *vdp22br_findgrp(struct vdp22br *br,
+					   unsigned long grpid)
+{
+	struct vdp22br_grp *gp;
+
+	LIST_FOREACH(gp, &br->grp[vdp22br_hash(&grpid, sizeof(grpid), 0)],
+		     node)
+		if (gp->grpid == grpid)
+			return gp;
+	return NULL;
+}
+
+/*
+ * Find a VLAN ID not used by any filter entry on this port. Start searching
+ * where the last search ended.
+ *
+ * Returns the VLAN ID or 0 if all are in use.
+ */
+static unsigned short vdp22br_allocvid(struct vdp22br *br)
+{
+	unsigned short vid = br->nextvid;
+
+	do {
+		if (!br->vidref[vid]) {
+			br->nextvid = vid < VDP22BR_VIDMAX ? vid + 1
+							   : VDP22BR_VIDMIN;
+			return vid;
+		}
+		vid = vid < VDP22BR_VIDMAX ? vid + 1 : VDP22BR_VIDMIN;
+	} while (vid != br->nextvid);
+	return 0;
+}
+
+/*
+ * Get the group entry for a group identifier. Create it and assign a VLAN ID
+ * when the group is not known yet.
+ */
+static struct vdp22br_grp *vdp22br_getgrp(struct vdp22 *vdp,
+					  unsigned long grpid)
+{
+	struct vdp22br *br = vdp->br;
+	struct vdp22br_grp *gp = vdp22br_findgrp(br, grpid);
+	unsigned short vid;
+
+	if (gp)
+		return gp;
+	vid = vdp22br_allocvid(br);
+	if (!vid)
+		return NULL;
+	gp = slab22_zalloc(vdp->mem, sizeof(*gp));
+	if (!gp)
+		return NULL;
+	gp->grpid = grpid;
+	gp->vid = vid;
+	LIST_INSERT_HEAD(&br->grp[vdp22br_hash(&grpid, sizeof(grpid), 0)],
+			 gp, node);
+	++br->grps;
+	LLDPAD_DBG("%s:%s group:%ld vlan:%d\n", __func__, vdp->ifname,
+		   grpid, vid);
+	return gp;
+}
+
+static void vdp22br_putgrp(struct vdp22br *br, struct vdp22br_grp *gp)
+{
+	if (--gp->refs)
+		return;
+	LIST_REMOVE(gp, node);
+	--br->grps;
+	slab22_free(gp);
+}
+
+/*
+ * Return the index entry for a MAC address and VLAN ID, NULL if none.
+ */
+static struct vdp22br_fid *vdp22br_findfid(struct vdp22br *br,
+					   unsigned char *mac,
+					   unsigned short vid)
+{
+	struct vdp22br_fid *fp;
+
+	LIST_FOREACH(fp, &br->fid[vdp22br_hash(mac, ETH_ALEN, vid)], node)
+		if (fp->vid == vid && !memcmp(fp->mac, mac, ETH_ALEN))
+			return fp;
+	return NULL;
+}
+
+/*
+ * Remove the filter data of a VSI from the indexes.
+ */
+static void vdp22br_unhashfid(struct vsi22 *p)
+{
+	struct vdp22br *br = p->vdp->br;
+	struct vdp22br_fid *fp = p->brfid;
+	unsigned short i;
+
+	if (!fp)
+		return;
+	for (i = 0; i < p->no_fdata; ++i, ++fp) {
+		if (!fp->vsi)
+			continue;
+		if (fp->hashed) {
+			LIST_REMOVE(fp, node);
+			--br->fids;
+		}
+		if (fp->grp)
+			vdp22br_putgrp(br, fp->grp);
+		--br->vidref[fp->vid];
+	}
+	slab22_free(p->brfid);
+	p->brfid = NULL;
+}
+
+/*
+ * Release the groups held while the filter data of a VSI is entered again.
+ */
+static void vdp22br_putgrps(struct vdp22br *br, struct vdp22br_grp **hold,
+			    unsigned short cnt)
+{
+	unsigned short i;
+
+	for (i = 0; i < cnt; ++i)
+		if (hold[i])
+			vdp22br_putgrp(br, hold[i]);
+}
+
+/*
+ * Enter the filter data of a VSI into the indexes. A group with VLAN ID 0
+ * gets the VLAN ID assigned to the group. A MAC address and VLAN ID pair
+ * must not be used by another VSI on this port.
+ *
+ * Groups of previously entered filter data are held until the new entries
+ * are in place, a group keeps its VLAN ID while the VSI changes state.
+ *
+ * Returns 0 on success and the VDP22 error code else.
+ */
+static int vdp22br_hashfid(struct vsi22 *p)
+{
+	struct vdp22br *br = p->vdp->br;
+	struct vdp22br_grp *hold[p->no_fdata ? p->no_fdata : 1];
+	struct vdp22br_fid *fp = p->brfid;
+	unsigned short i;
+	int rc = VDP22_RESP_NOADDR;
+
+	for (i = 0; i < p->no_fdata; ++i) {
+		hold[i] = fp ? fp[i].grp : NULL;
+		if (hold[i])
+			++hold[i]->refs;
+	}
+	vdp22br_unhashfid(p);
+	if (!br || !p->no_fdata)
+		return 0;
+	fp = slab22_zalloc(p->vdp->mem, p->no_fdata * sizeof(*fp));
+	if (!fp) {
+		vdp22br_putgrps(br, hold, p->no_fdata);
+		return VDP22_RESP_NO_RESOURCES;
+	}
+	p->brfid = fp;
+	for (i = 0; i < p->no_fdata; ++i, ++fp) {
+		struct fid22 *fid = &p->fdata[i];
+		struct vdp22br_fid *hit;
+
+		if ((p->fif == VDP22_FFMT_GROUPVID
+		     || p->fif == VDP22_FFMT_GROUPMACVID)
+		    && (hold[i] || !vdp22_get_vlanid(fid->vlan))) {
+			fp->grp = vdp22br_getgrp(p->vdp, fid->grpid);
+			if (!fp->grp) {
+				rc = VDP22_RESP_NO_RESOURCES;
+				goto conflict;
+			}
+			++fp->grp->refs;
+			fid->vlan = vdp22_set_qos(vdp22_get_qos(fid->vlan))
+				    | vdp22_set_vlanid(fp->grp->vid);
+		}
+		fp->vsi = p;
+		fp->vid = vdp22_get_vlanid(fid->vlan);
+		++br->vidref[fp->vid];
+		if (p->fif != VDP22_FFMT_MACVID
+		    && p->fif != VDP22_FFMT_GROUPMACVID)
+			continue;
+		memcpy(fp->mac, fid->mac, sizeof(fp->mac));
+		hit = vdp22br_findfid(br, fp->mac, fp->vid);
+		if (hit) {
+			if (hit->vsi != p)
+				goto conflict;
+			continue;		/* Duplicate in same VSI */
+		}
+		LIST_INSERT_HEAD(&br->fid[vdp22br_hash(fp->mac, ETH_ALEN,
+						       fp->vid)], fp, node);
+		fp->hashed = true;
+		++br->fids;
+	}
+	vdp22br_putgrps(br, hold, p->no_fdata);
+	return 0;
+conflict:
+	LLDPAD_DBG("%s:%s vsi:%p(%02x) filter %d rejected rc:%d\n", __func__,
+		   p->vdp->ifname, p, p->vsi[0], i, rc);
+	++br->conflicts;
+	vdp22br_unhashfid(p);
+	vdp22br_putgrps(br, hold, p->no_fdata);
+	return rc;
+}
+
+/*
+ * Enter a VSI into the VSI index of its bridge port.
+ */
+void vdp22br_hashvsi(struct vsi22 *p)
+{
+	struct vdp22br *br = p->vdp->br;
+
+	if (!br)
+		return;
+	LIST_INSERT_HEAD(&br->vsi[vdp22br_hash(p->vsi, sizeof(p->vsi), 0)], p,
+			 brnode);
+	++br->vsis;
+}
+
+/*
+ * Remove a VSI and its filter data from the indexes of its bridge port.
+ */
+void vdp22br_unhashvsi(struct vsi22 *p)
+{
+	struct vdp22br *br = p->vdp->br;
+
+	if (!br)
+		return;
+	vdp22br_unhashfid(p);
+	if (p->brnode.le_prev) {
+		LIST_REMOVE(p, brnode);
+		p->brnode.le_prev = NULL;
+		--br->vsis;
+	}
+}
+
+/*
+ * Find an allocated VSI using the VSI index of a bridge port.
+ *
+ * Returns pointer to the VSI, NULL if not found.
+ */
+struct vsi22 *vdp22br_findvsi(struct vdp22 *vdp, struct vsi22 *me)
+{
+	struct vsi22 *p;
+
+	LIST_FOREACH(p, &vdp->br->vsi[vdp22br_hash(me->vsi, sizeof(me->vsi),
+						   0)], brnode)
+		if (vdp22_vsi_equal(p, me))
+			return p;
+	return NULL;
+}
+
+/*
+ * Print the usage of the lookup tables of each bridge port into buffer.
+ * Parameter ifname selects one port, all ports are printed if NULL or empty.
+ * Returns the number of bytes written to the buffer.
+ */
+int vdp22br_stats(char *buf, size_t len, const char *ifname)
+{
+	struct vdp22_user_data *vud;
+	struct vdp22 *vdp;
+	size_t used = 0;
+	int c;
+
+	c = snprintf(buf, len, "%-16s %8s %8s %8s %8s\n", "interface", "vsis",
+		     "filters", "groups", "rejects");
+	if (c < 0 || (size_t)c >= len)
+		return 0;
+	used += c;
+	vud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_VDP22);
+	if (!vud)
+		return used;
+	LIST_FOREACH(vdp, &vud->head, node) {
+		struct vdp22br *br = vdp->br;
+
+		if (!br || (ifname && *ifname && strcmp(ifname, vdp->ifname)))
+			continue;
+		c = snprintf(buf + used, len - used,
+			     "%-16s %8lu %8lu %8lu %8lu\n", vdp->ifname,
+			     br->vsis, br->fids, br->grps, br->conflicts);
+		if (c < 0 || (size_t)c >= len - used)
+			break;
+		used += c;
+	}
+	return used;
+}
 
 #ifdef BUILD_DEBUG
-static unsigned char deassoc_buf[256];
-static unsigned char ifname_buf[16];
-static struct qbg22_imm deassoc_qbg;
+static __thread unsigned char deassoc_buf[256];
+static __thread unsigned char ifname_buf[16];
+static __thread struct qbg22_imm deassoc_qbg;
 
 static void deassoc(void *ctx, void *parm)
 {
@@ -118,7 +489,7 @@ static int change_fid(struct vsi22 *p)
 int vdp22br_resources(struct vsi22 *p, int *error)
 {
 	int rc = VDP22_RESP_SUCCESS;
-	static unsigned long called;
+	static __thread unsigned long called;
 
 	*error = 0;
 	++called;
@@ -184,6 +555,12 @@ int vdp22br_resources(struct vsi22 *p, int *error)
 		break;
 	}
 #endif
+	if (rc == VDP22_RESP_SUCCESS && !*error) {
+		*error = vdp22br_hashfid(p);
+		if (*error)
+			rc = VDP22_RESP_DEASSOC;
+	} else if (rc == VDP22_RESP_DEASSOC)
+		vdp22br_unhashfid(p);
 	LLDPAD_DBG("%s:%s resp_vsi_mode:%d rc:%d error:%d\n", __func__,
 		   p->vdp->ifname, p->resp_vsi_mode, rc, *error);
 	return rc;
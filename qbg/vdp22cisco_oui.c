@@ -27,10 +27,12 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <net/if.h>
 #include "messages.h"
 #include "qbg_vdp22def.h"
 #include "qbg_utils.h"
 #include "vdp_cisco.h"
+#include "qbg_vdp22.h"
 
 struct vdp22_oui_handler_s cisco_oui_hndlr = {
 		{0x00, 0x00, 0x0c}, "cisco", cisco_str2vdpnl_hndlr,
@@ -161,13 +163,15 @@ bool cisco_str2vdpnl_hndlr(struct vdpnl_oui_data_s *vdp_oui_p, char *token)
 bool cisco_vdpnl2vsi22_hndlr(void *vsi_data, struct vdpnl_oui_data_s *from,
 			     struct vdp22_oui_data_s *to)
 {
+	struct vsi22 *vsi = (struct vsi22 *)vsi_data;
+
 	if ((from == NULL) || (to == NULL)) {
 		LLDPAD_ERR("%s: NULL arg\n", __func__);
 		return false;
 	}
-	to->data = calloc(1, from->len);
+	to->data = slab22_zalloc(vsi ? vsi->vdp->mem : NULL, from->len);
 	if (to->data == NULL) {
-		LLDPAD_ERR("%s: calloc failure\n", __func__);
+		LLDPAD_ERR("%s: slab22_zalloc failure\n", __func__);
 		return false;
 	}
 	memcpy(to->oui_type, from->oui_type, sizeof(to->oui_type));
@@ -318,7 +322,7 @@ bool cisco_vdp_free_oui(struct vdp22_oui_data_s *vdp_oui_p)
 		LLDPAD_ERR("%s: NULL arg\n", __func__);
 		return false;
 	}
-	free(vdp_oui_p->data);
+	slab22_free(vdp_oui_p->data);
 	vdp_oui_p->len = 0;
 	vdp_oui_p->data = NULL;
 	return true;
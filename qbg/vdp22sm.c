@@ -43,8 +43,10 @@
 #include "eloop.h"
 
 #include "qbg22.h"
+#include "qbg_ecp22.h"
 #include "qbg_vdp22.h"
 #include "qbg_utils.h"
+#include "lldp/stats.h"
 
 /*
  * Set status code
@@ -411,6 +413,209 @@ static void mgr22_2tlv(struct vsi22 *vp, unsigned char *cp)
 	append_nb(cp + offset, vp->mgrid, sizeof(vp->mgrid));
 }
 
+/*
+ * Packed TLVs are built in place in a transmit buffer reserved from ECP22.
+ * ECP22 copies the buffer into the ECP data unit when it is sent.
+ *
+ * Transmit batching. While a batch is open the packed TLVs of all VSIs of an
+ * interface are collected in one ECP22 buffer and queued as one data unit
+ * when the batch is closed. The manager identifier TLV is sent only once at
+ * the start of the data unit, so all VSIs in one data unit must share the
+ * same manager identifier. A VSI with a different manager identifier or a
+ * VSI which does not fit into the data unit flushes the buffer first.
+ */
+static __thread int vdp22_txbatch_open;	/* Nesting level of open batches */
+
+/*
+ * Reserve a transmit buffer of len bytes from ECP22.
+ */
+static int vdp22_ecpget(struct vdp22 *vdp, unsigned short len,
+			unsigned char **buf)
+{
+	struct qbg22_imm qbg;
+	int rc;
+
+	qbg.data_type = VDP22_ECP22_GETBUF;
+	qbg.u.c.len = len;
+	qbg.u.c.data = NULL;
+	rc = modules_notify(LLDP_MOD_ECP22, LLDP_MOD_VDP22, vdp->ifname, &qbg);
+	if (!rc && !qbg.u.c.data)
+		rc = -ENODEV;
+	*buf = qbg.u.c.data;
+	return rc;
+}
+
+/*
+ * Return a transmit buffer with len bytes of data to ECP22 for transmission.
+ * A length of zero releases the buffer.
+ */
+static int vdp22_ecpput(struct vdp22 *vdp, unsigned char *buf,
+			unsigned short len)
+{
+	struct qbg22_imm qbg;
+
+	qbg.data_type = VDP22_ECP22_PUTBUF;
+	qbg.u.c.len = len;
+	qbg.u.c.data = buf;
+	return modules_notify(LLDP_MOD_ECP22, LLDP_MOD_VDP22, vdp->ifname,
+			      &qbg);
+}
+
+/*
+ * Remove a station VSI from the transmit batch of its interface.
+ */
+void vdp22_txbatch_remove(struct vsi22 *p)
+{
+	if (p->flags & VDP22_TXBATCH) {
+		LIST_REMOVE(p, txnode);
+		p->flags &= ~VDP22_TXBATCH;
+	}
+}
+
+/*
+ * Release the transmit batch buffer of an interface without sending it.
+ */
+void vdp22_txbatch_free(struct vdp22 *vdp)
+{
+	if (vdp->txbatch)
+		vdp22_ecpput(vdp, vdp->txbatch, 0);
+	vdp->txbatch = NULL;
+	vdp->txbatch_len = 0;
+}
+
+/*
+ * Hand the batched packed TLVs of an interface to ECP22. A transmit error
+ * is reported to the state machine of each VSI contained in the batch.
+ */
+static void vdp22_txbatch_flush(struct vdp22 *vdp)
+{
+	struct vsi22 *p;
+	int rc;
+
+	if (!vdp->txbatch)
+		return;
+	rc = vdp22_ecpput(vdp, vdp->txbatch, vdp->txbatch_len);
+	LLDPAD_DBG("%s:%s len:%hd rc:%d\n", __func__, vdp->ifname,
+		   vdp->txbatch_len, rc);
+	vdp->txbatch = NULL;
+	vdp->txbatch_len = 0;
+	while ((p = LIST_FIRST(&vdp->txbatch_que))) {
+		vdp22_txbatch_remove(p);
+		if (rc) {
+			p->smi.txmit_error = rc;
+			vdp22st_run(p);
+		}
+	}
+}
+
+/*
+ * Return true when len bytes of packed TLVs following a manager identifier
+ * TLV are added to the transmit batch.
+ */
+static bool vdp22_txbatched(unsigned short len)
+{
+	return vdp22_txbatch_open
+	       && mgr22_ptlv_sz() + len < ECP22_MAXPAYLOAD_LEN;
+}
+
+/*
+ * Reserve room for len bytes of packed TLVs following the manager identifier
+ * TLV of the VSI. Without an open batch a buffer of the exact size is
+ * reserved from ECP22. Otherwise the room is taken from the batch buffer of
+ * the interface. The manager identifier TLV is written here, the caller
+ * builds the remaining TLVs at the location returned in cp and hands them to
+ * ECP22 with vdp22_txput().
+ *
+ * Returns zero on success and errno else.
+ */
+static int vdp22_txget(struct vsi22 *vsi, unsigned short len,
+		       unsigned char **cp)
+{
+	struct vdp22 *vdp = vsi->vdp;
+	unsigned short mlen = mgr22_ptlv_sz();
+	unsigned char *buf;
+	int rc;
+
+	if (!vdp22_txbatched(len)) {
+		rc = vdp22_ecpget(vdp, mlen + len, &buf);
+		if (!rc) {
+			mgr22_2tlv(vsi, buf);
+			*cp = buf + mlen;
+		}
+		return rc;
+	}
+	if (vdp->txbatch) {
+		unsigned char mgr[mlen];
+
+		mgr22_2tlv(vsi, mgr);
+		if (memcmp(vdp->txbatch, mgr, mlen)
+		    || vdp->txbatch_len + len > vdp->txbatch_size)
+			vdp22_txbatch_flush(vdp);
+	}
+	if (!vdp->txbatch) {
+		vdp->txbatch_size = ECP22_MAXPAYLOAD_LEN - 1;
+		rc = vdp22_ecpget(vdp, vdp->txbatch_size, &vdp->txbatch);
+		if (rc)
+			return rc;
+		mgr22_2tlv(vsi, vdp->txbatch);
+		vdp->txbatch_len = mlen;
+	}
+	*cp = vdp->txbatch + vdp->txbatch_len;
+	vdp->txbatch_len += len;
+	return 0;
+}
+
+/*
+ * Send len bytes of packed TLVs built at cp after vdp22_txget() to ECP22.
+ * Without an open batch the data is queued for transmission immediately.
+ * Otherwise it is sent when the batch is flushed. Station VSIs are
+ * remembered to report transmit errors detected when the batch is flushed.
+ *
+ * Returns zero when the data has been accepted and errno else.
+ */
+static int vdp22_txput(struct vsi22 *vsi, unsigned char *cp,
+		       unsigned short len, bool station)
+{
+	struct vdp22 *vdp = vsi->vdp;
+	unsigned short mlen = mgr22_ptlv_sz();
+
+	if (!vdp22_txbatched(len))
+		return vdp22_ecpput(vdp, cp - mlen, mlen + len);
+	if (station && !(vsi->flags & VDP22_TXBATCH)) {
+		LIST_INSERT_HEAD(&vdp->txbatch_que, vsi, txnode);
+		vsi->flags |= VDP22_TXBATCH;
+	}
+	LLDPAD_DBG("%s:%s vsi:%p(%02x) batch-len:%hd\n", __func__,
+		   vdp->ifname, vsi, vsi->vsi[0], vdp->txbatch_len);
+	return 0;
+}
+
+/*
+ * Open a transmit batch. Batches may be nested, data is sent when the
+ * outermost batch is closed.
+ */
+void vdp22_txbatch_begin(void)
+{
+	++vdp22_txbatch_open;
+}
+
+/*
+ * Close a transmit batch and send the collected data of all interfaces.
+ */
+void vdp22_txbatch_end(void)
+{
+	struct vdp22_user_data *vud;
+	struct vdp22 *vdp;
+
+	if (!vdp22_txbatch_open || --vdp22_txbatch_open)
+		return;
+	vud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_VDP22);
+	if (!vud)
+		return;
+	LIST_FOREACH(vdp, &vud->head, node)
+		vdp22_txbatch_flush(vdp);
+}
+
 /*
  * Code for VSI station state machine
  */
@@ -549,24 +754,20 @@ static void vdp22st_wait_syscmd(struct vsi22 *vsip)
 }
 
 /*
- * Station processing state, send packed tlvs to bridge. Allocate send buffer
- * on stack and create packed TLVs.
+ * Station processing state, send packed tlvs to bridge. Create packed TLVs
+ * in the ECP22 transmit buffer.
  */
 static void vdp22st_process(struct vsi22 *vsi)
 {
-	unsigned short len = mgr22_ptlv_sz() + vsi22_ptlv_sz(vsi) +
-			      oui22_ptlv_sz(vsi);
-	unsigned char buf[len];
-	struct qbg22_imm qbg;
+	unsigned short len = vsi22_ptlv_sz(vsi) + oui22_ptlv_sz(vsi);
+	unsigned char *cp;
 
-	qbg.data_type = VDP22_TO_ECP22;
-	qbg.u.c.len = len;
-	qbg.u.c.data = buf;
-	mgr22_2tlv(vsi, buf);
-	vsi22_2tlv(vsi, buf + mgr22_ptlv_sz(), vsi->hints);
-	oui22_2tlv(vsi, buf + mgr22_ptlv_sz() + vsi22_ptlv_sz(vsi));
-	vsi->smi.txmit_error = modules_notify(LLDP_MOD_ECP22, LLDP_MOD_VDP22,
-					       vsi->vdp->ifname, &qbg);
+	vsi->smi.txmit_error = vdp22_txget(vsi, len, &cp);
+	if (!vsi->smi.txmit_error) {
+		vsi22_2tlv(vsi, cp, vsi->hints);
+		oui22_2tlv(vsi, cp + vsi22_ptlv_sz(vsi));
+		vsi->smi.txmit_error = vdp22_txput(vsi, cp, len, true);
+	}
 	if (!vsi->smi.txmit_error) {
 		vdp22st_stop_katimer(vsi);	/* Could still be running */
 		vdp22st_start_acktimer(vsi);
@@ -690,6 +891,9 @@ static void vdp22st_change_state(struct vsi22 *vsi, enum vdp22_states newstate)
 	LLDPAD_DBG("%s:%s state change %s -> %s\n", __func__,
 		   vsi->vdp->ifname, vdp22_states_n[vsi->smi.state],
 		   vdp22_states_n[newstate]);
+	modstats_state(modstats_get(vsi->vdp->ifname, "vdp22"), vdp22_states_n,
+		       sizeof(vdp22_states_n) / sizeof(vdp22_states_n[0]),
+		       newstate);
 	vsi->smi.state = newstate;
 }
 
@@ -933,7 +1137,7 @@ int vdp22_start_localchange_timer(struct vsi22 *p)
  * compares mgrid, type id, type version, id format, id and filter info format
  * returns true if they are equal.
  */
-static bool vdp22_vsi_equal(struct vsi22 *p1, struct vsi22 *p2)
+bool vdp22_vsi_equal(struct vsi22 *p1, struct vsi22 *p2)
 {
 	if (memcmp(p1->mgrid, p2->mgrid, sizeof(p2->mgrid)))
 		return false;
@@ -951,7 +1155,8 @@ static bool vdp22_vsi_equal(struct vsi22 *p1, struct vsi22 *p2)
 }
 
 /*
- * Find a VSI in the list of VSIs already allocated
+ * Find a VSI in the list of VSIs already allocated. The bridge role uses
+ * its VSI index.
  *
  * Returns pointer to already allocated VSI in list, 0 if not.
  */
@@ -959,6 +1164,8 @@ static struct vsi22 *vdp22_findvsi(struct vdp22 *vdp, struct vsi22 *me)
 {
 	struct vsi22 *p;
 
+	if (vdp->br)
+		return vdp22br_findvsi(vdp, me);
 	LIST_FOREACH(p, &vdp->vsi22_que, node) {
 		if (vdp22_vsi_equal(p, me))
 			return p;
@@ -1038,6 +1245,23 @@ bool vdp22_cmp_fdata(struct vsi22 *p, struct vsi22 *vsip)
 	return true;
 }
 
+/*
+ * Remember the sequence number of the latest request for an existing VSI.
+ * The completion of the state change is reported with this number.
+ */
+static void vdp22_cpseq(struct vsi22 *p, struct vsi22 *vsip)
+{
+	int i;
+
+	for (i = 0; i < p->no_fdata; ++i) {
+		struct vsi_origin *o1 = &p->fdata[i].requestor;
+		struct vsi_origin *o2 = &vsip->fdata[i].requestor;
+
+		if (o1->req_pid == o2->req_pid)
+			o1->req_seq = o2->req_seq;
+	}
+}
+
 /*
  * Update a current/existing VSI instance.
  * The next table describes the transition diagram for the VSI instance update:
@@ -1122,6 +1346,7 @@ int vdp22_addreq(struct vsi22 *vsip, struct vdp22 *vdp, bool *modf_vsi)
 			rc = -EINVAL;
 		} else {
 			vdp22_modoui(p, vsip);
+			vdp22_cpseq(p, vsip);
 			rc = vdp22_modvsi(p, vsip->vsi_mode);
 			*modf_vsi = true;
 		}
@@ -1395,7 +1620,9 @@ static void vdp22_ecp22in(UNUSED void *ctx, void *parm)
 			   __func__, vdp->ifname, total_len);
 		return;
 	}
-	return vdp22_input(vdp);
+	vdp22_txbatch_begin();		/* Combine replies to all VSIs */
+	vdp22_input(vdp);
+	vdp22_txbatch_end();
 }
 
 /*
@@ -1557,24 +1784,22 @@ static void vdp22br_addvsi(struct vsi22 *p)
 	p->smi.state = VDP22_BR_BEGIN;
 	p->flags = VDP22_BUSY;
 	LIST_INSERT_HEAD(&p->vdp->vsi22_que, p, node);
+	vdp22br_hashvsi(p);
 	vdp22br_run(p);
 }
 
 /*
- * Send a bridge reply. Allocate send buffer on stack and create packed TLVs.
+ * Send a bridge reply. Create packed TLVs in the ECP22 transmit buffer.
  */
 static void vdp22br_reply(struct vsi22 *vsi)
 {
-	unsigned short len = mgr22_ptlv_sz() + vsi22_ptlv_sz(vsi);
-	unsigned char buf[len];
-	struct qbg22_imm qbg;
+	unsigned short len = vsi22_ptlv_sz(vsi);
+	unsigned char *cp;
 
-	qbg.data_type = VDP22_TO_ECP22;
-	qbg.u.c.len = len;
-	qbg.u.c.data = buf;
-	mgr22_2tlv(vsi, buf);
-	vsi22_2tlv(vsi, buf + mgr22_ptlv_sz(), vsi->status);
-	modules_notify(LLDP_MOD_ECP22, LLDP_MOD_VDP22, vsi->vdp->ifname, &qbg);
+	if (!vdp22_txget(vsi, len, &cp)) {
+		vsi22_2tlv(vsi, cp, vsi->status);
+		vdp22_txput(vsi, cp, len, false);
+	}
 	vsi->flags &= ~VDP22_BUSY;
 	vsi->smi.localchg = false;
 	LLDPAD_DBG("%s:%s len:%hd rc:%d\n", __func__, vsi->vdp->ifname, len,
@@ -1651,6 +1876,10 @@ static void vdp22br_change_state(struct vsi22 *p, enum vdp22br_states new)
 	LLDPAD_DBG("%s:%s state change %s -> %s\n", __func__,
 		   p->vdp->ifname, vdp22br_state_name(p->smi.state),
 		   vdp22br_state_name(new));
+	modstats_state(modstats_get(p->vdp->ifname, "vdp22br"),
+		       vdp22br_states_n,
+		       sizeof(vdp22br_states_n) / sizeof(vdp22br_states_n[0]),
+		       new - VDP22_BR_START);
 	p->smi.state = new;
 }
 
@@ -679,6 +679,14 @@ int vdp_vdpnl2str(struct vdpnl_vsi *p, char *s, size_t length)
 				goto out;
 		}
 	}
+	/* Sequence number assigned to a control interface request */
+	if (p->req_seq) {
+		c = snprintf(s, length, "%02x%s%04x%lu",
+			     (unsigned int)strlen(VSI22_ARG_SEQ_STR),
+			     VSI22_ARG_SEQ_STR, get_strlen_num(p->req_seq),
+			     p->req_seq);
+		s = check_and_update(&total, &length, s, c);
+	}
 
 out:
 	return s ? total : 0;
@@ -484,22 +484,27 @@ struct tlv_info_vdp_nopp {	/* VSI information without profile data */
 }  __attribute__ ((__packed__));
 
 /*
- * Flatten a profile stored as TLV and append it. Skip the first 4 bytes.
- * They contain the OUI already stored.
+ * Flatten the profile last sent as TLV and append it. Skip the first 6
+ * bytes. They contain the TLV header and the OUI already stored.
  * Returns the number of bytes added to the buffer.
  */
 static int add_profile(unsigned char *pdu, size_t pdusz, struct vdp_data *vdp)
 {
-	size_t size = 0;
+	struct vsi_profile *profile = vdp->lastsent;
+	u8 buf[ETH_DATA_LEN];
+	int size;
 
-	if (!vdp->vdp)
-		return size;
-	size = (unsigned)TLVSIZE(vdp->vdp) - 4;
-	if (pdusz >= size)
-		memcpy(pdu, vdp->vdp->info + 4, size);
+	if (!profile)
+		return 0;
+	size = vdp_puttlv(vdp, profile, buf, sizeof(buf));
+	if (size <= 6)
+		return 0;
+	size -= 6;
+	if (pdusz >= (size_t)size)
+		memcpy(pdu, buf + 6, size);
 	else {
 		LLDPAD_ERR("%s: %s buffer size too small (need %d bytes)\n",
-			   __func__, vdp->ifname, TLVSIZE(vdp->vdp));
+			   __func__, vdp->ifname, size + 4);
 		return -1;
 	}
 	return size;
@@ -94,14 +94,68 @@ static void vdpnl_show(struct vdpnl_vsi *vsi)
 }
 
 /*
- * Parse the IFLA_IFLA_VF_PORTIFLA_VF_PORTS block of the netlink message.
+ * Parse one IFLA_VF_PORT entry of the IFLA_VF_PORTS block.
  * Return zero on success and errno else.
  */
-static int vdpnl_vfports(struct nlattr *vfports, struct vdpnl_vsi *vsi)
+static int vdpnl_vfport(struct nlattr *tb_vf_port, struct vdpnl_vsi *vsi)
 {
 	char instance[VDP_UUID_STRLEN + 2];
-	struct nlattr *tb_vf_ports, *tb3[IFLA_PORT_MAX + 1];
-	int rem;
+	struct nlattr *tb3[IFLA_PORT_MAX + 1];
+
+	if (nla_parse_nested(tb3, IFLA_PORT_MAX, tb_vf_port,
+		ifla_port_policy)) {
+		LLDPAD_ERR("%s:IFLA_PORT_MAX parsing failed\n", __func__);
+		return -EINVAL;
+	}
+	if (tb3[IFLA_PORT_VF])
+		LLDPAD_DBG("%s:IFLA_PORT_VF:%d\n", __func__,
+		    *(uint32_t *) RTA_DATA(tb3[IFLA_PORT_VF]));
+	if (tb3[IFLA_PORT_PROFILE])
+		LLDPAD_DBG("%s:IFLA_PORT_PROFILE:%s\n", __func__,
+			   (char *)RTA_DATA(tb3[IFLA_PORT_PROFILE]));
+	if (tb3[IFLA_PORT_HOST_UUID]) {
+		unsigned char *uuid;
+
+		uuid = (unsigned char *)RTA_DATA(tb3[IFLA_PORT_HOST_UUID]);
+		vdp_uuid2str(uuid, instance, sizeof(instance));
+		LLDPAD_DBG("%s:IFLA_PORT_HOST_UUID:%s\n", __func__, instance);
+	}
+	if (tb3[IFLA_PORT_VSI_TYPE]) {
+		struct ifla_port_vsi *pvsi;
+		int tid = 0;
+
+		pvsi = (struct ifla_port_vsi *)
+		    RTA_DATA(tb3[IFLA_PORT_VSI_TYPE]);
+		tid = pvsi->vsi_type_id[2] << 16 |
+		    pvsi->vsi_type_id[1] << 8 |
+		    pvsi->vsi_type_id[0];
+		vsi->vsi_mgrid = pvsi->vsi_mgr_id;
+		vsi->vsi_typeversion = pvsi->vsi_type_version;
+		vsi->vsi_typeid = tid;
+	}
+	if (tb3[IFLA_PORT_INSTANCE_UUID]) {
+		unsigned char *uuid = (unsigned char *)
+			RTA_DATA(tb3[IFLA_PORT_INSTANCE_UUID]);
+		memcpy(vsi->vsi_uuid, uuid, sizeof vsi->vsi_uuid);
+	}
+	if (tb3[IFLA_PORT_REQUEST])
+		vsi->request = *(uint8_t *) RTA_DATA(tb3[IFLA_PORT_REQUEST]);
+	if (tb3[IFLA_PORT_RESPONSE])
+		vsi->response = *(uint16_t *) RTA_DATA(tb3[IFLA_PORT_RESPONSE]);
+	return 0;
+}
+
+/*
+ * Parse the IFLA_VF_PORTS block of the netlink message. Each IFLA_VF_PORT
+ * entry describes one VSI and is stored in the next element of the array
+ * 'vsi', which has room for 'cnt' entries.
+ * Return zero on success and errno else.
+ */
+static int vdpnl_vfports(struct nlattr *vfports, struct vdpnl_vsi *vsi,
+			 int cnt)
+{
+	struct nlattr *tb_vf_ports;
+	int rem, rc, i = 0;
 
 	if (!vfports) {
 		LLDPAD_DBG("%s:FOUND NO IFLA_VF_PORTS\n", __func__);
@@ -114,122 +168,110 @@ static int vdpnl_vfports(struct nlattr *vfports, struct vdpnl_vsi *vsi)
 				   __func__);
 			continue;
 		}
-		if (nla_parse_nested(tb3, IFLA_PORT_MAX, tb_vf_ports,
-			ifla_port_policy)) {
-			LLDPAD_ERR("%s:IFLA_PORT_MAX parsing failed\n",
+		if (i >= cnt) {
+			LLDPAD_ERR("%s:too many IFLA_VF_PORT entries\n",
 				   __func__);
 			return -EINVAL;
 		}
-		if (tb3[IFLA_PORT_VF])
-			LLDPAD_DBG("%s:IFLA_PORT_VF:%d\n", __func__,
-			    *(uint32_t *) RTA_DATA(tb3[IFLA_PORT_VF]));
-		if (tb3[IFLA_PORT_PROFILE])
-			LLDPAD_DBG("%s:IFLA_PORT_PROFILE:%s\n", __func__,
-				   (char *)RTA_DATA(tb3[IFLA_PORT_PROFILE]));
-		if (tb3[IFLA_PORT_HOST_UUID]) {
-			unsigned char *uuid;
-
-			uuid = (unsigned char *)
-				RTA_DATA(tb3[IFLA_PORT_HOST_UUID]);
-			vdp_uuid2str(uuid, instance, sizeof(instance));
-			LLDPAD_DBG("%s:IFLA_PORT_HOST_UUID:%s\n", __func__,
-				   instance);
-		}
-		if (tb3[IFLA_PORT_VSI_TYPE]) {
-			struct ifla_port_vsi *pvsi;
-			int tid = 0;
-
-			pvsi = (struct ifla_port_vsi *)
-			    RTA_DATA(tb3[IFLA_PORT_VSI_TYPE]);
-			tid = pvsi->vsi_type_id[2] << 16 |
-			    pvsi->vsi_type_id[1] << 8 |
-			    pvsi->vsi_type_id[0];
-			vsi->vsi_mgrid = pvsi->vsi_mgr_id;
-			vsi->vsi_typeversion = pvsi->vsi_type_version;
-			vsi->vsi_typeid = tid;
-		}
-		if (tb3[IFLA_PORT_INSTANCE_UUID]) {
-			unsigned char *uuid = (unsigned char *)
-				RTA_DATA(tb3[IFLA_PORT_INSTANCE_UUID]);
-			memcpy(vsi->vsi_uuid, uuid, sizeof vsi->vsi_uuid);
-		}
-		if (tb3[IFLA_PORT_REQUEST])
-			vsi->request =
-				*(uint8_t *) RTA_DATA(tb3[IFLA_PORT_REQUEST]);
-		if (tb3[IFLA_PORT_RESPONSE])
-			vsi->response =
-				*(uint16_t *) RTA_DATA(tb3[IFLA_PORT_RESPONSE]);
+		rc = vdpnl_vfport(tb_vf_ports, &vsi[i++]);
+		if (rc)
+			return rc;
 	}
 	return 0;
 }
 
+/*
+ * Parse one IFLA_VF_INFO entry of the IFLA_VFINFO_LIST block.
+ * Return zero on success and errno else.
+ */
+static int vdpnl_vfinfo(struct nlattr *le1, struct vdpnl_vsi *vsi)
+{
+	struct nlattr *vf[IFLA_VF_MAX + 1];
+	bool have_mac = false, have_vid = false;
+
+	if (nla_type(le1) != IFLA_VF_INFO) {
+		LLDPAD_ERR("%s:parsing of IFLA_VFINFO_LIST failed\n",
+			   __func__);
+		return -EINVAL;
+	}
+	if (nla_parse_nested(vf, IFLA_VF_MAX, le1, ifla_vf_policy)) {
+		LLDPAD_ERR("%s:parsing of IFLA_VF_INFO failed\n", __func__);
+		return -EINVAL;
+	}
+
+	if (vf[IFLA_VF_MAC]) {
+		struct ifla_vf_mac *mac = RTA_DATA(vf[IFLA_VF_MAC]);
+
+		memcpy(vsi->maclist->mac, mac->mac, ETH_ALEN);
+		have_mac = true;
+	}
+
+	if (vf[IFLA_VF_VLAN]) {
+		struct ifla_vf_vlan *vlan = RTA_DATA(vf[IFLA_VF_VLAN]);
+
+		vsi->maclist->vlan = vlan->vlan;
+		vsi->maclist->qos = vlan->qos;
+		have_vid = true;
+	}
+	LLDPAD_DBG("%s:have_vid:%d have_mac:%d\n", __func__, have_vid,
+		   have_mac);
+	if (have_vid && have_mac)
+		vsi->filter_fmt = VDP22_FFMT_MACVID;
+	else if (have_vid)
+		vsi->filter_fmt = VDP22_FFMT_VID;
+	else
+		return -EINVAL;
+	return 0;
+}
+
 /*
  * Parse the IFLA_VFINFO_LIST block of the netlink message.
+ * With one VSI in the message all entries refer to this VSI. With several
+ * VSIs the n-th IFLA_VF_INFO entry holds the filter data of the n-th VSI and
+ * the number of entries must match the number of VSIs.
  * Return zero on success and errno else.
  */
-static int vdpnl_vfinfolist(struct nlattr *vfinfolist, struct vdpnl_vsi *vsi)
+static int vdpnl_vfinfolist(struct nlattr *vfinfolist, struct vdpnl_vsi *vsi,
+			    int cnt)
 {
-	struct nlattr *le1, *vf[IFLA_VF_MAX + 1];
-	int rem;
+	struct nlattr *le1;
+	int rem, rc, i = 0;
 
 	if (!vfinfolist) {
 		LLDPAD_ERR("%s:IFLA_VFINFO_LIST missing\n", __func__);
 		return -EINVAL;
 	}
 	nla_for_each_nested(le1, vfinfolist, rem) {
-		bool have_mac = false, have_vid = false;
-
-		if (nla_type(le1) != IFLA_VF_INFO) {
-			LLDPAD_ERR("%s:parsing of IFLA_VFINFO_LIST failed\n",
-				   __func__);
-			return -EINVAL;
-		}
-		if (nla_parse_nested(vf, IFLA_VF_MAX, le1, ifla_vf_policy)) {
-			LLDPAD_ERR("%s:parsing of IFLA_VF_INFO failed\n",
+		if (i >= cnt) {
+			LLDPAD_ERR("%s:too many IFLA_VF_INFO entries\n",
 				   __func__);
 			return -EINVAL;
 		}
-
-		if (vf[IFLA_VF_MAC]) {
-			struct ifla_vf_mac *mac = RTA_DATA(vf[IFLA_VF_MAC]);
-
-			memcpy(vsi->maclist->mac, mac->mac, ETH_ALEN);
-			have_mac = true;
-		}
-
-		if (vf[IFLA_VF_VLAN]) {
-			struct ifla_vf_vlan *vlan = RTA_DATA(vf[IFLA_VF_VLAN]);
-
-			vsi->maclist->vlan = vlan->vlan;
-			vsi->maclist->qos = vlan->qos;
-			have_vid = true;
-		}
-		LLDPAD_DBG("%s:have_vid:%d have_mac:%d\n", __func__, have_vid,
-			   have_mac);
-		if (have_vid && have_mac)
-			vsi->filter_fmt = VDP22_FFMT_MACVID;
-		else if (have_vid)
-			vsi->filter_fmt = VDP22_FFMT_VID;
-		else
-			return -EINVAL;
+		rc = vdpnl_vfinfo(le1, &vsi[i]);
+		if (rc)
+			return rc;
+		if (cnt > 1)
+			++i;
+	}
+	if (cnt > 1 && i != cnt) {
+		LLDPAD_ERR("%s:%d IFLA_VF_INFO entries for %d VSIs\n",
+			   __func__, i, cnt);
+		return -EINVAL;
 	}
 	return 0;
 }
 
 /*
- * Convert the SETLINK message into internal data structure.
+ * Convert the SETLINK message into internal data structure. The message
+ * attributes have already been parsed into 'tb'. The message may carry
+ * several VSIs, one per IFLA_VF_PORT entry. They are stored in the array
+ * 'vsi', which has room for 'cnt' entries.
  */
-static int vdpnl_set(struct nlmsghdr *nlh, struct vdpnl_vsi *vsi)
+static int vdpnl_set(struct nlmsghdr *nlh, struct nlattr **tb,
+		     struct vdpnl_vsi *vsi, int cnt)
 {
-	struct nlattr *tb[IFLA_MAX + 1];
 	struct ifinfomsg *ifinfo = (struct ifinfomsg *)NLMSG_DATA(nlh);
-	int rc;
-
-	if (nlmsg_parse(nlh, sizeof(struct ifinfomsg),
-			(struct nlattr **)&tb, IFLA_MAX, NULL)) {
-		LLDPAD_ERR("%s:error parsing SETLINK request\n", __func__);
-		return -EINVAL;
-	}
+	int i, rc;
 
 	vsi->ifindex = ifinfo->ifi_index;
 	if (tb[IFLA_IFNAME])
@@ -244,11 +286,17 @@ static int vdpnl_set(struct nlmsghdr *nlh, struct vdpnl_vsi *vsi)
 	}
 	vsi->req_pid = nlh->nlmsg_pid;
 	vsi->req_seq = nlh->nlmsg_seq;
-	rc = vdpnl_vfinfolist(tb[IFLA_VFINFO_LIST], vsi);
+	for (i = 1; i < cnt; ++i) {
+		memcpy(vsi[i].ifname, vsi->ifname, sizeof vsi[i].ifname);
+		vsi[i].ifindex = vsi->ifindex;
+		vsi[i].req_pid = vsi->req_pid;
+		vsi[i].req_seq = vsi->req_seq;
+	}
+	rc = vdpnl_vfinfolist(tb[IFLA_VFINFO_LIST], vsi, cnt);
 	if (!rc) {
-		rc = vdpnl_vfports(tb[IFLA_VF_PORTS], vsi);
-		if (!rc)
-			vdpnl_show(vsi);
+		rc = vdpnl_vfports(tb[IFLA_VF_PORTS], vsi, cnt);
+		for (i = 0; !rc && i < cnt; ++i)
+			vdpnl_show(&vsi[i]);
 	}
 	return rc;
 }
@@ -447,24 +495,63 @@ static int vdpnl_getlink(struct nlmsghdr *nlh, size_t len)
 	return rc;
 }
 
+/*
+ * Return the number of VSIs in a SETLINK message, which is the number of
+ * IFLA_VF_PORT entries. A message without entries counts as one VSI.
+ */
+static int vdpnl_vsicnt(struct nlattr *vfports)
+{
+	struct nlattr *pos;
+	int rem, cnt = 0;
+
+	if (vfports)
+		nla_for_each_nested(pos, vfports, rem)
+			if (nla_type(pos) == IFLA_VF_PORT)
+				++cnt;
+	return cnt ? cnt : 1;
+}
+
 /*
  * Parse incoming command and create a data structure to store the VSI data.
+ * A message with several VSIs is handed over to the VDP module entry by
+ * entry. The reply carries the first error detected.
  */
 static int vdpnl_setlink(struct nlmsghdr *nlh, size_t len)
 {
-	int rc = -ENOMEM;
-	struct vdpnl_mac mac;
-	struct vdpnl_vsi p;
+	struct nlattr *tb[IFLA_MAX + 1];
+	struct vdpnl_mac *mac;
+	struct vdpnl_vsi *p;
+	int i, cnt, rc = -ENOMEM;
 
-	memset(&p, 0, sizeof p);
-	memset(&mac, 0, sizeof mac);
-	p.vsi_idfmt = VDP22_ID_UUID;
-	p.macsz = 1;
-	p.maclist = &mac;
-	rc = vdpnl_set(nlh, &p);
-	if (!rc)
-		rc = vdp22_query(p.ifname) ? vdp22_request(&p, 0)
-					   : vdp_request(&p);
+	if (nlmsg_parse(nlh, sizeof(struct ifinfomsg), tb, IFLA_MAX, NULL)) {
+		LLDPAD_ERR("%s:error parsing SETLINK request\n", __func__);
+		return vdpnl_error(-EINVAL, nlh, len);
+	}
+	cnt = vdpnl_vsicnt(tb[IFLA_VF_PORTS]);
+	p = calloc(cnt, sizeof(*p));
+	mac = calloc(cnt, sizeof(*mac));
+	if (p && mac) {
+		for (i = 0; i < cnt; ++i) {
+			p[i].vsi_idfmt = VDP22_ID_UUID;
+			p[i].macsz = 1;
+			p[i].maclist = &mac[i];
+		}
+		rc = vdpnl_set(nlh, tb, p, cnt);
+	}
+	if (!rc) {
+		bool is22 = vdp22_query(p->ifname);
+
+		LLDPAD_DBG("%s:%s vsi-count:%d\n", __func__, p->ifname, cnt);
+		for (i = 0; i < cnt; ++i) {
+			int err = is22 ? vdp22_request(&p[i], 0)
+				       : vdp_request(&p[i]);
+
+			if (err && !rc)
+				rc = err;
+		}
+	}
+	free(mac);
+	free(p);
 	return vdpnl_error(rc, nlh, len);
 }
 
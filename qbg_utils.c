@@ -36,7 +36,6 @@
 #include "qbg_utils.h"
 
 extern int loglvl;			/* Global lldpad log level */
-extern struct lldp_head lldp_head;
 
 /*
  * hexdump_frame - print raw evb/ecp/vdp frame
@@ -49,7 +48,7 @@ void hexdump_frame(const char *ifname, char *txt, const unsigned char *buf,
 	char buffer[ETH_FRAME_LEN * 3];
 
 	/* Only collect data when the loglvl ensures data printout */
-	if (LOG_DEBUG < loglvl)
+	if (!log_enabled(LOG_DEBUG))
 		return;
 	for (i = 0; i < len; i++) {
 		int c;
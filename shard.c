@@ -0,0 +1,308 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include "lldp_mod.h"
+#include "eloop.h"
+#include "shard.h"
+#include "messages.h"
+
+/* Module list of the calling thread, each shard loads its own modules */
+__thread struct lldp_head lldp_head;
+
+struct shard {
+	pthread_t tid;
+	struct eloop_data *loop;	/* Event loop of the shard */
+	struct eloop_msg stop;		/* Terminates the event loop */
+	int ready;			/* Start function has returned */
+	int rc;				/* Return code of start function */
+};
+
+/* Synchronous call, lives on the stack of the caller */
+struct shard_req {
+	struct eloop_msg msg;		/* Must be first */
+	int (*fn)(void *);
+	void *arg;
+	int rc;
+	int done;
+};
+
+/* Asynchronous call */
+struct shard_msg {
+	struct eloop_msg msg;		/* Must be first */
+	void (*fn)(void *);
+	void *arg;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;		/* Shard started or call done */
+	unsigned int count;		/* # of shards, 0 when not started */
+	unsigned int started;		/* # of threads created */
+	struct shard *s;
+	struct eloop_data *main;	/* Event loop of the main thread */
+	int (*start)(void);
+	void (*stop)(void);
+} shards = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static __thread int shard_cur = -1;	/* Shard of the calling thread */
+
+static void shard_stop_msg(UNUSED struct eloop_msg *msg)
+{
+	eloop_stop();
+}
+
+static void *shard_thread(void *arg)
+{
+	struct shard *s = arg;
+	int rc;
+
+	shard_cur = s - shards.s;
+	rc = eloop_init(NULL);
+	if (rc)
+		goto out;
+	rc = shards.start();
+	pthread_mutex_lock(&shards.lock);
+	s->rc = rc;
+	s->ready = 1;
+	if (!rc)
+		s->loop = eloop_self();
+	pthread_cond_broadcast(&shards.cond);
+	pthread_mutex_unlock(&shards.lock);
+	if (!rc)
+		eloop_run();
+	shards.stop();
+	eloop_destroy();
+	return NULL;
+out:
+	pthread_mutex_lock(&shards.lock);
+	s->rc = rc;
+	s->ready = 1;
+	pthread_cond_broadcast(&shards.cond);
+	pthread_mutex_unlock(&shards.lock);
+	return NULL;
+}
+
+/*
+ * Start count shards, each calls the start function in its own thread and
+ * the stop function before the thread exits. Signals are blocked in the
+ * shards and stay with the main thread.
+ * Returns 0 on success and a negative errno value otherwise.
+ */
+int shard_init(unsigned int count, int (*start)(void), void (*stop)(void))
+{
+	sigset_t all, old;
+	unsigned int i;
+	int rc = 0;
+
+	if (!count)
+		return 0;
+	shards.s = calloc(count, sizeof(*shards.s));
+	if (!shards.s)
+		return -ENOMEM;
+	shards.main = eloop_self();
+	shards.start = start;
+	shards.stop = stop;
+	shards.count = count;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	for (i = 0; i < count; ++i) {
+		struct shard *s = &shards.s[i];
+
+		s->stop.handler = shard_stop_msg;
+		rc = pthread_create(&s->tid, NULL, shard_thread, s);
+		if (rc) {
+			rc = -rc;
+			break;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	shards.started = i;
+
+	pthread_mutex_lock(&shards.lock);
+	for (i = 0; i < shards.started; ++i) {
+		while (!shards.s[i].ready)
+			pthread_cond_wait(&shards.cond, &shards.lock);
+		if (!rc && shards.s[i].rc)
+			rc = shards.s[i].rc < 0 ? shards.s[i].rc : -EIO;
+	}
+	pthread_mutex_unlock(&shards.lock);
+	if (rc) {
+		LLDPAD_ERR("%s:cannot start %u shards:%d\n", __func__, count,
+			   rc);
+		shard_destroy();
+		return rc;
+	}
+	LLDPAD_DBG("%s:started %u shards\n", __func__, count);
+	return 0;
+}
+
+/*
+ * Stop all shards and wait for them. Messages posted by the shards while
+ * stopping are left to the event loop of the main thread.
+ */
+void shard_destroy(void)
+{
+	unsigned int i;
+
+	if (!shards.s)
+		return;
+	for (i = 0; i < shards.started; ++i)
+		if (shards.s[i].loop)
+			eloop_post(shards.s[i].loop, &shards.s[i].stop);
+	for (i = 0; i < shards.started; ++i)
+		pthread_join(shards.s[i].tid, NULL);
+	shards.started = 0;
+	shards.count = 0;
+	free(shards.s);
+	shards.s = NULL;
+}
+
+unsigned int shard_count(void)
+{
+	return shards.count;
+}
+
+/*
+ * Returns the shard of the calling thread, -1 for the main thread.
+ */
+int shard_self(void)
+{
+	return shard_cur;
+}
+
+unsigned int shard_of(int ifindex)
+{
+	if (!shards.count || ifindex <= 0)
+		return 0;
+	return ifindex % shards.count;
+}
+
+/*
+ * Returns true if the calling thread owns the port with the interface
+ * index. Always true without shards.
+ */
+int shard_mine(int ifindex)
+{
+	return !shards.count || (int)shard_of(ifindex) == shard_cur;
+}
+
+static void shard_run(struct eloop_msg *msg)
+{
+	struct shard_req *req = (struct shard_req *)msg;
+
+	req->rc = req->fn(req->arg);
+	pthread_mutex_lock(&shards.lock);
+	req->done = 1;
+	pthread_cond_broadcast(&shards.cond);
+	pthread_mutex_unlock(&shards.lock);
+}
+
+/*
+ * Call fn(arg) on a shard and wait for the result. Only the main thread
+ * may wait for a shard, shards never wait for each other.
+ * Returns the return code of fn.
+ */
+int shard_call(unsigned int shard, int (*fn)(void *), void *arg)
+{
+	struct shard_req req = {
+		.msg.handler = shard_run,
+		.fn = fn,
+		.arg = arg
+	};
+
+	if (!shards.count)
+		return fn(arg);
+	shard %= shards.count;
+	if ((int)shard == shard_cur)
+		return fn(arg);
+	eloop_post(shards.s[shard].loop, &req.msg);
+	pthread_mutex_lock(&shards.lock);
+	while (!req.done)
+		pthread_cond_wait(&shards.cond, &shards.lock);
+	pthread_mutex_unlock(&shards.lock);
+	return req.rc;
+}
+
+/*
+ * Call fn(arg) on every shard one after another, once in the caller
+ * without shards.
+ * Returns 0 or the first nonzero return code of fn.
+ */
+int shard_call_all(int (*fn)(void *), void *arg)
+{
+	unsigned int i;
+	int rc = 0, c;
+
+	if (!shards.count)
+		return fn(arg);
+	for (i = 0; i < shards.count; ++i) {
+		c = shard_call(i, fn, arg);
+		if (!rc)
+			rc = c;
+	}
+	return rc;
+}
+
+static void shard_deliver(struct eloop_msg *msg)
+{
+	struct shard_msg *m = (struct shard_msg *)msg;
+
+	m->fn(m->arg);
+	free(m);
+}
+
+/*
+ * Queue a call of fn(arg) to a shard, -1 is the main thread. Without
+ * shards or when posting to itself fn is called immediately. The argument
+ * is owned by fn.
+ * Returns 0 on success and -ENOMEM otherwise.
+ */
+int shard_post(int shard, void (*fn)(void *), void *arg)
+{
+	struct eloop_data *loop;
+	struct shard_msg *m;
+
+	if (!shards.count || shard == shard_cur) {
+		fn(arg);
+		return 0;
+	}
+	loop = shard < 0 ? shards.main : shards.s[shard % shards.count].loop;
+	m = malloc(sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+	m->msg.handler = shard_deliver;
+	m->fn = fn;
+	m->arg = arg;
+	eloop_post(loop, &m->msg);
+	return 0;
+}
@@ -0,0 +1,558 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+/*
+ * Benchmark program linked with the lldpad core objects. It registers all
+ * TLV modules and sets up one interface the same way lldpad does at start
+ * up, but does not run the event loop. LLDPDUs and ECPDUs are injected
+ * in-process into the receive handlers of the layer 2 sockets, one at a
+ * time and at a controlled rate. The frames are either synthesized or
+ * read from a packet capture file. Each frame is timed and the memory
+ * allocations done by lldpad are counted.
+ *
+ * Must run as root, the interface needs raw sockets. A veth pair keeps
+ * the transmitted frames (LLDP updates and ECP acknowledgements) local.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <syslog.h>
+#include <time.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+
+#include "eloop.h"
+#include "lldpad.h"
+#include "config.h"
+#include "messages.h"
+#include "lldp_mod.h"
+#include "lldp/ports.h"
+#include "lldp/agent.h"
+#include "lldp/states.h"
+#include "lldp/l2_packet.h"
+#include "lldp_mand.h"
+#include "lldp_basman.h"
+#include "lldp_dcbx.h"
+#include "lldp_med.h"
+#include "lldp_8023.h"
+#include "lldp_evb.h"
+#include "lldp_evb22.h"
+#include "qbg22.h"
+#include "qbg_ecp22.h"
+#include "qbg_vdp.h"
+#include "qbg_vdp22.h"
+#include "lldp_8021qaz.h"
+
+/* Globals lldpad.c provides for the core objects */
+char *cfg_file_name = "/tmp/lldpbench.conf";
+bool daemonize = 0;
+int loglvl = LOG_WARNING;
+int omit_tstamp;
+
+void send_event(UNUSED int level, UNUSED u32 moduleid, UNUSED char *msg)
+{
+}
+
+static struct lldp_module *(*register_tlv_table[])(void) = {
+	mand_register,
+	basman_register,
+	dcbx_register,
+	med_register,
+	ieee8023_register,
+	evb_register,
+	evb22_register,
+	vdp_register,
+	vdp22_register,
+	ecp22_register,
+	ieee8021qaz_register,
+	NULL,
+};
+
+/*
+ * Count the allocations done in the lldpad objects. The program is linked
+ * with --wrap for malloc, calloc and realloc.
+ */
+static unsigned long allocs;
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+
+void *__wrap_malloc(size_t size)
+{
+	++allocs;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	++allocs;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	++allocs;
+	return __real_realloc(ptr, size);
+}
+
+static char *progname;
+
+struct frame {
+	unsigned char *buf;
+	size_t len;
+};
+
+struct frames {				/* Captured frames of one protocol */
+	struct frame *f;
+	unsigned long cnt;
+};
+
+struct bench {
+	char *ifname;			/* Interface to inject into */
+	unsigned long count;		/* # of frames per run */
+	unsigned long rate;		/* Frames per second, 0 unlimited */
+	unsigned long apps;		/* # of APP entries in LLDPDUs */
+	bool same;			/* Inject the same LLDPDU */
+	struct frames lldp;		/* Captured LLDPDUs */
+	struct frames ecp;		/* Captured ECPDUs */
+	unsigned long *lat;		/* Latency per frame in ns */
+	struct port *port;
+	struct lldp_agent *agent;
+	struct ecp22 *ecp22;
+};
+
+static unsigned long long now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void init_modules(void)
+{
+	struct lldp_module *module;
+	struct lldp_module *premod = NULL;
+	int i;
+
+	LIST_INIT(&lldp_head);
+	for (i = 0; register_tlv_table[i]; i++) {
+		module = register_tlv_table[i]();
+		if (!module)
+			continue;
+		if (premod)
+			LIST_INSERT_AFTER(premod, module, lldp);
+		else
+			LIST_INSERT_HEAD(&lldp_head, module, lldp);
+		premod = module;
+	}
+}
+
+static void deinit_modules(void)
+{
+	struct lldp_module *module;
+
+	while (lldp_head.lh_first != NULL) {
+		module = lldp_head.lh_first;
+		LIST_REMOVE(lldp_head.lh_first, lldp);
+		module->ops->lldp_mod_unregister(module);
+	}
+}
+
+/*
+ * Add the port and its nearest bridge agent and call the ifup handlers of
+ * all modules, as init_ports() does.
+ */
+static int bench_ifup(struct bench *bp)
+{
+	int ifindex = if_nametoindex(bp->ifname);
+	struct lldp_module *np;
+	struct ecp22_user_data *eud;
+
+	if (!ifindex) {
+		fprintf(stderr, "%s interface %s not found\n", progname,
+			bp->ifname);
+		return -ENODEV;
+	}
+	bp->port = add_port(ifindex, bp->ifname);
+	if (!bp->port) {
+		fprintf(stderr, "%s can not open interface %s\n", progname,
+			bp->ifname);
+		return -EIO;
+	}
+	lldp_add_agent(bp->ifname, NEAREST_BRIDGE);
+	bp->agent = lldp_agent_find_by_type(bp->ifname, NEAREST_BRIDGE);
+	if (!bp->agent)
+		return -ENOMEM;
+	LIST_FOREACH(np, &lldp_head, lldp)
+		if (np->ops->lldp_mod_ifup)
+			np->ops->lldp_mod_ifup(bp->ifname, bp->agent);
+	set_lldp_port_enable(bp->ifname, 1);
+	bp->agent->adminStatus = enabledRxTx;
+
+	ecp22_start(bp->ifname);
+	eud = find_module_user_data_by_id(&lldp_head, LLDP_MOD_ECP22);
+	if (eud)
+		LIST_FOREACH(bp->ecp22, &eud->head, node)
+			if (!strcmp(bp->ecp22->ifname, bp->ifname))
+				break;
+	return 0;
+}
+
+static void bench_ifdown(struct bench *bp)
+{
+	ecp22_stop(bp->ifname);
+	deinit_modules();
+	remove_port(bp->ifname);
+}
+
+static void put_tlv(unsigned char *buf, size_t *pos, int type, size_t len,
+		    const void *data)
+{
+	u16 hdr = htons(type << 9 | len);
+
+	memcpy(buf + *pos, &hdr, sizeof(hdr));
+	memcpy(buf + *pos + sizeof(hdr), data, len);
+	*pos += sizeof(hdr) + len;
+}
+
+/*
+ * Build LLDPDU number i. The system name changes with every frame unless
+ * the same frame is requested, identical frames only refresh the TTL.
+ * The optional 802.1Qaz APP TLV carries apps entries.
+ */
+static size_t lldp_frame(struct bench *bp, unsigned long i, unsigned char *buf)
+{
+	static const u8 mac[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 0x01 };
+	struct l2_ethhdr *eth = (struct l2_ethhdr *)buf;
+	unsigned char data[3 * 160 + 6];
+	size_t pos = ETH_HLEN;
+	unsigned long j;
+	u16 ttl = htons(120);
+	int c;
+
+	memcpy(eth->h_dest, nearest_bridge, ETH_ALEN);
+	memcpy(eth->h_source, mac, ETH_ALEN);
+	eth->h_proto = htons(ETH_P_LLDP);
+	data[0] = 4;		/* Chassis ID is MAC address */
+	memcpy(data + 1, mac, ETH_ALEN);
+	put_tlv(buf, &pos, 1, 1 + ETH_ALEN, data);
+	data[0] = 3;		/* Port ID is MAC address */
+	put_tlv(buf, &pos, 2, 1 + ETH_ALEN, data);
+	put_tlv(buf, &pos, 3, sizeof(ttl), &ttl);
+	c = snprintf((char *)data, sizeof(data), "bench%08lx",
+		     bp->same ? 0 : i);
+	put_tlv(buf, &pos, 5, c, data);
+	if (bp->apps) {
+		data[0] = 0x00;		/* IEEE 802.1 OUI */
+		data[1] = 0x80;
+		data[2] = 0xc2;
+		data[3] = LLDP_8021QAZ_APP;
+		data[4] = 0;
+		for (j = 0; j < bp->apps; ++j) {
+			data[5 + 3 * j] = (j % 8) << 5 | 2;
+			data[6 + 3 * j] = (3260 + j) >> 8;
+			data[7 + 3 * j] = (3260 + j) & 0xff;
+		}
+		put_tlv(buf, &pos, 127, 5 + 3 * bp->apps, data);
+	}
+	put_tlv(buf, &pos, 0, 0, data);
+	if (pos < ETH_ZLEN) {
+		memset(buf + pos, 0, ETH_ZLEN - pos);
+		pos = ETH_ZLEN;
+	}
+	return pos;
+}
+
+/*
+ * Build ECPDU number i, a VDP request with a new sequence number and an
+ * empty payload.
+ */
+static size_t ecp_frame(unsigned long i, unsigned char *buf)
+{
+	static const u8 mac[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 0x01 };
+	struct l2_ethhdr *eth = (struct l2_ethhdr *)buf;
+	struct ecp22_hdr *hdr = (struct ecp22_hdr *)(buf + ETH_HLEN);
+	struct ecp22_hdr ecph;
+
+	memset(buf, 0, ETH_ZLEN);
+	memcpy(eth->h_dest, nearest_customer_bridge, ETH_ALEN);
+	memcpy(eth->h_source, mac, ETH_ALEN);
+	eth->h_proto = htons(ETH_P_ECP22);
+	ecph.ver_op_sub = 0;
+	ecp22_hdr_set_version(&ecph, 1);
+	ecp22_hdr_set_op(&ecph, ECP22_REQUEST);
+	ecp22_hdr_set_subtype(&ecph, ECP22_VDP);
+	hdr->ver_op_sub = htons(ecph.ver_op_sub);
+	hdr->seqno = htons(i + 1);
+	return ETH_ZLEN;
+}
+
+static int cmp_ulong(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_report(struct bench *bp, const char *mode,
+			 unsigned long long elapsed, unsigned long nallocs)
+{
+	unsigned long long sum = 0;
+	unsigned long i, n = bp->count;
+
+	for (i = 0; i < n; ++i)
+		sum += bp->lat[i];
+	qsort(bp->lat, n, sizeof(*bp->lat), cmp_ulong);
+	printf("%-6s %9lu frames %11.0f frames/s %8llu ns/frame "
+	       "%6.2f allocs/frame %8lu p50 %8lu p99 %8lu max ns\n",
+	       mode, n, elapsed ? n * 1e9 / elapsed : 0.0, sum / n,
+	       (double)nallocs / n, bp->lat[n / 2],
+	       bp->lat[(n * 99 + 99) / 100 - 1], bp->lat[n - 1]);
+}
+
+/*
+ * Run one mode: inject count frames into the LLDP or ECP receive handler
+ * or construct and send count LLDPDUs.
+ */
+static int bench_run(struct bench *bp, const char *mode)
+{
+	unsigned char buf[ETH_FRAME_LEN];
+	unsigned long long start, t, gap;
+	unsigned long i, nallocs = 0;
+	struct frames *cap = NULL;
+	struct l2_packet_data *l2 = NULL;
+	struct timespec ts;
+	size_t len = 0;
+
+	if (!strcmp(mode, "lldp")) {
+		l2 = bp->port->l2;
+		cap = &bp->lldp;
+	} else if (!strcmp(mode, "ecp")) {
+		if (!bp->ecp22) {
+			fprintf(stderr, "%s no ECP on %s\n", progname,
+				bp->ifname);
+			return 1;
+		}
+		l2 = bp->ecp22->l2;
+		cap = &bp->ecp;
+	} else if (strcmp(mode, "tx")) {
+		fprintf(stderr, "%s unknown mode %s\n", progname, mode);
+		return 1;
+	}
+	gap = bp->rate ? 1000000000ULL / bp->rate : 0;
+	start = now();
+	for (i = 0; i < bp->count; ++i) {
+		unsigned long a;
+
+		if (gap) {
+			t = start + i * gap;
+			ts.tv_sec = t / 1000000000ULL;
+			ts.tv_nsec = t % 1000000000ULL;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL);
+		}
+		if (cap && cap->cnt) {
+			struct frame *fp = &cap->f[i % cap->cnt];
+
+			len = MIN(fp->len, sizeof(buf));
+			memcpy(buf, fp->buf, len);
+		} else if (cap == &bp->lldp) {
+			len = lldp_frame(bp, i, buf);
+		} else if (cap == &bp->ecp) {
+			len = ecp_frame(i, buf);
+		}
+		a = allocs;
+		t = now();
+		if (cap) {
+			l2_packet_inject(l2, buf, len);
+		} else {
+			mibConstrInfoLLDPDU(bp->port, bp->agent);
+			txFrame(bp->port, bp->agent);
+		}
+		bp->lat[i] = now() - t;
+		nallocs += allocs - a;
+	}
+	bench_report(bp, mode, now() - start, nallocs);
+	return 0;
+}
+
+static u32 swap32(u32 x, bool swap)
+{
+	return swap ? __builtin_bswap32(x) : x;
+}
+
+/*
+ * Read the LLDP and ECP frames from a pcap file with ethernet link type.
+ */
+static int read_capture(struct bench *bp, const char *file)
+{
+	u32 ghdr[6], rhdr[4];
+	unsigned char buf[65536];
+	struct frames *cap;
+	struct frame *fp;
+	bool swap;
+	u16 proto;
+	FILE *f;
+	int rc = -EINVAL;
+
+	f = fopen(file, "r");
+	if (!f) {
+		fprintf(stderr, "%s can not open %s:%s\n", progname, file,
+			strerror(errno));
+		return -errno;
+	}
+	if (fread(ghdr, sizeof(ghdr), 1, f) != 1)
+		goto out;
+	if (ghdr[0] == 0xa1b2c3d4 || ghdr[0] == 0xa1b23c4d)
+		swap = false;
+	else if (ghdr[0] == 0xd4c3b2a1 || ghdr[0] == 0x4d3cb2a1)
+		swap = true;
+	else
+		goto out;
+	if (swap32(ghdr[5], swap) != 1)		/* LINKTYPE_ETHERNET */
+		goto out;
+	while (fread(rhdr, sizeof(rhdr), 1, f) == 1) {
+		u32 len = swap32(rhdr[2], swap);
+
+		if (len > sizeof(buf) || fread(buf, len, 1, f) != 1)
+			goto out;
+		if (len < ETH_HLEN || len > ETH_FRAME_LEN)
+			continue;
+		proto = buf[12] << 8 | buf[13];
+		if (proto == ETH_P_LLDP)
+			cap = &bp->lldp;
+		else if (proto == ETH_P_ECP22)
+			cap = &bp->ecp;
+		else
+			continue;
+		fp = realloc(cap->f, (cap->cnt + 1) * sizeof(*fp));
+		if (!fp) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		cap->f = fp;
+		fp += cap->cnt;
+		fp->buf = malloc(len);
+		if (!fp->buf) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		memcpy(fp->buf, buf, len);
+		fp->len = len;
+		++cap->cnt;
+	}
+	rc = 0;
+out:
+	if (rc)
+		fprintf(stderr, "%s %s is no valid ethernet capture file\n",
+			progname, file);
+	fclose(f);
+	return rc;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [-s] [-i ifname] [-n count] [-r rate] "
+		"[-a apps] [-c capture] [-f configfile] [-V level] "
+		"[mode ...]\n", progname);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	static char *modes[] = { "lldp", "tx", "ecp", NULL };
+	struct bench bench = {
+		.ifname = "veth0",
+		.count = 100000
+	};
+	char **mp = modes;
+	int ch, rc = 0;
+
+	progname = argv[0];
+	while ((ch = getopt(argc, argv, ":a:c:f:i:n:r:sV:")) != EOF)
+		switch (ch) {
+		case 'a':
+			bench.apps = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			if (read_capture(&bench, optarg))
+				return 3;
+			break;
+		case 'f':
+			cfg_file_name = optarg;
+			break;
+		case 'i':
+			bench.ifname = optarg;
+			break;
+		case 'n':
+			bench.count = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			bench.rate = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			bench.same = true;
+			break;
+		case 'V':
+			loglvl = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	if (!bench.count || bench.apps > 160)
+		usage();
+	if (optind < argc)
+		mp = argv + optind;
+	bench.lat = calloc(bench.count, sizeof(*bench.lat));
+	if (!bench.lat) {
+		fprintf(stderr, "%s out of memory\n", progname);
+		return 3;
+	}
+	if (!init_cfg() || eloop_init(NULL)) {
+		fprintf(stderr, "%s can not initialize with %s\n", progname,
+			cfg_file_name);
+		return 4;
+	}
+	init_modules();
+	if (bench_ifup(&bench)) {
+		deinit_modules();
+		destroy_cfg();
+		return 5;
+	}
+	for (; *mp; ++mp)
+		rc |= bench_run(&bench, *mp);
+	bench_ifdown(&bench);
+	destroy_cfg();
+	eloop_destroy();
+	free(bench.lat);
+	return rc;
+}
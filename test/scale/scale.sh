@@ -0,0 +1,325 @@
+#!/bin/bash
+#
+# Scale test for LLDPAD with thousands of ports
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms and conditions of the GNU General Public License,
+# version 2, as published by the Free Software Foundation.
+#
+# This program is distributed in the hope it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+#
+
+#
+# Create N veth pairs between two network name spaces. The lldpad under test
+# runs in name space scale_st on interfaces st0..stN-1, a second lldpad runs
+# in name space scale_br on the peer interfaces br0..brN-1. Both use their
+# own IPC name space for the shared memory segment.
+#
+# The test measures
+# 1. the time until lldpad under test has learned all N neighbors,
+# 2. the time to converge again after flapping a number of links,
+# 3. the time to converge again after the peer lldpad restarted (neighbor
+#    churn, the peer sends shutdown LLDPDUs for all ports),
+# 4. with -e the same with EVB22 negotiated on all ports and with -v count
+#    VSI associations through vdp22brbench on the first port.
+# During the whole run the CPU time and RSS of the lldpad under test and the
+# latency of a ping on its command line interface are sampled every second.
+# The ping is served by the event loop and shows how long it is blocked.
+#
+
+top=$(cd $(dirname $0)/../.. && pwd)
+ports=1000
+flaps=100
+rounds=3
+evb=0
+vsis=0
+timeout=600
+out=/tmp/lldpad-scale
+
+function usage()
+{
+	echo "usage: $0 [-n ports] [-f flaps] [-r rounds] [-e] [-v vsis]" \
+		"[-t timeout] [-o outdir] [-b builddir]" >&2
+	exit 2
+}
+
+while getopts ":n:f:r:ev:t:o:b:" opt
+do
+	case $opt in
+	n) ports=$OPTARG ;;
+	f) flaps=$OPTARG ;;
+	r) rounds=$OPTARG ;;
+	e) evb=1 ;;
+	v) vsis=$OPTARG; evb=1 ;;
+	t) timeout=$OPTARG ;;
+	o) out=$OPTARG ;;
+	b) top=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+[ "$ports" -gt 0 -a "$flaps" -le "$ports" ] || usage
+
+lldpad=$top/lldpad
+lldptool=$top/lldptool
+for i in $lldpad $lldptool
+do
+	if [ ! -x $i ]
+	then
+		echo "$0:$i missing"
+		exit 1
+	fi
+done
+if [ $(id -u) -ne 0 ]
+then
+	echo "$0:must run as root"
+	exit 1
+fi
+
+mkdir -p $out
+samples=$out/samples.txt
+log=$out/summary.txt
+: > $samples
+: > $log
+
+function msg()
+{
+	echo "$(date +%T) $*" | tee -a $log
+}
+
+function now_ms()
+{
+	echo $(($(date +%s%N) / 1000000))
+}
+
+# Create all veth pairs with one ip batch per name space.
+function topo_up()
+{
+	local i
+
+	ip netns add scale_st || exit 1
+	ip netns add scale_br || exit 1
+	for ((i = 0; i < ports; ++i))
+	do
+		echo "link add st$i type veth peer name br$i netns scale_br"
+	done | ip -n scale_st -batch - || exit 1
+	for ((i = 0; i < ports; ++i))
+	do
+		echo "link set st$i up"
+	done | ip -n scale_st -batch -
+	for ((i = 0; i < ports; ++i))
+	do
+		echo "link set br$i up"
+	done | ip -n scale_br -batch -
+}
+
+function topo_down()
+{
+	# Deleting the name spaces deletes all veth pairs
+	ip netns del scale_st 2>/dev/null
+	ip netns del scale_br 2>/dev/null
+}
+
+# Write the configuration file, with -e enable EVB22 on all ports.
+# $1: file name, $2: prefix of interface names, $3: evb mode
+function mkconf()
+{
+	local i
+
+	{
+		echo 'dcbx : { version = "1.0"; dcbx_version = 2; };'
+		if [ $evb -eq 1 ]
+		then
+			echo 'nearest_customer_bridge : {'
+			for ((i = 0; i < ports; ++i))
+			do
+				echo "$2$i : { adminStatus = 3;"
+				echo " tlvid0080c20d : { enableTx = true;"
+				echo "  evbmode = \"$3\"; evbrrreq = true;"
+				echo "  ecpretries = 3; ecprte = 14;"
+				echo "  vdprwd = 20; vdprka = 20; }; };"
+			done
+			echo '};'
+		fi
+	} > $1
+}
+
+# Start lldpad in a name space, $1: name space, $2: config file
+function lldpad_start()
+{
+	rm -f $2.out
+	ip netns exec $1 unshare -i -- $lldpad -p -f $2 > $2.out 2>&1 &
+	sleep 1
+	pgrep -f -- "lldpad -p -f $2" | head -1
+}
+
+function lldpad_stop()
+{
+	[ -n "$1" ] || return
+	kill -s SIGTERM $1 2>/dev/null
+	sleep 1
+	kill -s SIGKILL $1 2>/dev/null
+}
+
+# Sample CPU time in clock ticks, RSS and command line interface latency
+# of the lldpad under test once per second until killed.
+function sampler()
+{
+	local t0 t1 stat rss
+
+	echo "# ms cputicks rss_kb ping_ms" >> $samples
+	while kill -0 $pid_st 2>/dev/null
+	do
+		stat=$(cut -d' ' -f14,15 /proc/$pid_st/stat)
+		rss=$(awk '/VmRSS/ { print $2 }' /proc/$pid_st/status)
+		t0=$(now_ms)
+		ip netns exec scale_st $lldptool ping > /dev/null 2>&1
+		t1=$(now_ms)
+		echo "$t1 $((${stat% *} + ${stat#* })) $rss $((t1 - t0))" \
+			>> $samples
+		sleep 1
+	done
+}
+
+# Wait until lldpad under test has a neighbor on all ports and, with -e,
+# has negotiated EVB. Only ports not yet converged are polled again.
+# Prints the time to converge.
+function converge()
+{
+	local start=$(now_ms) end=$(($(date +%s) + timeout))
+	local todo="$(seq 0 $((ports - 1)))" left i
+
+	while [ -n "$todo" ]
+	do
+		left=""
+		for i in $todo
+		do
+			if ! ip netns exec scale_st $lldptool -t -n -i st$i \
+				-V chassisID 2>/dev/null | fgrep -q "Chassis ID"
+			then
+				left="$left $i"
+			elif [ $evb -eq 1 ] && ! ip netns exec scale_st \
+				$lldptool -t -n -g ncb -i st$i -V evb \
+				2>/dev/null | fgrep -qi "evb"
+			then
+				left="$left $i"
+			fi
+		done
+		todo=$left
+		if [ $(date +%s) -ge $end ]
+		then
+			msg "converge timeout, $(echo $todo | wc -w) ports left"
+			return 1
+		fi
+		[ -n "$todo" ] && sleep 1
+	done
+	msg "converged $ports ports in $(($(now_ms) - start)) ms"
+	return 0
+}
+
+# Take down and bring up flaps randomly selected ports
+function flap()
+{
+	local list=$(shuf -i 0-$((ports - 1)) -n $flaps) i
+
+	for i in $list
+	do
+		echo "link set st$i down"
+	done | ip -n scale_st -batch -
+	sleep 2
+	for i in $list
+	do
+		echo "link set st$i up"
+	done | ip -n scale_st -batch -
+}
+
+function report()
+{
+	awk -v hz=$(getconf CLK_TCK) '
+	/^#/ { next }
+	{
+		if (n == 0) { t0 = $1; c0 = $2 }
+		t1 = $1; c1 = $2
+		if ($3 > rss) rss = $3
+		lat[n++] = $4
+	}
+	END {
+		if (n < 2)
+			exit
+		asort(lat)
+		printf "cpu %.1f%% max rss %d kB ping p50 %d p99 %d max %d ms\n",
+		       (c1 - c0) * 100000 / hz / (t1 - t0), rss,
+		       lat[int(n / 2) + 1], lat[int((n * 99 + 99) / 100)],
+		       lat[n]
+	}' $samples | while read line; do msg "$line"; done
+}
+
+function cleanup()
+{
+	[ -n "$pid_sampler" ] && kill $pid_sampler 2>/dev/null
+	lldpad_stop $pid_st
+	lldpad_stop $pid_br
+	topo_down
+}
+trap cleanup EXIT
+
+topo_down
+msg "creating $ports veth pairs"
+t=$(now_ms)
+topo_up
+msg "created $ports veth pairs in $(($(now_ms) - t)) ms"
+
+mkconf $out/st.conf st station
+mkconf $out/br.conf br bridge
+pid_br=$(lldpad_start scale_br $out/br.conf)
+t=$(now_ms)
+pid_st=$(lldpad_start scale_st $out/st.conf)
+if [ -z "$pid_st" -o -z "$pid_br" ]
+then
+	msg "lldpad not started"
+	exit 1
+fi
+msg "lldpad under test pid $pid_st, peer pid $pid_br"
+sampler &
+pid_sampler=$!
+
+rc=0
+converge || rc=1
+msg "startup to converged $(($(now_ms) - t)) ms"
+
+for ((r = 1; r <= rounds && rc == 0; ++r))
+do
+	msg "round $r: flap $flaps links"
+	flap
+	converge || rc=1
+
+	msg "round $r: restart peer lldpad"
+	lldpad_stop $pid_br
+	pid_br=$(lldpad_start scale_br $out/br.conf)
+	if [ -z "$pid_br" ]
+	then
+		msg "peer lldpad not restarted"
+		rc=1
+		break
+	fi
+	converge || rc=1
+done
+
+if [ $rc -eq 0 -a $vsis -gt 0 ]
+then
+	msg "associate $vsis VSIs on st0"
+	ip netns exec scale_st $top/vdp22brbench -i st0 -n $vsis \
+		-w $timeout | tee -a $log
+	rc=${PIPESTATUS[0]}
+fi
+
+kill $pid_sampler 2>/dev/null
+pid_sampler=
+report
+exit $rc
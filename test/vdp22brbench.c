@@ -0,0 +1,255 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+/*
+ * Benchmark program for lldpad in bridge role.
+ * Connects to a lldpad in station role and submits a large number of VSI
+ * association requests, each with its own VSI identifier, MAC address and
+ * VLAN identifier. The station lldpad sends them to the bridge lldpad
+ * on the other end of the link (a veth pair). The program waits until all
+ * requests have been answered and prints the elapsed time. Then all VSIs
+ * are de-associated the same way.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "clif.h"
+#include "clif_msgs.h"
+#include "qbg_vdp22def.h"
+
+static char *progname;
+static int verbose;
+static struct clif *conn;
+
+struct bench {
+	char *ifname;			/* Station interface */
+	unsigned long count;		/* # of VSIs */
+	unsigned long groups;		/* # of groups, 0 for MAC,VLAN format */
+	int waittime;			/* Max seconds to wait for responses */
+	unsigned long *seq;		/* Sequence numbers of requests */
+	bool *done;			/* Request completed */
+	unsigned short *vid;		/* VLAN ID returned by bridge */
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Build the VSI command for request number i. VLAN identifiers 2..4094 are
+ * used round robin, the MAC address is derived from the request number.
+ * With groups the VLAN identifier is 0 and the bridge assigns one, which
+ * must be used for the de-association.
+ */
+static void bench_cmd(struct bench *bp, const char *mode, unsigned long i,
+		      char *cmd, size_t len)
+{
+	unsigned long vid = bp->groups ? bp->vid[i] : i % 4093 + 2;
+	int c;
+
+	c = snprintf(cmd, len, "%s,bench,1,1,"
+		     "00000000-0000-0000-0000-%012lx,none,%lu-"
+		     "02:00:%02lx:%02lx:%02lx:%02lx", mode, i, vid,
+		     (i >> 24) & 0xff, (i >> 16) & 0xff, (i >> 8) & 0xff,
+		     i & 0xff);
+	if (bp->groups)
+		snprintf(cmd + c, len - c, "-%lu", i % bp->groups + 1);
+}
+
+/*
+ * Mark the request with sequence number seq as completed and return its
+ * number. Requests are sent in order and sequence numbers increase.
+ * Returns -1 when the event does not complete an outstanding request.
+ */
+static long bench_done(struct bench *bp, unsigned long sent,
+		       unsigned long seq)
+{
+	unsigned long lo = 0, hi = sent;
+
+	while (lo < hi) {
+		unsigned long mid = lo + (hi - lo) / 2;
+
+		if (bp->seq[mid] == seq) {
+			if (bp->done[mid])
+				return -1;
+			bp->done[mid] = true;
+			return mid;
+		}
+		if (bp->seq[mid] < seq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+/*
+ * Receive completion events. Wait at most waittime seconds for the first one.
+ * Returns the number of requests completed.
+ */
+static unsigned long bench_recv(struct bench *bp, unsigned long sent,
+				int waittime)
+{
+	char reply[MAX_CLIF_MSGBUF];
+	unsigned long seq, cnt = 0;
+	size_t len;
+	long idx;
+	char *cp;
+	int rc;
+
+	for (;;) {
+		len = sizeof(reply) - 1;
+		rc = clif_vsicompl(conn, reply, &len, &seq, waittime);
+		if (rc == -EBADF)
+			continue;
+		if (rc)
+			break;
+		if (verbose > 1)
+			printf("event seq:%lu %s\n", seq, reply);
+		idx = bench_done(bp, sent, seq);
+		if (idx < 0)
+			continue;
+		++cnt;
+		/* Last field is filter data: vlan-mac-group */
+		cp = strrchr(reply, ',');
+		if (bp->groups && cp)
+			bp->vid[idx] = strtoul(cp + 1, NULL, 10);
+		waittime = 0;
+	}
+	return cnt;
+}
+
+/*
+ * Send all requests of one mode and wait for their completion.
+ */
+static int bench_run(struct bench *bp, const char *mode, unsigned int tlvid)
+{
+	char cmd[MAX_CLIF_MSGBUF], reply[MAX_CLIF_MSGBUF];
+	unsigned long i, sent = 0, failed = 0, completed = 0;
+	double start, elapsed;
+	size_t len;
+	time_t end;
+
+	memset(bp->done, 0, bp->count * sizeof(*bp->done));
+	start = now();
+	for (i = 0; i < bp->count; ++i) {
+		bench_cmd(bp, mode, i, cmd, sizeof(cmd));
+		len = sizeof(reply) - 1;
+		if (clif_vsi(conn, bp->ifname, tlvid, cmd, reply, &len)) {
+			if (verbose)
+				fprintf(stderr, "%s %s rejected\n", progname,
+					cmd);
+			++failed;
+			continue;
+		}
+		bp->seq[sent++] = clif_vsiseq(reply, len);
+		completed += bench_recv(bp, sent, 0);
+	}
+	end = time(NULL) + bp->waittime;
+	while (completed < sent && time(NULL) < end)
+		completed += bench_recv(bp, sent, 1);
+	elapsed = now() - start;
+	printf("%-8s %8lu sent %8lu completed %8lu rejected %10.3f s "
+	       "%10.1f req/s\n", mode, sent, completed, failed, elapsed,
+	       elapsed > 0 ? completed / elapsed : 0.0);
+	return completed == sent && !failed ? 0 : 1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [-v] [-i ifname] [-n count] [-g groups] "
+		"[-w seconds]\n", progname);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench bench = {
+		.ifname = "veth0",
+		.count = 1000,
+		.waittime = 60
+	};
+	int ch, rc;
+
+	progname = argv[0];
+	while ((ch = getopt(argc, argv, ":i:n:g:w:v")) != EOF)
+		switch (ch) {
+		case 'i':
+			bench.ifname = optarg;
+			break;
+		case 'n':
+			bench.count = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			bench.groups = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			bench.waittime = atoi(optarg);
+			break;
+		case 'v':
+			++verbose;
+			break;
+		default:
+			usage();
+		}
+	if (optind != argc || !bench.count || bench.waittime < 0)
+		usage();
+	bench.seq = calloc(bench.count, sizeof(*bench.seq));
+	bench.done = calloc(bench.count, sizeof(*bench.done));
+	bench.vid = calloc(bench.count, sizeof(*bench.vid));
+	if (!bench.seq || !bench.done || !bench.vid) {
+		fprintf(stderr, "%s out of memory\n", progname);
+		return 3;
+	}
+	conn = clif_open();
+	if (!conn) {
+		fprintf(stderr, "%s can not open connection to LLDPAD\n",
+			progname);
+		return 5;
+	}
+	if (clif_attach(conn, "80c4")) {
+		fprintf(stderr, "%s can not attach to LLDPAD\n", progname);
+		clif_close(conn);
+		return 5;
+	}
+	rc = bench_run(&bench, "assoc", VDP22_ASSOC);
+	rc |= bench_run(&bench, "deassoc", VDP22_DEASSOC);
+	clif_detach(conn);
+	clif_close(conn);
+	free(bench.seq);
+	free(bench.done);
+	free(bench.vid);
+	return rc;
+}
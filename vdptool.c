@@ -43,6 +43,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
+#include <time.h>
 
 #include <sys/queue.h>
 
@@ -70,6 +71,8 @@
 
 EXTERN_OUI_FN(cisco);
 
+__thread struct lldp_head lldp_head;
+
 /* The OUI specific handlers should be added here */
 
 vdptool_oui_hndlr_tbl_t oui_hndlr_tbl[] = {
@@ -642,7 +645,7 @@ static void print_cmd_response(char *ibuf, int status)
 		print_all_vsis(ibuf + ioff, false, NULL);
 		break;
 	case cmd_settlv:
-		printf("%s", ibuf + ioff);
+		get_vsi_args(ibuf + ioff, false);
 		break;
 	default:
 		return;
@@ -894,7 +897,10 @@ static int _clif_command(struct clif *clif, char *cmd, int print)
 	int ret;
 	int rc;
 	char reply[MAX_CLIF_MSGBUF];
-	size_t reply_len2 = sizeof(reply);
+	size_t reply_len2;
+	unsigned long seq, evtseq;
+	time_t end = time(NULL) + 5;
+	int wait;
 
 	print_raw_message(cmd, print);
 
@@ -912,12 +918,28 @@ static int _clif_command(struct clif *clif, char *cmd, int print)
 			strerror(errno));
 		return -1;
 	}
+	seq = clif_vsiseq(buf, len);
 	if (print) {
 		buf[len] = '\0';
 		ret = parse_print_message(buf, print);
 	}
 	if (cli_attached) {
-		rc = clif_vsievt(clif, reply, &reply_len2, 5);
+		/*
+		 * Skip events completing requests of other clients, give up
+		 * 5 seconds after the request was sent.
+		 */
+		for (;;) {
+			wait = end - time(NULL);
+			if (wait <= 0) {
+				rc = -ETIMEDOUT;
+				break;
+			}
+			reply_len2 = sizeof(reply) - 1;
+			rc = clif_vsicompl(clif, reply, &reply_len2, &evtseq,
+					   wait);
+			if (rc || !seq || seq == evtseq)
+				break;
+		}
 		if (!rc)
 			print_all_vsis(reply, true, "Response from VDP");
 	}
@@ -0,0 +1,287 @@
+/*******************************************************************************
+
+  LLDP Agent Daemon (LLDPAD) Software
+
+  This program is free software; you can redistribute it and/or modify it
+  under the terms and conditions of the GNU General Public License,
+  version 2, as published by the Free Software Foundation.
+
+  This program is distributed in the hope it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License along with
+  this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+
+  The full GNU General Public License is included in this distribution in
+  the file called "COPYING".
+
+  Contact Information:
+  open-lldp Mailing List <lldp-devel@open-lldp.org>
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include "lldp.h"
+#include "eloop.h"
+#include "worker.h"
+#include "messages.h"
+
+struct worker_job {
+	struct eloop_msg msg;		/* Completion, must be first */
+	struct eloop_data *loop;	/* Event loop of submitter */
+	struct worker_job *next;
+	worker_fn fn;
+	worker_done_fn done;
+	void *arg;
+	int rc;
+};
+
+struct worker {
+	pthread_t tid;
+	pthread_cond_t wakeup;		/* Job queued or stop requested */
+	struct worker_job *head;	/* Queued jobs */
+	struct worker_job **tail;
+	unsigned int queued;		/* # of queued jobs */
+	unsigned int hiwat;		/* Max # of queued jobs */
+	int busy;			/* Job running */
+	unsigned long jobs;		/* # of jobs done */
+};
+
+/*
+ * One lock protects all queues, requests are few and short compared with
+ * the time the drivers take to execute them. Completed jobs are posted to
+ * the event loop of the thread which submitted them.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t idle;		/* A worker finished a job */
+	unsigned int count;		/* # of threads, 0 when not started */
+	struct worker *w;
+	int stop;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER
+};
+
+static struct worker *worker_find(const char *key)
+{
+	unsigned int h = 2166136261U;
+
+	while (*key)
+		h = (h ^ (unsigned char)*key++) * 16777619U;
+	return &pool.w[h % pool.count];
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct worker_job *job;
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (!w->head && !pool.stop)
+			pthread_cond_wait(&w->wakeup, &pool.lock);
+		job = w->head;
+		if (!job)
+			break;
+		w->head = job->next;
+		if (!w->head)
+			w->tail = &w->head;
+		--w->queued;
+		w->busy = 1;
+		pthread_mutex_unlock(&pool.lock);
+
+		job->rc = job->fn(job->arg);
+
+		eloop_post(job->loop, &job->msg);
+		pthread_mutex_lock(&pool.lock);
+		w->busy = 0;
+		++w->jobs;
+		pthread_cond_broadcast(&pool.idle);
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return NULL;
+}
+
+/*
+ * Call the completion function of a finished job.
+ */
+static void worker_complete(struct eloop_msg *msg)
+{
+	struct worker_job *job = (struct worker_job *)msg;
+
+	if (job->done)
+		job->done(job->arg, job->rc);
+	free(job);
+}
+
+/*
+ * Start the worker threads. Signals are blocked in the threads and stay
+ * with the event loop thread.
+ * Returns 0 on success and a negative errno value otherwise, requests are
+ * executed by the caller then.
+ */
+int worker_init(unsigned int threads)
+{
+	sigset_t all, old;
+	unsigned int i;
+	int rc;
+
+	if (!threads)
+		return 0;
+	pool.w = calloc(threads, sizeof(*pool.w));
+	if (!pool.w)
+		return -ENOMEM;
+	pool.stop = 0;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	for (i = 0; i < threads; ++i) {
+		struct worker *w = &pool.w[i];
+
+		w->tail = &w->head;
+		pthread_cond_init(&w->wakeup, NULL);
+		rc = pthread_create(&w->tid, NULL, worker_thread, w);
+		if (rc)
+			break;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	pool.count = i;
+	if (i < threads) {
+		LLDPAD_ERR("%s:cannot create worker thread %u:%d\n", __func__,
+			   i, rc);
+		worker_destroy();
+		return -rc;
+	}
+	LLDPAD_DBG("%s:started %u worker threads\n", __func__, threads);
+	return 0;
+}
+
+/*
+ * Wait for all queued requests and stop the threads. Completion functions
+ * of the caller's requests are called, those of other threads are left to
+ * their event loops. Later requests are executed by the caller.
+ */
+void worker_destroy(void)
+{
+	unsigned int i, count = pool.count;
+
+	if (!pool.w)
+		return;
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = 1;
+	for (i = 0; i < count; ++i)
+		pthread_cond_signal(&pool.w[i].wakeup);
+	pthread_mutex_unlock(&pool.lock);
+	for (i = 0; i < count; ++i) {
+		pthread_join(pool.w[i].tid, NULL);
+		pthread_cond_destroy(&pool.w[i].wakeup);
+	}
+	pthread_mutex_lock(&pool.lock);
+	pool.count = 0;
+	pthread_mutex_unlock(&pool.lock);
+	eloop_run_posted();
+	free(pool.w);
+	pool.w = NULL;
+}
+
+/*
+ * Queue a request. The argument is owned by the request until the
+ * completion function has been called.
+ */
+void worker_submit(const char *key, worker_fn fn, worker_done_fn done,
+		   void *arg)
+{
+	struct worker_job *job = NULL;
+	struct worker *w;
+	int rc;
+
+	if (pool.count)
+		job = malloc(sizeof(*job));
+	if (!job)
+		goto direct;
+	job->msg.handler = worker_complete;
+	job->loop = eloop_self();
+	job->next = NULL;
+	job->fn = fn;
+	job->done = done;
+	job->arg = arg;
+	pthread_mutex_lock(&pool.lock);
+	if (!pool.count || pool.stop) {
+		/* Stopped meanwhile by another thread */
+		pthread_mutex_unlock(&pool.lock);
+		free(job);
+		goto direct;
+	}
+	w = worker_find(key);
+	*w->tail = job;
+	w->tail = &job->next;
+	if (++w->queued > w->hiwat)
+		w->hiwat = w->queued;
+	pthread_cond_signal(&w->wakeup);
+	pthread_mutex_unlock(&pool.lock);
+	return;
+direct:
+	rc = fn(arg);
+	if (done)
+		done(arg, rc);
+}
+
+/*
+ * Wait until all requests queued for key have been executed. Used before
+ * a direct request to the driver to keep the order of requests per
+ * interface. Completion functions are called later by the event loop of
+ * the submitting thread.
+ */
+void worker_sync(const char *key)
+{
+	struct worker *w;
+
+	if (!pool.count)
+		return;
+	pthread_mutex_lock(&pool.lock);
+	if (pool.count) {
+		w = worker_find(key);
+		/* The pool is gone once count is 0 */
+		while (pool.count && (w->head || w->busy))
+			pthread_cond_wait(&pool.idle, &pool.lock);
+	}
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+ * Print the number of requests executed and queued per worker thread.
+ * Returns the number of bytes written to the buffer.
+ */
+int worker_stats(char *buf, size_t len, UNUSED const char *arg)
+{
+	size_t used = 0;
+	unsigned int i;
+	int c;
+
+	c = snprintf(buf, len, "%-8s %10s %8s %8s %4s\n", "worker", "jobs",
+		     "queued", "hiwat", "busy");
+	if (c < 0 || (size_t)c >= len)
+		return 0;
+	used += c;
+	pthread_mutex_lock(&pool.lock);
+	for (i = 0; i < pool.count; ++i) {
+		struct worker *w = &pool.w[i];
+
+		c = snprintf(buf + used, len - used, "%-8u %10lu %8u %8u %4d\n",
+			     i, w->jobs, w->queued, w->hiwat, w->busy);
+		if (c < 0 || (size_t)c >= len - used)
+			break;
+		used += c;
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return used;
+}